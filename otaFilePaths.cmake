@@ -29,9 +29,15 @@ set( OTA_SOURCES
     "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_private.h"
     "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_interface_private.h"
     "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_base64_private.h"
+    "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_event_buffer.h"
+    "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_job_arena_private.h"
+    "${CMAKE_CURRENT_LIST_DIR}/source/include/ota_bitmap_private.h"
     "${CMAKE_CURRENT_LIST_DIR}/source/ota.c"
     "${CMAKE_CURRENT_LIST_DIR}/source/ota_interface.c"
     "${CMAKE_CURRENT_LIST_DIR}/source/ota_base64.c"
+    "${CMAKE_CURRENT_LIST_DIR}/source/ota_event_buffer.c"
+    "${CMAKE_CURRENT_LIST_DIR}/source/ota_job_arena.c"
+    "${CMAKE_CURRENT_LIST_DIR}/source/ota_bitmap.c"
     ${JSON_SOURCES}
     ${TINYCBOR_SOURCES}
 )
@@ -51,7 +57,8 @@ set( OTA_INCLUDE_PRIVATE_DIRS
 
 # OTA library POSIX OS porting source files.
 # Note: user needs to call find_library(LIB_RT rt REQUIRED) and link with
-# ${LIB_RT} because librt is required to use OTA OS POSIX port.
+# ${LIB_RT} because librt is required to use OTA OS POSIX port. The in-process
+# event ring of the port also requires linking with pthread.
 set( OTA_OS_POSIX_SOURCES
     "${CMAKE_CURRENT_LIST_DIR}/source/portable/os/ota_os_posix.c"
 )
@@ -61,6 +68,17 @@ set( OTA_INCLUDE_OS_POSIX_DIRS
     "${CMAKE_CURRENT_LIST_DIR}/source/portable/os"
 )
 
+# OTA library POSIX PAL source files, receiving the files in memory mappings
+# of them.
+set( OTA_PAL_POSIX_SOURCES
+    "${CMAKE_CURRENT_LIST_DIR}/source/portable/pal/ota_pal_posix.c"
+)
+
+# OTA library POSIX PAL include directories.
+set( OTA_INCLUDE_PAL_POSIX_DIRS
+    "${CMAKE_CURRENT_LIST_DIR}/source/portable/pal"
+)
+
 # OTA library FreeRTOS OS porting source files.
 set( OTA_OS_FREERTOS_SOURCES
     "${CMAKE_CURRENT_LIST_DIR}/source/portable/os/ota_os_freertos.c"
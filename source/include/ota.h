@@ -39,6 +39,7 @@
 #include "ota_mqtt_interface.h"
 #include "ota_http_interface.h"
 #include "ota_platform_interface.h"
+#include "ota_job_arena_private.h"
 
 /**
  * @ingroup ota_helpers
@@ -283,7 +284,65 @@ typedef struct OtaAppBuffer
 
 /**
  * @ingroup ota_private_struct_types
- * @brief  The OTA agent is a singleton today. The structure keeps it nice and organized.
+ * @brief Sliding window state used to keep several data block requests in flight.
+ *
+ * The window is sized with an additive increase / multiplicative decrease
+ * scheme: it grows while blocks keep arriving and shrinks when blocks are
+ * dropped or the request timer expires. A window size of zero means the
+ * data interface uses the classic request-and-drain scheme.
+ */
+typedef struct OtaRequestWindow
+{
+    uint32_t windowSize;     /*!< Number of blocks allowed in flight. Zero if the window is disabled. */
+    uint32_t threshold;      /*!< Window size at which growth changes from one block per block received to one block per window received. */
+    uint32_t blocksInFlight; /*!< Number of blocks requested but not received yet. */
+    uint32_t nextBlock;      /*!< Index of the first block not requested yet in the current pass over the file. */
+    uint32_t blocksAcked;    /*!< Number of blocks received since the window last grew. */
+    uint32_t packetsDropped; /*!< Snapshot of the dropped packets statistic used to detect new drops. */
+    uint32_t blocksPerRange; /*!< Maximum number of blocks in one range request. Non-zero if blocks are tagged with their file offset and may arrive out of order. */
+} OtaRequestWindow_t;
+
+/**
+ * @ingroup ota_private_struct_types
+ * @brief MQTT topics and request prefix of the current job, rendered once
+ * rather than for every message.
+ *
+ * A length of zero means the entry has not been rendered yet. The stream
+ * entries are cleared when the transfer of a file starts and the status
+ * topic is rendered again when the active job changes.
+ */
+typedef struct OtaRequestCache
+{
+    char pStatusTopic[ OTA_CACHED_TOPIC_MAX_SIZE ];    /*!< Job status topic of the active job. */
+    uint16_t statusTopicLength;                        /*!< Length of the job status topic. */
+    char pStreamTopic[ OTA_CACHED_TOPIC_MAX_SIZE ];    /*!< Get stream topic of the file being received. */
+    uint16_t streamTopicLength;                        /*!< Length of the get stream topic. */
+    uint8_t pRequestPrefix[ OTA_REQUEST_PREFIX_SIZE ]; /*!< CBOR encoded fields of the get stream request that are the same for the whole file. */
+    size_t requestPrefixLength;                        /*!< Length of the encoded request prefix. */
+} OtaRequestCache_t;
+
+#if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+
+/**
+ * @ingroup ota_private_struct_types
+ * @brief Buffer of contiguous file data blocks written to the file with one call.
+ *
+ * The blocks buffered start at any block of the file and end at most at the
+ * end of the sector holding the first one, a sector being
+ * otaconfigWRITE_COMBINE_SIZE bytes from the start of the file.
+ */
+    typedef struct OtaWriteCombine
+    {
+        uint8_t pBuffer[ otaconfigWRITE_COMBINE_SIZE ]; /*!< Data of the blocks buffered. */
+        uint32_t offset;                                /*!< Offset in the file of the first byte buffered. */
+        uint32_t length;                                /*!< Number of bytes buffered. Zero if the buffer is empty. */
+    } OtaWriteCombine_t;
+#endif
+
+/**
+ * @ingroup ota_private_struct_types
+ * @brief  The context of an OTA agent instance. The agent started by @ref OTA_Init has its own,
+ * the application provides the storage of those started by @ref OTA_InstanceInit.
  */
 
 typedef struct OtaAgentContext
@@ -300,9 +359,56 @@ typedef struct OtaAgentContext
     uint32_t numOfBlocksToReceive;                         /*!< Number of data blocks to receive per data request. */
     OtaAgentStatistics_t statistics;                       /*!< The OTA agent statistics block. */
     uint32_t requestMomentum;                              /*!< The number of requests sent before a response was received. */
+    OtaRequestWindow_t requestWindow;                      /*!< Sliding window of data block requests in flight. */
+    OtaRequestCache_t requestCache;                        /*!< Topics and request prefix rendered for the current job. */
+    uint32_t log2BlockSize;                                /*!< Log base 2 of the block size of the next file, adapted to the link. */
+    uint32_t requestTimeouts;                              /*!< Number of data requests timed out while receiving the current file. */
+    uint32_t requestTicks;                                 /*!< Number of ticks of the request timer. */
+    uint32_t requestDeadline;                              /*!< Tick at which the pending request times out. */
+    bool requestTimerArmed;                                /*!< Set while a request waits for its deadline. */
+    bool requestTimerTicking;                              /*!< Set while the OS request timer is started, shared with the timer callback. */
     OtaInterfaces_t * pOtaInterface;                       /*!< Collection of all interfaces used by the agent. */
     OtaAppCallback_t OtaAppCallback;                       /*!< OTA App callback. */
     uint8_t unsubscribeOnShutdown;                         /*!< Flag to indicate if unsubscribe from job topics should be done at shutdown. */
+    uint32_t agentIndex;                                   /*!< Index of the agent instance, which selects its timers. */
+    uint8_t pJobNameBuffer[ OTA_JOB_ID_MAX_SIZE ];         /*!< Buffer to store job name. */
+    uint8_t pProtocolBuffer[ OTA_PROTOCOL_BUFFER_SIZE ];   /*!< Buffer to store data protocol. */
+    Sig256_t sig256Buffer;                                 /*!< Buffer to store key file signature. */
+    uint32_t currBlock;                                    /*!< The current block for HTTP requests. */
+    uint8_t * pJobDoc;                                     /*!< Copy of the job document of a job with several files, NULL otherwise. */
+    uint32_t jobDocLength;                                 /*!< Length of the copy of the job document. */
+    uint32_t numJobFiles;                                  /*!< Number of files of the current job to receive. */
+    bool jobHasFirmware;                                   /*!< Set once a firmware file of the current job is received. */
+    bool progressPending;                                  /*!< Set when blocks were received since the last progress status. */
+    bool progressTimerStarted;                             /*!< Set from the start of the progress timer until it expires. */
+    #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+        OtaFileContext_t * pFileSinks[ otaconfigMAX_NUM_FILE_SINKS ]; /*!< Additional files written with every block received. */
+        uint32_t numFileSinks;                                        /*!< Number of file sinks added. */
+    #endif
+    #if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+        OtaWriteCombine_t writeCombine; /*!< Blocks received but not written to the file yet. */
+    #endif
+    #if ( otaconfigLATENCY_STATS == 1U )
+        OtaLatencyStatistics_t latency; /*!< Durations of the stages of the downloads. */
+        uint32_t requestTimestamp;      /*!< Time of the first data request not answered yet. */
+    #endif
+    #if ( otaconfigJOB_ARENA_SIZE > 0U )
+        OtaJobArena_t jobArena; /*!< Arena holding the buffers of the current job of the instance. */
+    #endif
+    #if ( otaconfigSTATIC_ONLY == 1U )
+        union
+        {
+            uint8_t pBytes[ otaconfigJOB_ARENA_SIZE ]; /*!< Bytes of the storage. */
+            uint64_t alignment;                        /*!< Aligns the storage for the buffers handed out by the arena. */
+        } jobArenaStorage;                             /*!< Storage of the job arena. */
+        #if ( otaconfigMAX_FILES_PER_JOB > 1U )
+            union
+            {
+                uint8_t pBytes[ OTA_DATA_BLOCK_SIZE ]; /*!< Bytes of the storage. */
+                uint64_t alignment;                    /*!< Aligns the storage as the buffers of the job arena. */
+            } jobDocStorage;                           /*!< Copy of a job document listing more than one file. */
+        #endif
+    #endif
 } OtaAgentContext_t;
 
 /*------------------------- OTA Public API --------------------------*/
@@ -311,8 +417,9 @@ typedef struct OtaAgentContext
  * @brief OTA Agent initialization function.
  *
  * Initialize the OTA engine by starting the OTA Agent ("OTA Task") in the system. This function must
- * be called with the connection client context before calling @ref OTA_CheckForUpdate. Only one
- * OTA Agent may exist.
+ * be called with the connection client context before calling @ref OTA_CheckForUpdate. The task
+ * running @ref OTA_EventProcessingTask for this agent also runs the agent instances started with
+ * @ref OTA_InstanceInit.
  *
  * @param[in] pOtaBuffer Buffers used by the agent to store different params.
  * @param[in] pOtaInterfaces A pointer to the OS context.
@@ -672,7 +779,8 @@ void OTA_EventProcessingTask( void * pUnused );
  * by internal OTA modules to signal agent task.
  *
  * @param[in] pEventMsg Event to be added to the queue
- * @return true If operation is successful, false If the event can not be added
+ * @return true If operation is successful, false If the event can not be added, is NULL or
+ * the agent is stopped.
  *
  * <b>Example</b>
  * Signal OTA agent that a new file block has been received over the http connection.
@@ -710,6 +818,49 @@ void OTA_EventProcessingTask( void * pUnused );
 bool OTA_SignalEvent( const OtaEventMsg_t * const pEventMsg );
 /* @[declare_ota_signalevent] */
 
+/**
+ * @brief Process the pending events of the OTA agent without waiting.
+ *
+ * This runs the agent from an existing loop of the application instead of a task of its own
+ * calling @ref OTA_EventProcessingTask. It receives the pending events with the poll function
+ * of the OS event interface, processes up to maxEvents of them and returns, without waiting
+ * for more. The first call after @ref OTA_Init has the agent ready to be started, as the agent
+ * task would. It must always be called from the same task, and not from the callbacks of the
+ * agent.
+ *
+ * @param[in] maxEvents The maximum number of events to process.
+ *
+ * @return The number of events processed, 0 if none was pending or if the OS event interface
+ * can't poll events.
+ */
+/* @[declare_ota_poll] */
+uint32_t OTA_Poll( uint32_t maxEvents );
+/* @[declare_ota_poll] */
+
+/**
+ * @brief Process an event of the OTA agent at once, in the calling task.
+ *
+ * When the agent is run with @ref OTA_Poll, the MQTT and HTTP callbacks of the application
+ * running in the same task deliver the file blocks with this function instead of
+ * @ref OTA_SignalEvent, and the event is processed before it returns, without going through
+ * the event queue. The events already in the queue are processed first, so that the events
+ * are processed in the order they are signaled. Up to otaconfigEVENT_BATCH_SIZE of them are
+ * processed, if more may be waiting the event is added to the queue behind them, to be
+ * processed by the next call to @ref OTA_Poll. The event is also added to the queue as
+ * @ref OTA_SignalEvent does when the agent is not run with @ref OTA_Poll, when it is called
+ * back by the agent while it processes an event, for example from an MQTT publish that
+ * delivers messages synchronously, or when it is called from another task while the agent
+ * processes events.
+ *
+ * @param[in] pEventMsg Event to be processed.
+ *
+ * @return true If the event is processed or added to the queue, false if the agent is stopped,
+ * pEventMsg is NULL or the event can not be added to the queue.
+ */
+/* @[declare_ota_processevent] */
+bool OTA_ProcessEvent( const OtaEventMsg_t * const pEventMsg );
+/* @[declare_ota_processevent] */
+
 /*---------------------------------------------------------------------------*/
 /*							Statistics API									 */
 /*---------------------------------------------------------------------------*/
@@ -756,6 +907,178 @@ bool OTA_SignalEvent( const OtaEventMsg_t * const pEventMsg );
 OtaErr_t OTA_GetStatistics( OtaAgentStatistics_t * pStatistics );
 /* @[declare_ota_getstatistics] */
 
+#if ( otaconfigLATENCY_STATS == 1U )
+
+/**
+ * @brief Get the durations of the stages of the downloads of the agent.
+ *
+ * Available when @ref otaconfigLATENCY_STATS is 1. The durations are in ticks
+ * of otaconfigLATENCY_TIMESTAMP() and are kept from the initialization of the
+ * agent, they are reset with the packet statistics when @ref OTA_Init is called
+ * again while the agent is running. The summary of a stage not measured yet has
+ * a count of 0.
+ *
+ * @param[out] pStatistics Statistics of the stages of the downloads.
+ *
+ * @return OtaErrNone if the statistics are returned and OtaErrInvalidArg when
+ * pStatistics is NULL.
+ */
+/* @[declare_ota_getlatencystatistics] */
+    OtaErr_t OTA_GetLatencyStatistics( OtaLatencyStatistics_t * pStatistics );
+/* @[declare_ota_getlatencystatistics] */
+#endif
+
+/**
+ * @brief Add a file sink to the OTA agent.
+ *
+ * A file sink is an additional file written with every block of the files received by the
+ * agent, so that one download updates several targets, for example identical devices behind
+ * a gateway or several file slots of a device. The agent passes the sink to the PAL like the
+ * file received: it is created, written, closed and validated, or aborted at the same time.
+ * Before creating it, the agent copies the parameters of the job into it, except for the file
+ * path, the file handle and the block bitmap which belong to the sink.
+ *
+ * The application sets the file path of the sink for the PAL to tell the targets apart. If it
+ * sets a buffer for the block bitmap, the buffer must be large enough for the files of the
+ * jobs, otherwise the bitmap is allocated like the one of the file received. The sink must stay
+ * valid until the agent shuts down, which removes all the sinks.
+ *
+ * @note Add the sinks while the agent is not receiving a file. Up to otaconfigMAX_NUM_FILE_SINKS
+ * sinks can be added.
+ *
+ * @param[in] pFileSink The file context of the sink.
+ *
+ * @return OtaErrNone if the sink is added, OtaErrInvalidArg if the sink is NULL, no more sinks
+ * can be added or a file is being received.
+ */
+/* @[declare_ota_addfilesink] */
+OtaErr_t OTA_AddFileSink( OtaFileContext_t * pFileSink );
+/* @[declare_ota_addfilesink] */
+
+/*---------------------------------------------------------------------------*/
+/*							Instance API									 */
+/*---------------------------------------------------------------------------*/
+
+/**
+ * @brief Start an additional OTA agent instance.
+ *
+ * Initialize an agent instance that downloads its own jobs next to the agent started by
+ * @ref OTA_Init, for example to let a gateway update the devices behind it. The context is
+ * the handle of the instance for the other functions of this API, it must stay valid until
+ * the instance is shut down.
+ *
+ * The instance is run by the task calling @ref OTA_EventProcessingTask, so the agent started
+ * by @ref OTA_Init must be initialized first, and its events go through the event queue of
+ * that agent. Its interfaces may share the connections of that agent, the MQTT callbacks of
+ * the application signal the events of each instance with @ref OTA_InstanceSignalEvent.
+ * Up to otaconfigMAX_NUM_AGENTS agents can run at once.
+ *
+ * @param[in] pAgentCtx Storage for the context of the instance.
+ * @param[in] pOtaBuffer Buffers used by the instance to store different params.
+ * @param[in] pOtaInterfaces A pointer to the interfaces used by the instance.
+ * @param[in] pThingName A pointer to a C string holding the Thing name of the instance.
+ * @param[in] OtaAppCallback Callback function for when an OTA job of the instance is complete.
+ *
+ * @return OtaErrNone if the instance is ready to receive @ref OtaAgentEventStart, OtaErrInvalidArg
+ * if an argument is invalid or no more instances can run, OtaErrAgentStopped if the agent started
+ * by @ref OTA_Init is stopped.
+ */
+/* @[declare_ota_instanceinit] */
+OtaErr_t OTA_InstanceInit( OtaAgentContext_t * pAgentCtx,
+                           OtaAppBuffer_t * pOtaBuffer,
+                           OtaInterfaces_t * pOtaInterfaces,
+                           const uint8_t * pThingName,
+                           OtaAppCallback_t OtaAppCallback );
+/* @[declare_ota_instanceinit] */
+
+/**
+ * @brief Signal an OTA agent instance to shut down.
+ *
+ * Same as @ref OTA_Shutdown for the instance started with @ref OTA_InstanceInit.
+ *
+ * @param[in] pAgentCtx The context of the instance.
+ * @param[in] ticksToWait The number of ticks to wait for the instance to complete the shutdown process.
+ * @param[in] unsubscribeFlag Flag to indicate if unsubscribe operations should be performed from the job topics.
+ *
+ * @return One of the OTA agent states from the OtaState_t enum.
+ */
+/* @[declare_ota_instanceshutdown] */
+OtaState_t OTA_InstanceShutdown( OtaAgentContext_t * pAgentCtx,
+                                 uint32_t ticksToWait,
+                                 uint8_t unsubscribeFlag );
+/* @[declare_ota_instanceshutdown] */
+
+/**
+ * @brief Get the current state of an OTA agent instance.
+ *
+ * @param[in] pAgentCtx The context of the instance.
+ *
+ * @return The current state of the instance.
+ */
+/* @[declare_ota_instancegetstate] */
+OtaState_t OTA_InstanceGetState( const OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_instancegetstate] */
+
+/**
+ * @brief Request for the next available OTA job of an OTA agent instance.
+ *
+ * Same as @ref OTA_CheckForUpdate for the instance started with @ref OTA_InstanceInit.
+ *
+ * @param[in] pAgentCtx The context of the instance.
+ *
+ * @return OtaErrNone if successful, otherwise OtaErrSignalEventFailed.
+ */
+/* @[declare_ota_instancecheckforupdate] */
+OtaErr_t OTA_InstanceCheckForUpdate( OtaAgentContext_t * pAgentCtx );
+/* @[declare_ota_instancecheckforupdate] */
+
+/**
+ * @brief Signal event to an OTA agent instance.
+ *
+ * Same as @ref OTA_SignalEvent for the instance started with @ref OTA_InstanceInit. The event
+ * is added to the event queue of the agent started by @ref OTA_Init, tagged with the instance.
+ *
+ * @param[in] pAgentCtx The context of the instance.
+ * @param[in] pEventMsg Event to be added to the queue.
+ *
+ * @return true If operation is successful, false If the event can not be added, an argument
+ * is NULL or the instance is stopped.
+ */
+/* @[declare_ota_instancesignalevent] */
+bool OTA_InstanceSignalEvent( OtaAgentContext_t * pAgentCtx,
+                              const OtaEventMsg_t * const pEventMsg );
+/* @[declare_ota_instancesignalevent] */
+
+/**
+ * @brief Process an event of an OTA agent instance at once, in the calling task.
+ *
+ * Same as @ref OTA_ProcessEvent for the instance started with @ref OTA_InstanceInit.
+ *
+ * @param[in] pAgentCtx The context of the instance.
+ * @param[in] pEventMsg Event to be processed.
+ *
+ * @return true If the event is processed or added to the queue, false otherwise.
+ */
+/* @[declare_ota_instanceprocessevent] */
+bool OTA_InstanceProcessEvent( OtaAgentContext_t * pAgentCtx,
+                               const OtaEventMsg_t * const pEventMsg );
+/* @[declare_ota_instanceprocessevent] */
+
+/**
+ * @brief Add a file sink to an OTA agent instance.
+ *
+ * Same as @ref OTA_AddFileSink for the instance started with @ref OTA_InstanceInit.
+ *
+ * @param[in] pAgentCtx The context of the instance.
+ * @param[in] pFileSink The file context of the sink.
+ *
+ * @return OtaErrNone if the sink is added, otherwise OtaErrInvalidArg.
+ */
+/* @[declare_ota_instanceaddfilesink] */
+OtaErr_t OTA_InstanceAddFileSink( OtaAgentContext_t * pAgentCtx,
+                                  OtaFileContext_t * pFileSink );
+/* @[declare_ota_instanceaddfilesink] */
+
 /**
  * @brief Error code to string conversion for OTA errors.
  *
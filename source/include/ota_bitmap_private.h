@@ -0,0 +1,76 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_bitmap_private.h
+ * @brief Function declarations for ota_bitmap.c.
+ */
+
+#ifndef OTA_BITMAP_PRIVATE_H
+#define OTA_BITMAP_PRIVATE_H
+
+/* Standard includes. */
+#include <stdint.h>
+
+/**
+ * @brief Find the first bit set in a bitmap, at or after a given bit.
+ *
+ * Bit i of the bitmap is bit ( i % 8 ) of byte ( i / 8 ), the layout of the
+ * block bitmap of a file, where a set bit marks a block still missing.
+ *
+ * @param[in] pBitmap The bitmap.
+ * @param[in] numBits Number of bits in the bitmap.
+ * @param[in] startBit Index of the first bit to look at.
+ *
+ * @return Index of the first bit set, or numBits if there is none.
+ */
+uint32_t otaBitmap_FindFirstSet( const uint8_t * pBitmap,
+                                 uint32_t numBits,
+                                 uint32_t startBit );
+
+/**
+ * @brief Count the bits set in a row from a given bit.
+ *
+ * @param[in] pBitmap The bitmap.
+ * @param[in] numBits Number of bits in the bitmap.
+ * @param[in] startBit Index of the first bit of the run.
+ * @param[in] maxLength Number of bits after which to stop counting.
+ *
+ * @return Length of the run of bits set, at most maxLength.
+ */
+uint32_t otaBitmap_RunLength( const uint8_t * pBitmap,
+                              uint32_t numBits,
+                              uint32_t startBit,
+                              uint32_t maxLength );
+
+/**
+ * @brief Count the bits set in a bitmap.
+ *
+ * @param[in] pBitmap The bitmap.
+ * @param[in] numBits Number of bits in the bitmap.
+ *
+ * @return Number of bits set.
+ */
+uint32_t otaBitmap_CountSet( const uint8_t * pBitmap,
+                             uint32_t numBits );
+
+#endif /* ifndef OTA_BITMAP_PRIVATE_H */
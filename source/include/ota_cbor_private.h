@@ -47,6 +47,9 @@
 
 /**
  * @brief Decode a Get Stream response message from AWS IoT OTA.
+ *
+ * The payload is copied to the buffer pointed to by pPayload, or lent in
+ * place within pMessageBuffer when pPayload points to NULL.
  */
 bool OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pMessageBuffer,
                                                size_t messageSize,
@@ -56,6 +59,30 @@ bool OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pMessageBuffer,
                                                uint8_t ** pPayload,
                                                size_t * pPayloadSize );
 
+/**
+ * @brief Encode the map header and the fields of a Get Stream Request message
+ * that are the same for all the requests of a file.
+ */
+bool OTA_CBOR_Encode_GetStreamRequestPrefix( uint8_t * pMessageBuffer,
+                                             size_t messageBufferSize,
+                                             size_t * pEncodedPrefixSize,
+                                             const char * pClientToken,
+                                             int32_t fileId,
+                                             int32_t blockSize );
+
+/**
+ * @brief Encode the fields of a Get Stream Request message that change with
+ * every request, after the prefix already in the buffer.
+ */
+bool OTA_CBOR_Encode_GetStreamRequestFields( uint8_t * pMessageBuffer,
+                                             size_t messageBufferSize,
+                                             size_t * pEncodedMessageSize,
+                                             size_t prefixSize,
+                                             int32_t blockOffset,
+                                             uint8_t * pBlockBitmap,
+                                             size_t blockBitmapSize,
+                                             int32_t numOfBlocksRequested );
+
 /**
  * @brief Create an encoded Get Stream Request message for the AWS IoT OTA
  * service. The service allows block count or block bitmap to be requested,
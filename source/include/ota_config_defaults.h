@@ -59,6 +59,7 @@
  * to the task being created (the size is specified in words, not bytes!). The amount
  * of stack required is dependent on the application specific parameters,
  * for more information [Link](https://www.freertos.org/FAQMem.html#StackSize)
+ * No task is needed when the application runs the agent with @ref OTA_Poll.
  *
  * <b>Possible values:</b> Any positive 32 bit integer. <br>
  * <b>Default value:</b> Varies by platform
@@ -83,6 +84,9 @@
  * @brief Log base 2 of the size of the file data block message (excluding the
  * header).
  *
+ * This is the largest block size when otaconfigMIN_LOG2_FILE_BLOCK_SIZE is
+ * smaller.
+ *
  * <b>Possible values:</b> Any unsigned 32 integer. <br>
  * <b>Default value:</b> '12'
  */
@@ -90,6 +94,69 @@
     #define otaconfigLOG2_FILE_BLOCK_SIZE    12UL
 #endif
 
+/**
+ * @brief Log base 2 of the smallest file block size the agent adapts down to.
+ *
+ * Each file is received in blocks of one size, chosen when the file is
+ * opened. The size starts at the largest one, otaconfigLOG2_FILE_BLOCK_SIZE,
+ * which sizes the buffers. After a file is received without any request
+ * timing out, the blocks of the next file are twice as large. After a file
+ * where requests timed out more than once every eight blocks, or after
+ * the download is aborted because the
+ * service did not answer, they are half as large.
+ *
+ * @note The stream service only takes blocks of 256 bytes and more, so the
+ * value must not be less than 8.
+ *
+ * <b>Possible values:</b> 8 to otaconfigLOG2_FILE_BLOCK_SIZE. <br>
+ * <b>Default value:</b> otaconfigLOG2_FILE_BLOCK_SIZE, the block size does not change.
+ */
+#ifndef otaconfigMIN_LOG2_FILE_BLOCK_SIZE
+    #define otaconfigMIN_LOG2_FILE_BLOCK_SIZE    otaconfigLOG2_FILE_BLOCK_SIZE
+#endif
+
+/**
+ * @brief Write file data blocks straight from the buffer they were received in.
+ *
+ * @note When this is set to 1, the data plane does not copy the payload of a
+ * file data block to a decode buffer. The PAL writeBlock function is given a
+ * pointer into the event data buffer instead, to the payload of the CBOR
+ * message for MQTT or to the body for HTTP. The event data buffer is released
+ * when the application callback receives OtaJobEventProcessed, as before. The
+ * payload is not aligned to any boundary and must not be changed by the PAL.
+ * Set this to 0 if the PAL needs an aligned buffer or the payload is copied
+ * to a decode buffer given in OtaAppBuffer_t or allocated per block.
+ *
+ * <b>Possible values:</b> 0 or 1 <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigZERO_COPY_DATA_BLOCKS
+    #define otaconfigZERO_COPY_DATA_BLOCKS    0U
+#endif
+
+/**
+ * @brief The size in bytes of the buffer that combines blocks into one write.
+ *
+ * @note Without it, the PAL writeBlock function is called once per file data
+ * block, which makes a PAL writing to flash read, erase and program a whole
+ * sector for each block. When this is greater than 0, contiguous blocks are
+ * gathered in a buffer of this size in the agent context, and written with
+ * one call to writeBlock once they reach the end of a sector, a sector being
+ * this many bytes from the start of the file. A block that does not follow
+ * the ones buffered, such as one received out of order, writes them first.
+ * What is left in the buffer is written before the file is closed or a
+ * checkpoint of it is saved. Set this to the flash sector size of the device,
+ * a multiple of the block size. writeBlock returns an int16_t, so a PAL used
+ * with a buffer larger than 32 KB must return a non-negative value on success.
+ * Set this to 0 to write each block as it is received.
+ *
+ * <b>Possible values:</b> 0 or any multiple of the block size. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigWRITE_COMBINE_SIZE
+    #define otaconfigWRITE_COMBINE_SIZE    0U
+#endif
+
 /**
  * @brief Milliseconds to wait for the self test phase to succeed before we
  * force reset.
@@ -116,6 +183,28 @@
     #define otaconfigFILE_REQUEST_WAIT_MS    10000U
 #endif
 
+/**
+ * @brief Number of ticks of the request timer in otaconfigFILE_REQUEST_WAIT_MS.
+ *
+ * @note The request timer is not restarted for every data block received.
+ * A block only moves the deadline of the request, which the timer checks every
+ * otaconfigFILE_REQUEST_WAIT_MS / otaconfigREQUEST_TIMER_TICKS milliseconds
+ * while a request is waiting. The blocks are requested again at most one tick
+ * later than otaconfigFILE_REQUEST_WAIT_MS after the last one received. Each
+ * tick costs an OS timer start and an event of the agent.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer from 1 up to
+ * otaconfigFILE_REQUEST_WAIT_MS. <br>
+ * <b>Default value:</b> '4'
+ */
+#ifndef otaconfigREQUEST_TIMER_TICKS
+    #define otaconfigREQUEST_TIMER_TICKS    4U
+#endif
+
+#if ( otaconfigREQUEST_TIMER_TICKS == 0U )
+    #error "otaconfigREQUEST_TIMER_TICKS must be at least 1."
+#endif
+
 /**
  * @brief The maximum allowed length of the thing name used by the OTA agent.
  *
@@ -152,6 +241,83 @@
     #define otaconfigMAX_NUM_BLOCKS_REQUEST    1U
 #endif
 
+/**
+ * @brief Flag to send only the part of the block bitmap that is still needed
+ * in data requests to the OTA streaming service.
+ *
+ * @note Set this configuration parameter to '1' to start the bitmap of a
+ * request at the byte of the first missing block, with the block offset of
+ * the request set to match, and to end it at the byte holding the last block
+ * of the request. Otherwise the bitmap of the whole file is sent with every
+ * request, which for large files is mostly blocks already received and may
+ * not fit in a request message. This applies when the sliding request window
+ * is disabled; the window always sends only the blocks it requests.
+ *
+ * <b>Possible values:</b> 0 or 1 <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigCOMPACT_BLOCK_BITMAP
+    #define otaconfigCOMPACT_BLOCK_BITMAP    0U
+#endif
+
+/**
+ * @brief The maximum number of data blocks kept in flight by the sliding
+ * request window of the data plane.
+ *
+ * @note When this is greater than 0, the agent does not wait for a whole
+ * request to be answered before asking for more data. Instead it sends a new
+ * request for the missing blocks every time a block arrives, so that up to
+ * this many blocks are outstanding at any time. The window starts at
+ * otaconfigINITIAL_REQUEST_WINDOW_SIZE blocks, grows while blocks keep
+ * arriving and shrinks when blocks are dropped or the request timer expires.
+ * Set this to 0 to use a single request of otaconfigMAX_NUM_BLOCKS_REQUEST
+ * blocks at a time. The same service limit as otaconfigMAX_NUM_BLOCKS_REQUEST
+ * applies to the number of blocks in flight.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer value. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigMAX_REQUEST_WINDOW_SIZE
+    #define otaconfigMAX_REQUEST_WINDOW_SIZE    0U
+#endif
+
+/**
+ * @brief The number of data blocks kept in flight when a file transfer starts
+ * with the sliding request window enabled.
+ *
+ * @note The value is capped at otaconfigMAX_REQUEST_WINDOW_SIZE. After the
+ * request timer expires the window starts again from a single block.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer value greater than 0. <br>
+ * <b>Default value:</b> '1'
+ */
+#ifndef otaconfigINITIAL_REQUEST_WINDOW_SIZE
+    #define otaconfigINITIAL_REQUEST_WINDOW_SIZE    1U
+#endif
+
+/**
+ * @brief The maximum number of contiguous data blocks asked for by a single
+ * HTTP range request.
+ *
+ * @note When this is greater than 0 and otaconfigMAX_REQUEST_WINDOW_SIZE is
+ * greater than 0, the HTTP data plane uses the sliding request window. It
+ * issues one range request for each run of missing blocks that fits in the
+ * window, so several requests can be pending at the same time, and it ingests
+ * the blocks in whatever order they arrive. The OtaHttpRequest_t callback
+ * must then not block until the response is received. Each
+ * OtaAgentEventReceivedFileBlock event must carry at most one block, starting
+ * on a block boundary, with its offset in the file set in the fileOffset
+ * field of the event data. A response for a range of several blocks is
+ * signalled as one event per block. Set this to 0 to request one block at a
+ * time and take the blocks in the order they were requested.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer value. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigHTTP_MAX_BLOCKS_PER_RANGE
+    #define otaconfigHTTP_MAX_BLOCKS_PER_RANGE    0U
+#endif
+
 /**
  * @brief The maximum number of requests allowed to send without a response
  * before we abort.
@@ -167,6 +333,23 @@
     #define otaconfigMAX_NUM_REQUEST_MOMENTUM    32U
 #endif
 
+/**
+ * @brief The number of blocks received between two checkpoints of the file.
+ *
+ * @note If the platform implements the optional saveCheckpoint interface, the
+ * block bitmap of the file is saved every time this number of blocks is
+ * received. A download interrupted by a reset or a lost connection then
+ * resumes from its last checkpoint, and only the blocks received since are
+ * requested again. A lower value re-transfers fewer blocks at the cost of
+ * more writes to the non-volatile memory.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer greater than 0. <br>
+ * <b>Default value:</b> '16'
+ */
+#ifndef otaconfigCHECKPOINT_INTERVAL_BLOCKS
+    #define otaconfigCHECKPOINT_INTERVAL_BLOCKS    16U
+#endif
+
 /**
  * @brief How frequently the device will report its OTA progress to the cloud.
  *
@@ -181,6 +364,24 @@
     #define otaconfigOTA_UPDATE_STATUS_FREQUENCY    64U
 #endif
 
+/**
+ * @brief The minimum time in milliseconds between two progress reports to the cloud.
+ *
+ * @note When this is greater than 0, the job status with the number of blocks
+ * received is not published while blocks are processed. The first block
+ * received after a report starts a timer of this length instead, and the status
+ * is published once it expires, with all the blocks received until then, so at
+ * most one progress status is published per interval. A progress status that
+ * fails to publish is published with the next one. Set this to 0 to report the
+ * progress every @ref otaconfigOTA_UPDATE_STATUS_FREQUENCY blocks.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigPROGRESS_REPORT_INTERVAL_MS
+    #define otaconfigPROGRESS_REPORT_INTERVAL_MS    0U
+#endif
+
 /**
  * @brief The number of data buffers reserved by the OTA agent.
  *
@@ -194,6 +395,175 @@
     #define otaconfigMAX_NUM_OTA_DATA_BUFFERS    1U
 #endif
 
+/**
+ * @brief The number of event data buffers in the pool owned by the OTA library.
+ *
+ * @note When this is greater than 0, the library reserves this many
+ * OtaEventData_t buffers that the application can acquire with
+ * OTA_EventBufferGet and release with OTA_EventBufferFree, from a transport
+ * callback or an ISR, without a lock. The request window is then kept within
+ * the number of free buffers, so blocks are requested no faster than they can
+ * be received. Set this to 0 if the application keeps its own buffers, in
+ * which case no memory is reserved.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigEVENT_BUFFER_POOL_SIZE
+    #define otaconfigEVENT_BUFFER_POOL_SIZE    0U
+#endif
+
+/**
+ * @brief The maximum number of events the OTA agent receives at once.
+ *
+ * @note When the OS interface provides OtaEventInterface_t::recvBatch, the
+ * agent task receives up to this many pending events with a single call and
+ * processes them back to back. The events are received on the stack of the
+ * agent task, which needs sizeof( OtaEventMsg_t ) bytes for each of them.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer value greater than 0. <br>
+ * <b>Default value:</b> '4'
+ */
+#ifndef otaconfigEVENT_BATCH_SIZE
+    #define otaconfigEVENT_BATCH_SIZE    4U
+#endif
+
+/**
+ * @brief The maximum number of OTA agent instances.
+ *
+ * @note Besides the agent started by OTA_Init, up to this number minus one
+ * additional agents can be started with OTA_InstanceInit, for example by a
+ * gateway updating several devices at once. All of them are run by the task
+ * calling OTA_EventProcessingTask and share its event queue, and each of them
+ * uses OtaNumOfTimers timers of the OS interface, so the OS timer functions
+ * must accept timer ids up to OTA_NUM_TIMER_IDS.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer value greater than 0. <br>
+ * <b>Default value:</b> '1'
+ */
+#ifndef otaconfigMAX_NUM_AGENTS
+    #define otaconfigMAX_NUM_AGENTS    1U
+#endif
+
+/**
+ * @brief The maximum number of file sinks of an OTA agent.
+ *
+ * @note A file sink is an additional file written with every block of the
+ * file received, for example for several identical devices behind a gateway
+ * or several file slots of a device. The stream is downloaded once and each
+ * block is written to the file received and to every sink added with
+ * OTA_AddFileSink. Set this to 0 to leave out the support for sinks.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigMAX_NUM_FILE_SINKS
+    #define otaconfigMAX_NUM_FILE_SINKS    0U
+#endif
+
+/**
+ * @brief The maximum number of files of a job downloaded in one job run.
+ *
+ * @note The files listed in the "files" array of a job document are received
+ * one after the other without fetching the job document again. The application
+ * is notified once, when the last file is received. A copy of the job document
+ * is allocated with the OS interface, or kept in static memory when
+ * otaconfigSTATIC_ONLY is 1, for the duration of the job when it lists more
+ * than one file. The files after this limit are ignored. Set this to 1 to
+ * only receive the first file of a job.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer greater than 0. <br>
+ * <b>Default value:</b> '1'
+ */
+#ifndef otaconfigMAX_FILES_PER_JOB
+    #define otaconfigMAX_FILES_PER_JOB    1U
+#endif
+
+/**
+ * @brief Flag to only use static memory.
+ *
+ * @note When this is set to 1, the library does not allocate any memory with
+ * the OS interface. The job arena is a buffer of otaconfigJOB_ARENA_SIZE
+ * bytes, which by default is sized from the block size, the block bitmap size
+ * and the event buffer size, and the copy of a job document listing more than
+ * one file is kept in a buffer of the event buffer size. Both are in the
+ * context of each agent instance, the one of the agent started by OTA_Init
+ * being static data. The malloc and free functions of the OS interface are
+ * then never referenced by the library, and may be left NULL. All the memory
+ * of the library is reported in its static data and in the contexts of the
+ * instances, and the memory a job needs no longer depends on the contents of
+ * its job document. Place the static buffers with otaconfigSTATIC_MEMORY_ATTRIBUTE.
+ *
+ * <b>Possible values:</b> 0 or 1 <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigSTATIC_ONLY
+    #define otaconfigSTATIC_ONLY    0U
+#endif
+
+/**
+ * @brief Attribute of the context of the agent started by OTA_Init, which
+ * holds its static buffers when otaconfigSTATIC_ONLY is 1.
+ *
+ * @note This can be defined to align the buffers on a cache line, or to place
+ * them in a given memory section, for example with
+ * `__attribute__( ( aligned( 32 ) ) )` on GCC. It is empty by default.
+ */
+#ifndef otaconfigSTATIC_MEMORY_ATTRIBUTE
+    #define otaconfigSTATIC_MEMORY_ATTRIBUTE
+#endif
+
+/**
+ * @brief The size in bytes of the memory arena allocated once per OTA job.
+ *
+ * @note When this is greater than 0, the buffers the library would otherwise
+ * allocate dynamically for a job (the job document strings not backed by an
+ * application buffer, the block bitmap and the block decode buffer) are all
+ * carved out of a single allocation of this size, one for each agent
+ * instance. The arena is allocated when the first of these buffers is needed
+ * and released when the file is closed, so the peak memory used by a job is
+ * bounded by this value and no allocation happens per block. An allocation
+ * that does not fit in the arena fails the same way an allocation failure
+ * would. Set this to 0 to allocate each buffer separately with the OS
+ * interface. When otaconfigSTATIC_ONLY is 1 the arena is a buffer in the
+ * context of the instance that is never released, and this must not be 0.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer. <br>
+ * <b>Default value:</b> '0', or OTA_STATIC_JOB_ARENA_SIZE when otaconfigSTATIC_ONLY is 1
+ */
+#ifndef otaconfigJOB_ARENA_SIZE
+    #if ( otaconfigSTATIC_ONLY == 1U )
+        #define otaconfigJOB_ARENA_SIZE    OTA_STATIC_JOB_ARENA_SIZE
+    #else
+        #define otaconfigJOB_ARENA_SIZE    0U
+    #endif
+#endif
+
+/**
+ * @brief Flag to time the stages of a download.
+ *
+ * @note When this is set to 1, the agent measures how long events wait in
+ * the queue, how long a data request takes to be answered with a block, and
+ * how long decoding a block, storing it with the PAL writeBlock function and
+ * closing the file with the PAL closeFile function take. The last one includes
+ * the signature verification. It also counts the duplicate blocks received,
+ * the requests sent again without an answer to the previous one and the peak
+ * request momentum. The results are read with @ref OTA_GetLatencyStatistics.
+ * The time is read with otaconfigLATENCY_TIMESTAMP(), which must be defined
+ * in the OTA config to return a free running uint32_t counter, preferably in
+ * microseconds. Set this to 0 to leave no code or data for the measurement.
+ *
+ * <b>Possible values:</b> 0 or 1 <br>
+ * <b>Default value:</b> '0'
+ */
+#ifndef otaconfigLATENCY_STATS
+    #define otaconfigLATENCY_STATS    0U
+#endif
+
+#if ( otaconfigLATENCY_STATS == 1U ) && !defined( otaconfigLATENCY_TIMESTAMP )
+    #error "otaconfigLATENCY_TIMESTAMP() must be defined when otaconfigLATENCY_STATS is 1."
+#endif
+
 /**
  * @brief Flag to enable booting into updates that have an identical or lower
  * version than the current version.
@@ -223,6 +593,25 @@
     #define configOTA_FIRMWARE_UPDATE_FILE_TYPE_ID    0U
 #endif
 
+/**
+ * @brief The file type id of delta updates received in the job document.
+ *
+ * @note A file of this type in the job document is a binary patch against the
+ * firmware image running on the device, instead of the new image itself. Its
+ * blocks are given in order to the PAL patchBlock function, which rebuilds the
+ * new image from the running one and the patch. A block received out of order
+ * is requested again. A job with a delta file is rejected if the PAL does not
+ * implement patchBlock, and activated like a firmware update once the new image
+ * is rebuilt and its signature checked. The default value matches no file type,
+ * so no file is received as a delta update.
+ *
+ * <b>Possible values:</b> Any unsigned 32 integer other than configOTA_FIRMWARE_UPDATE_FILE_TYPE_ID. <br>
+ * <b>Default value:</b> '0xFFFFFFFF'
+ */
+#ifndef configOTA_DELTA_UPDATE_FILE_TYPE_ID
+    #define configOTA_DELTA_UPDATE_FILE_TYPE_ID    0xFFFFFFFFU
+#endif
+
 /**
  * @brief The protocol selected for OTA control operations.
  *
@@ -0,0 +1,127 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_event_buffer.h
+ * @brief Pool of event data buffers owned by the OTA library.
+ */
+
+#ifndef OTA_EVENT_BUFFER_H
+#define OTA_EVENT_BUFFER_H
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* OTA includes. */
+#include "ota_private.h"
+
+/**
+ * @ingroup ota_struct_types
+ * @brief Usage statistics of the event data buffer pool.
+ */
+typedef struct OtaEventBufferStatistics
+{
+    uint32_t poolSize;      /*!< Number of buffers in the pool. */
+    uint32_t buffersInUse;  /*!< Number of buffers currently acquired. */
+    uint32_t highWatermark; /*!< Highest number of buffers acquired at the same time. */
+    uint32_t exhausted;     /*!< Number of times no buffer was available. */
+} OtaEventBufferStatistics_t;
+
+/**
+ * @brief Put all the buffers of the pool back in the free list.
+ *
+ * Called by OTA_Init when the agent starts. Buffers acquired before that are
+ * considered free again.
+ */
+/* @[declare_ota_eventbufferinit] */
+void OTA_EventBufferInit( void );
+/* @[declare_ota_eventbufferinit] */
+
+/**
+ * @brief Acquire a free event data buffer from the pool.
+ *
+ * Takes constant time and no lock, so it may be called from an ISR or a
+ * transport callback. Buffers must be acquired from a single context at a
+ * time, and released from a single context at a time, typically the OTA
+ * agent task when the application callback receives OtaJobEventProcessed.
+ *
+ * @return Pointer to the buffer, or NULL if the pool is empty or disabled.
+ *
+ * <b>Example</b>
+ * @code{c}
+ * void handleFileBlock( const uint8_t * pData, uint32_t dataLength )
+ * {
+ *     OtaEventData_t * pBuffer = OTA_EventBufferGet();
+ *     OtaEventMsg_t eventMsg = { 0 };
+ *
+ *     if( pBuffer != NULL )
+ *     {
+ *         memcpy( pBuffer->data, pData, dataLength );
+ *         pBuffer->dataLength = dataLength;
+ *         eventMsg.eventId = OtaAgentEventReceivedFileBlock;
+ *         eventMsg.pEventData = pBuffer;
+ *
+ *         if( OTA_SignalEvent( &eventMsg ) == false )
+ *         {
+ *             OTA_EventBufferFree( pBuffer );
+ *         }
+ *     }
+ * }
+ * @endcode
+ */
+/* @[declare_ota_eventbufferget] */
+OtaEventData_t * OTA_EventBufferGet( void );
+/* @[declare_ota_eventbufferget] */
+
+/**
+ * @brief Release an event data buffer back to the pool.
+ *
+ * Buffers that are not part of the pool or are not in use are ignored.
+ *
+ * @param[in] pBuffer Buffer acquired with OTA_EventBufferGet.
+ */
+/* @[declare_ota_eventbufferfree] */
+void OTA_EventBufferFree( OtaEventData_t * const pBuffer );
+/* @[declare_ota_eventbufferfree] */
+
+/**
+ * @brief Get the number of free buffers in the pool.
+ *
+ * The agent uses it to limit the request window to the buffers available,
+ * so blocks are not requested faster than they can be received.
+ *
+ * @return Number of buffers that can be acquired.
+ */
+/* @[declare_ota_eventbufferfreecount] */
+uint32_t OTA_EventBufferFreeCount( void );
+/* @[declare_ota_eventbufferfreecount] */
+
+/**
+ * @brief Get the usage statistics of the pool.
+ *
+ * @param[out] pStatistics Statistics of the pool.
+ */
+/* @[declare_ota_geteventbufferstatistics] */
+void OTA_GetEventBufferStatistics( OtaEventBufferStatistics_t * pStatistics );
+/* @[declare_ota_geteventbufferstatistics] */
+
+#endif /* ifndef OTA_EVENT_BUFFER_H */
@@ -50,7 +50,8 @@ OtaErr_t initFileTransfer_Http( OtaAgentContext_t * pAgentCtx );
  * @brief Request File block over HTTP.
  *
  * This function is used for requesting a file block over HTTP using the
- * file context.
+ * file context. When the sliding request window is open, it sends one range
+ * request for each run of missing blocks that fits in the window instead.
  *
  * @param[in] pAgentCtx The OTA agent context.
  *
@@ -66,18 +67,20 @@ OtaErr_t requestDataBlock_Http( OtaAgentContext_t * pAgentCtx );
  * File block received over HTTP does not require decoding, only increment the number
  * of blocks received.
  *
+ * @param[in] pAgentCtx      The OTA agent context, which keeps the next block in order.
  * @param[in] pMessageBuffer The message to be decoded.
  * @param[in] messageSize     The size of the message in bytes.
  * @param[out] pFileId        The server file ID.
- * @param[out] pBlockId       The file block ID.
+ * @param[in,out] pBlockId    The file block ID. Kept if not negative on input, otherwise the next block in order.
  * @param[out] pBlockSize     The file block size.
- * @param[out] pPayload     The payload.
+ * @param[in,out] pPayload  The payload. Set to point to pMessageBuffer if it points to NULL.
  * @param[out] pPayloadSize   The payload size.
  *
  * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
  * error codes information in ota.h.
  */
-OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
+OtaErr_t decodeFileBlock_Http( OtaAgentContext_t * pAgentCtx,
+                               const uint8_t * pMessageBuffer,
                                size_t messageSize,
                                int32_t * pFileId,
                                int32_t * pBlockId,
@@ -88,8 +91,8 @@ OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
 /**
  * @brief Cleanup related to OTA data plane over HTTP.
  *
- * This function performs cleanup by resetting the number of blocks received
- * and deinit the http component.
+ * This function performs cleanup by deinit the http component. The block
+ * count of the agent is reset when the next file transfer is initialized.
  *
  * @param[in] pAgentCtx The OTA agent context.
  *
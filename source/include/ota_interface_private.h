@@ -69,13 +69,14 @@ typedef struct
 {
     OtaErr_t ( * initFileTransfer )( OtaAgentContext_t * pAgentCtx ); /*!< Initialize file transfer. */
     OtaErr_t ( * requestFileBlock )( OtaAgentContext_t * pAgentCtx ); /*!< Request File block. */
-    OtaErr_t ( * decodeFileBlock )( const uint8_t * pMessageBuffer,
+    OtaErr_t ( * decodeFileBlock )( OtaAgentContext_t * pAgentCtx,
+                                    const uint8_t * pMessageBuffer,
                                     size_t messageSize,
                                     int32_t * pFileId,
                                     int32_t * pBlockId,
                                     int32_t * pBlockSize,
                                     uint8_t ** pPayload,
-                                    size_t * pPayloadSize );       /*!< Decode a cbor encoded fileblock. */
+                                    size_t * pPayloadSize );       /*!< Decode a cbor encoded fileblock. pBlockId holds the block index tagged on the block on input, or -1 if there is none. If pPayload points to NULL, it is set to point to the payload in place. */
     OtaErr_t ( * cleanup )( const OtaAgentContext_t * pAgentCtx ); /*!< Cleanup related to OTA data plane. */
 } OtaDataInterface_t;
 
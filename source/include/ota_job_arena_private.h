@@ -0,0 +1,87 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_job_arena_private.h
+ * @brief Function declarations for ota_job_arena.c.
+ */
+
+#ifndef OTA_JOB_ARENA_PRIVATE_H
+#define OTA_JOB_ARENA_PRIVATE_H
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdlib.h>
+
+/* OTA includes. */
+#include "ota_os_interface.h"
+
+/**
+ * @brief Alignment of the buffers handed out by the arena.
+ */
+#define OTA_JOB_ARENA_ALIGNMENT    8U
+
+/**
+ * @ingroup ota_private_struct_types
+ * @brief Memory arena holding the buffers of one OTA job.
+ *
+ * The arena is allocated with a single call to the OS interface when the first
+ * buffer is requested, and buffers are handed out from it in order. They are
+ * not released one by one but all together when the arena is released. An
+ * arena created with pBase already pointing to static storage is used with a
+ * NULL memory interface, and is never allocated nor freed.
+ */
+typedef struct OtaJobArena
+{
+    uint8_t * pBase; /*!< @brief Start of the arena, NULL while it is not allocated. */
+    size_t size;     /*!< @brief Size of the arena in bytes. */
+    size_t used;     /*!< @brief Number of bytes already handed out. */
+} OtaJobArena_t;
+
+/**
+ * @brief Get a buffer from the arena, allocating the arena first if needed.
+ *
+ * @param[in,out] pArena The arena to take the buffer from.
+ * @param[in] pMem OS memory interface used to allocate the arena, NULL for a
+ * static arena.
+ * @param[in] size Size of the buffer in bytes.
+ *
+ * @return Pointer to the buffer, or NULL if the arena could not be allocated
+ *         or does not have room for the buffer.
+ */
+void * otaJobArena_Alloc( OtaJobArena_t * pArena,
+                          const OtaMallocInterface_t * pMem,
+                          size_t size );
+
+/**
+ * @brief Release the arena and every buffer taken from it.
+ *
+ * A static arena keeps its storage, only its buffers are released.
+ *
+ * @param[in,out] pArena The arena to release.
+ * @param[in] pMem OS memory interface used to free the arena, NULL for a
+ * static arena.
+ */
+void otaJobArena_Release( OtaJobArena_t * pArena,
+                          const OtaMallocInterface_t * pMem );
+
+#endif /* ifndef OTA_JOB_ARENA_PRIVATE_H */
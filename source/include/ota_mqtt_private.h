@@ -77,6 +77,7 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx );
  *
  * This function is used for decoding a file block received over MQTT & encoded in cbor.
  *
+ * @param[in] pAgentCtx      The OTA agent context.
  * @param[in] pMessageBuffer The message to be decoded.
  * @param[in] messageSize     The size of the message in bytes.
  * @param[out] pFileId        The server file ID.
@@ -89,7 +90,8 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx );
  * error codes information in ota.h.
  */
 
-OtaErr_t decodeFileBlock_Mqtt( const uint8_t * pMessageBuffer,
+OtaErr_t decodeFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx,
+                               const uint8_t * pMessageBuffer,
                                size_t messageSize,
                                int32_t * pFileId,
                                int32_t * pBlockId,
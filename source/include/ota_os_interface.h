@@ -82,6 +82,7 @@ typedef enum
 {
     OtaRequestTimer = 0,
     OtaSelfTestTimer,
+    OtaProgressTimer,
     OtaNumOfTimers
 } OtaTimerId_t;
 
@@ -151,6 +152,55 @@ typedef OtaOsStatus_t ( * OtaReceiveEvent_t )( OtaEventContext_t * pEventCtx,
                                                void * pEventMsg,
                                                uint32_t timeout );
 
+/**
+ * @brief Receive the pending OTA events.
+ *
+ * This function waits for the next event as OtaReceiveEvent_t does, then
+ * receives the events already pending without blocking, until maxEvents
+ * events are received.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsgs]    Pointer to store maxEvents messages.
+ *
+ * @param[maxEvents]     The maximum number of events to receive.
+ *
+ * @param[pNumEvents]    Pointer to store the number of events received.
+ *
+ * @param[timeout]       The maximum amount of time the task should block.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if at least one event is received, other error code on failure.
+ */
+
+typedef OtaOsStatus_t ( * OtaReceiveEvents_t )( OtaEventContext_t * pEventCtx,
+                                                void * pEventMsgs,
+                                                uint32_t maxEvents,
+                                                uint32_t * pNumEvents,
+                                                uint32_t timeout );
+
+/**
+ * @brief Receive the pending OTA events without waiting.
+ *
+ * This function receives the events already pending, until maxEvents events
+ * are received, and returns at once when there are none. It is used by
+ * @ref OTA_Poll to run the agent without a task of its own.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsgs]    Pointer to store maxEvents messages.
+ *
+ * @param[maxEvents]     The maximum number of events to receive.
+ *
+ * @param[pNumEvents]    Pointer to store the number of events received, 0 if none is pending.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+
+typedef OtaOsStatus_t ( * OtaPollEvents_t )( OtaEventContext_t * pEventCtx,
+                                             void * pEventMsgs,
+                                             uint32_t maxEvents,
+                                             uint32_t * pNumEvents );
+
 /**
  * @brief Deinitialize the OTA Events mechanism.
  *
@@ -259,6 +309,8 @@ typedef struct OtaEventInterface
     OtaReceiveEvent_t recv;            /*!< @brief Receive data. */
     OtaDeinitEvent_t deinit;           /*!< @brief Deinitialize event. */
     OtaEventContext_t * pEventContext; /*!< @brief Event context to store event information. */
+    OtaReceiveEvents_t recvBatch;      /*!< @brief Receive all pending data, optional. */
+    OtaPollEvents_t poll;              /*!< @brief Receive pending data without waiting, optional, required by OTA_Poll. */
 } OtaEventInterface_t;
 
 /**
@@ -171,6 +171,10 @@ typedef OtaPalStatus_t (* OtaPalCreateFileForRx_t)( OtaFileContext_t * const pFi
  *
  * If the signature verification fails, file close should still be attempted.
  *
+ * If the platform implements OtaPalDigestUpdate_t, the first pFileContext->digestLength
+ * bytes of the file are already in the digest, and only the rest of the file has
+ * to be read back and added to it before the signature is checked.
+ *
  * @param[in] pFileContext OTA file context information.
  *
  * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
@@ -284,6 +288,120 @@ typedef OtaPalStatus_t ( * OtaPalSetPlatformImageState_t )( OtaFileContext_t * c
  */
 typedef OtaPalImageState_t ( * OtaPalGetPlatformImageState_t ) ( OtaFileContext_t * const pFileContext );
 
+/**
+ * @brief Save a checkpoint of the file being received.
+ *
+ * The checkpoint is the block bitmap pFileContext->pRxBlockBitmap, in which the
+ * bits of the blocks already written with OtaPalWriteBlock_t are cleared, along
+ * with the identity of the file: the job name pFileContext->pJobName, the file ID
+ * pFileContext->serverFileID, the file size pFileContext->fileSize and the block
+ * size pFileContext->log2BlockSize, as the bitmap only holds for the block size it
+ * was saved with. The agent saves a checkpoint every @ref otaconfigCHECKPOINT_INTERVAL_BLOCKS blocks received
+ * and when it is suspended. Only the latest checkpoint needs to be kept.
+ *
+ * @note This function is optional. Set it to NULL if the platform does not
+ * resume interrupted downloads.
+ *
+ * @param[in] pFileContext OTA file context information.
+ * @param[in] bitmapSize Size of the block bitmap in bytes.
+ *
+ * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
+ * error codes information in ota.h.
+ *
+ * OtaPalSuccess is returned when the checkpoint is saved. The download goes on
+ * whatever the result.
+ */
+typedef OtaPalStatus_t ( * OtaPalSaveCheckpoint_t )( OtaFileContext_t * const pFileContext,
+                                                     uint32_t bitmapSize );
+
+/**
+ * @brief Resume receiving a file from its checkpoint.
+ *
+ * Called before creating the receive file. If the checkpoint saved with
+ * OtaPalSaveCheckpoint_t is for the same job name, file ID and file size, copy
+ * its bitmap to pFileContext->pRxBlockBitmap, restore its block size to
+ * pFileContext->log2BlockSize and open the file keeping the blocks already
+ * written, instead of creating it. Only the blocks still marked in the bitmap
+ * are requested, with the restored block size. A checkpoint whose block size is
+ * not supported by the agent, or whose bitmap does not fit in bitmapSize bytes,
+ * is not resumed.
+ *
+ * @note This function is optional. Set it to NULL if the platform does not
+ * resume interrupted downloads. A platform that resumes downloads keeps the
+ * data and the checkpoint of a file aborted with OtaPalAbort_t, and drops the
+ * checkpoint once the file is closed with OtaPalCloseFile_t.
+ *
+ * @param[in] pFileContext OTA file context information.
+ * @param[in] bitmapSize Size of the block bitmap buffer in bytes.
+ *
+ * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
+ * error codes information in ota.h.
+ *
+ * OtaPalSuccess is returned when the file is resumed. With any other code, the
+ * file is created with OtaPalCreateFileForRx_t and received from the start.
+ */
+typedef OtaPalStatus_t ( * OtaPalResumeFile_t )( OtaFileContext_t * const pFileContext,
+                                                 uint32_t bitmapSize );
+
+/**
+ * @brief Add the next bytes of the file being received to its digest.
+ *
+ * The agent gives the blocks of the file to this function in order from the
+ * start of the file, as they are written with OtaPalWriteBlock_t, so the digest
+ * used to check the signature is computed while the file is received. The data
+ * starts at offset pFileContext->digestLength in the file, which the agent
+ * advances by size once this function returns. A block received out of order is
+ * not given, and neither are the blocks after it, so OtaPalCloseFile_t reads back
+ * and digests the file from pFileContext->digestLength. The digest starts over
+ * when a file is created with OtaPalCreateFileForRx_t or resumed with
+ * OtaPalResumeFile_t, pFileContext->digestLength being 0 then.
+ *
+ * @note This function is optional. Set it to NULL if the platform digests the
+ * whole file when it is closed.
+ *
+ * @param[in] pFileContext OTA file context information.
+ * @param[in] pData Pointer to the bytes to add to the digest.
+ * @param[in] size The number of bytes to add to the digest.
+ *
+ * @return The OTA PAL layer error code combined with the MCU specific error code. See OTA Agent
+ * error codes information in ota.h.
+ *
+ * OtaPalSuccess is returned when the bytes are added to the digest. With any
+ * other code, no more bytes are given and the rest of the file is digested when
+ * it is closed.
+ */
+typedef OtaPalStatus_t ( * OtaPalDigestUpdate_t )( OtaFileContext_t * const pFileContext,
+                                                   const uint8_t * pData,
+                                                   uint32_t size );
+
+/**
+ * @brief Apply a block of a delta update to the new image.
+ *
+ * Called instead of OtaPalWriteBlock_t for a file of the type
+ * @ref configOTA_DELTA_UPDATE_FILE_TYPE_ID, which is a binary patch against the
+ * firmware image running on the device. The blocks of the patch are given in
+ * order from the start of the file, so a streaming patch engine can rebuild the
+ * new image as they arrive, keeping only its own state in RAM. The new image is
+ * written to the file created with OtaPalCreateFileForRx_t, and its signature is
+ * checked with OtaPalCloseFile_t as for a full image. A delta file is never
+ * resumed from a checkpoint.
+ *
+ * @note This function is optional. Set it to NULL if the platform does not
+ * apply delta updates, the jobs with a delta file are then rejected.
+ *
+ * @param[in] pFileContext OTA file context information.
+ * @param[in] offset Byte offset of the block in the patch file.
+ * @param[in] pData Pointer to the block of the patch.
+ * @param[in] blockSize The number of bytes in the block.
+ *
+ * @return The number of bytes of the patch applied on a success, or a negative
+ * error code from the platform abstraction layer.
+ */
+typedef int16_t ( * OtaPalPatchBlock_t )( OtaFileContext_t * const pFileContext,
+                                          uint32_t offset,
+                                          uint8_t * const pData,
+                                          uint32_t blockSize );
+
 /**
  * @ingroup ota_struct_types
  * @brief OTA pal Interface structure.
@@ -302,6 +420,10 @@ typedef struct OtaPalInterface
     OtaPalResetDevice_t reset;                           /*!< @brief Reset the device. */
     OtaPalSetPlatformImageState_t setPlatformImageState; /*!< @brief Set the state of the OTA update image. */
     OtaPalGetPlatformImageState_t getPlatformImageState; /*!< @brief Get the state of the OTA update image. */
+    OtaPalSaveCheckpoint_t saveCheckpoint;               /*!< @brief Save a checkpoint of the file being received, optional. */
+    OtaPalResumeFile_t resumeFile;                       /*!< @brief Resume receiving a file from its checkpoint, optional. */
+    OtaPalDigestUpdate_t digestUpdate;                   /*!< @brief Add the next bytes of the file being received to its digest, optional. */
+    OtaPalPatchBlock_t patchBlock;                       /*!< @brief Apply a block of a delta update to the new image, optional. */
 } OtaPalInterface_t;
 
 #endif /* ifndef OTA_PLATFORM_INTERFACE */
@@ -53,11 +53,13 @@
 /* General constants. */
 #define LOG2_BITS_PER_BYTE           3U                                                   /*!< @brief Log base 2 of bits per byte. */
 #define BITS_PER_BYTE                ( ( uint32_t ) 1U << LOG2_BITS_PER_BYTE )            /*!< @brief Number of bits in a byte. This is used by the block bitmap implementation. */
-#define OTA_FILE_BLOCK_SIZE          ( ( uint32_t ) 1U << otaconfigLOG2_FILE_BLOCK_SIZE ) /*!< @brief Data section size of the file data block message (excludes the header). */
+#define OTA_FILE_BLOCK_SIZE          ( ( uint32_t ) 1U << otaconfigLOG2_FILE_BLOCK_SIZE ) /*!< @brief Largest data section size of the file data block message (excludes the header). */
 #define OTA_MAX_FILES                1U                                                   /*!< @brief [MUST REMAIN 1! Future support.] Maximum number of concurrent OTA files. */
 #define OTA_MAX_BLOCK_BITMAP_SIZE    128U                                                 /*!< @brief Max allowed number of bytes to track all blocks of an OTA file. Adjust block size if more range is needed. */
 #define OTA_REQUEST_MSG_MAX_SIZE     ( 3U * OTA_MAX_BLOCK_BITMAP_SIZE )                   /*!< @brief Maximum size of the message */
 #define OTA_REQUEST_URL_MAX_SIZE     ( 1500 )                                             /*!< @brief Maximum size of the S3 presigned URL */
+#define OTA_REQUEST_PREFIX_SIZE      32U                                                  /*!< @brief Maximum size of the encoded fields that start every request of a file. */
+#define OTA_BLOCK_SIZE_LOSS_RATIO    8U                                                   /*!< @brief The block size of the next file is halved if requests timed out more than once every this many blocks. */
 #define OTA_ERASED_BLOCKS_VAL        0xffU                                                /*!< @brief The starting state of a group of erased blocks in the Rx block bitmap. */
 #ifdef configOTA_NUM_MSG_Q_ENTRIES
     #define OTA_NUM_MSG_Q_ENTRIES    configOTA_NUM_MSG_Q_ENTRIES
@@ -74,6 +76,8 @@
 #define OTA_MAX_JSON_TOKENS         64U                                                                         /*!< @brief Number of JSON tokens supported in a single parser call. */
 #define OTA_MAX_JSON_STR_LEN        256U                                                                        /*!< @brief Limit our JSON string compares to something small to avoid going into the weeds. */
 #define OTA_DOC_MODEL_MAX_PARAMS    32U                                                                         /*!< @brief The parameter list is backed by a 32 bit longword bitmap by design. */
+#define OTA_DOC_MODEL_KEY_SLOTS     64U                                                                         /*!< @brief Number of slots in the hash table of the document model keys, at least twice the number of parameters. */
+#define OTA_DOC_MODEL_MAX_DEPTH     8U                                                                          /*!< @brief Deepest nesting of objects walked to find the document model keys. */
 #define OTA_JOB_PARAM_REQUIRED      ( bool ) true                                                               /*!< @brief Used to denote a required document model parameter. */
 #define OTA_JOB_PARAM_OPTIONAL      ( bool ) false                                                              /*!< @brief Used to denote an optional document model parameter. */
 #define OTA_DONT_STORE_PARAM        0xffff                                                                      /*!< @brief If destOffset in the model is 0xffffffff, do not store the value. */
@@ -81,6 +85,33 @@
 #define OTA_DATA_BLOCK_SIZE         ( ( 1U << otaconfigLOG2_FILE_BLOCK_SIZE ) + OTA_REQUEST_URL_MAX_SIZE + 30 ) /*!< @brief Header is 19 bytes.*/
 /** @} */
 
+/**
+ * @brief Size of the block decode buffer taken from the job arena.
+ */
+#if ( otaconfigZERO_COPY_DATA_BLOCKS == 1U )
+    #define OTA_JOB_ARENA_DECODE_SIZE    0UL
+#else
+    #define OTA_JOB_ARENA_DECODE_SIZE    ( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE )
+#endif
+
+/**
+ * @brief Most buffers taken from the job arena besides the file sink bitmaps:
+ * the seven strings of the job document, the block bitmap and the decode buffer.
+ */
+#define OTA_JOB_ARENA_MAX_BUFFERS    9U
+
+/**
+ * @brief Size of the static job arena when otaconfigSTATIC_ONLY is 1.
+ *
+ * The strings copied from a job document are not longer than the document,
+ * which fits in an event buffer. Each buffer is padded to the arena alignment.
+ */
+#define OTA_STATIC_JOB_ARENA_SIZE                                            \
+    ( OTA_JOB_ARENA_DECODE_SIZE +                                            \
+      ( ( otaconfigMAX_NUM_FILE_SINKS + 1U ) * OTA_MAX_BLOCK_BITMAP_SIZE ) + \
+      OTA_DATA_BLOCK_SIZE +                                                  \
+      ( ( otaconfigMAX_NUM_FILE_SINKS + OTA_JOB_ARENA_MAX_BUFFERS ) * OTA_JOB_ARENA_ALIGNMENT ) )
+
 /**
  * @addtogroup ota_constants
  * @{
@@ -106,6 +137,14 @@
  */
 #define OTA_JOB_ID_MAX_SIZE         ( 72UL + 1UL )
 
+/**
+ * @brief Size of the buffers caching the MQTT topics of the current job.
+ *
+ * Large enough for the fixed parts of the job status and get stream topics,
+ * the thing name and the job or stream name.
+ */
+#define OTA_CACHED_TOPIC_MAX_SIZE    ( 32UL + otaconfigMAX_THINGNAME_LEN + OTA_JOB_ID_MAX_SIZE )
+
 /**
  * @brief Size of the buffer used to store the protocol field of the job document.
  *
@@ -164,19 +203,21 @@
  */
 typedef enum
 {
-    IngestResultFileComplete = -1,     /*!< The file transfer is complete and the signature check passed. */
-    IngestResultSigCheckFail = -2,     /*!< The file transfer is complete but the signature check failed. */
-    IngestResultFileCloseFail = -3,    /*!< There was a problem trying to close the receive file. */
-    IngestResultNullInput = -4,        /*!< One of the input pointers is NULL. */
-    IngestResultBadFileHandle = -5,    /*!< The receive file pointer is invalid. */
-    IngestResultUnexpectedBlock = -6,  /*!< We were asked to ingest a block but were not expecting one. */
-    IngestResultBlockOutOfRange = -7,  /*!< The received block is out of the expected range. */
-    IngestResultBadData = -8,          /*!< The data block from the server was malformed. */
-    IngestResultWriteBlockFailed = -9, /*!< The PAL layer failed to write the file block. */
-    IngestResultNoDecodeMemory = -10,  /*!< Memory could not be allocated for decoding . */
-    IngestResultUninitialized = -127,  /*!< Software BUG: We forgot to set the result code. */
-    IngestResultAccepted_Continue = 0, /*!< The block was accepted and we're expecting more. */
-    IngestResultDuplicate_Continue = 1 /*!< The block was a duplicate but that's OK. Continue. */
+    IngestResultFileComplete = -1,       /*!< The file transfer is complete and the signature check passed. */
+    IngestResultSigCheckFail = -2,       /*!< The file transfer is complete but the signature check failed. */
+    IngestResultFileCloseFail = -3,      /*!< There was a problem trying to close the receive file. */
+    IngestResultNullInput = -4,          /*!< One of the input pointers is NULL. */
+    IngestResultBadFileHandle = -5,      /*!< The receive file pointer is invalid. */
+    IngestResultUnexpectedBlock = -6,    /*!< We were asked to ingest a block but were not expecting one. */
+    IngestResultBlockOutOfRange = -7,    /*!< The received block is out of the expected range. */
+    IngestResultBadData = -8,            /*!< The data block from the server was malformed. */
+    IngestResultWriteBlockFailed = -9,   /*!< The PAL layer failed to write the file block. */
+    IngestResultNoDecodeMemory = -10,    /*!< Memory could not be allocated for decoding . */
+    IngestResultUninitialized = -127,    /*!< Software BUG: We forgot to set the result code. */
+    IngestResultAccepted_Continue = 0,   /*!< The block was accepted and we're expecting more. */
+    IngestResultDuplicate_Continue = 1,  /*!< The block was a duplicate but that's OK. Continue. */
+    IngestResultOutOfOrder_Continue = 2, /*!< The block of a file received in order came too early, it is requested again. Continue. */
+    IngestResultOtherFile_Continue = 3   /*!< The block belongs to another file than the one being received, it is dropped. Continue. */
 } IngestResult_t;
 
 /**
@@ -279,6 +320,11 @@ typedef struct
     uint16_t numModelParams;         /*!< The number of entries in the document model (limited to 32). */
     uint32_t paramsReceivedBitmap;   /*!< Bitmap of the parameters received based on the model. */
     uint32_t paramsRequiredBitmap;   /*!< Bitmap of the parameters required from the model. */
+    uint16_t nestedParamIndex;       /*!< Index of the parameter holding the nested file parameters, or numModelParams if none. */
+    uint32_t fileParamsIndex;        /*!< Index of the object of the nested file parameters array to extract. */
+    uint32_t numFileParams;          /*!< Number of objects in the nested file parameters array, 0 if it was not walked. */
+    uint32_t keyHashes[ OTA_DOC_MODEL_MAX_PARAMS ];  /*!< Hash of the key of each parameter. */
+    uint8_t keySlots[ OTA_DOC_MODEL_KEY_SLOTS ];     /*!< Parameter index plus one of each key, by key hash, 0 if the slot is free. */
 } JsonDocModel_t;
 
 /**
@@ -293,6 +339,62 @@ typedef struct OtaAgentStatistics
     uint32_t otaPacketsDropped;   /*!< Number of OTA packets dropped due to congestion. */
 } OtaAgentStatistics_t;
 
+#if ( otaconfigLATENCY_STATS == 1U )
+
+/**
+ * @ingroup ota_constants
+ * @brief Number of bins of the histogram of each stage timed.
+ *
+ * Bin n counts the durations shorter than 4^(n+2) ticks of
+ * otaconfigLATENCY_TIMESTAMP(), the last bin counts the longer ones. In
+ * microseconds, the bins go from under 16 us to over 1 s.
+ */
+    #define OTA_LATENCY_HISTOGRAM_BINS    10U
+
+/**
+ * @ingroup ota_enum_types
+ * @brief The stages of a download timed by the agent.
+ */
+    typedef enum OtaLatencyStage
+    {
+        OtaLatencyQueueWait = 0, /*!< From signaling an event to the agent receiving it from the queue. */
+        OtaLatencyBlockRtt,      /*!< From a data request to the next block accepted. */
+        OtaLatencyDecode,        /*!< Decoding a file block. */
+        OtaLatencyWrite,         /*!< Writing a file block to the file. */
+        OtaLatencyClose,         /*!< Closing the file and verifying its signature. */
+        OtaNumLatencyStages      /*!< Number of stages timed. */
+    } OtaLatencyStage_t;
+
+/**
+ * @ingroup ota_private_struct_types
+ * @brief Summary of the durations measured for a stage, in ticks of
+ * otaconfigLATENCY_TIMESTAMP().
+ *
+ * The average duration is total divided by count.
+ */
+    typedef struct OtaLatencySummary
+    {
+        uint32_t count;                                   /*!< Number of durations measured. */
+        uint32_t min;                                     /*!< Shortest duration. */
+        uint32_t max;                                     /*!< Longest duration. */
+        uint32_t total;                                   /*!< Sum of the durations, wraps around. */
+        uint32_t histogram[ OTA_LATENCY_HISTOGRAM_BINS ]; /*!< Number of durations per bin, see OTA_LATENCY_HISTOGRAM_BINS. */
+    } OtaLatencySummary_t;
+
+/**
+ * @ingroup ota_private_struct_types
+ * @brief Durations of the stages of a download and the counters that go
+ * with them, kept when otaconfigLATENCY_STATS is 1.
+ */
+    typedef struct OtaLatencyStatistics
+    {
+        OtaLatencySummary_t stages[ OtaNumLatencyStages ]; /*!< Durations of each stage, indexed by OtaLatencyStage_t. */
+        uint32_t duplicateBlocks;                          /*!< Number of blocks received more than once. */
+        uint32_t repeatedRequests;                         /*!< Number of data requests sent with no answer to the previous one. */
+        uint32_t requestMomentumPeak;                      /*!< Highest request momentum reached. */
+    } OtaLatencyStatistics_t;
+#endif /* if ( otaconfigLATENCY_STATS == 1U ) */
+
 /**
  * @ingroup ota_enum_types
  * @brief OTA Image states.
@@ -354,6 +456,8 @@ typedef enum OtaEvent
     OtaAgentEventResume,              /*!< @brief Event to resume suspended task */
     OtaAgentEventUserAbort,           /*!< @brief Event triggered by user to stop agent. */
     OtaAgentEventShutdown,            /*!< @brief Event to trigger ota shutdown */
+    OtaAgentEventProgressTimer,       /*!< @brief Event to publish the progress of the file being received. */
+    OtaAgentEventRequestTimerTick,    /*!< @brief Event to check the deadline of the request. */
     OtaAgentEventMax                  /*!< @brief Last event specifier */
 } OtaEvent_t;
 
@@ -409,8 +513,20 @@ typedef struct OtaFileContext
     uint32_t decodeMemMaxSize;    /*!< @brief Maximum size of the decode memory. */
     uint32_t fileType;            /*!< @brief The file type id set when creating the OTA job. */
     Sig256_t * pSignature;        /*!< @brief Pointer to the file's signature structure. */
+    uint32_t digestLength;        /*!< @brief Number of bytes from the start of the file given to the streaming digest. */
+    uint32_t log2BlockSize;       /*!< @brief Log base 2 of the size of the blocks the file is received in. */
 } OtaFileContext_t;
 
+/**
+ * @brief Size of the blocks a file is received in.
+ */
+#define OTA_FILE_BLOCK_SIZE_OF( pFileContext )    ( ( uint32_t ) 1U << ( pFileContext )->log2BlockSize )
+
+/**
+ * @brief Number of blocks of a file.
+ */
+#define OTA_FILE_NUM_BLOCKS( pFileContext )       ( ( ( pFileContext )->fileSize + ( OTA_FILE_BLOCK_SIZE_OF( pFileContext ) - 1U ) ) >> ( pFileContext )->log2BlockSize )
+
 /**
  * @ingroup ota_private_struct_types
  * @brief  The OTA Agent event and data structures.
@@ -421,8 +537,12 @@ typedef struct OtaEventData
     uint8_t data[ OTA_DATA_BLOCK_SIZE ]; /*!< Buffer for storing event information. */
     uint32_t dataLength;                 /*!< Total space required for the event. */
     bool bufferUsed;                     /*!< Flag set when buffer is used otherwise cleared. */
+    uint32_t fileOffset;                 /*!< Offset in the file of a data block received out of order. */
 } OtaEventData_t;
 
+/* Defined in ota.h, which includes this file. */
+struct OtaAgentContext;
+
 /**
  * @ingroup ota_private_struct_types
  * @brief Stores information about the event message.
@@ -430,8 +550,33 @@ typedef struct OtaEventData
  */
 typedef struct OtaEventMsg
 {
-    OtaEventData_t * pEventData; /*!< Event status message. */
-    OtaEvent_t eventId;          /*!< Identifier for the event. */
+    OtaEventData_t * pEventData;        /*!< Event status message. */
+    OtaEvent_t eventId;                 /*!< Identifier for the event. */
+    struct OtaAgentContext * pAgentCtx; /*!< Agent instance the event is for, NULL for the agent started by OTA_Init. */
+    #if ( otaconfigLATENCY_STATS == 1U )
+        uint32_t timestamp;             /*!< Time the event was signaled. */
+    #endif
+    #if ( otaconfigMAX_NUM_AGENTS > 1U )
+        uint32_t generation;            /*!< Generation of the agent instance when the event was signaled. */
+    #endif
 } OtaEventMsg_t;
 
+/**
+ * @brief Whether an event is a control event, as opposed to a file block.
+ *
+ * The OS ports can queue the control events, timer events included, ahead of
+ * the file blocks so that they are not delayed or dropped during a download.
+ */
+#define OTA_IS_CONTROL_EVENT( pEventMsg )    ( ( pEventMsg )->eventId != OtaAgentEventReceivedFileBlock )
+
+/**
+ * @ingroup ota_constants
+ * @brief The number of timer ids the OS timer functions must accept.
+ *
+ * The agent instance at index i of the instances uses the timer ids
+ * ( i * OtaNumOfTimers ) + OtaRequestTimer, ( i * OtaNumOfTimers ) + OtaSelfTestTimer
+ * and ( i * OtaNumOfTimers ) + OtaProgressTimer.
+ */
+#define OTA_NUM_TIMER_IDS    ( ( uint32_t ) OtaNumOfTimers * otaconfigMAX_NUM_AGENTS )
+
 #endif /* ifndef OTA_PRIVATE_H */
@@ -59,6 +59,15 @@
 /* OTA interface includes. */
 #include "ota_interface_private.h"
 
+/* OTA event buffer pool includes. */
+#include "ota_event_buffer.h"
+
+/* OTA job arena includes. */
+#include "ota_job_arena_private.h"
+
+/* OTA block bitmap includes. */
+#include "ota_bitmap_private.h"
+
 /* OTA OS interface. */
 #include "ota_os_interface.h"
 
@@ -74,6 +83,21 @@
  */
 #define U16_OFFSET( type, member )    ( ( uint16_t ) offsetof( type, member ) )
 
+/**
+ * @brief Offset basis of the FNV-1a hash of the job document keys.
+ */
+#define JSON_KEY_HASH_BASIS    2166136261UL
+
+/**
+ * @brief Prime of the FNV-1a hash of the job document keys.
+ */
+#define JSON_KEY_HASH_PRIME    16777619UL
+
+/**
+ * @brief Milliseconds between the ticks of the request timer.
+ */
+#define REQUEST_TIMER_TICK_MS    ( otaconfigFILE_REQUEST_WAIT_MS / otaconfigREQUEST_TIMER_TICKS )
+
 /**
  * @brief OTA event handler definition.
  */
@@ -92,6 +116,44 @@ typedef struct OtaStateTableEntry
     OtaState_t nextState;      /**< New state to be triggered*/
 } OtaStateTableEntry_t;
 
+/**
+ * @brief Value of a document model parameter found in the job document.
+ */
+typedef struct JsonDocValue
+{
+    const char * pValue; /**< Start of the value, after the quote for strings. */
+    size_t valueLength;  /**< Length of the value, without the quotes for strings. */
+} JsonDocValue_t;
+
+/**
+ * @brief Object on the key path being walked in the job document.
+ */
+typedef struct JsonPathFrame
+{
+    const char * pKey;      /**< Key of the object in its parent. */
+    size_t keyLength;       /**< Length of the key. */
+    uint32_t pathHash;      /**< Hash of the key path to the object. */
+    uint32_t pendingParams; /**< Parameters whose value ends with the object, or with the array holding it. */
+    bool isFileParams;      /**< Set for the object of the nested file parameters array being extracted. */
+} JsonPathFrame_t;
+
+/**
+ * @brief State of the walk through the job document looking for the document model keys.
+ */
+typedef struct JsonDocWalk
+{
+    const char * pJson;                                         /**< JSON job document. */
+    size_t jsonLength;                                          /**< Length of the job document. */
+    const JsonDocModel_t * pDocModel;                           /**< Details of expected parameters in the job doc. */
+    JsonDocValue_t * pValues;                                   /**< Values of the parameters found. */
+    JsonPathFrame_t frames[ OTA_DOC_MODEL_MAX_DEPTH + 1U ];     /**< Objects on the key path, the document itself first. */
+    uint32_t depth;                                             /**< Index of the innermost object in frames. */
+    uint32_t scopeDepth;                                        /**< Index in frames of the object the keys are relative to. */
+    uint32_t paramsFound;                                       /**< Bitmap of the parameters found. */
+    uint32_t paramsFoundInDoc;                                  /**< Bitmap of the parameters found relative to the document itself. */
+    uint32_t numFileParams;                                     /**< Number of objects in the nested file parameters array. */
+} JsonDocWalk_t;
+
 /**
  * @brief OTA control interface.
  */
@@ -102,6 +164,34 @@ static OtaControlInterface_t otaControlInterface;
  */
 static OtaDataInterface_t otaDataInterface;
 
+#if ( otaconfigSTATIC_ONLY == 1U )
+
+    #if ( otaconfigJOB_ARENA_SIZE == 0U )
+        #error "otaconfigJOB_ARENA_SIZE must be greater than 0 when otaconfigSTATIC_ONLY is 1."
+    #endif
+
+/**
+ * @brief Storage of the job arena of an agent instance, in its context.
+ */
+    #define JOB_ARENA_STORAGE( pAgentCtx )    ( ( pAgentCtx )->jobArenaStorage.pBytes )
+
+/**
+ * @brief Memory interface of the job arena, none as it is never allocated.
+ */
+    #define JOB_ARENA_MEM                     NULL
+#elif ( otaconfigJOB_ARENA_SIZE > 0U )
+
+/**
+ * @brief Storage of the job arena of an agent instance, allocated with its first buffer.
+ */
+    #define JOB_ARENA_STORAGE( pAgentCtx )    NULL
+
+/**
+ * @brief Memory interface the job arena is allocated with.
+ */
+    #define JOB_ARENA_MEM                     ( &( pOtaAgent->pOtaInterface->os.mem ) )
+#endif /* if ( otaconfigSTATIC_ONLY == 1U ) */
+
 /* OTA agent private function prototypes. */
 
 /**
@@ -117,14 +207,30 @@ static OtaDataInterface_t otaDataInterface;
  * @param[in] pFileContext Information of file to be streamed.
  * @param[in] pRawMsg Raw job document.
  * @param[in] messageSize Length of document.
+ * @param[in] fileOffset Offset in the file of a block received out of order.
  * @param[in] pCloseResult Result of closing file in PAL.
  * @return IngestResult_t IngestResultAccepted_Continue if successful, other error for failure.
  */
 static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
                                        const uint8_t * pRawMsg,
                                        uint32_t messageSize,
+                                       uint32_t fileOffset,
                                        OtaPalStatus_t * pCloseResult );
 
+/**
+ * @brief Write a data block to the file, or give it to the PAL to apply if the file is a delta update.
+ *
+ * @param[in] pFileContext Information of file being received.
+ * @param[in] offset Offset of the block in the file.
+ * @param[in] pData Data from the block.
+ * @param[in] blockSize Size of the block.
+ * @return The number of bytes written on success, a negative value on failure.
+ */
+static int32_t writeFileBlock( OtaFileContext_t * pFileContext,
+                               uint32_t offset,
+                               uint8_t * pData,
+                               uint32_t blockSize );
+
 /**
  * @brief Validate the incoming data block and store it in the file context.
  *
@@ -190,6 +296,137 @@ static DocParseErr_t extractParameter( JsonDocParam_t docParam,
                                        const char * pValueInJson,
                                        size_t valueLength );
 
+/**
+ * @brief Hash a key, or a key path, of the job document.
+ *
+ * @param[in] hash Hash of the key path the key is appended to, or JSON_KEY_HASH_BASIS.
+ * @param[in] pKey Key to hash.
+ * @param[in] keyLength Length of the key.
+ * @return uint32_t Hash of the key path.
+ */
+static uint32_t hashJsonKey( uint32_t hash,
+                             const char * pKey,
+                             size_t keyLength );
+
+/**
+ * @brief Skip the whitespace in a JSON document.
+ *
+ * @param[in] pJson JSON document.
+ * @param[in] jsonLength Length of the document.
+ * @param[in] index Index to start from.
+ * @return size_t Index of the first character that is not whitespace.
+ */
+static size_t skipJsonSpace( const char * pJson,
+                             size_t jsonLength,
+                             size_t index );
+
+/**
+ * @brief Skip a string, an object or array, or a scalar value in a valid JSON document.
+ *
+ * @param[in] pJson JSON document.
+ * @param[in] jsonLength Length of the document.
+ * @param[in] index Index of the first character of the value.
+ * @param[in] nesting Number of objects and arrays already open at index, 0 to skip a whole value.
+ * @return size_t Index following the value, or the close of the open objects and arrays.
+ */
+static size_t skipJsonValue( const char * pJson,
+                             size_t jsonLength,
+                             size_t index,
+                             uint32_t nesting );
+
+/**
+ * @brief Check if the key path walked to a key is the key of a document model parameter.
+ *
+ * @param[in] pWalk State of the walk through the job document.
+ * @param[in] pSrcKey Key of the document model parameter.
+ * @param[in] pKey Key in the job document.
+ * @param[in] keyLength Length of the key.
+ * @return bool true if the key paths are the same, otherwise false.
+ */
+static bool matchJsonKeyPath( const JsonDocWalk_t * pWalk,
+                              const char * pSrcKey,
+                              const char * pKey,
+                              size_t keyLength );
+
+/**
+ * @brief Store the value of each document model parameter with the key path walked to a key.
+ *
+ * A parameter keeps the first value found relative to the document, then the first found in
+ * the nested file parameters.
+ *
+ * @param[in,out] pWalk State of the walk through the job document.
+ * @param[in] pKey Key in the job document.
+ * @param[in] keyLength Length of the key.
+ * @param[in] pathHash Hash of the key path.
+ * @param[in] pValue Start of the value, whose length is set by endJsonDocValues.
+ * @return uint32_t Bitmap of the parameters the value was stored for.
+ */
+static uint32_t storeJsonDocValue( JsonDocWalk_t * pWalk,
+                                   const char * pKey,
+                                   size_t keyLength,
+                                   uint32_t pathHash,
+                                   const char * pValue );
+
+/**
+ * @brief Set the length of the values stored for document model parameters.
+ *
+ * @param[in,out] pWalk State of the walk through the job document.
+ * @param[in] params Bitmap of the parameters.
+ * @param[in] pValueEnd End of the values.
+ */
+static void endJsonDocValues( JsonDocWalk_t * pWalk,
+                              uint32_t params,
+                              const char * pValueEnd );
+
+/**
+ * @brief Find an object of a JSON array and count the values of the array.
+ *
+ * @param[in] pJson JSON document.
+ * @param[in] jsonLength Length of the document.
+ * @param[in] index Index following the opening bracket of the array.
+ * @param[in] objectIndex Index in the array of the object to find.
+ * @param[out] pNumValues Number of values in the array.
+ * @return size_t Index of the opening brace of the object, or jsonLength if that value is not an object.
+ */
+static size_t findJsonArrayObject( const char * pJson,
+                                   size_t jsonLength,
+                                   size_t index,
+                                   uint32_t objectIndex,
+                                   uint32_t * pNumValues );
+
+/**
+ * @brief Walk a key and its value in the job document, opening the value if it is an object.
+ *
+ * @param[in,out] pWalk State of the walk through the job document.
+ * @param[in] index Index of the key.
+ * @return size_t Index following the value, or its opening brace for an object that was opened.
+ */
+static size_t walkJsonKey( JsonDocWalk_t * pWalk,
+                           size_t index );
+
+/**
+ * @brief Find the values of the document model parameters in a single walk through the job document.
+ *
+ * Keys are looked up by the hash of their key path in the table built by initDocModel. The
+ * document must have been validated, although the walk never reads past messageLength and
+ * finds nothing in a document that ends before its top object is closed. The walk is
+ * iterative: its only stack is the JsonDocWalk_t, with one frame for each of the
+ * OTA_DOC_MODEL_MAX_DEPTH objects it can open plus the document. Deeper objects are
+ * skipped with a nesting count, without a frame.
+ *
+ * @param[in] pJson JSON job document.
+ * @param[in] messageLength Length of the job document.
+ * @param[in] pDocModel Details of expected parameters in the job doc.
+ * @param[out] pValues Values of the parameters found.
+ * @param[out] pNumFileParams Number of objects in the nested file parameters array.
+ * @return uint32_t Bitmap of the parameters found.
+ */
+static uint32_t findJsonDocValues( const char * pJson,
+                                   uint32_t messageLength,
+                                   const JsonDocModel_t * pDocModel,
+                                   JsonDocValue_t * pValues,
+                                   uint32_t * pNumFileParams );
+
 /**
  * @brief Extract the desired fields from the JSON document based on the specified document model.
  *
@@ -316,6 +553,7 @@ static bool validateDataBlock( const OtaFileContext_t * pFileContext,
  * @param[in] pFileContext Information of file to be streamed.
  * @param[in] pRawMsg Raw job document.
  * @param[in] messageSize Length of document.
+ * @param[in] fileOffset Offset in the file of a block received out of order.
  * @param[in] pPayload Data stored in the document.
  * @param[out] pBlockSize Block size of incoming data block.
  * @param[out] pBlockIndex Block index of incoming data block.
@@ -324,6 +562,7 @@ static bool validateDataBlock( const OtaFileContext_t * pFileContext,
 static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
                                                const uint8_t * pRawMsg,
                                                uint32_t messageSize,
+                                               uint32_t fileOffset,
                                                uint8_t ** pPayload,
                                                uint32_t * pBlockSize,
                                                uint32_t * pBlockIndex );
@@ -336,31 +575,380 @@ static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
  */
 static bool otaClose( OtaFileContext_t * const pFileContext );
 
+/**
+ * @brief Allocate a buffer for the current job.
+ *
+ * The buffer is taken from the job arena if one is configured, otherwise it is
+ * allocated with the OS interface.
+ *
+ * @param[in] size Size of the buffer in bytes.
+ * @return Pointer to the buffer, or NULL if there is not enough memory.
+ */
+static void * allocJobBuffer( size_t size );
+
+/**
+ * @brief Free a buffer allocated with allocJobBuffer.
+ *
+ * Buffers taken from the job arena are only released with the arena.
+ *
+ * @param[in] pBuffer The buffer to free.
+ */
+static void freeJobBuffer( void * pBuffer );
+
+/**
+ * @brief Prepare the block bitmap of a file to receive.
+ *
+ * The bitmap is allocated unless the file context has a buffer for it. All the
+ * blocks of the file are marked as not received yet.
+ *
+ * @param[in] pFileContext Information of file to be streamed.
+ * @param[in] numBlocks Number of blocks in the file.
+ * @return true if the bitmap is ready, false if it could not be allocated.
+ */
+static bool initBlockBitmap( OtaFileContext_t * pFileContext,
+                             uint32_t numBlocks );
+
+/**
+ * @brief Mark all the blocks of a file as not received yet in its block bitmap.
+ *
+ * @param[in] pFileContext Information of file to be streamed, with a block bitmap.
+ * @param[in] numBlocks Number of blocks in the file.
+ */
+static void eraseBlockBitmap( OtaFileContext_t * pFileContext,
+                              uint32_t numBlocks );
+
+/**
+ * @brief Open the file to receive, resuming it from its checkpoint if the platform can.
+ *
+ * The file of each sink of the agent is created too.
+ *
+ * @param[in] pFileContext Information of file to be streamed, with its block bitmap ready.
+ * @param[in] numBlocks Number of blocks in the file.
+ * @return OtaPalStatus_t OtaPalSuccess if the files are open, other codes on failure.
+ */
+static OtaPalStatus_t openFileForRx( OtaFileContext_t * pFileContext,
+                                     uint32_t numBlocks );
+
+/**
+ * @brief Size of the block bitmap buffer of a file.
+ *
+ * When the platform resumes downloads, an allocated bitmap is large enough for
+ * the smallest block size, so that a checkpoint saved with a block size the
+ * agent has since forgotten can still be restored.
+ *
+ * @param[in] pFileContext Information of file to be streamed.
+ * @param[in] numBlocks Number of blocks in the file.
+ * @return uint32_t Size of the block bitmap buffer in bytes.
+ */
+static uint32_t blockBitmapCapacity( const OtaFileContext_t * pFileContext,
+                                     uint32_t numBlocks );
+
+/**
+ * @brief Resume receiving a file from the checkpoint saved by the platform.
+ *
+ * The file is received in blocks of the size the checkpoint was saved with,
+ * which is also taken for the next files.
+ *
+ * @param[in] pFileContext Information of file to be streamed, with its block bitmap ready.
+ * @param[in] numBlocks Number of blocks in the file.
+ * @return true if the file is resumed, false if it has to be received from the start.
+ */
+static bool resumeFileFromCheckpoint( OtaFileContext_t * pFileContext,
+                                      uint32_t numBlocks );
+
+/**
+ * @brief Choose the size of the blocks to receive a file in.
+ *
+ * The block size adapted to the link is used, or a larger one if the block
+ * bitmap can't track the blocks of the file otherwise.
+ *
+ * @param[in] pFileContext Information of file to be streamed, its block size is set.
+ * @return uint32_t Number of blocks in the file.
+ */
+static uint32_t chooseFileBlockSize( OtaFileContext_t * pFileContext );
+
+/**
+ * @brief Adapt the block size of the next file to how the current one was received.
+ *
+ * @param[in] aborted true if the download is aborted because the service did not answer.
+ */
+static void adaptBlockSize( bool aborted );
+
+#if ( otaconfigLATENCY_STATS == 1U )
+
+/**
+ * @brief Add the time elapsed since a start time to the statistics of a stage
+ * of the download.
+ *
+ * @param[in] stage The stage timed.
+ * @param[in] startTime The otaconfigLATENCY_TIMESTAMP() the stage started at.
+ */
+    static void recordLatency( OtaLatencyStage_t stage,
+                               uint32_t startTime );
+#endif
+
+/**
+ * @brief Save a checkpoint of the file being received if the platform supports it.
+ *
+ * @param[in] blockInterval The checkpoint is only saved if the number of blocks received is a multiple of it.
+ */
+static void saveFileCheckpoint( uint32_t blockInterval );
+
+/**
+ * @brief Add a block written to the file to its digest if it follows the part already digested.
+ *
+ * @param[in] pFileContext Information of file being received.
+ * @param[in] offset Offset of the block in the file.
+ * @param[in] pData Data from the block.
+ * @param[in] blockSize Size of the block.
+ */
+static void updateFileDigest( OtaFileContext_t * pFileContext,
+                              uint32_t offset,
+                              const uint8_t * pData,
+                              uint32_t blockSize );
+
+/**
+ * @brief Report the progress of the file being received once a block is accepted.
+ *
+ * If otaconfigPROGRESS_REPORT_INTERVAL_MS is greater than 0, the progress is kept
+ * pending and the progress timer started, the status is published by
+ * progressTimerHandler. Otherwise the status is published every
+ * otaconfigOTA_UPDATE_STATUS_FREQUENCY blocks.
+ *
+ * @return OtaErr_t OtaErrNone if the progress is reported or does not need to be, other codes on failure.
+ */
+static OtaErr_t reportProgress( void );
+
+/**
+ * @brief Stop the progress timer and drop the progress not published yet.
+ */
+static void stopProgressReports( void );
+
+/**
+ * @brief Keep a copy of the job document if the job has more than one file to receive.
+ *
+ * A copy the agent already has is replaced, or kept if the new one can't be allocated.
+ *
+ * @param[in] pJson JSON job document.
+ * @param[in] messageLength Length of the job document.
+ * @return true if the job document is kept or does not need to be, false if it could not be allocated.
+ */
+static bool storeJobDoc( const char * pJson,
+                         uint32_t messageLength );
+
+/**
+ * @brief Free the copy of the job document, if any.
+ */
+static void freeJobDoc( void );
+
+/**
+ * @brief Start receiving the next file of the job once a file is complete.
+ *
+ * The file context is parsed again from the copy of the job document for the next file
+ * and its file is created. The event to start the file transfer is then sent.
+ *
+ * @return OtaErr_t OtaErrNone if the file transfer is started, other codes on failure.
+ */
+static OtaErr_t startNextJobFile( void );
+
+#if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+
+/**
+ * @brief Create the files of the sinks of the agent for the file to receive.
+ *
+ * @param[in] pFileContext Information of file to be streamed.
+ * @param[in] numBlocks Number of blocks in the file.
+ * @return OtaPalStatus_t The status of the first sink that failed, OtaPalSuccess otherwise.
+ */
+    static OtaPalStatus_t createFileSinks( const OtaFileContext_t * pFileContext,
+                                           uint32_t numBlocks );
+
+/**
+ * @brief Write a block accepted for the file received to the files of the sinks.
+ *
+ * @param[in] blockIndex Index of the block.
+ * @param[in] pPayload Data from the block.
+ * @param[in] blockSize Size of the block.
+ * @return true if every sink missing the block wrote it, false otherwise.
+ */
+    static bool writeFileSinks( uint32_t blockIndex,
+                                uint8_t * pPayload,
+                                uint32_t blockSize );
+
+/**
+ * @brief Close the files of the sinks once the file received is complete.
+ *
+ * @param[out] pCloseResult Result of closing the file of the first sink that failed.
+ * @return IngestResult_t IngestResultFileComplete if all the files are closed, other error for failure.
+ */
+    static IngestResult_t closeFileSinks( OtaPalStatus_t * pCloseResult );
+
+/**
+ * @brief Abort the files of the sinks still open and free their bitmaps.
+ */
+    static void abortFileSinks( void );
+#endif /* if ( otaconfigMAX_NUM_FILE_SINKS > 0U ) */
+
+#if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+
+/**
+ * @brief Write a block to the file through the write combining buffer.
+ *
+ * The block is added to the blocks buffered if it follows them, otherwise they
+ * are written first. The buffer is written once it reaches the end of a sector
+ * or of the file.
+ *
+ * @param[in] pFileContext Information of file being received.
+ * @param[in] offset Offset of the block in the file.
+ * @param[in] pData Data from the block.
+ * @param[in] blockSize Size of the block.
+ * @return The size of the block on success, a negative value if writing to the file failed.
+ */
+    static int32_t writeCombinedBlock( OtaFileContext_t * pFileContext,
+                                       uint32_t offset,
+                                       const uint8_t * pData,
+                                       uint32_t blockSize );
+
+/**
+ * @brief Write the blocks buffered, if any, to the file.
+ *
+ * The blocks are kept in the buffer if writing them fails.
+ *
+ * @param[in] pFileContext Information of file being received.
+ * @return true if the buffer is empty or written, false if writing to the file failed.
+ */
+    static bool flushWriteCombine( OtaFileContext_t * pFileContext );
+#endif /* if ( otaconfigWRITE_COMBINE_SIZE > 0U ) */
+
 /**
  * @brief OTA Timer callback.
  *
- * @param[in] otaTimerId Reference to the timer to use.
+ * @param[in] otaTimerId Reference to the timer to use, for the agent instance it was started by.
  */
 static void otaTimerCallback( OtaTimerId_t otaTimerId );
 
+/**
+ * @brief Get the id of a timer of an agent instance for the OS timer functions.
+ *
+ * @param[in] pAgentCtx The agent instance.
+ * @param[in] otaTimerId The timer of the instance.
+ * @return The id of the timer for the OS interface, below OTA_NUM_TIMER_IDS.
+ */
+static OtaTimerId_t agentTimerId( const OtaAgentContext_t * pAgentCtx,
+                                  OtaTimerId_t otaTimerId );
+
+/**
+ * @brief Set the deadline of a request otaconfigFILE_REQUEST_WAIT_MS from now.
+ *
+ * The OS timer is started only if it is not ticking already, so that the data
+ * blocks received just move the deadline.
+ *
+ * @return OtaOsSuccess if the request timer is running, the error of the OS
+ * timer otherwise.
+ */
+static OtaOsStatus_t startRequestTimer( void );
+
+/**
+ * @brief Stop waiting for the deadline of the request.
+ *
+ * The OS timer stops at its next tick.
+ */
+static void stopRequestTimer( void );
+
+/**
+ * @brief Count a tick of the request timer and time the request out once
+ * its deadline is reached.
+ */
+static void requestTimerTick( void );
+
+/**
+ * @brief Make an agent instance the one processing events.
+ *
+ * Saves the data interface selected by the current instance and restores the
+ * one of the instance processing events next.
+ *
+ * @param[in] pAgentCtx The agent instance, NULL for the agent started by OTA_Init.
+ */
+static void switchAgent( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Check if an event is for an agent instance shut down since the event was signaled.
+ *
+ * The context of such an instance may be released or started again by the
+ * application, so it is found by its address only and never read.
+ *
+ * @param[in] pEventMsg The event received.
+ * @return true if the instance of the event is shut down, false otherwise.
+ */
+static bool eventInstanceStale( const OtaEventMsg_t * pEventMsg );
+
+/**
+ * @brief Check if agent instances started with OTA_InstanceInit are running.
+ *
+ * @return true if an instance is running, false otherwise.
+ */
+static bool instancesRunning( void );
+
+/**
+ * @brief Initialize the context of an agent instance.
+ *
+ * @param[in] pAgentCtx The agent instance.
+ * @param[in] pOtaBuffer OTA Application buffers.
+ * @param[in] pOtaInterfaces The interfaces used by the instance.
+ * @param[in] pThingName A pointer to a C string holding the Thing name.
+ * @param[in] OtaAppCallback OTA App callback.
+ * @return OtaErr_t OtaErrNone if successful, OtaErrUninitialized if the Thing name is invalid.
+ */
+static OtaErr_t initAgentContext( OtaAgentContext_t * pAgentCtx,
+                                  OtaAppBuffer_t * pOtaBuffer,
+                                  OtaInterfaces_t * pOtaInterfaces,
+                                  const uint8_t * pThingName,
+                                  OtaAppCallback_t OtaAppCallback );
+
+/**
+ * @brief Signal an agent instance to shut down.
+ *
+ * @param[in] pAgentCtx The agent instance.
+ * @param[in] ticksToWait The number of ticks to wait for the shutdown to complete.
+ * @param[in] unsubscribeFlag Flag to indicate if unsubscribe from job topics should be done.
+ * @return The state of the instance.
+ */
+static OtaState_t shutdownAgent( OtaAgentContext_t * pAgentCtx,
+                                 uint32_t ticksToWait,
+                                 uint8_t unsubscribeFlag );
+
+/**
+ * @brief Add a file sink to an agent instance.
+ *
+ * @param[in] pAgentCtx The agent instance.
+ * @param[in] pFileSink The file context of the sink.
+ * @return OtaErr_t OtaErrNone if the sink is added, otherwise OtaErrInvalidArg.
+ */
+static OtaErr_t addFileSink( OtaAgentContext_t * pAgentCtx,
+                             OtaFileContext_t * pFileSink );
+
 /**
  * @brief Internal function to set the image state including an optional reason code.
  *
+ * @param[in] pAgentCtx The agent instance.
  * @param[in] stateToSet State to set.
  * @param[in] reasonToSet Reason to set.
  * @return OtaErr_t OtaErrNone if successful, other codes on failure.
  */
-static OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
+static OtaErr_t setImageStateWithReason( OtaAgentContext_t * pAgentCtx,
+                                         OtaImageState_t stateToSet,
                                          uint32_t reasonToSet );
 
 /**
  * @brief Internal function to update the job status to the jobs service from current image state.
  *
+ * @param[in] pAgentCtx The agent instance.
  * @param[in] state State to set.
  * @param[in] subReason Reason for status.
  * @return OtaErr_t OtaErrNone if successful, other codes on failure.
  */
-static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
+static OtaErr_t updateJobStatusFromImageState( OtaAgentContext_t * pAgentCtx,
+                                               OtaImageState_t state,
                                                int32_t subReason );
 
 /**
@@ -392,23 +980,39 @@ static DocParseErr_t initDocModel( JsonDocModel_t * pDocModel,
 /**
  * @brief Initialize buffers for storing the file attributes.
  *
- * @param[out] pOtaBuffer OTA Application buffers.
+ * @param[out] pAgentCtx The agent instance.
+ * @param[in] pOtaBuffer OTA Application buffers.
  */
-static void initializeAppBuffers( OtaAppBuffer_t * pOtaBuffer );
+static void initializeAppBuffers( OtaAgentContext_t * pAgentCtx,
+                                  OtaAppBuffer_t * pOtaBuffer );
 
 /**
  * @brief Initialize jobId and protocol buffers.
+ *
+ * @param[out] pAgentCtx The agent instance.
  */
-static void initializeLocalBuffers( void );
+static void initializeLocalBuffers( OtaAgentContext_t * pAgentCtx );
 
 /**
- * @brief Search the state transition table for the entry based on current state and incoming event.
+ * @brief Look up the state transition table entry for the current state and incoming event.
  *
  * @param[in] pEventMsg Incoming event information.
  * @return uint32_t Index of the transition.
  */
 static uint32_t searchTransition( const OtaEventMsg_t * pEventMsg );
 
+/**
+ * @brief Build the index of the state transition table for each state and event.
+ */
+static void initTransitionIndex( void );
+
+/**
+ * @brief Process an event with the handler of its transition, if there is one.
+ *
+ * @param[in] pEventMsg Incoming event information.
+ */
+static void processOtaEvent( const OtaEventMsg_t * pEventMsg );
+
 /**
  * @brief Initiate download if not in self-test else reboot
  *
@@ -462,16 +1066,76 @@ static void handleJobParsingError( const OtaFileContext_t * pFileContext,
                                    OtaJobParseErr_t err );
 
 /**
- * @brief Receive and process the next available event from the event queue.
+ * @brief Update the sliding request window after a new data block is accepted.
+ *
+ * The block no longer counts as in flight. If packets were dropped before
+ * reaching the agent since the last update, their slots are freed and the
+ * window is halved. Otherwise the window grows by one block per block received
+ * until it reaches the threshold, then by one block per window received.
+ */
+static void updateRequestWindow( void );
+
+/**
+ * @brief Shrink the sliding request window to the event buffers left in the pool.
+ *
+ * Every block in flight needs a free event buffer when it arrives. Keeping
+ * the window within the free buffers slows the requests down while the agent
+ * drains a burst, instead of receiving blocks that would have to be dropped.
+ */
+static void limitRequestWindowToBuffers( void );
+
+/**
+ * @brief Receive and process the next available events from the event queue.
  *
  * Each event is processed based on the behavior defined in the OTA transition
  * table. The state of the OTA state machine will be updated and the
- * corresponding event handler will be called.
+ * corresponding event handler will be called. If the OS interface can receive
+ * a batch of events, all the pending ones are received and processed at once.
  */
 static void receiveAndProcessOtaEvent( void );
 
-/* OTA state event handler functions. */
-
+/**
+ * @brief Process events received together, in order.
+ *
+ * @param[in] pEventMsgs The events to process.
+ * @param[in] numEvents Number of events.
+ */
+static void processOtaEvents( OtaEventMsg_t * pEventMsgs,
+                              uint32_t numEvents );
+
+/**
+ * @brief Poll and process the pending events until the queue is empty.
+ *
+ * The caller holds the processing of the events.
+ *
+ * @param[in] maxEvents The maximum number of events to process.
+ * @return uint32_t The number of events processed.
+ */
+static uint32_t pollOtaEvents( uint32_t maxEvents );
+
+/**
+ * @brief Set a flag shared by the tasks of the application and return its previous value.
+ *
+ * The exchange is atomic with the GCC builtins, which clang provides too.
+ * Other compilers get a plain read and write.
+ *
+ * @param[in] pFlag The flag.
+ * @param[in] value The new value of the flag.
+ * @return bool The value of the flag before it is set.
+ */
+static bool exchangeFlag( bool * pFlag,
+                          bool value );
+
+/**
+ * @brief Read a flag shared by the tasks of the application.
+ *
+ * @param[in] pFlag The flag.
+ * @return bool The value of the flag.
+ */
+static bool loadFlag( const bool * pFlag );
+
+/* OTA state event handler functions. */
+
 static OtaErr_t startHandler( const OtaEventData_t * pEventData );           /*!< Start timers and initiate request for job document. */
 static OtaErr_t requestJobHandler( const OtaEventData_t * pEventData );      /*!< Initiate a request for a job. */
 static OtaErr_t processJobHandler( const OtaEventData_t * pEventData );      /*!< Update file context from job document. */
@@ -479,19 +1143,22 @@ static OtaErr_t inSelfTestHandler( const OtaEventData_t * pEventData );      /*!
 static OtaErr_t initFileHandler( const OtaEventData_t * pEventData );        /*!< Initialize and handle file transfer. */
 static OtaErr_t processDataHandler( const OtaEventData_t * pEventData );     /*!< Process incoming data blocks. */
 static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData );     /*!< Request for data blocks. */
+static OtaErr_t requestTimeoutHandler( const OtaEventData_t * pEventData );  /*!< Shrink the request window and request data blocks again. */
 static OtaErr_t shutdownHandler( const OtaEventData_t * pEventData );        /*!< Shutdown OTA and cleanup. */
 static OtaErr_t closeFileHandler( const OtaEventData_t * pEventData );       /*!< Close file opened for download. */
 static OtaErr_t userAbortHandler( const OtaEventData_t * pEventData );       /*!< Handle user interrupt to abort task. */
 static OtaErr_t suspendHandler( const OtaEventData_t * pEventData );         /*!< Handle suspend event for OTA agent. */
 static OtaErr_t resumeHandler( const OtaEventData_t * pEventData );          /*!< Resume from a suspended state. */
 static OtaErr_t jobNotificationHandler( const OtaEventData_t * pEventData ); /*!< Upon receiving a new job document cancel current job if present and initiate new download. */
+static OtaErr_t progressTimerHandler( const OtaEventData_t * pEventData );   /*!< Publish the progress of the blocks received since the last status. */
 static void executeHandler( uint32_t index,
                             const OtaEventMsg_t * const pEventMsg );         /*!< Execute the handler for selected index from the transition table. */
 
 /**
- * @brief This is THE OTA agent context and initialization state.
+ * @brief This is THE OTA agent context and initialization state. It holds the
+ * static buffers of the agent when otaconfigSTATIC_ONLY is 1.
  */
-static OtaAgentContext_t otaAgent =
+static OtaAgentContext_t otaAgent otaconfigSTATIC_MEMORY_ATTRIBUTE =
 {
     OtaAgentStateStopped, /* state */
     { 0 },                /* pThingName */
@@ -505,11 +1172,73 @@ static OtaAgentContext_t otaAgent =
     1,                    /* numOfBlocksToReceive */
     { 0 },                /* statistics */
     0,                    /* requestMomentum */
+    { 0 },                /* requestWindow */
+    { { 0 }, 0, { 0 }, 0, { 0 }, 0 }, /* requestCache */
+    otaconfigLOG2_FILE_BLOCK_SIZE,    /* log2BlockSize */
+    0,                                /* requestTimeouts */
+    0,                                /* requestTicks */
+    0,                                /* requestDeadline */
+    false,                            /* requestTimerArmed */
+    false,                            /* requestTimerTicking */
     NULL,                 /* pOtaInterface */
     NULL,                 /* OtaAppCallback */
-    1                     /* unsubscribe flag */
+    1,                    /* unsubscribe flag */
+    0,                    /* agentIndex */
+    { 0 },                /* pJobNameBuffer */
+    { 0 },                /* pProtocolBuffer */
+    { 0 },                /* sig256Buffer */
+    0,                    /* currBlock */
+    NULL,                 /* pJobDoc */
+    0,                    /* jobDocLength */
+    0,                    /* numJobFiles */
+    false,                /* jobHasFirmware */
+    false,                /* progressPending */
+    false,                /* progressTimerStarted */
+    #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+        { NULL },         /* pFileSinks */
+        0,                /* numFileSinks */
+    #endif
+    #if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+        { { 0 }, 0, 0 },  /* writeCombine */
+    #endif
+    #if ( otaconfigLATENCY_STATS == 1U )
+        { { { 0 } }, 0, 0, 0 }, /* latency */
+        0,                      /* requestTimestamp */
+    #endif
+    #if ( otaconfigJOB_ARENA_SIZE > 0U )
+        { NULL, 0, 0 }, /* jobArena */
+    #endif
+    #if ( otaconfigSTATIC_ONLY == 1U )
+        { { 0 } },      /* jobArenaStorage */
+        #if ( otaconfigMAX_FILES_PER_JOB > 1U )
+            { { 0 } },  /* jobDocStorage */
+        #endif
+    #endif
 };
 
+/**
+ * @brief The agent instances, by index. The first one is the agent started by OTA_Init.
+ */
+static OtaAgentContext_t * pOtaAgents[ otaconfigMAX_NUM_AGENTS ] = { &otaAgent };
+
+/**
+ * @brief The agent instance whose event is being processed.
+ */
+static OtaAgentContext_t * pOtaAgent = &otaAgent;
+
+#if ( otaconfigMAX_NUM_AGENTS > 1U )
+
+/**
+ * @brief The data interface selected by each agent instance, saved while another is processing events.
+ */
+    static OtaDataInterface_t otaDataInterfaces[ otaconfigMAX_NUM_AGENTS ];
+
+/**
+ * @brief The generation of each agent instance index, advanced when the instance is shut down.
+ */
+    static uint32_t agentGenerations[ otaconfigMAX_NUM_AGENTS ];
+#endif
+
 /**
  * @brief Transition table for the OTA state machine.
  */
@@ -526,17 +1255,26 @@ static OtaStateTableEntry_t otaTransitionTable[] =
     { OtaAgentStateRequestingFileBlock, OtaAgentEventRequestFileBlock,    requestDataHandler,     OtaAgentStateWaitingForFileBlock },
     { OtaAgentStateRequestingFileBlock, OtaAgentEventRequestTimer,        requestDataHandler,     OtaAgentStateWaitingForFileBlock },
     { OtaAgentStateWaitingForFileBlock, OtaAgentEventReceivedFileBlock,   processDataHandler,     OtaAgentStateWaitingForFileBlock },
-    { OtaAgentStateWaitingForFileBlock, OtaAgentEventRequestTimer,        requestDataHandler,     OtaAgentStateWaitingForFileBlock },
+    { OtaAgentStateWaitingForFileBlock, OtaAgentEventRequestTimer,        requestTimeoutHandler,  OtaAgentStateWaitingForFileBlock },
     { OtaAgentStateWaitingForFileBlock, OtaAgentEventRequestFileBlock,    requestDataHandler,     OtaAgentStateWaitingForFileBlock },
     { OtaAgentStateWaitingForFileBlock, OtaAgentEventRequestJobDocument,  requestJobHandler,      OtaAgentStateWaitingForJob       },
     { OtaAgentStateWaitingForFileBlock, OtaAgentEventReceivedJobDocument, jobNotificationHandler, OtaAgentStateRequestingJob       },
     { OtaAgentStateWaitingForFileBlock, OtaAgentEventCloseFile,           closeFileHandler,       OtaAgentStateWaitingForJob       },
+    { OtaAgentStateWaitingForFileBlock, OtaAgentEventCreateFile,          initFileHandler,        OtaAgentStateRequestingFileBlock },
+    { OtaAgentStateWaitingForFileBlock, OtaAgentEventProgressTimer,       progressTimerHandler,   OtaAgentStateWaitingForFileBlock },
     { OtaAgentStateSuspended,           OtaAgentEventResume,              resumeHandler,          OtaAgentStateRequestingJob       },
     { OtaAgentStateAll,                 OtaAgentEventSuspend,             suspendHandler,         OtaAgentStateSuspended           },
     { OtaAgentStateAll,                 OtaAgentEventUserAbort,           userAbortHandler,       OtaAgentStateWaitingForJob       },
     { OtaAgentStateAll,                 OtaAgentEventShutdown,            shutdownHandler,        OtaAgentStateStopped             },
 };
 
+/**
+ * @brief Index of the transition for each state and event, or the length of
+ * the transition table if there is none. The last row holds the transitions of
+ * any other state. Built from otaTransitionTable by OTA_Init.
+ */
+static uint8_t otaTransitionIndex[ OtaAgentStateAll + 1 ][ OtaAgentEventMax ];
+
 /* MISRA rule 2.2 warns about unused variables. These 2 variables are used in log messages, which is
  * disabled when running static analysis. So it's a false positive. */
 /* coverity[misra_c_2012_rule_2_2_violation] */
@@ -573,7 +1311,9 @@ static const char * pOtaEventStrings[ OtaAgentEventMax ] =
     "Suspend",
     "Resume",
     "UserAbort",
-    "Shutdown"
+    "Shutdown",
+    "ProgressTimer",
+    "RequestTimerTick"
 };
 
 /**
@@ -604,36 +1344,245 @@ static const JsonDocParam_t otaJobDocModelParamStructure[ OTA_NUM_JOB_PARAMS ] =
     { OTA_JSON_FILETYPE_KEY,        OTA_JOB_PARAM_OPTIONAL, U16_OFFSET( OtaFileContext_t, fileType ),            OTA_DONT_STORE_PARAM, ModelParamTypeUInt32}
 };
 
-static uint8_t pJobNameBuffer[ OTA_JOB_ID_MAX_SIZE ];       /*!< Buffer to store job name. */
-static uint8_t pProtocolBuffer[ OTA_PROTOCOL_BUFFER_SIZE ]; /*!< Buffer to store data protocol. */
-static Sig256_t sig256Buffer;                               /*!< Buffer to store key file signature. */
+/* The events of every agent instance are processed by the task of the agent
+ * started by OTA_Init, so the state of the processing is shared by all of them. */
+
+static bool eventsProcessing = false; /*!< The agent is processing events, so they can't be processed from a callback or another task. */
+
+static bool eventsPolled = false; /*!< The agent is run with OTA_Poll instead of the agent task. */
+
+static bool exchangeFlag( bool * pFlag,
+                          bool value )
+{
+    bool previous = false;
+
+    #if defined( __GNUC__ )
+        previous = __atomic_exchange_n( pFlag, value, __ATOMIC_ACQ_REL );
+    #else
+        previous = *pFlag;
+        *pFlag = value;
+    #endif
+
+    return previous;
+}
+
+static bool loadFlag( const bool * pFlag )
+{
+    bool value = false;
+
+    #if defined( __GNUC__ )
+        value = __atomic_load_n( pFlag, __ATOMIC_ACQUIRE );
+    #else
+        value = *pFlag;
+    #endif
+
+    return value;
+}
 
 static void otaTimerCallback( OtaTimerId_t otaTimerId )
 {
-    assert( ( otaTimerId == OtaRequestTimer ) || ( otaTimerId == OtaSelfTestTimer ) );
+    uint32_t agentIndex = ( uint32_t ) otaTimerId / ( uint32_t ) OtaNumOfTimers;
+    uint32_t timerIndex = ( uint32_t ) otaTimerId % ( uint32_t ) OtaNumOfTimers;
+    OtaAgentContext_t * pAgentCtx = NULL;
+
+    assert( agentIndex < otaconfigMAX_NUM_AGENTS );
 
-    if( otaTimerId == OtaRequestTimer )
+    if( agentIndex < otaconfigMAX_NUM_AGENTS )
     {
-        OtaEventMsg_t xEventMsg = { 0 };
+        pAgentCtx = pOtaAgents[ agentIndex ];
+    }
 
-        LogDebug( ( "Self-test expired within %ums",
-                    otaconfigFILE_REQUEST_WAIT_MS ) );
+    if( pAgentCtx == NULL )
+    {
+        LogWarn( ( "Timer expired for an agent instance that is not started: "
+                   "otaTimerId=%u",
+                   ( unsigned ) otaTimerId ) );
+    }
+    else if( timerIndex == ( uint32_t ) OtaRequestTimer )
+    {
+        OtaEventMsg_t xEventMsg = { 0 };
 
-        xEventMsg.eventId = OtaAgentEventRequestTimer;
+        xEventMsg.eventId = OtaAgentEventRequestTimerTick;
 
-        /* Send request timer event. */
-        if( OTA_SignalEvent( &xEventMsg ) == false )
+        /* Send the tick, the agent checks the deadline of the request. */
+        if( OTA_InstanceSignalEvent( pAgentCtx, &xEventMsg ) == false )
         {
-            LogError( ( "Failed to signal the OTA Agent to start request timer" ) );
+            LogError( ( "Failed to signal the OTA Agent with a tick of the request timer, "
+                        "sending it again after the next tick period" ) );
+
+            /* The agent only restarts the timer when it gets the tick, so
+             * the tick is sent again rather than lost. */
+            if( pAgentCtx->pOtaInterface->os.timer.start( otaTimerId,
+                                                          "OtaRequestTimer",
+                                                          REQUEST_TIMER_TICK_MS,
+                                                          otaTimerCallback ) != OtaOsSuccess )
+            {
+                /* No tick is coming, so the next request starts the timer again. The
+                 * agent task reads the flag while the timer may clear it. */
+                ( void ) exchangeFlag( &( pAgentCtx->requestTimerTicking ), false );
+            }
         }
     }
-    else /* ( otaTimerId == OtaSelfTestTimer ) */
+    else if( timerIndex == ( uint32_t ) OtaSelfTestTimer )
     {
         LogError( ( "Self test failed to complete within %ums",
                     otaconfigSELF_TEST_RESPONSE_WAIT_MS ) );
 
-        ( void ) otaAgent.pOtaInterface->pal.reset( &otaAgent.fileContext );
+        ( void ) pAgentCtx->pOtaInterface->pal.reset( &pAgentCtx->fileContext );
+    }
+    else /* ( timerIndex == OtaProgressTimer ) */
+    {
+        OtaEventMsg_t xEventMsg = { 0 };
+
+        xEventMsg.eventId = OtaAgentEventProgressTimer;
+
+        /* Send progress timer event. */
+        if( OTA_InstanceSignalEvent( pAgentCtx, &xEventMsg ) == false )
+        {
+            LogError( ( "Failed to signal the OTA Agent to publish the progress" ) );
+        }
+    }
+}
+
+static OtaTimerId_t agentTimerId( const OtaAgentContext_t * pAgentCtx,
+                                  OtaTimerId_t otaTimerId )
+{
+    /* The ids of the timers of an instance follow those of the instance before it. */
+    return ( OtaTimerId_t ) ( ( pAgentCtx->agentIndex * ( uint32_t ) OtaNumOfTimers ) + ( uint32_t ) otaTimerId );
+}
+
+static OtaOsStatus_t startRequestTimer( void )
+{
+    OtaOsStatus_t osErr = OtaOsSuccess;
+
+    if( loadFlag( &( pOtaAgent->requestTimerTicking ) ) == false )
+    {
+        osErr = pOtaAgent->pOtaInterface->os.timer.start( agentTimerId( pOtaAgent, OtaRequestTimer ),
+                                                        "OtaRequestTimer",
+                                                        REQUEST_TIMER_TICK_MS,
+                                                        otaTimerCallback );
+
+        if( osErr == OtaOsSuccess )
+        {
+            ( void ) exchangeFlag( &( pOtaAgent->requestTimerTicking ), true );
+            pOtaAgent->requestDeadline = pOtaAgent->requestTicks + otaconfigREQUEST_TIMER_TICKS;
+            pOtaAgent->requestTimerArmed = true;
+        }
+    }
+    else
+    {
+        /* The tick in progress started before now, so it is not counted. */
+        pOtaAgent->requestDeadline = pOtaAgent->requestTicks + otaconfigREQUEST_TIMER_TICKS + 1U;
+        pOtaAgent->requestTimerArmed = true;
+    }
+
+    return osErr;
+}
+
+static void stopRequestTimer( void )
+{
+    pOtaAgent->requestTimerArmed = false;
+}
+
+static void requestTimerTick( void )
+{
+    OtaEventMsg_t eventMsg = { 0 };
+    OtaOsStatus_t osErr = OtaOsSuccess;
+
+    pOtaAgent->requestTicks++;
+    ( void ) exchangeFlag( &( pOtaAgent->requestTimerTicking ), false );
+
+    /* The deadline is always ahead of the ticks counted, so it is reached
+     * exactly, even once the ticks wrap around. */
+    if( ( pOtaAgent->requestTimerArmed == true ) && ( pOtaAgent->requestTicks != pOtaAgent->requestDeadline ) )
+    {
+        osErr = pOtaAgent->pOtaInterface->os.timer.start( agentTimerId( pOtaAgent, OtaRequestTimer ),
+                                                        "OtaRequestTimer",
+                                                        REQUEST_TIMER_TICK_MS,
+                                                        otaTimerCallback );
+
+        if( osErr == OtaOsSuccess )
+        {
+            ( void ) exchangeFlag( &( pOtaAgent->requestTimerTicking ), true );
+        }
+        else
+        {
+            /* Time the request out now rather than never. */
+            LogError( ( "Failed to restart request timer: "
+                        "OtaOsStatus_t=%s",
+                        OTA_OsStatus_strerror( osErr ) ) );
+        }
+    }
+
+    if( ( pOtaAgent->requestTimerArmed == true ) && ( loadFlag( &( pOtaAgent->requestTimerTicking ) ) == false ) )
+    {
+        LogDebug( ( "Request timed out after %ums",
+                    otaconfigFILE_REQUEST_WAIT_MS ) );
+
+        pOtaAgent->requestTimerArmed = false;
+
+        eventMsg.eventId = OtaAgentEventRequestTimer;
+        eventMsg.pAgentCtx = pOtaAgent;
+        processOtaEvent( &eventMsg );
+    }
+}
+
+static bool eventInstanceStale( const OtaEventMsg_t * pEventMsg )
+{
+    bool stale = false;
+
+    #if ( otaconfigMAX_NUM_AGENTS > 1U )
+        uint32_t index = 0;
+
+        if( pEventMsg->pAgentCtx != NULL )
+        {
+            stale = true;
+
+            for( index = 1U; index < otaconfigMAX_NUM_AGENTS; index++ )
+            {
+                if( ( pOtaAgents[ index ] == pEventMsg->pAgentCtx ) &&
+                    ( agentGenerations[ index ] == pEventMsg->generation ) )
+                {
+                    stale = false;
+                }
+            }
+        }
+    #else
+        ( void ) pEventMsg;
+    #endif
+
+    return stale;
+}
+
+static bool instancesRunning( void )
+{
+    bool running = false;
+    uint32_t index = 0;
+
+    for( index = 1U; index < otaconfigMAX_NUM_AGENTS; index++ )
+    {
+        if( pOtaAgents[ index ] != NULL )
+        {
+            running = true;
+        }
     }
+
+    return running;
+}
+
+static void switchAgent( OtaAgentContext_t * pAgentCtx )
+{
+    OtaAgentContext_t * pNextAgent = ( pAgentCtx != NULL ) ? pAgentCtx : &otaAgent;
+
+    #if ( otaconfigMAX_NUM_AGENTS > 1U )
+        if( pNextAgent != pOtaAgent )
+        {
+            otaDataInterfaces[ pOtaAgent->agentIndex ] = otaDataInterface;
+            otaDataInterface = otaDataInterfaces[ pNextAgent->agentIndex ];
+        }
+    #endif
+
+    pOtaAgent = pNextAgent;
 }
 
 
@@ -644,7 +1593,7 @@ static bool platformInSelftest( void )
     /*
      * Get the platform state from the OTA pal layer.
      */
-    if( otaAgent.pOtaInterface->pal.getPlatformImageState( &( otaAgent.fileContext ) ) == OtaPalImageStatePendingCommit )
+    if( pOtaAgent->pOtaInterface->pal.getPlatformImageState( &( pOtaAgent->fileContext ) ) == OtaPalImageStatePendingCommit )
     {
         selfTest = true;
     }
@@ -652,7 +1601,8 @@ static bool platformInSelftest( void )
     return selfTest;
 }
 
-static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
+static OtaErr_t updateJobStatusFromImageState( OtaAgentContext_t * pAgentCtx,
+                                               OtaImageState_t state,
                                                int32_t subReason )
 {
     OtaErr_t err = OtaErrNone;
@@ -661,7 +1611,7 @@ static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
     if( state == OtaImageStateTesting )
     {
         /* We discovered we're ready for test mode, put job status in self_test active. */
-        err = otaControlInterface.updateJobStatus( &otaAgent,
+        err = otaControlInterface.updateJobStatus( pAgentCtx,
                                                    JobStatusInProgress,
                                                    JobReasonSelfTestActive,
                                                    0 );
@@ -671,7 +1621,7 @@ static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
         if( state == OtaImageStateAccepted )
         {
             /* Now that we have accepted the firmware update, we can complete the job. */
-            err = otaControlInterface.updateJobStatus( &otaAgent,
+            err = otaControlInterface.updateJobStatus( pAgentCtx,
                                                        JobStatusSucceeded,
                                                        JobReasonAccepted,
                                                        appFirmwareVersion.u.signedVersion32 );
@@ -683,7 +1633,7 @@ static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
              * will not allow us to set REJECTED after the job has been started already).
              */
             reason = ( state == OtaImageStateRejected ) ? JobReasonRejected : JobReasonAborted;
-            err = otaControlInterface.updateJobStatus( &otaAgent,
+            err = otaControlInterface.updateJobStatus( pAgentCtx,
                                                        JobStatusFailed,
                                                        reason,
                                                        subReason );
@@ -692,13 +1642,14 @@ static OtaErr_t updateJobStatusFromImageState( OtaImageState_t state,
         /*
          * We don't need the job name memory anymore since we're done with this job.
          */
-        ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+        ( void ) memset( pAgentCtx->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
     }
 
     return err;
 }
 
-static OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
+static OtaErr_t setImageStateWithReason( OtaAgentContext_t * pAgentCtx,
+                                         OtaImageState_t stateToSet,
                                          uint32_t reasonToSet )
 {
     OtaErr_t err = OtaErrNone;
@@ -707,7 +1658,7 @@ static OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
     OtaPalStatus_t palStatus;
 
     /* Call the platform specific code to set the image state. */
-    palStatus = otaAgent.pOtaInterface->pal.setPlatformImageState( &( otaAgent.fileContext ), state );
+    palStatus = pAgentCtx->pOtaInterface->pal.setPlatformImageState( &( pAgentCtx->fileContext ), state );
 
     /*
      * If the platform image state couldn't be set correctly, force fail the update by setting the
@@ -731,11 +1682,11 @@ static OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
     }
 
     /* Now update the image state and job status on service side. */
-    otaAgent.imageState = state;
+    pAgentCtx->imageState = state;
 
-    if( strlen( ( const char * ) otaAgent.pActiveJobName ) > 0u )
+    if( strlen( ( const char * ) pAgentCtx->pActiveJobName ) > 0u )
     {
-        err = updateJobStatusFromImageState( state, ( int32_t ) reason );
+        err = updateJobStatusFromImageState( pAgentCtx, state, ( int32_t ) reason );
     }
     else
     {
@@ -768,7 +1719,7 @@ static OtaErr_t startHandler( const OtaEventData_t * pEventData )
     /* Start self-test timer, if platform is in self-test. */
     if( platformInSelftest() == true )
     {
-        ( void ) otaAgent.pOtaInterface->os.timer.start( OtaSelfTestTimer,
+        ( void ) pOtaAgent->pOtaInterface->os.timer.start( agentTimerId( pOtaAgent, OtaSelfTestTimer ),
                                                          "OtaSelfTestTimer",
                                                          otaconfigSELF_TEST_RESPONSE_WAIT_MS,
                                                          otaTimerCallback );
@@ -777,7 +1728,7 @@ static OtaErr_t startHandler( const OtaEventData_t * pEventData )
     /* Send event to OTA task to get job document. */
     eventMsg.eventId = OtaAgentEventRequestJobDocument;
 
-    if( OTA_SignalEvent( &eventMsg ) == false )
+    if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
     {
         retVal = OtaErrSignalEventFailed;
     }
@@ -797,13 +1748,13 @@ static OtaErr_t inSelfTestHandler( const OtaEventData_t * pEventData )
     if( platformInSelftest() == true )
     {
         /* Callback for application specific self-test. */
-        otaAgent.OtaAppCallback( OtaJobEventStartTest, NULL );
+        pOtaAgent->OtaAppCallback( OtaJobEventStartTest, NULL );
 
         /* Clear self-test flag. */
-        otaAgent.fileContext.isInSelfTest = false;
+        pOtaAgent->fileContext.isInSelfTest = false;
 
         /* Stop the self test timer as it is no longer required. */
-        ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaSelfTestTimer );
+        ( void ) pOtaAgent->pOtaInterface->os.timer.stop( agentTimerId( pOtaAgent, OtaSelfTestTimer ) );
     }
     else
     {
@@ -813,8 +1764,8 @@ static OtaErr_t inSelfTestHandler( const OtaEventData_t * pEventData )
         LogWarn( ( "Rejecting new image and rebooting:"
                    "The job is in the self-test state while the platform is not." ) );
 
-        err = setImageStateWithReason( OtaImageStateRejected, ( uint32_t ) OtaErrImageStateMismatch );
-        ( void ) otaAgent.pOtaInterface->pal.reset( &( otaAgent.fileContext ) );
+        err = setImageStateWithReason( pOtaAgent, OtaImageStateRejected, ( uint32_t ) OtaErrImageStateMismatch );
+        ( void ) pOtaAgent->pOtaInterface->pal.reset( &( pOtaAgent->fileContext ) );
     }
 
     if( err != OtaErrNone )
@@ -838,17 +1789,14 @@ static OtaErr_t requestJobHandler( const OtaEventData_t * pEventData )
     /*
      * Check if any pending jobs are available from job service.
      */
-    retVal = otaControlInterface.requestJob( &otaAgent );
+    retVal = otaControlInterface.requestJob( pOtaAgent );
 
     if( retVal != OtaErrNone )
     {
-        if( otaAgent.requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM )
+        if( pOtaAgent->requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM )
         {
             /* Start the request timer. */
-            osErr = otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer,
-                                                            "OtaRequestTimer",
-                                                            otaconfigFILE_REQUEST_WAIT_MS,
-                                                            otaTimerCallback );
+            osErr = startRequestTimer();
 
             if( osErr != OtaOsSuccess )
             {
@@ -859,18 +1807,18 @@ static OtaErr_t requestJobHandler( const OtaEventData_t * pEventData )
             }
             else
             {
-                otaAgent.requestMomentum++;
+                pOtaAgent->requestMomentum++;
             }
         }
         else
         {
             /* Stop the request timer. */
-            ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+            stopRequestTimer();
 
             /* Send shutdown event to the OTA Agent task. */
             eventMsg.eventId = OtaAgentEventShutdown;
 
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
             {
                 retVal = OtaErrSignalEventFailed;
             }
@@ -885,10 +1833,10 @@ static OtaErr_t requestJobHandler( const OtaEventData_t * pEventData )
     else
     {
         /* Stop the request timer. */
-        ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+        stopRequestTimer();
 
         /* Reset the request momentum. */
-        otaAgent.requestMomentum = 0;
+        pOtaAgent->requestMomentum = 0;
     }
 
     return retVal;
@@ -905,7 +1853,7 @@ static OtaErr_t processNullFileContext( void )
         /* Send event to OTA task to start self-test. */
         eventMsg.eventId = OtaAgentEventStartSelfTest;
 
-        if( OTA_SignalEvent( &eventMsg ) == false )
+        if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
         {
             retVal = OtaErrSignalEventFailed;
         }
@@ -931,7 +1879,7 @@ static OtaErr_t processValidFileContext( void )
     if( platformInSelftest() == false )
     {
         /* Init data interface routines */
-        retVal = setDataInterface( &otaDataInterface, otaAgent.fileContext.pProtocols );
+        retVal = setDataInterface( &otaDataInterface, pOtaAgent->fileContext.pProtocols );
 
         if( retVal == OtaErrNone )
         {
@@ -941,7 +1889,7 @@ static OtaErr_t processValidFileContext( void )
             eventMsg.eventId = OtaAgentEventCreateFile;
 
             /*Send the event to OTA Agent task. */
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
             {
                 retVal = OtaErrSignalEventFailed;
             }
@@ -954,7 +1902,7 @@ static OtaErr_t processValidFileContext( void )
              */
             LogError( ( "Failed to set OTA data interface: OtaErr_t=%s, aborting current update.", OTA_Err_strerror( retVal ) ) );
 
-            retVal = setImageStateWithReason( OtaImageStateAborted, ( uint32_t ) retVal );
+            retVal = setImageStateWithReason( pOtaAgent, OtaImageStateAborted, ( uint32_t ) retVal );
 
             if( retVal != OtaErrNone )
             {
@@ -971,7 +1919,7 @@ static OtaErr_t processValidFileContext( void )
         LogWarn( ( "Rejecting new image and rebooting:"
                    "The platform is in the self-test state while the job is not." ) );
 
-        ( void ) otaAgent.pOtaInterface->pal.reset( &( otaAgent.fileContext ) );
+        ( void ) pOtaAgent->pOtaInterface->pal.reset( &( pOtaAgent->fileContext ) );
     }
 
     return retVal;
@@ -1004,7 +1952,7 @@ static OtaErr_t processJobHandler( const OtaEventData_t * pEventData )
     }
 
     /* Application callback for event processed. */
-    otaAgent.OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventData );
+    pOtaAgent->OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventData );
 
     return retVal;
 }
@@ -1017,17 +1965,17 @@ static OtaErr_t initFileHandler( const OtaEventData_t * pEventData )
 
     ( void ) pEventData;
 
-    err = otaDataInterface.initFileTransfer( &otaAgent );
+    /* Close the request window, the data interface opens it again if it supports one. */
+    ( void ) memset( &( pOtaAgent->requestWindow ), 0, sizeof( pOtaAgent->requestWindow ) );
+
+    err = otaDataInterface.initFileTransfer( pOtaAgent );
 
     if( err != OtaErrNone )
     {
-        if( otaAgent.requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM )
+        if( pOtaAgent->requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM )
         {
             /* Start the request timer. */
-            osErr = otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer,
-                                                            "OtaRequestTimer",
-                                                            otaconfigFILE_REQUEST_WAIT_MS,
-                                                            otaTimerCallback );
+            osErr = startRequestTimer();
 
             if( osErr != OtaOsSuccess )
             {
@@ -1038,18 +1986,18 @@ static OtaErr_t initFileHandler( const OtaEventData_t * pEventData )
             }
             else
             {
-                otaAgent.requestMomentum++;
+                pOtaAgent->requestMomentum++;
             }
         }
         else
         {
             /* Stop the request timer. */
-            ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+            stopRequestTimer();
 
             /* Send shutdown event. */
             eventMsg.eventId = OtaAgentEventShutdown;
 
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
             {
                 err = OtaErrSignalEventFailed;
             }
@@ -1064,14 +2012,15 @@ static OtaErr_t initFileHandler( const OtaEventData_t * pEventData )
     else
     {
         /* Reset the request momentum. */
-        otaAgent.requestMomentum = 0;
+        pOtaAgent->requestMomentum = 0;
 
         /* Reset the OTA statistics. */
-        ( void ) memset( &otaAgent.statistics, 0, sizeof( otaAgent.statistics ) );
+        ( void ) memset( &pOtaAgent->statistics, 0, sizeof( pOtaAgent->statistics ) );
+        pOtaAgent->requestWindow.packetsDropped = 0;
 
         eventMsg.eventId = OtaAgentEventRequestFileBlock;
 
-        if( OTA_SignalEvent( &eventMsg ) == false )
+        if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
         {
             err = OtaErrSignalEventFailed;
         }
@@ -1085,33 +2034,76 @@ static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData )
     OtaErr_t err = OtaErrNone;
     OtaOsStatus_t osErr = OtaOsSuccess;
     OtaEventMsg_t eventMsg = { 0 };
+    uint32_t blocksInFlight = 0;
 
     ( void ) pEventData;
 
-    if( otaAgent.fileContext.blocksRemaining > 0U )
+    if( pOtaAgent->fileContext.blocksRemaining > 0U )
     {
         /* Start the request timer. */
-        osErr = otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer,
-                                                        "OtaRequestTimer",
-                                                        otaconfigFILE_REQUEST_WAIT_MS,
-                                                        otaTimerCallback );
+        osErr = startRequestTimer();
 
-        if( ( osErr == OtaOsSuccess ) && ( otaAgent.requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM ) )
+        if( ( osErr == OtaOsSuccess ) && ( pOtaAgent->requestMomentum < otaconfigMAX_NUM_REQUEST_MOMENTUM ) )
         {
+            if( pOtaAgent->requestWindow.windowSize > 0U )
+            {
+                limitRequestWindowToBuffers();
+            }
+
+            #if ( otaconfigLATENCY_STATS == 1U )
+                /* The round trip is timed from the first request not answered. */
+                if( pOtaAgent->requestMomentum == 0U )
+                {
+                    pOtaAgent->requestTimestamp = otaconfigLATENCY_TIMESTAMP();
+                }
+            #endif
+
             /* Request data blocks. */
-            err = otaDataInterface.requestFileBlock( &otaAgent );
+            blocksInFlight = pOtaAgent->requestWindow.blocksInFlight;
+            err = otaDataInterface.requestFileBlock( pOtaAgent );
 
-            /* Each request increases the momentum until a response is received. Too much momentum is
-             * interpreted as a failure to communicate and will cause us to abort the OTA. */
-            otaAgent.requestMomentum++;
+            if( ( err == OtaErrNone ) &&
+                ( pOtaAgent->requestWindow.windowSize > 0U ) &&
+                ( pOtaAgent->requestWindow.blocksInFlight == blocksInFlight ) )
+            {
+                /* The window is full so no request was sent, the service was not asked for anything. */
+                LogDebug( ( "No block requested, request momentum kept: requestMomentum=%u",
+                            ( unsigned int ) pOtaAgent->requestMomentum ) );
+            }
+            else
+            {
+                #if ( otaconfigLATENCY_STATS == 1U )
+                    if( pOtaAgent->requestMomentum > 0U )
+                    {
+                        pOtaAgent->latency.repeatedRequests++;
+                    }
+                #endif
+
+                /* Each request increases the momentum until a response is received. Too much momentum is
+                 * interpreted as a failure to communicate and will cause us to abort the OTA. */
+                pOtaAgent->requestMomentum++;
+
+                #if ( otaconfigLATENCY_STATS == 1U )
+                    if( pOtaAgent->requestMomentum > pOtaAgent->latency.requestMomentumPeak )
+                    {
+                        pOtaAgent->latency.requestMomentumPeak = pOtaAgent->requestMomentum;
+                    }
+                #endif
+            }
         }
         else
         {
             /* Stop the request timer. */
-            ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+            stopRequestTimer();
+
+            /* The next download starts with smaller blocks if the service did not answer. */
+            if( pOtaAgent->requestMomentum >= otaconfigMAX_NUM_REQUEST_MOMENTUM )
+            {
+                adaptBlockSize( true );
+            }
 
             /* Failed to send data request abort and close file. */
-            err = setImageStateWithReason( OtaImageStateAborted, ( uint32_t ) err );
+            err = setImageStateWithReason( pOtaAgent, OtaImageStateAborted, ( uint32_t ) err );
 
             if( err != OtaErrNone )
             {
@@ -1121,7 +2113,7 @@ static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData )
             /* Send shutdown event. */
             eventMsg.eventId = OtaAgentEventShutdown;
 
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
             {
                 err = OtaErrSignalEventFailed;
             }
@@ -1132,7 +2124,7 @@ static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData )
                 err = OtaErrMomentumAbort;
 
                 /* Reset the request momentum. */
-                otaAgent.requestMomentum = 0;
+                pOtaAgent->requestMomentum = 0;
             }
         }
     }
@@ -1140,17 +2132,109 @@ static OtaErr_t requestDataHandler( const OtaEventData_t * pEventData )
     return err;
 }
 
+static OtaErr_t requestTimeoutHandler( const OtaEventData_t * pEventData )
+{
+    OtaRequestWindow_t * pWindow = &( pOtaAgent->requestWindow );
+
+    /* Timeouts are taken as lost blocks to adapt the block size. */
+    pOtaAgent->requestTimeouts++;
+
+    if( pWindow->windowSize > 0U )
+    {
+        /* Nothing arrived for a whole request period, so the blocks still in
+         * flight are considered lost. Start again from the first missing block
+         * with a single block window and grow back up to half the old size. */
+        pWindow->threshold = ( pWindow->windowSize > 1U ) ? ( pWindow->windowSize / 2U ) : 1U;
+        pWindow->windowSize = 1U;
+        pWindow->blocksInFlight = 0;
+        pWindow->nextBlock = 0;
+        pWindow->blocksAcked = 0;
+
+        LogDebug( ( "Request timer expired, shrinking request window: "
+                    "threshold=%u",
+                    pWindow->threshold ) );
+    }
+
+    return requestDataHandler( pEventData );
+}
+
+static void limitRequestWindowToBuffers( void )
+{
+    #if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+        OtaRequestWindow_t * pWindow = &( pOtaAgent->requestWindow );
+        uint32_t freeBuffers = OTA_EventBufferFreeCount();
+
+        /* Keep one block in the window so the transfer still makes progress. */
+        if( freeBuffers == 0U )
+        {
+            freeBuffers = 1U;
+        }
+
+        if( pWindow->windowSize > freeBuffers )
+        {
+            pWindow->windowSize = freeBuffers;
+            pWindow->blocksAcked = 0;
+
+            LogDebug( ( "Event buffers running low, shrinking request window: "
+                        "window=%u",
+                        pWindow->windowSize ) );
+        }
+    #endif /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+}
+
+static void updateRequestWindow( void )
+{
+    OtaRequestWindow_t * pWindow = &( pOtaAgent->requestWindow );
+    uint32_t newDrops = pOtaAgent->statistics.otaPacketsDropped - pWindow->packetsDropped;
+
+    if( pWindow->blocksInFlight > 0U )
+    {
+        pWindow->blocksInFlight--;
+    }
+
+    if( newDrops > 0U )
+    {
+        /* Dropped blocks will never arrive, don't keep their slots busy. */
+        pWindow->packetsDropped = pOtaAgent->statistics.otaPacketsDropped;
+        pWindow->blocksInFlight = ( pWindow->blocksInFlight > newDrops ) ? ( pWindow->blocksInFlight - newDrops ) : 0U;
+
+        /* Back off, the agent can't keep up with the current window. */
+        pWindow->threshold = ( pWindow->windowSize > 1U ) ? ( pWindow->windowSize / 2U ) : 1U;
+        pWindow->windowSize = pWindow->threshold;
+        pWindow->blocksAcked = 0;
+
+        LogDebug( ( "Blocks dropped, shrinking request window: "
+                    "dropped=%u, window=%u",
+                    newDrops,
+                    pWindow->windowSize ) );
+    }
+    else if( ( pWindow->windowSize + 1U ) <= otaconfigMAX_REQUEST_WINDOW_SIZE )
+    {
+        pWindow->blocksAcked++;
+
+        if( ( pWindow->windowSize < pWindow->threshold ) || ( pWindow->blocksAcked >= pWindow->windowSize ) )
+        {
+            pWindow->windowSize++;
+            pWindow->blocksAcked = 0;
+        }
+    }
+    else
+    {
+        /* The window is already at its maximum size. */
+    }
+}
+
 static void dataHandlerCleanup( void )
 {
     OtaEventMsg_t eventMsg = { 0 };
 
     /* Stop the request timer. */
-    ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+    stopRequestTimer();
 
     /* Send event to close file. */
     eventMsg.eventId = OtaAgentEventCloseFile;
 
-    if( OTA_SignalEvent( &eventMsg ) == false )
+    if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
     {
         LogWarn( ( "Failed to trigger closing file: "
                    "Unable to signal event: "
@@ -1159,7 +2243,7 @@ static void dataHandlerCleanup( void )
     }
 
     /* Clear any remaining string memory holding the job name since this job is done. */
-    ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+    ( void ) memset( pOtaAgent->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
 }
 
 static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
@@ -1172,12 +2256,12 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
     OtaJobEvent_t otaJobEvent = OtaLastJobEvent;
 
     /* Get the file context. */
-    OtaFileContext_t * pFileContext = &( otaAgent.fileContext );
+    OtaFileContext_t * pFileContext = &( pOtaAgent->fileContext );
 
     /* Set the job id and length from OTA context. */
-    jobDoc.pJobId = otaAgent.pActiveJobName;
-    jobDoc.jobIdLength = strlen( ( const char * ) otaAgent.pActiveJobName ) + 1U;
-    jobDoc.fileTypeId = otaAgent.fileContext.fileType;
+    jobDoc.pJobId = pOtaAgent->pActiveJobName;
+    jobDoc.jobIdLength = strlen( ( const char * ) pOtaAgent->pActiveJobName ) + 1U;
+    jobDoc.fileTypeId = pOtaAgent->fileContext.fileType;
 
     /* Ingest data blocks received. */
     if( pEventData != NULL )
@@ -1185,6 +2269,7 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
         result = ingestDataBlock( pFileContext,
                                   pEventData->data,
                                   pEventData->dataLength,
+                                  pEventData->fileOffset,
                                   &closeResult );
     }
     else
@@ -1192,13 +2277,47 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
         result = IngestResultNullInput;
     }
 
+    /* A job with a firmware file, or a delta update of it, is activated once all its files are received. */
+    if( ( result == IngestResultFileComplete ) &&
+        ( ( pOtaAgent->fileContext.fileType == configOTA_FIRMWARE_UPDATE_FILE_TYPE_ID ) ||
+          ( pOtaAgent->fileContext.fileType == configOTA_DELTA_UPDATE_FILE_TYPE_ID ) ) )
+    {
+        pOtaAgent->jobHasFirmware = true;
+    }
+
+    /* The next file is received in blocks sized after how well this one was. */
     if( result == IngestResultFileComplete )
+    {
+        adaptBlockSize( false );
+    }
+
+    if( ( result == IngestResultFileComplete ) && ( ( pOtaAgent->fileIndex + 1U ) < pOtaAgent->numJobFiles ) )
+    {
+        /* The job is complete with its last file, receive the next one. */
+        err = startNextJobFile();
+
+        if( err != OtaErrNone )
+        {
+            LogError( ( "Failed to receive the next file of the job, aborting the job: OtaErr_t=%s", OTA_Err_strerror( err ) ) );
+
+            jobDoc.status = JobStatusFailedWithVal;
+            jobDoc.reason = ( int32_t ) err;
+
+            err = setImageStateWithReason( pOtaAgent, OtaImageStateAborted, ( uint32_t ) err );
+
+            dataHandlerCleanup();
+
+            pOtaAgent->OtaAppCallback( OtaJobEventFail, &jobDoc );
+        }
+    }
+    else if( result == IngestResultFileComplete )
     {
         /* Check if this is firmware update. */
-        if( otaAgent.fileContext.fileType == configOTA_FIRMWARE_UPDATE_FILE_TYPE_ID )
+        if( pOtaAgent->jobHasFirmware == true )
         {
             jobDoc.status = JobStatusInProgress;
             jobDoc.reason = JobReasonSigCheckPassed;
+            jobDoc.fileTypeId = configOTA_FIRMWARE_UPDATE_FILE_TYPE_ID;
 
             otaJobEvent = OtaJobEventActivate;
         }
@@ -1206,66 +2325,117 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
         {
             jobDoc.status = JobStatusSucceeded;
             jobDoc.reason = JobReasonAccepted;
-            jobDoc.subReason = ( int32_t ) otaAgent.fileContext.fileType;
+            jobDoc.subReason = ( int32_t ) pOtaAgent->fileContext.fileType;
 
             otaJobEvent = OtaJobEventUpdateComplete;
         }
 
         /* File receive is complete and authenticated. Update the job status. */
-        err = otaControlInterface.updateJobStatus( &otaAgent, jobDoc.status, jobDoc.reason, jobDoc.subReason );
+        err = otaControlInterface.updateJobStatus( pOtaAgent, jobDoc.status, jobDoc.reason, jobDoc.subReason );
 
         dataHandlerCleanup();
 
         /* Last file block processed, increment the statistics. */
-        otaAgent.statistics.otaPacketsProcessed++;
+        pOtaAgent->statistics.otaPacketsProcessed++;
 
         /* Let main application know that update is complete */
-        otaAgent.OtaAppCallback( otaJobEvent, &jobDoc );
+        pOtaAgent->OtaAppCallback( otaJobEvent, &jobDoc );
     }
     else if( result < IngestResultFileComplete )
     {
         LogError( ( "Failed to ingest data block, rejecting image: ingestDataBlock returned error: OtaErr_t=%d", result ) );
 
         /* Call the platform specific code to reject the image. */
-        ( void ) otaAgent.pOtaInterface->pal.setPlatformImageState( &( otaAgent.fileContext ), OtaImageStateRejected );
+        ( void ) pOtaAgent->pOtaInterface->pal.setPlatformImageState( &( pOtaAgent->fileContext ), OtaImageStateRejected );
 
         jobDoc.status = JobStatusFailedWithVal;
         jobDoc.reason = ( int32_t ) closeResult;
         jobDoc.subReason = result;
 
         /* Update the job status with the with failure code. */
-        err = otaControlInterface.updateJobStatus( &otaAgent, JobStatusFailedWithVal, ( int32_t ) closeResult, ( int32_t ) result );
+        err = otaControlInterface.updateJobStatus( pOtaAgent, JobStatusFailedWithVal, ( int32_t ) closeResult, ( int32_t ) result );
 
         dataHandlerCleanup();
 
         /* Let main application know activate event. */
-        otaAgent.OtaAppCallback( OtaJobEventFail, &jobDoc );
+        pOtaAgent->OtaAppCallback( OtaJobEventFail, &jobDoc );
     }
     else
     {
         if( result == IngestResultAccepted_Continue )
         {
             /* File block processed, increment the statistics. */
-            otaAgent.statistics.otaPacketsProcessed++;
+            pOtaAgent->statistics.otaPacketsProcessed++;
+
+            #if ( otaconfigLATENCY_STATS == 1U )
+                if( pOtaAgent->requestMomentum > 0U )
+                {
+                    recordLatency( OtaLatencyBlockRtt, pOtaAgent->requestTimestamp );
+                }
+            #endif
 
             /* Reset the momentum counter since we received a good block. */
-            otaAgent.requestMomentum = 0;
+            pOtaAgent->requestMomentum = 0;
+
+            /* Save the progress every few blocks so that the download can be resumed. */
+            saveFileCheckpoint( otaconfigCHECKPOINT_INTERVAL_BLOCKS );
+
             /* We're actively receiving a file so update the job status as needed. */
-            err = otaControlInterface.updateJobStatus( &otaAgent, JobStatusInProgress, JobReasonReceiving, 0 );
+            err = reportProgress();
         }
 
-        if( otaAgent.numOfBlocksToReceive > 1U )
+        if( result == IngestResultOtherFile_Continue )
+        {
+            /* The block does not answer a request for this file. */
+        }
+        else if( pOtaAgent->requestWindow.windowSize > 0U )
+        {
+            if( result == IngestResultAccepted_Continue )
+            {
+                updateRequestWindow();
+            }
+            else if( result == IngestResultOutOfOrder_Continue )
+            {
+                /* The block arrived and is not lost, so its slot is free without
+                 * shrinking the window. The requests go on from the first block
+                 * missing, which the patch is waiting for. */
+                if( pOtaAgent->requestWindow.blocksInFlight > 0U )
+                {
+                    pOtaAgent->requestWindow.blocksInFlight--;
+                }
+
+                pOtaAgent->requestWindow.nextBlock = 0U;
+            }
+            else
+            {
+                /* A duplicate block was answered by another one already. */
+            }
+
+            /* Keep the window full by requesting more blocks as soon as there is room for them.
+             * The request timer was already restarted when the block was decoded. */
+            if( ( result != IngestResultDuplicate_Continue ) &&
+                ( pOtaAgent->requestWindow.blocksInFlight < pOtaAgent->requestWindow.windowSize ) )
+            {
+                eventMsg.eventId = OtaAgentEventRequestFileBlock;
+
+                if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
+                {
+                    LogWarn( ( "Failed to trigger requesting the next block: Unable to signal event=%d", eventMsg.eventId ) );
+                }
+            }
+        }
+        else if( pOtaAgent->numOfBlocksToReceive > 1U )
         {
-            otaAgent.numOfBlocksToReceive--;
+            pOtaAgent->numOfBlocksToReceive--;
         }
         else
         {
             /* Start the request timer. */
-            ( void ) otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer, "OtaRequestTimer", otaconfigFILE_REQUEST_WAIT_MS, otaTimerCallback );
+            ( void ) startRequestTimer();
 
             eventMsg.eventId = OtaAgentEventRequestFileBlock;
 
-            if( OTA_SignalEvent( &eventMsg ) == false )
+            if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
             {
                 LogWarn( ( "Failed to trigger requesting the next block: Unable to signal event=%d", eventMsg.eventId ) );
             }
@@ -1273,7 +2443,7 @@ static OtaErr_t processDataHandler( const OtaEventData_t * pEventData )
     }
 
     /* Application callback for event processed. */
-    otaAgent.OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventData );
+    pOtaAgent->OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventData );
 
     if( err != OtaErrNone )
     {
@@ -1290,9 +2460,9 @@ static OtaErr_t closeFileHandler( const OtaEventData_t * pEventData )
 
     LogInfo( ( "Closing file: "
                "file index=%u",
-               otaAgent.fileIndex ) );
+               pOtaAgent->fileIndex ) );
 
-    ( void ) otaClose( &( otaAgent.fileContext ) );
+    ( void ) otaClose( &( pOtaAgent->fileContext ) );
 
     return OtaErrNone;
 }
@@ -1304,13 +2474,13 @@ static OtaErr_t userAbortHandler( const OtaEventData_t * pEventData )
     ( void ) pEventData;
 
     /* If we have active Job abort it and close the file. */
-    if( strlen( ( const char * ) otaAgent.pActiveJobName ) > 0u )
+    if( strlen( ( const char * ) pOtaAgent->pActiveJobName ) > 0u )
     {
-        err = setImageStateWithReason( OtaImageStateAborted, ( uint32_t ) OtaErrUserAbort );
+        err = setImageStateWithReason( pOtaAgent, OtaImageStateAborted, ( uint32_t ) OtaErrUserAbort );
 
         if( err == OtaErrNone )
         {
-            ( void ) otaClose( &( otaAgent.fileContext ) );
+            ( void ) otaClose( &( pOtaAgent->fileContext ) );
         }
     }
     else
@@ -1323,6 +2493,8 @@ static OtaErr_t userAbortHandler( const OtaEventData_t * pEventData )
 
 static OtaErr_t shutdownHandler( const OtaEventData_t * pEventData )
 {
+    uint32_t agentIndex = pOtaAgent->agentIndex;
+
     ( void ) pEventData;
 
     LogInfo( ( "OTA Agent is shutting down." ) );
@@ -1331,7 +2503,22 @@ static OtaErr_t shutdownHandler( const OtaEventData_t * pEventData )
     agentShutdownCleanup();
 
     /* Clear the entire agent context. This includes the OTA agent state. */
-    ( void ) memset( &otaAgent, 0, sizeof( otaAgent ) );
+    ( void ) memset( pOtaAgent, 0, sizeof( *pOtaAgent ) );
+
+    /* Keep the index of the instance until the agent switches away from it. */
+    pOtaAgent->agentIndex = agentIndex;
+
+    /* Free the index of an instance started with OTA_InstanceInit. The
+     * events still queued for it are dropped, even if the index or the
+     * context is used again by the time they are received. */
+    if( pOtaAgent != &otaAgent )
+    {
+        pOtaAgents[ agentIndex ] = NULL;
+
+        #if ( otaconfigMAX_NUM_AGENTS > 1U )
+            agentGenerations[ agentIndex ]++;
+        #endif
+    }
 
     return OtaErrNone;
 }
@@ -1340,6 +2527,16 @@ static OtaErr_t suspendHandler( const OtaEventData_t * pEventData )
 {
     ( void ) pEventData;
 
+    /* Save the progress of the file being received, if any, in case the device is reset while suspended. */
+    saveFileCheckpoint( 1U );
+
+    /* The progress is reported again once blocks are received after resuming. */
+    stopProgressReports();
+
+    /* OTA_Suspend stopped the request timer, it is started again after resuming. */
+    pOtaAgent->requestTimerArmed = false;
+    ( void ) exchangeFlag( &( pOtaAgent->requestTimerTicking ), false );
+
     /* Log the state change to suspended state.*/
     LogInfo( ( "OTA Agent is suspended." ) );
 
@@ -1357,7 +2554,7 @@ static OtaErr_t resumeHandler( const OtaEventData_t * pEventData )
      */
     eventMsg.eventId = OtaAgentEventRequestJobDocument;
 
-    return ( OTA_SignalEvent( &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
+    return ( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
 }
 
 static OtaErr_t jobNotificationHandler( const OtaEventData_t * pEventData )
@@ -1367,37 +2564,63 @@ static OtaErr_t jobNotificationHandler( const OtaEventData_t * pEventData )
     ( void ) pEventData;
 
     /* Stop the request timer. */
-    ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+    stopRequestTimer();
 
     /* Abort the current job. */
-    ( void ) otaAgent.pOtaInterface->pal.setPlatformImageState( &( otaAgent.fileContext ), OtaImageStateAborted );
-    ( void ) otaClose( &( otaAgent.fileContext ) );
+    ( void ) pOtaAgent->pOtaInterface->pal.setPlatformImageState( &( pOtaAgent->fileContext ), OtaImageStateAborted );
+    ( void ) otaClose( &( pOtaAgent->fileContext ) );
 
     /* Clear the active job name as its no longer required. */
-    ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+    ( void ) memset( pOtaAgent->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
 
     /*
      * Send signal to request next OTA job document from service.
      */
     eventMsg.eventId = OtaAgentEventRequestJobDocument;
 
-    return ( OTA_SignalEvent( &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
+    return ( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == true ) ? OtaErrNone : OtaErrSignalEventFailed;
 }
 
-static void freeFileContextMem( OtaFileContext_t * const pFileContext )
+static OtaErr_t progressTimerHandler( const OtaEventData_t * pEventData )
 {
-    assert( pFileContext != NULL );
+    OtaErr_t err = OtaErrNone;
 
-    /* Free or clear the filepath buffer.*/
-    if( pFileContext->pFilePath != NULL )
+    ( void ) pEventData;
+
+    if( pOtaAgent->progressPending == true )
     {
-        if( pFileContext->filePathMaxSize > 0u )
+        err = otaControlInterface.updateJobStatus( pOtaAgent, JobStatusInProgress, JobReasonReceiving, 0 );
+
+        if( err == OtaErrNone )
         {
-            ( void ) memset( pFileContext->pFilePath, 0, pFileContext->filePathMaxSize );
+            pOtaAgent->progressPending = false;
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pFilePath );
+            /* Nothing waits for the progress, it is published with the next blocks received. */
+            LogWarn( ( "Failed to publish the progress of the file: "
+                       "OtaErr_t=%s",
+                       OTA_Err_strerror( err ) ) );
+        }
+    }
+
+    return OtaErrNone;
+}
+
+static void freeFileContextMem( OtaFileContext_t * const pFileContext )
+{
+    assert( pFileContext != NULL );
+
+    /* Free or clear the filepath buffer.*/
+    if( pFileContext->pFilePath != NULL )
+    {
+        if( pFileContext->filePathMaxSize > 0u )
+        {
+            ( void ) memset( pFileContext->pFilePath, 0, pFileContext->filePathMaxSize );
+        }
+        else
+        {
+            freeJobBuffer( pFileContext->pFilePath );
             pFileContext->pFilePath = NULL;
         }
     }
@@ -1411,7 +2634,7 @@ static void freeFileContextMem( OtaFileContext_t * const pFileContext )
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pCertFilepath );
+            freeJobBuffer( pFileContext->pCertFilepath );
             pFileContext->pCertFilepath = NULL;
         }
     }
@@ -1425,53 +2648,914 @@ static void freeFileContextMem( OtaFileContext_t * const pFileContext )
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pStreamName );
-            pFileContext->pStreamName = NULL;
+            freeJobBuffer( pFileContext->pStreamName );
+            pFileContext->pStreamName = NULL;
+        }
+    }
+
+    /* Free or clear the bitmap buffer.*/
+    if( pFileContext->pRxBlockBitmap != NULL )
+    {
+        if( pFileContext->blockBitmapMaxSize > 0u )
+        {
+            ( void ) memset( pFileContext->pRxBlockBitmap, 0, pFileContext->blockBitmapMaxSize );
+        }
+        else
+        {
+            freeJobBuffer( pFileContext->pRxBlockBitmap );
+            pFileContext->pRxBlockBitmap = NULL;
+        }
+    }
+
+    /* Free or clear url buffer.*/
+    if( pFileContext->pUpdateUrlPath != NULL )
+    {
+        if( pFileContext->updateUrlMaxSize > 0u )
+        {
+            ( void ) memset( pFileContext->pUpdateUrlPath, 0, pFileContext->updateUrlMaxSize );
+        }
+        else
+        {
+            freeJobBuffer( pFileContext->pUpdateUrlPath );
+            pFileContext->pUpdateUrlPath = NULL;
+        }
+    }
+
+    /* Initialize auth scheme buffer from application buffer.*/
+    if( pFileContext->pAuthScheme != NULL )
+    {
+        if( pFileContext->authSchemeMaxSize > 0u )
+        {
+            ( void ) memset( pFileContext->pAuthScheme, 0, pFileContext->authSchemeMaxSize );
+        }
+        else
+        {
+            freeJobBuffer( pFileContext->pAuthScheme );
+            pFileContext->pAuthScheme = NULL;
+        }
+    }
+
+    #if ( otaconfigJOB_ARENA_SIZE > 0U )
+        /* The decode buffer is taken from the arena if the application did not provide one. */
+        if( pFileContext->decodeMemMaxSize == 0u )
+        {
+            pFileContext->pDecodeMem = NULL;
+        }
+
+        /* Release every buffer of the job at once. */
+        otaJobArena_Release( &( pOtaAgent->jobArena ), JOB_ARENA_MEM );
+    #endif
+}
+
+static void * allocJobBuffer( size_t size )
+{
+    void * pBuffer = NULL;
+
+    #if ( otaconfigJOB_ARENA_SIZE > 0U )
+        pBuffer = otaJobArena_Alloc( &( pOtaAgent->jobArena ), JOB_ARENA_MEM, size );
+
+        if( pBuffer == NULL )
+        {
+            LogError( ( "Job arena is too small: "
+                        "requested=%lu, used=%lu, size=%lu",
+                        ( unsigned long ) size,
+                        ( unsigned long ) pOtaAgent->jobArena.used,
+                        ( unsigned long ) pOtaAgent->jobArena.size ) );
+        }
+    #else
+        pBuffer = pOtaAgent->pOtaInterface->os.mem.malloc( size );
+    #endif
+
+    return pBuffer;
+}
+
+static void freeJobBuffer( void * pBuffer )
+{
+    #if ( otaconfigJOB_ARENA_SIZE > 0U )
+        /* Released with the arena when the file is closed. */
+        ( void ) pBuffer;
+    #else
+        pOtaAgent->pOtaInterface->os.mem.free( pBuffer );
+    #endif
+}
+
+static uint32_t blockBitmapCapacity( const OtaFileContext_t * pFileContext,
+                                     uint32_t numBlocks )
+{
+    uint32_t capacity = ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+    uint32_t minBlocks = 0U;
+    uint32_t minBitmapLen = 0U;
+
+    if( pFileContext->blockBitmapMaxSize > 0U )
+    {
+        capacity = pFileContext->blockBitmapMaxSize;
+    }
+    else if( pOtaAgent->pOtaInterface->pal.resumeFile != NULL )
+    {
+        /* Written so that it does not overflow for the largest file sizes. */
+        minBlocks = ( pFileContext->fileSize >> otaconfigMIN_LOG2_FILE_BLOCK_SIZE ) + 1U;
+        minBitmapLen = ( minBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+
+        if( minBitmapLen > OTA_MAX_BLOCK_BITMAP_SIZE )
+        {
+            minBitmapLen = OTA_MAX_BLOCK_BITMAP_SIZE;
+        }
+
+        if( minBitmapLen > capacity )
+        {
+            capacity = minBitmapLen;
+        }
+    }
+    else
+    {
+        /* The bitmap only tracks the blocks of the file. */
+    }
+
+    return capacity;
+}
+
+static bool initBlockBitmap( OtaFileContext_t * pFileContext,
+                             uint32_t numBlocks )
+{
+    uint32_t bitmapLen = blockBitmapCapacity( pFileContext, numBlocks );
+
+    if( pFileContext->blockBitmapMaxSize == 0u )
+    {
+        /* LCOV_EXCL_START */
+        if( pFileContext->pRxBlockBitmap != NULL )
+        {
+            /* Free any previously allocated bitmap. */
+            freeJobBuffer( pFileContext->pRxBlockBitmap );
+        }
+
+        /* LCOV_EXCL_STOP */
+
+        pFileContext->pRxBlockBitmap = ( uint8_t * ) allocJobBuffer( bitmapLen );
+    }
+    else
+    {
+        assert( pFileContext->pRxBlockBitmap != NULL );
+        ( void ) memset( pFileContext->pRxBlockBitmap, 0, pFileContext->blockBitmapMaxSize );
+    }
+
+    if( pFileContext->pRxBlockBitmap != NULL )
+    {
+        eraseBlockBitmap( pFileContext, numBlocks );
+    }
+
+    return( pFileContext->pRxBlockBitmap != NULL );
+}
+
+static void eraseBlockBitmap( OtaFileContext_t * pFileContext,
+                              uint32_t numBlocks )
+{
+    uint32_t index;
+    uint32_t bitmapLen = ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+
+    /* Mark as used any pages in the bitmap that are out of range, based on the file size.
+     * This keeps us from requesting those pages during retry processing or if using a windowed
+     * block request. It also avoids erroneously accepting an out of range data block should it
+     * get past any safety checks.
+     * Files are not always a multiple of 8 pages (8 bits/pages per byte) so some bits of the
+     * last byte may be out of range and those are the bits we want to clear. */
+
+    uint8_t bit = 1U << ( BITS_PER_BYTE - 1U );
+    uint32_t numOutOfRange = ( bitmapLen * BITS_PER_BYTE ) - numBlocks;
+
+    /* Set all bits in the bitmap to the erased state (we use 1 for erased just like flash memory). */
+    ( void ) memset( pFileContext->pRxBlockBitmap, ( int32_t ) OTA_ERASED_BLOCKS_VAL, bitmapLen );
+
+    for( index = 0U; index < numOutOfRange; index++ )
+    {
+        pFileContext->pRxBlockBitmap[ bitmapLen - 1U ] &= ( uint8_t ) ~bit;
+        bit >>= 1U;
+    }
+
+    pFileContext->blocksRemaining = numBlocks; /* Initialize our blocks remaining counter. */
+}
+
+static OtaPalStatus_t openFileForRx( OtaFileContext_t * pFileContext,
+                                     uint32_t numBlocks )
+{
+    OtaPalStatus_t palStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+
+    /* The digest of the file starts over, resumed or not. */
+    pFileContext->digestLength = 0U;
+
+    #if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+        pOtaAgent->writeCombine.length = 0U;
+    #endif
+
+    if( ( pFileContext->fileType == configOTA_DELTA_UPDATE_FILE_TYPE_ID ) &&
+        ( pOtaAgent->pOtaInterface->pal.patchBlock == NULL ) )
+    {
+        LogError( ( "Failed to create the file: The platform does not apply delta updates: "
+                    "File type=%u",
+                    pFileContext->fileType ) );
+        palStatus = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, 0 );
+    }
+    else if( resumeFileFromCheckpoint( pFileContext, numBlocks ) == false )
+    {
+        palStatus = pOtaAgent->pOtaInterface->pal.createFile( pFileContext );
+    }
+    else
+    {
+        /* The file is resumed. */
+    }
+
+    #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+        /* The sinks are written with the same blocks, create their files too. */
+        if( OTA_PAL_MAIN_ERR( palStatus ) == OtaPalSuccess )
+        {
+            palStatus = createFileSinks( pFileContext, numBlocks );
+        }
+    #endif
+
+    return palStatus;
+}
+
+static bool resumeFileFromCheckpoint( OtaFileContext_t * pFileContext,
+                                      uint32_t numBlocks )
+{
+    OtaPalStatus_t palStatus = OTA_PAL_COMBINE_ERR( OtaPalUninitialized, 0 );
+    uint32_t bitmapCapacity = blockBitmapCapacity( pFileContext, numBlocks );
+    uint32_t log2BlockSize = pFileContext->log2BlockSize;
+    uint32_t resumedBlocks = 0U;
+    uint32_t resumedBitmapLen = 0U;
+    bool canResume = ( pOtaAgent->pOtaInterface->pal.resumeFile != NULL );
+    bool resumed = false;
+
+    /* The state of the patch engine of a delta update is not saved in the checkpoint. */
+    if( pFileContext->fileType == configOTA_DELTA_UPDATE_FILE_TYPE_ID )
+    {
+        canResume = false;
+    }
+
+    /* The files of the sinks are created empty, so they need every block. */
+    #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+        if( pOtaAgent->numFileSinks > 0U )
+        {
+            canResume = false;
+        }
+    #endif
+
+    if( canResume == true )
+    {
+        palStatus = pOtaAgent->pOtaInterface->pal.resumeFile( pFileContext, bitmapCapacity );
+    }
+
+    if( OTA_PAL_MAIN_ERR( palStatus ) == OtaPalSuccess )
+    {
+        /* The bitmap of the checkpoint is for the block size it was saved with. */
+        resumedBlocks = OTA_FILE_NUM_BLOCKS( pFileContext );
+        resumedBitmapLen = ( resumedBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+
+        if( ( pFileContext->log2BlockSize < otaconfigMIN_LOG2_FILE_BLOCK_SIZE ) ||
+            ( pFileContext->log2BlockSize > otaconfigLOG2_FILE_BLOCK_SIZE ) ||
+            ( resumedBitmapLen > bitmapCapacity ) )
+        {
+            LogWarn( ( "Failed to resume the file: The block size of its checkpoint is not supported: "
+                       "Log2 block size=%u",
+                       pFileContext->log2BlockSize ) );
+        }
+        else
+        {
+            /* Clear the bits of the last byte that are out of range, as when the
+             * bitmap is erased, whatever the platform restored in them. */
+            if( ( resumedBlocks & ( BITS_PER_BYTE - 1U ) ) != 0U )
+            {
+                pFileContext->pRxBlockBitmap[ resumedBitmapLen - 1U ] &=
+                    ( uint8_t ) ( ( 1U << ( resumedBlocks & ( BITS_PER_BYTE - 1U ) ) ) - 1U );
+            }
+
+            pFileContext->blocksRemaining = otaBitmap_CountSet( pFileContext->pRxBlockBitmap, resumedBlocks );
+            resumed = ( pFileContext->blocksRemaining > 0U );
+        }
+
+        if( resumed == true )
+        {
+            LogInfo( ( "Resuming the file from its checkpoint: "
+                       "Number of blocks remaining: %u, Log2 block size=%u",
+                       pFileContext->blocksRemaining, pFileContext->log2BlockSize ) );
+
+            /* The block size was adapted to the link before the download was interrupted. */
+            pOtaAgent->log2BlockSize = pFileContext->log2BlockSize;
+        }
+        else
+        {
+            /* The file was complete but not closed, or can't be resumed, receive it again. */
+            pFileContext->log2BlockSize = log2BlockSize;
+            ( void ) pOtaAgent->pOtaInterface->pal.abort( pFileContext );
+        }
+    }
+
+    /* The file is received from the start if the checkpoint is not used. */
+    if( ( canResume == true ) && ( resumed == false ) )
+    {
+        eraseBlockBitmap( pFileContext, numBlocks );
+    }
+
+    return resumed;
+}
+
+static uint32_t chooseFileBlockSize( OtaFileContext_t * pFileContext )
+{
+    uint32_t maxBitmapLen = OTA_MAX_BLOCK_BITMAP_SIZE;
+    uint32_t numBlocks = 0U;
+
+    if( ( pFileContext->blockBitmapMaxSize > 0U ) && ( pFileContext->blockBitmapMaxSize < maxBitmapLen ) )
+    {
+        maxBitmapLen = pFileContext->blockBitmapMaxSize;
+    }
+
+    pFileContext->log2BlockSize = pOtaAgent->log2BlockSize;
+    numBlocks = OTA_FILE_NUM_BLOCKS( pFileContext );
+
+    /* Smaller blocks are only used as long as the bitmap can track all of them. */
+    while( ( pFileContext->log2BlockSize < otaconfigLOG2_FILE_BLOCK_SIZE ) &&
+           ( ( ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE ) > maxBitmapLen ) )
+    {
+        pFileContext->log2BlockSize++;
+        numBlocks = OTA_FILE_NUM_BLOCKS( pFileContext );
+    }
+
+    /* The timeouts are counted again for this file. */
+    pOtaAgent->requestTimeouts = 0U;
+
+    LogInfo( ( "Receiving the file in blocks: "
+               "Block size=%u, Number of blocks=%u",
+               OTA_FILE_BLOCK_SIZE_OF( pFileContext ), numBlocks ) );
+
+    return numBlocks;
+}
+
+static void adaptBlockSize( bool aborted )
+{
+    uint32_t numBlocks = OTA_FILE_NUM_BLOCKS( &( pOtaAgent->fileContext ) );
+    uint32_t log2BlockSize = pOtaAgent->log2BlockSize;
+
+    /* Smaller blocks are lost less often and cost less to request again. */
+    if( ( aborted == true ) || ( ( pOtaAgent->requestTimeouts * OTA_BLOCK_SIZE_LOSS_RATIO ) > numBlocks ) )
+    {
+        if( log2BlockSize > otaconfigMIN_LOG2_FILE_BLOCK_SIZE )
+        {
+            log2BlockSize--;
+        }
+    }
+    /* Larger blocks take fewer round trips on a link that loses none. */
+    else if( pOtaAgent->requestTimeouts == 0U )
+    {
+        if( log2BlockSize < otaconfigLOG2_FILE_BLOCK_SIZE )
+        {
+            log2BlockSize++;
+        }
+    }
+    else
+    {
+        /* Some requests timed out, keep the block size. */
+    }
+
+    if( log2BlockSize != pOtaAgent->log2BlockSize )
+    {
+        LogInfo( ( "Adapted the block size of the next file: "
+                   "Block size=%u, Request timeouts=%u",
+                   ( 1U << log2BlockSize ), pOtaAgent->requestTimeouts ) );
+        pOtaAgent->log2BlockSize = log2BlockSize;
+    }
+
+    pOtaAgent->requestTimeouts = 0U;
+}
+
+#if ( otaconfigLATENCY_STATS == 1U )
+    static void recordLatency( OtaLatencyStage_t stage,
+                               uint32_t startTime )
+    {
+        OtaLatencySummary_t * pSummary = &( pOtaAgent->latency.stages[ stage ] );
+        uint32_t duration = otaconfigLATENCY_TIMESTAMP() - startTime;
+        uint32_t bin = 0U;
+
+        /* Bin n holds the durations shorter than 4^(n+2) ticks. */
+        while( ( bin < ( OTA_LATENCY_HISTOGRAM_BINS - 1U ) ) && ( ( duration >> ( 2U * ( bin + 2U ) ) ) > 0U ) )
+        {
+            bin++;
+        }
+
+        if( ( pSummary->count == 0U ) || ( duration < pSummary->min ) )
+        {
+            pSummary->min = duration;
+        }
+
+        if( duration > pSummary->max )
+        {
+            pSummary->max = duration;
+        }
+
+        pSummary->count++;
+        pSummary->total += duration;
+        pSummary->histogram[ bin ]++;
+    }
+#endif /* if ( otaconfigLATENCY_STATS == 1U ) */
+
+static void saveFileCheckpoint( uint32_t blockInterval )
+{
+    OtaPalStatus_t palStatus = OTA_PAL_COMBINE_ERR( OtaPalUninitialized, 0 );
+    OtaFileContext_t * pFileContext = &( pOtaAgent->fileContext );
+    uint32_t numBlocks = OTA_FILE_NUM_BLOCKS( pFileContext );
+    uint32_t bitmapLen = ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+    bool flushed = true;
+
+    if( ( pOtaAgent->pOtaInterface->pal.saveCheckpoint != NULL ) &&
+        ( strlen( ( const char * ) pOtaAgent->pActiveJobName ) > 0U ) &&
+        ( pFileContext->pFile != NULL ) && ( pFileContext->pRxBlockBitmap != NULL ) &&
+        ( pFileContext->blocksRemaining <= numBlocks ) &&
+        ( ( ( numBlocks - pFileContext->blocksRemaining ) % blockInterval ) == 0U ) )
+    {
+        #if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+            /* The bitmap marks the blocks buffered as received, they have to be in the file first. */
+            flushed = flushWriteCombine( pFileContext );
+        #endif
+
+        if( flushed == true )
+        {
+            palStatus = pOtaAgent->pOtaInterface->pal.saveCheckpoint( pFileContext, bitmapLen );
+        }
+
+        if( OTA_PAL_MAIN_ERR( palStatus ) != OtaPalSuccess )
+        {
+            LogWarn( ( "Failed to save a checkpoint of the file: "
+                       "OtaPalStatus_t=%s",
+                       OTA_PalStatus_strerror( OTA_PAL_MAIN_ERR( palStatus ) ) ) );
+        }
+    }
+}
+
+static OtaErr_t reportProgress( void )
+{
+    OtaErr_t err = OtaErrNone;
+
+    #if ( otaconfigPROGRESS_REPORT_INTERVAL_MS > 0U )
+        pOtaAgent->progressPending = true;
+
+        /* The status is published when the timer expires, with the blocks received until then. */
+        if( pOtaAgent->progressTimerStarted == false )
+        {
+            if( pOtaAgent->pOtaInterface->os.timer.start( agentTimerId( pOtaAgent, OtaProgressTimer ),
+                                                          "OtaProgressTimer",
+                                                          otaconfigPROGRESS_REPORT_INTERVAL_MS,
+                                                          otaTimerCallback ) == OtaOsSuccess )
+            {
+                pOtaAgent->progressTimerStarted = true;
+            }
+        }
+    #else
+        uint32_t numBlocks = OTA_FILE_NUM_BLOCKS( &( pOtaAgent->fileContext ) );
+        uint32_t received = numBlocks - pOtaAgent->fileContext.blocksRemaining;
+
+        /* Output a status update once in a while. */
+        if( ( received % otaconfigOTA_UPDATE_STATUS_FREQUENCY ) == 0U )
+        {
+            err = otaControlInterface.updateJobStatus( pOtaAgent, JobStatusInProgress, JobReasonReceiving, 0 );
+        }
+    #endif /* if ( otaconfigPROGRESS_REPORT_INTERVAL_MS > 0U ) */
+
+    return err;
+}
+
+static void stopProgressReports( void )
+{
+    if( pOtaAgent->progressTimerStarted == true )
+    {
+        ( void ) pOtaAgent->pOtaInterface->os.timer.stop( agentTimerId( pOtaAgent, OtaProgressTimer ) );
+    }
+
+    pOtaAgent->progressPending = false;
+    pOtaAgent->progressTimerStarted = false;
+}
+
+static void updateFileDigest( OtaFileContext_t * pFileContext,
+                              uint32_t offset,
+                              const uint8_t * pData,
+                              uint32_t blockSize )
+{
+    OtaPalStatus_t palStatus = OTA_PAL_COMBINE_ERR( OtaPalUninitialized, 0 );
+
+    /* A block after a gap is left for the PAL to digest when the file is closed. */
+    if( ( pOtaAgent->pOtaInterface->pal.digestUpdate != NULL ) && ( offset == pFileContext->digestLength ) )
+    {
+        palStatus = pOtaAgent->pOtaInterface->pal.digestUpdate( pFileContext, pData, blockSize );
+
+        if( OTA_PAL_MAIN_ERR( palStatus ) == OtaPalSuccess )
+        {
+            pFileContext->digestLength += blockSize;
+        }
+        else
+        {
+            LogWarn( ( "Failed to add the block to the digest of the file: "
+                       "Offset=%u, OtaPalStatus_t=%s",
+                       offset,
+                       OTA_PalStatus_strerror( OTA_PAL_MAIN_ERR( palStatus ) ) ) );
+        }
+    }
+}
+
+static bool storeJobDoc( const char * pJson,
+                         uint32_t messageLength )
+{
+    uint8_t * pJobDoc = NULL;
+    bool stored = true;
+
+    if( pOtaAgent->numJobFiles > 1U )
+    {
+        /* Not taken from the job arena, which is released with each file. */
+        #if ( otaconfigSTATIC_ONLY == 1U )
+            #if ( otaconfigMAX_FILES_PER_JOB > 1U )
+                if( messageLength <= sizeof( pOtaAgent->jobDocStorage.pBytes ) )
+                {
+                    pJobDoc = pOtaAgent->jobDocStorage.pBytes;
+                }
+            #endif
+        #else
+            pJobDoc = ( uint8_t * ) pOtaAgent->pOtaInterface->os.mem.malloc( messageLength );
+        #endif
+
+        if( pJobDoc == NULL )
+        {
+            LogError( ( "Failed to allocate a copy of the job document: "
+                        "size=%u",
+                        messageLength ) );
+            stored = false;
+        }
+        else
+        {
+            ( void ) memcpy( pJobDoc, pJson, messageLength );
+
+            freeJobDoc();
+            pOtaAgent->pJobDoc = pJobDoc;
+            pOtaAgent->jobDocLength = messageLength;
+        }
+    }
+
+    return stored;
+}
+
+static void freeJobDoc( void )
+{
+    if( pOtaAgent->pJobDoc != NULL )
+    {
+        #if ( otaconfigSTATIC_ONLY == 0U )
+            pOtaAgent->pOtaInterface->os.mem.free( pOtaAgent->pJobDoc );
+        #endif
+        pOtaAgent->pJobDoc = NULL;
+        pOtaAgent->jobDocLength = 0;
+    }
+}
+
+static OtaErr_t startNextJobFile( void )
+{
+    OtaErr_t err = OtaErrNone;
+    DocParseErr_t parseError = DocParseErrUnknown;
+    OtaPalStatus_t palStatus = OTA_PAL_COMBINE_ERR( OtaPalUninitialized, 0 );
+    OtaFileContext_t * pFileContext = &( pOtaAgent->fileContext );
+    JsonDocModel_t otaJobDocModel;
+    OtaEventMsg_t eventMsg = { 0 };
+    uint32_t numBlocks = 0;
+
+    /* Done with the transfer of the file received. */
+    stopRequestTimer();
+    stopProgressReports();
+
+    if( otaDataInterface.cleanup != NULL )
+    {
+        ( void ) otaDataInterface.cleanup( pOtaAgent );
+    }
+
+    freeFileContextMem( pFileContext );
+    pOtaAgent->fileIndex++;
+
+    /* Don't keep the values of the optional parameters of the previous file. */
+    pFileContext->fileSize = 0;
+    pFileContext->fileAttributes = 0;
+    pFileContext->fileType = 0;
+
+    parseError = initDocModel( &otaJobDocModel,
+                               otaJobDocModelParamStructure,
+                               ( void * ) pFileContext,
+                               ( uint32_t ) sizeof( OtaFileContext_t ),
+                               OTA_NUM_JOB_PARAMS );
+
+    if( parseError == DocParseErrNone )
+    {
+        otaJobDocModel.fileParamsIndex = pOtaAgent->fileIndex;
+        parseError = parseJSONbyModel( ( const char * ) pOtaAgent->pJobDoc, pOtaAgent->jobDocLength, &otaJobDocModel );
+    }
+
+    if( ( parseError != DocParseErrNone ) || ( pFileContext->fileSize == 0U ) )
+    {
+        LogError( ( "Failed to parse the next file of the job: "
+                    "file index=%u, DocParseErr_t=%d",
+                    pOtaAgent->fileIndex, parseError ) );
+        err = OtaErrJobParserError;
+    }
+    else
+    {
+        LogInfo( ( "Receiving the next file of the job: "
+                   "file index=%u, File ID=%u",
+                   pOtaAgent->fileIndex, pFileContext->serverFileID ) );
+
+        pOtaAgent->serverFileID = pFileContext->serverFileID;
+        numBlocks = chooseFileBlockSize( pFileContext );
+
+        if( initBlockBitmap( pFileContext, numBlocks ) == true )
+        {
+            palStatus = openFileForRx( pFileContext, numBlocks );
+        }
+
+        if( OTA_PAL_MAIN_ERR( palStatus ) != OtaPalSuccess )
+        {
+            LogError( ( "Failed to create the next file of the job: "
+                        "OtaPalStatus_t=%s",
+                        OTA_PalStatus_strerror( OTA_PAL_MAIN_ERR( palStatus ) ) ) );
+            err = OtaErrInitFileTransferFailed;
+        }
+    }
+
+    if( err == OtaErrNone )
+    {
+        eventMsg.eventId = OtaAgentEventCreateFile;
+
+        if( OTA_InstanceSignalEvent( pOtaAgent, &eventMsg ) == false )
+        {
+            err = OtaErrSignalEventFailed;
+        }
+    }
+
+    return err;
+}
+
+#if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+
+    static OtaPalStatus_t createFileSinks( const OtaFileContext_t * pFileContext,
+                                           uint32_t numBlocks )
+    {
+        OtaPalStatus_t palStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+        OtaFileContext_t * pFileSink = NULL;
+        OtaFileContext_t sinkContext;
+        uint32_t bitmapLen = ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+        uint32_t index;
+
+        for( index = 0U; ( index < pOtaAgent->numFileSinks ) && ( OTA_PAL_MAIN_ERR( palStatus ) == OtaPalSuccess ); index++ )
+        {
+            pFileSink = pOtaAgent->pFileSinks[ index ];
+
+            /* Take the parameters of the job, but keep what belongs to the sink. */
+            sinkContext = *pFileSink;
+            *pFileSink = *pFileContext;
+            pFileSink->pFilePath = sinkContext.pFilePath;
+            pFileSink->filePathMaxSize = sinkContext.filePathMaxSize;
+            pFileSink->pFile = NULL;
+            pFileSink->pRxBlockBitmap = sinkContext.pRxBlockBitmap;
+            pFileSink->blockBitmapMaxSize = sinkContext.blockBitmapMaxSize;
+            pFileSink->pDecodeMem = NULL;
+            pFileSink->decodeMemMaxSize = 0U;
+
+            if( ( pFileSink->blockBitmapMaxSize != 0u ) && ( pFileSink->blockBitmapMaxSize < bitmapLen ) )
+            {
+                LogError( ( "Failed to create file sink: The block bitmap of the sink is too small: "
+                            "Sink index=%u, size=%u, required=%u",
+                            index, pFileSink->blockBitmapMaxSize, bitmapLen ) );
+                palStatus = OTA_PAL_COMBINE_ERR( OtaPalOutOfMemory, 0 );
+            }
+            else if( initBlockBitmap( pFileSink, numBlocks ) == false )
+            {
+                LogError( ( "Failed to create file sink: Unable to allocate the block bitmap: "
+                            "Sink index=%u",
+                            index ) );
+                palStatus = OTA_PAL_COMBINE_ERR( OtaPalOutOfMemory, 0 );
+            }
+            else
+            {
+                palStatus = pOtaAgent->pOtaInterface->pal.createFile( pFileSink );
+
+                if( OTA_PAL_MAIN_ERR( palStatus ) != OtaPalSuccess )
+                {
+                    LogError( ( "Failed to create file sink: "
+                                "Sink index=%u, Error=(%s:0x%06x)",
+                                index,
+                                OTA_PalStatus_strerror( OTA_PAL_MAIN_ERR( palStatus ) ),
+                                OTA_PAL_SUB_ERR( palStatus ) ) );
+                }
+            }
+        }
+
+        return palStatus;
+    }
+
+    static bool writeFileSinks( uint32_t blockIndex,
+                                uint8_t * pPayload,
+                                uint32_t blockSize )
+    {
+        bool written = true;
+        OtaFileContext_t * pFileSink = NULL;
+        uint32_t byte = blockIndex >> LOG2_BITS_PER_BYTE;
+        uint8_t bitMask = ( uint8_t ) ( 1U << ( blockIndex % BITS_PER_BYTE ) );
+        uint32_t index;
+
+        for( index = 0U; ( index < pOtaAgent->numFileSinks ) && ( written == true ); index++ )
+        {
+            pFileSink = pOtaAgent->pFileSinks[ index ];
+
+            if( pFileSink->pFile == NULL )
+            {
+                LogError( ( "Parameter check failed: The file of the sink is NULL: "
+                            "Sink index=%u",
+                            index ) );
+                written = false;
+            }
+            /* Each sink keeps its own bitmap, so a block is written to it only once. */
+            else if( ( pFileSink->pRxBlockBitmap[ byte ] & bitMask ) != 0U )
+            {
+                if( pOtaAgent->pOtaInterface->pal.writeBlock( pFileSink,
+                                                              ( blockIndex * OTA_FILE_BLOCK_SIZE_OF( pFileSink ) ),
+                                                              pPayload,
+                                                              blockSize ) < 0 )
+                {
+                    LogError( ( "Failed to write the block to the file sink: "
+                                "Sink index=%u, Block index=%u",
+                                index, blockIndex ) );
+                    written = false;
+                }
+                else
+                {
+                    pFileSink->pRxBlockBitmap[ byte ] &= ( uint8_t ) ~bitMask;
+                    pFileSink->blocksRemaining--;
+                }
+            }
+            else
+            {
+                /* Already written to this sink. */
+            }
+        }
+
+        return written;
+    }
+
+    static IngestResult_t closeFileSinks( OtaPalStatus_t * pCloseResult )
+    {
+        IngestResult_t eIngestResult = IngestResultFileComplete;
+        OtaPalStatus_t closeResult = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+        OtaFileContext_t * pFileSink = NULL;
+        uint32_t index;
+
+        for( index = 0U; index < pOtaAgent->numFileSinks; index++ )
+        {
+            pFileSink = pOtaAgent->pFileSinks[ index ];
+
+            if( ( pFileSink->pRxBlockBitmap != NULL ) && ( pFileSink->blockBitmapMaxSize == 0u ) )
+            {
+                freeJobBuffer( pFileSink->pRxBlockBitmap );
+                pFileSink->pRxBlockBitmap = NULL;
+            }
+
+            /* Close all the sinks so that the PAL validates each of them, but report the first failure. */
+            if( pFileSink->pFile != NULL )
+            {
+                closeResult = pOtaAgent->pOtaInterface->pal.closeFile( pFileSink );
+                pFileSink->pFile = NULL;
+
+                if( ( OTA_PAL_MAIN_ERR( closeResult ) != OtaPalSuccess ) && ( eIngestResult == IngestResultFileComplete ) )
+                {
+                    LogError( ( "Failed to close the file sink: "
+                                "Sink index=%u, Error=(%s:0x%06x)",
+                                index,
+                                OTA_PalStatus_strerror( OTA_PAL_MAIN_ERR( closeResult ) ),
+                                OTA_PAL_SUB_ERR( closeResult ) ) );
+
+                    *pCloseResult = closeResult;
+
+                    if( OTA_PAL_MAIN_ERR( closeResult ) == OtaPalSignatureCheckFailed )
+                    {
+                        eIngestResult = IngestResultSigCheckFail;
+                    }
+                    else
+                    {
+                        eIngestResult = IngestResultFileCloseFail;
+                    }
+                }
+            }
+        }
+
+        return eIngestResult;
+    }
+
+    static void abortFileSinks( void )
+    {
+        OtaFileContext_t * pFileSink = NULL;
+        uint32_t index;
+
+        for( index = 0U; index < pOtaAgent->numFileSinks; index++ )
+        {
+            pFileSink = pOtaAgent->pFileSinks[ index ];
+
+            if( pFileSink->pFile != NULL )
+            {
+                ( void ) pOtaAgent->pOtaInterface->pal.abort( pFileSink );
+                pFileSink->pFile = NULL;
+            }
+
+            if( ( pFileSink->pRxBlockBitmap != NULL ) && ( pFileSink->blockBitmapMaxSize == 0u ) )
+            {
+                freeJobBuffer( pFileSink->pRxBlockBitmap );
+                pFileSink->pRxBlockBitmap = NULL;
+            }
         }
     }
 
-    /* Free or clear the bitmap buffer.*/
-    if( pFileContext->pRxBlockBitmap != NULL )
+#endif /* if ( otaconfigMAX_NUM_FILE_SINKS > 0U ) */
+
+#if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+
+    static int32_t writeCombinedBlock( OtaFileContext_t * pFileContext,
+                                       uint32_t offset,
+                                       const uint8_t * pData,
+                                       uint32_t blockSize )
     {
-        if( pFileContext->blockBitmapMaxSize > 0u )
+        OtaWriteCombine_t * pCombine = &( pOtaAgent->writeCombine );
+        int32_t result = ( int32_t ) blockSize;
+        uint32_t end = 0U;
+
+        /* Start again from this block if it does not follow the ones buffered or does not fit. */
+        if( ( pCombine->length > 0U ) &&
+            ( ( offset != ( pCombine->offset + pCombine->length ) ) ||
+              ( ( pCombine->length + blockSize ) > otaconfigWRITE_COMBINE_SIZE ) ) )
         {
-            ( void ) memset( pFileContext->pRxBlockBitmap, 0, pFileContext->blockBitmapMaxSize );
+            if( flushWriteCombine( pFileContext ) == false )
+            {
+                result = -1;
+            }
         }
-        else
+
+        if( result < 0 )
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pRxBlockBitmap );
-            pFileContext->pRxBlockBitmap = NULL;
+            /* The blocks buffered were not written. */
         }
-    }
-
-    /* Free or clear url buffer.*/
-    if( pFileContext->pUpdateUrlPath != NULL )
-    {
-        if( pFileContext->updateUrlMaxSize > 0u )
+        else if( blockSize > otaconfigWRITE_COMBINE_SIZE )
         {
-            ( void ) memset( pFileContext->pUpdateUrlPath, 0, pFileContext->updateUrlMaxSize );
+            /* A buffer smaller than a block can't hold it, write it as it is. */
+            result = ( int32_t ) pOtaAgent->pOtaInterface->pal.writeBlock( pFileContext,
+                                                                         offset,
+                                                                         ( uint8_t * ) pData,
+                                                                         blockSize );
         }
         else
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pUpdateUrlPath );
-            pFileContext->pUpdateUrlPath = NULL;
+            if( pCombine->length == 0U )
+            {
+                pCombine->offset = offset;
+            }
+
+            ( void ) memcpy( &( pCombine->pBuffer[ pCombine->length ] ), pData, blockSize );
+            pCombine->length += blockSize;
+            end = pCombine->offset + pCombine->length;
+
+            if( ( ( end % otaconfigWRITE_COMBINE_SIZE ) == 0U ) || ( end >= pFileContext->fileSize ) )
+            {
+                if( flushWriteCombine( pFileContext ) == false )
+                {
+                    result = -1;
+                }
+            }
         }
+
+        return result;
     }
 
-    /* Initialize auth scheme buffer from application buffer.*/
-    if( pFileContext->pAuthScheme != NULL )
+    static bool flushWriteCombine( OtaFileContext_t * pFileContext )
     {
-        if( pFileContext->authSchemeMaxSize > 0u )
-        {
-            ( void ) memset( pFileContext->pAuthScheme, 0, pFileContext->authSchemeMaxSize );
-        }
-        else
+        OtaWriteCombine_t * pCombine = &( pOtaAgent->writeCombine );
+        bool written = true;
+
+        if( pCombine->length > 0U )
         {
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pAuthScheme );
-            pFileContext->pAuthScheme = NULL;
+            if( pOtaAgent->pOtaInterface->pal.writeBlock( pFileContext,
+                                                          pCombine->offset,
+                                                          pCombine->pBuffer,
+                                                          pCombine->length ) < 0 )
+            {
+                LogError( ( "Failed to write the buffered blocks to the file: "
+                            "Offset=%u, Length=%u",
+                            pCombine->offset, pCombine->length ) );
+                written = false;
+            }
+            else
+            {
+                pCombine->length = 0U;
+            }
         }
+
+        return written;
     }
-}
+
+#endif /* if ( otaconfigWRITE_COMBINE_SIZE > 0U ) */
 
 /* Close an existing OTA file context and free its resources. */
 
@@ -1486,7 +3570,7 @@ static bool otaClose( OtaFileContext_t * const pFileContext )
     /* Cleanup related to selected protocol. */
     if( otaDataInterface.cleanup != NULL )
     {
-        ( void ) otaDataInterface.cleanup( &otaAgent );
+        ( void ) otaDataInterface.cleanup( pOtaAgent );
     }
 
     if( pFileContext != NULL )
@@ -1494,9 +3578,25 @@ static bool otaClose( OtaFileContext_t * const pFileContext )
         /*
          * Abort any active file access and release the file resource, if needed.
          */
-        ( void ) otaAgent.pOtaInterface->pal.abort( pFileContext );
+        ( void ) pOtaAgent->pOtaInterface->pal.abort( pFileContext );
+
+        #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+            abortFileSinks();
+        #endif
 
-        freeFileContextMem( &( otaAgent.fileContext ) );
+        #if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+            /* The blocks buffered belong to the file aborted. */
+            pOtaAgent->writeCombine.length = 0U;
+        #endif
+
+        stopProgressReports();
+
+        freeFileContextMem( &( pOtaAgent->fileContext ) );
+
+        /* The job is done with, the next one starts from its first file. */
+        freeJobDoc();
+        pOtaAgent->fileIndex = 0;
+        pOtaAgent->jobHasFirmware = false;
 
         result = true;
     }
@@ -1598,14 +3698,28 @@ static DocParseErr_t extractAndStoreArray( const char * pKey,
 
     if( *pParamSizeAdd == 0U )
     {
-        /* Free previously allocated buffer. */
-        if( *pCharPtr != NULL )
-        {
-            otaAgent.pOtaInterface->os.mem.free( *pCharPtr );
-        }
+        #if ( otaconfigJOB_ARENA_SIZE > 0U )
+            /* Reuse the buffer of a previous value if the new one fits, instead of
+             * taking more of the arena each time the job document is received. */
+            if( ( *pCharPtr != NULL ) && ( strlen( *pCharPtr ) < valueLength ) )
+            {
+                *pCharPtr = NULL;
+            }
+
+            if( *pCharPtr == NULL )
+            {
+                *pCharPtr = allocJobBuffer( valueLength + 1U );
+            }
+        #else
+            /* Free previously allocated buffer. */
+            if( *pCharPtr != NULL )
+            {
+                freeJobBuffer( *pCharPtr );
+            }
 
-        /* Malloc memory for a copy of the value string plus a zero terminator. */
-        *pCharPtr = otaAgent.pOtaInterface->os.mem.malloc( valueLength + 1U );
+            /* Malloc memory for a copy of the value string plus a zero terminator. */
+            *pCharPtr = allocJobBuffer( valueLength + 1U );
+        #endif /* if ( otaconfigJOB_ARENA_SIZE > 0U ) */
 
         if( *pCharPtr == NULL )
         {
@@ -1745,6 +3859,446 @@ static DocParseErr_t verifyRequiredParamsExtracted( const JsonDocParam_t * pMode
     return err;
 }
 
+/* Hash a key, or a key path, of the job document. */
+
+static uint32_t hashJsonKey( uint32_t hash,
+                             const char * pKey,
+                             size_t keyLength )
+{
+    uint32_t keyHash = hash;
+    size_t index = 0;
+
+    for( index = 0; index < keyLength; index++ )
+    {
+        keyHash = ( keyHash ^ ( uint8_t ) pKey[ index ] ) * JSON_KEY_HASH_PRIME;
+    }
+
+    return keyHash;
+}
+
+/* Skip the whitespace in a JSON document. */
+
+static size_t skipJsonSpace( const char * pJson,
+                             size_t jsonLength,
+                             size_t index )
+{
+    size_t nextIndex = index;
+
+    while( ( nextIndex < jsonLength ) &&
+           ( ( pJson[ nextIndex ] == ' ' ) || ( pJson[ nextIndex ] == '\t' ) ||
+             ( pJson[ nextIndex ] == '\n' ) || ( pJson[ nextIndex ] == '\r' ) ) )
+    {
+        nextIndex++;
+    }
+
+    return nextIndex;
+}
+
+/* Skip a value in a valid JSON document. */
+
+static size_t skipJsonValue( const char * pJson,
+                             size_t jsonLength,
+                             size_t index,
+                             uint32_t nesting )
+{
+    size_t nextIndex = index;
+    uint32_t openNesting = nesting;
+    bool skipping = true;
+
+    if( ( openNesting == 0U ) && ( nextIndex < jsonLength ) &&
+        ( pJson[ nextIndex ] != '"' ) && ( pJson[ nextIndex ] != '{' ) && ( pJson[ nextIndex ] != '[' ) )
+    {
+        /* A number, true, false or null ends with the separator or close that follows it. */
+        while( ( nextIndex < jsonLength ) &&
+               ( pJson[ nextIndex ] != ',' ) && ( pJson[ nextIndex ] != '}' ) && ( pJson[ nextIndex ] != ']' ) &&
+               ( skipJsonSpace( pJson, jsonLength, nextIndex ) == nextIndex ) )
+        {
+            nextIndex++;
+        }
+
+        skipping = false;
+    }
+
+    while( ( skipping == true ) && ( nextIndex < jsonLength ) )
+    {
+        if( pJson[ nextIndex ] == '"' )
+        {
+            nextIndex++;
+
+            while( ( nextIndex < jsonLength ) && ( pJson[ nextIndex ] != '"' ) )
+            {
+                /* Step over the escaped character, which may be a quote. */
+                nextIndex += ( pJson[ nextIndex ] == '\\' ) ? 2U : 1U;
+            }
+
+            skipping = ( openNesting > 0U );
+        }
+        else if( ( pJson[ nextIndex ] == '{' ) || ( pJson[ nextIndex ] == '[' ) )
+        {
+            openNesting++;
+        }
+        else if( ( pJson[ nextIndex ] == '}' ) || ( pJson[ nextIndex ] == ']' ) )
+        {
+            openNesting--;
+            skipping = ( openNesting > 0U );
+        }
+        else
+        {
+            /* Other characters within objects and arrays are skipped. */
+        }
+
+        nextIndex++;
+    }
+
+    return ( nextIndex < jsonLength ) ? nextIndex : jsonLength;
+}
+
+/* Check if the key path walked to a key is the key of a document model parameter. */
+
+static bool matchJsonKeyPath( const JsonDocWalk_t * pWalk,
+                              const char * pSrcKey,
+                              const char * pKey,
+                              size_t keyLength )
+{
+    const char * pSegment = pSrcKey;
+    size_t segmentLength = 0;
+    uint32_t depth = pWalk->scopeDepth + 1U;
+    bool match = true;
+
+    /* Each key on the path is a segment of the source key, between separators. */
+    while( ( match == true ) && ( depth <= pWalk->depth ) )
+    {
+        segmentLength = strcspn( pSegment, OTA_JSON_SEPARATOR );
+        match = ( segmentLength == pWalk->frames[ depth ].keyLength ) &&
+                ( pSegment[ segmentLength ] != '\0' ) &&
+                ( strncmp( pSegment, pWalk->frames[ depth ].pKey, segmentLength ) == 0 );
+
+        if( match == true )
+        {
+            pSegment = &pSegment[ segmentLength + 1U ];
+        }
+
+        depth++;
+    }
+
+    if( match == true )
+    {
+        segmentLength = strcspn( pSegment, OTA_JSON_SEPARATOR );
+        match = ( segmentLength == keyLength ) &&
+                ( pSegment[ segmentLength ] == '\0' ) &&
+                ( strncmp( pSegment, pKey, segmentLength ) == 0 );
+    }
+
+    return match;
+}
+
+/* Store the value of each document model parameter with the key path walked to a key. */
+
+static uint32_t storeJsonDocValue( JsonDocWalk_t * pWalk,
+                                   const char * pKey,
+                                   size_t keyLength,
+                                   uint32_t pathHash,
+                                   const char * pValue )
+{
+    const JsonDocModel_t * pDocModel = pWalk->pDocModel;
+    uint32_t slot = pathHash & ( OTA_DOC_MODEL_KEY_SLOTS - 1U );
+    uint32_t paramIndex = 0;
+    uint32_t paramBit = 0;
+    uint32_t storedParams = 0;
+    bool inDoc = ( pWalk->scopeDepth == 0U );
+    bool isFirstValue = false;
+
+    /* The table always has free slots, which end the probing. */
+    while( pDocModel->keySlots[ slot ] != 0U )
+    {
+        paramIndex = ( uint32_t ) pDocModel->keySlots[ slot ] - 1U;
+        paramBit = ( uint32_t ) 1U << paramIndex;
+
+        /* The nested file parameters are only searched for the parameters that follow them in
+         * the model, and never override a value found relative to the document. */
+        if( inDoc == true )
+        {
+            isFirstValue = ( ( pWalk->paramsFoundInDoc & paramBit ) == 0U );
+        }
+        else
+        {
+            isFirstValue = ( paramIndex > pDocModel->nestedParamIndex ) &&
+                           ( ( pWalk->paramsFound & paramBit ) == 0U );
+        }
+
+        if( ( isFirstValue == true ) &&
+            ( pDocModel->keyHashes[ paramIndex ] == pathHash ) &&
+            ( matchJsonKeyPath( pWalk, pDocModel->pBodyDef[ paramIndex ].pSrcKey, pKey, keyLength ) == true ) )
+        {
+            pWalk->pValues[ paramIndex ].pValue = pValue;
+            pWalk->pValues[ paramIndex ].valueLength = 0U;
+            pWalk->paramsFound |= paramBit;
+
+            if( inDoc == true )
+            {
+                pWalk->paramsFoundInDoc |= paramBit;
+            }
+
+            storedParams |= paramBit;
+        }
+
+        slot = ( slot + 1U ) & ( OTA_DOC_MODEL_KEY_SLOTS - 1U );
+    }
+
+    return storedParams;
+}
+
+/* Set the length of the values stored for document model parameters. */
+
+static void endJsonDocValues( JsonDocWalk_t * pWalk,
+                              uint32_t params,
+                              const char * pValueEnd )
+{
+    uint32_t remainingParams = params;
+    uint32_t paramIndex = 0;
+
+    while( remainingParams != 0U )
+    {
+        if( ( remainingParams & 1U ) != 0U )
+        {
+            pWalk->pValues[ paramIndex ].valueLength = ( size_t ) ( pValueEnd - pWalk->pValues[ paramIndex ].pValue );
+        }
+
+        remainingParams >>= 1U;
+        paramIndex++;
+    }
+}
+
+/* Find an object of a JSON array and count the values of the array. */
+
+static size_t findJsonArrayObject( const char * pJson,
+                                   size_t jsonLength,
+                                   size_t index,
+                                   uint32_t objectIndex,
+                                   uint32_t * pNumValues )
+{
+    size_t nextIndex = skipJsonSpace( pJson, jsonLength, index );
+    size_t valueIndex = 0;
+    size_t objectStart = jsonLength;
+    uint32_t numValues = 0;
+    bool scanning = ( nextIndex < jsonLength ) && ( pJson[ nextIndex ] != ']' );
+
+    while( scanning == true )
+    {
+        if( ( numValues == objectIndex ) && ( pJson[ nextIndex ] == '{' ) )
+        {
+            objectStart = nextIndex;
+        }
+
+        numValues++;
+        valueIndex = nextIndex;
+        nextIndex = skipJsonSpace( pJson, jsonLength, skipJsonValue( pJson, jsonLength, valueIndex, 0U ) );
+
+        /* Only a comma is followed by another value, anything else ends the array. */
+        if( ( nextIndex > valueIndex ) && ( nextIndex < jsonLength ) && ( pJson[ nextIndex ] == ',' ) )
+        {
+            nextIndex = skipJsonSpace( pJson, jsonLength, nextIndex + 1U );
+            scanning = ( nextIndex < jsonLength );
+        }
+        else
+        {
+            scanning = false;
+        }
+    }
+
+    *pNumValues = numValues;
+
+    return objectStart;
+}
+
+/* Walk a key and its value in the job document. */
+
+static size_t walkJsonKey( JsonDocWalk_t * pWalk,
+                           size_t index )
+{
+    const char * pJson = pWalk->pJson;
+    size_t jsonLength = pWalk->jsonLength;
+    const char * pKey = &pJson[ index + 1U ];
+    size_t keyLength = 0;
+    size_t valueIndex = 0;
+    size_t fileIndex = pWalk->jsonLength;
+    size_t nextIndex = 0;
+    uint32_t pathHash = pWalk->frames[ pWalk->depth ].pathHash;
+    uint32_t storedParams = 0;
+    JsonPathFrame_t * pFrame = NULL;
+
+    /* The key is followed by a colon and its value, unless the document ends within the key. */
+    nextIndex = skipJsonValue( pJson, jsonLength, index, 0U );
+
+    if( nextIndex < jsonLength )
+    {
+        keyLength = nextIndex - index - 2U;
+        valueIndex = skipJsonSpace( pJson, jsonLength, skipJsonSpace( pJson, jsonLength, nextIndex ) + 1U );
+    }
+    else
+    {
+        valueIndex = jsonLength;
+    }
+
+    if( pWalk->depth > pWalk->scopeDepth )
+    {
+        pathHash = hashJsonKey( pathHash, OTA_JSON_SEPARATOR, 1U );
+    }
+
+    pathHash = hashJsonKey( pathHash, pKey, keyLength );
+
+    if( valueIndex >= jsonLength )
+    {
+        nextIndex = jsonLength;
+    }
+    else if( pJson[ valueIndex ] == '"' )
+    {
+        storedParams = storeJsonDocValue( pWalk, pKey, keyLength, pathHash, &pJson[ valueIndex + 1U ] );
+        nextIndex = skipJsonValue( pJson, jsonLength, valueIndex, 0U );
+        endJsonDocValues( pWalk, storedParams, &pJson[ nextIndex - 1U ] );
+    }
+    else
+    {
+        storedParams = storeJsonDocValue( pWalk, pKey, keyLength, pathHash, &pJson[ valueIndex ] );
+
+        if( ( pJson[ valueIndex ] == '[' ) && ( pWalk->scopeDepth == 0U ) &&
+            ( ( storedParams & ( ( uint32_t ) 1U << pWalk->pDocModel->nestedParamIndex ) ) != 0U ) )
+        {
+            fileIndex = findJsonArrayObject( pJson, jsonLength, valueIndex + 1U,
+                                             pWalk->pDocModel->fileParamsIndex, &( pWalk->numFileParams ) );
+        }
+
+        if( pWalk->depth >= OTA_DOC_MODEL_MAX_DEPTH )
+        {
+            /* Too deep to hold any of the keys. */
+            pFrame = NULL;
+        }
+        else if( pJson[ valueIndex ] == '{' )
+        {
+            /* Walk the keys of the object, its value ends with it. */
+            pWalk->depth++;
+            pFrame = &( pWalk->frames[ pWalk->depth ] );
+            pFrame->pKey = pKey;
+            pFrame->keyLength = keyLength;
+            pFrame->pathHash = pathHash;
+            pFrame->isFileParams = false;
+            nextIndex = valueIndex + 1U;
+        }
+        else if( fileIndex < jsonLength )
+        {
+            /* Walk the keys of the object of the nested file parameters being extracted,
+             * relative to it. The value of the array ends with the array. */
+            pWalk->depth++;
+            pWalk->scopeDepth = pWalk->depth;
+            pFrame = &( pWalk->frames[ pWalk->depth ] );
+            pFrame->pKey = NULL;
+            pFrame->keyLength = 0U;
+            pFrame->pathHash = JSON_KEY_HASH_BASIS;
+            pFrame->isFileParams = true;
+            nextIndex = fileIndex + 1U;
+        }
+        else
+        {
+            pFrame = NULL;
+        }
+
+        if( pFrame != NULL )
+        {
+            pFrame->pendingParams = storedParams;
+        }
+        else
+        {
+            nextIndex = skipJsonValue( pJson, jsonLength, valueIndex, 0U );
+            endJsonDocValues( pWalk, storedParams, &pJson[ nextIndex ] );
+        }
+    }
+
+    return nextIndex;
+}
+
+/* Find the values of the document model parameters in a single walk through the job document. */
+
+static uint32_t findJsonDocValues( const char * pJson,
+                                   uint32_t messageLength,
+                                   const JsonDocModel_t * pDocModel,
+                                   JsonDocValue_t * pValues,
+                                   uint32_t * pNumFileParams )
+{
+    JsonDocWalk_t walk;
+    JsonPathFrame_t * pFrame = NULL;
+    size_t index = 0;
+    bool walking = false;
+    bool complete = false;
+
+    walk.pJson = pJson;
+    walk.jsonLength = ( size_t ) messageLength;
+    walk.pDocModel = pDocModel;
+    walk.pValues = pValues;
+    walk.depth = 0U;
+    walk.scopeDepth = 0U;
+    walk.paramsFound = 0U;
+    walk.paramsFoundInDoc = 0U;
+    walk.numFileParams = 0U;
+    walk.frames[ 0 ].pKey = NULL;
+    walk.frames[ 0 ].keyLength = 0U;
+    walk.frames[ 0 ].pathHash = JSON_KEY_HASH_BASIS;
+    walk.frames[ 0 ].pendingParams = 0U;
+    walk.frames[ 0 ].isFileParams = false;
+
+    /* The keys are relative to the object at the top of the document. */
+    index = skipJsonSpace( pJson, walk.jsonLength, 0U );
+    walking = ( index < walk.jsonLength ) && ( pJson[ index ] == '{' );
+    index++;
+
+    while( walking == true )
+    {
+        index = skipJsonSpace( pJson, walk.jsonLength, index );
+
+        if( index >= walk.jsonLength )
+        {
+            walking = false;
+        }
+        else if( pJson[ index ] == '"' )
+        {
+            index = walkJsonKey( &walk, index );
+        }
+        else if( pJson[ index ] == '}' )
+        {
+            index++;
+            pFrame = &( walk.frames[ walk.depth ] );
+
+            if( pFrame->isFileParams == true )
+            {
+                /* The other objects of the nested file parameters are not searched. */
+                index = skipJsonValue( pJson, walk.jsonLength, index, 1U );
+                walk.scopeDepth = 0U;
+            }
+
+            endJsonDocValues( &walk, pFrame->pendingParams, &pJson[ index ] );
+
+            if( walk.depth == 0U )
+            {
+                walking = false;
+                complete = true;
+            }
+            else
+            {
+                walk.depth--;
+            }
+        }
+        else
+        {
+            /* Step over the comma between keys. */
+            index++;
+        }
+    }
+
+    *pNumFileParams = walk.numFileParams;
+
+    /* Nothing is taken from a document that ends before its top object is closed. */
+    return ( complete == true ) ? walk.paramsFound : 0U;
+}
+
 /* Extract the desired fields from the JSON document based on the specified document model. */
 
 static DocParseErr_t parseJSONbyModel( const char * pJson,
@@ -1757,6 +4311,9 @@ static DocParseErr_t parseJSONbyModel( const char * pJson,
     uint16_t paramIndex = 0;
     const char * pFileParams = NULL;
     uint32_t fileParamsLength = 0;
+    JsonDocValue_t paramValues[ OTA_DOC_MODEL_MAX_PARAMS ];
+    uint32_t paramsFound = 0;
+    bool isValidJson = false;
 
     LogDebug( ( "JSON received: %s", pJson ) );
 
@@ -1766,19 +4323,43 @@ static DocParseErr_t parseJSONbyModel( const char * pJson,
     /* Check the validity of the JSON document */
     err = validateJSON( pJson, messageLength );
 
+    /* Find all the parameters in a single walk through a valid document. */
+    if( err == DocParseErrNone )
+    {
+        paramsFound = findJsonDocValues( pJson, messageLength, pDocModel, paramValues, &( pDocModel->numFileParams ) );
+        isValidJson = true;
+    }
+
     /* Traverse the docModel and search the JSON if it containing the Source Key specified*/
     for( paramIndex = 0; paramIndex < pDocModel->numModelParams; paramIndex++ )
     {
-        const char * pQueryKey = pDocModel->pBodyDef[ paramIndex ].pSrcKey;
-        size_t queryKeyLength = strlen( pQueryKey );
         const char * pValueInJson = NULL;
         size_t valueLength = 0;
-        result = JSON_SearchConst( pJson, messageLength, pQueryKey, queryKeyLength, &pValueInJson, &valueLength, NULL );
 
-        /* If not found in pJSon search for the key in FileParameters JSON*/
-        if( ( result != JSONSuccess ) && ( pFileParams != NULL ) )
-        {
-            result = JSON_SearchConst( pFileParams, fileParamsLength, pQueryKey, queryKeyLength, &pValueInJson, &valueLength, NULL );
+        if( isValidJson == true )
+        {
+            result = JSONNotFound;
+
+            if( ( paramsFound & ( ( uint32_t ) 1U << paramIndex ) ) != 0U )
+            {
+                pValueInJson = paramValues[ paramIndex ].pValue;
+                valueLength = paramValues[ paramIndex ].valueLength;
+                result = JSONSuccess;
+            }
+        }
+        else
+        {
+            const char * pQueryKey = pDocModel->pBodyDef[ paramIndex ].pSrcKey;
+            size_t queryKeyLength = strlen( pQueryKey );
+
+            /* An invalid document is searched key by key, as far as it can be. */
+            result = JSON_SearchConst( pJson, messageLength, pQueryKey, queryKeyLength, &pValueInJson, &valueLength, NULL );
+
+            /* If not found in pJSon search for the key in FileParameters JSON*/
+            if( ( result != JSONSuccess ) && ( pFileParams != NULL ) )
+            {
+                result = JSON_SearchConst( pFileParams, fileParamsLength, pQueryKey, queryKeyLength, &pValueInJson, &valueLength, NULL );
+            }
         }
 
         if( result == JSONSuccess )
@@ -1837,6 +4418,7 @@ static DocParseErr_t initDocModel( JsonDocModel_t * pDocModel,
 {
     DocParseErr_t err = DocParseErrUnknown;
     uint32_t scanIndex;
+    uint32_t slot;
 
     /* Sanity check the model pointers and parameter count. Exclude the context base address and size since
      * it is technically possible to create a model that writes entirely into absolute memory locations.
@@ -1869,6 +4451,11 @@ static DocParseErr_t initDocModel( JsonDocModel_t * pDocModel,
         pDocModel->paramsReceivedBitmap = 0;
         pDocModel->paramsRequiredBitmap = 0;
 
+        pDocModel->nestedParamIndex = numJobParams;
+        pDocModel->fileParamsIndex = 0;
+        pDocModel->numFileParams = 0;
+        ( void ) memset( pDocModel->keySlots, 0, sizeof( pDocModel->keySlots ) );
+
         /* Scan the model and detect all required parameters (i.e. not optional). */
         for( scanIndex = 0; scanIndex < pDocModel->numModelParams; scanIndex++ )
         {
@@ -1877,6 +4464,25 @@ static DocParseErr_t initDocModel( JsonDocModel_t * pDocModel,
                 /* Add parameter to the required bitmap. */
                 pDocModel->paramsRequiredBitmap |= ( ( uint32_t ) 1U << scanIndex );
             }
+
+            if( ( pDocModel->pBodyDef[ scanIndex ].pDestOffset == OTA_STORE_NESTED_JSON ) &&
+                ( pDocModel->nestedParamIndex == numJobParams ) )
+            {
+                pDocModel->nestedParamIndex = ( uint16_t ) scanIndex;
+            }
+
+            /* Add the key to the hash table used to find it in the job document. */
+            pDocModel->keyHashes[ scanIndex ] = hashJsonKey( JSON_KEY_HASH_BASIS,
+                                                             pDocModel->pBodyDef[ scanIndex ].pSrcKey,
+                                                             strlen( pDocModel->pBodyDef[ scanIndex ].pSrcKey ) );
+            slot = pDocModel->keyHashes[ scanIndex ] & ( OTA_DOC_MODEL_KEY_SLOTS - 1U );
+
+            while( pDocModel->keySlots[ slot ] != 0U )
+            {
+                slot = ( slot + 1U ) & ( OTA_DOC_MODEL_KEY_SLOTS - 1U );
+            }
+
+            pDocModel->keySlots[ slot ] = ( uint8_t ) ( scanIndex + 1U );
         }
 
         err = DocParseErrNone;
@@ -1902,7 +4508,9 @@ static OtaErr_t validateUpdateVersion( const OtaFileContext_t * pFileContext )
     ( void ) previousVersion; /* For suppressing compiler-warning: unused variable. */
 
     /* Only check for versions if the target is self */
-    if( ( otaAgent.serverFileID == 0U ) && ( otaAgent.fileContext.fileType == configOTA_FIRMWARE_UPDATE_FILE_TYPE_ID ) )
+    if( ( pOtaAgent->serverFileID == 0U ) &&
+        ( ( pOtaAgent->fileContext.fileType == configOTA_FIRMWARE_UPDATE_FILE_TYPE_ID ) ||
+          ( pOtaAgent->fileContext.fileType == configOTA_DELTA_UPDATE_FILE_TYPE_ID ) ) )
     {
         /* Check if version reported is the same as the running version. */
         if( pFileContext->updaterVersion == appFirmwareVersion.u.unsignedVersion32 )
@@ -1972,13 +4580,13 @@ static OtaJobParseErr_t handleCustomJob( const char * pJson,
     {
         /* We have an unknown job parser error. Check to see if we can pass control
          * to a callback for parsing */
-        otaAgent.OtaAppCallback( OtaJobEventParseCustomJob, &jobDoc );
+        pOtaAgent->OtaAppCallback( OtaJobEventParseCustomJob, &jobDoc );
 
         if( ( jobDoc.jobIdLength > 0U ) && ( jobDoc.jobIdLength <= OTA_JOB_ID_MAX_SIZE ) ) /* LCOV_EXCL_BR_LINE */
         {
             jobDoc.pJobDocJson = ( const uint8_t * ) jobDocValue;
             jobDoc.pJobId = ( const uint8_t * ) jobIdValue;
-            ( void ) memcpy( otaAgent.pActiveJobName, jobDoc.pJobId, jobDoc.jobIdLength );
+            ( void ) memcpy( pOtaAgent->pActiveJobName, jobDoc.pJobId, jobDoc.jobIdLength );
         }
         else
         {
@@ -1987,13 +4595,13 @@ static OtaJobParseErr_t handleCustomJob( const char * pJson,
 
         if( jobDoc.parseErr == OtaJobParseErrNone )
         {
-            otaErr = otaControlInterface.updateJobStatus( &otaAgent, jobDoc.status, jobDoc.reason, jobDoc.subReason );
+            otaErr = otaControlInterface.updateJobStatus( pOtaAgent, jobDoc.status, jobDoc.reason, jobDoc.subReason );
 
             LogInfo( ( "Job document parsed from external callback" ) );
             err = jobDoc.parseErr;
 
             /* We don't need the job name memory anymore since we're done with this job. */
-            ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+            ( void ) memset( pOtaAgent->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
         }
         else
         {
@@ -2031,26 +4639,30 @@ static OtaJobParseErr_t verifyActiveJobStatus( OtaFileContext_t * pFileContext,
     if( pFileContext->pJobName != NULL )
     {
         /* pFileContext->pJobName is guaranteed to be zero terminated. */
-        if( strcmp( ( char * ) otaAgent.pActiveJobName, ( char * ) pFileContext->pJobName ) != 0 )
+        if( strcmp( ( char * ) pOtaAgent->pActiveJobName, ( char * ) pFileContext->pJobName ) != 0 )
         {
             LogInfo( ( "New job document received, aborting current job." ) );
 
             /* Abort the current job. */
-            ( void ) otaAgent.pOtaInterface->pal.setPlatformImageState( &( otaAgent.fileContext ), OtaImageStateAborted );
+            ( void ) pOtaAgent->pOtaInterface->pal.setPlatformImageState( &( pOtaAgent->fileContext ), OtaImageStateAborted );
 
             /*
              * Abort any active file access and release the file resource, if needed.
              */
-            ( void ) otaAgent.pOtaInterface->pal.abort( pFileContext );
+            ( void ) pOtaAgent->pOtaInterface->pal.abort( pFileContext );
+
+            #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+                abortFileSinks();
+            #endif
 
             /* Cleanup related to selected protocol. */
             if( otaDataInterface.cleanup != NULL )
             {
-                ( void ) otaDataInterface.cleanup( &otaAgent );
+                ( void ) otaDataInterface.cleanup( pOtaAgent );
             }
 
             /* Set new active job name. */
-            ( void ) memcpy( otaAgent.pActiveJobName, pFileContext->pJobName, strlen( ( const char * ) pFileContext->pJobName ) );
+            ( void ) memcpy( pOtaAgent->pActiveJobName, pFileContext->pJobName, strlen( ( const char * ) pFileContext->pJobName ) );
 
             err = OtaJobParseErrNone;
         }
@@ -2060,23 +4672,23 @@ static OtaJobParseErr_t verifyActiveJobStatus( OtaFileContext_t * pFileContext,
             LogInfo( ( "New job document ID is identical to the current job: "
                        "Updating the URL based on the new job document." ) );
 
-            if( otaAgent.fileContext.pUpdateUrlPath != NULL )
+            if( pOtaAgent->fileContext.pUpdateUrlPath != NULL )
             {
-                if( otaAgent.fileContext.updateUrlMaxSize == 0u )
+                if( pOtaAgent->fileContext.updateUrlMaxSize == 0u )
                 {
                     /* The buffer is allocated by us, free first then update. */
-                    otaAgent.pOtaInterface->os.mem.free( otaAgent.fileContext.pUpdateUrlPath );
-                    otaAgent.fileContext.pUpdateUrlPath = pFileContext->pUpdateUrlPath;
+                    freeJobBuffer( pOtaAgent->fileContext.pUpdateUrlPath );
+                    pOtaAgent->fileContext.pUpdateUrlPath = pFileContext->pUpdateUrlPath;
                     pFileContext->pUpdateUrlPath = NULL;
                 }
                 else
                 {
                     /* The buffer is provided by user, directly copy the new url to it. */
-                    ( void ) memcpy( otaAgent.fileContext.pUpdateUrlPath, pFileContext->pUpdateUrlPath, otaAgent.fileContext.updateUrlMaxSize );
+                    ( void ) memcpy( pOtaAgent->fileContext.pUpdateUrlPath, pFileContext->pUpdateUrlPath, pOtaAgent->fileContext.updateUrlMaxSize );
                 }
             }
 
-            *pFinalFile = &( otaAgent.fileContext );
+            *pFinalFile = &( pOtaAgent->fileContext );
             *pUpdateJob = true;
 
             err = OtaJobParseErrUpdateCurrentJob;
@@ -2117,9 +4729,9 @@ static void handleSelfTestJobDoc( OtaFileContext_t * pFileContext )
          * Set image state accordingly and update job status with self test identifier.
          */
         LogInfo( ( "Image version is valid: Begin testing file: File ID=%d",
-                   otaAgent.serverFileID ) );
+                   pOtaAgent->serverFileID ) );
 
-        otaErr = setImageStateWithReason( OtaImageStateTesting, ( uint32_t ) errVersionCheck );
+        otaErr = setImageStateWithReason( pOtaAgent, OtaImageStateTesting, ( uint32_t ) errVersionCheck );
 
         if( otaErr != OtaErrNone )
         {
@@ -2131,7 +4743,7 @@ static void handleSelfTestJobDoc( OtaFileContext_t * pFileContext )
         LogWarn( ( "New image is being rejected: Application version of the new image is invalid: "
                    "OtaErr_t=%s", OTA_Err_strerror( errVersionCheck ) ) );
 
-        otaErr = setImageStateWithReason( OtaImageStateRejected, ( uint32_t ) errVersionCheck );
+        otaErr = setImageStateWithReason( pOtaAgent, OtaImageStateRejected, ( uint32_t ) errVersionCheck );
 
         if( otaErr != OtaErrNone )
         {
@@ -2139,11 +4751,11 @@ static void handleSelfTestJobDoc( OtaFileContext_t * pFileContext )
         }
 
         /* Application callback for self-test failure.*/
-        otaAgent.OtaAppCallback( OtaJobEventSelfTestFailed, NULL );
+        pOtaAgent->OtaAppCallback( OtaJobEventSelfTestFailed, NULL );
 
         /* Handle self-test failure in the platform specific implementation,
          * example, reset the device in case of firmware upgrade. */
-        ( void ) otaAgent.pOtaInterface->pal.reset( &( otaAgent.fileContext ) );
+        ( void ) pOtaAgent->pOtaInterface->pal.reset( &( pOtaAgent->fileContext ) );
     }
 }
 
@@ -2163,18 +4775,18 @@ static OtaJobParseErr_t validateAndStartJob( OtaFileContext_t * pFileContext,
     }
     /* If there's an active job, verify that it's the same as what's being reported now. */
     /* We already checked for missing parameters so we SHOULD have a job name in the context. */
-    else if( strlen( ( const char * ) otaAgent.pActiveJobName ) > 0u )
+    else if( strlen( ( const char * ) pOtaAgent->pActiveJobName ) > 0u )
     {
         err = verifyActiveJobStatus( pFileContext, pFinalFile, pUpdateJob );
     }
     else
     {
         /* Assume control of the job name from the context. */
-        ( void ) memcpy( otaAgent.pActiveJobName, pFileContext->pJobName, strlen( ( const char * ) pFileContext->pJobName ) );
+        ( void ) memcpy( pOtaAgent->pActiveJobName, pFileContext->pJobName, strlen( ( const char * ) pFileContext->pJobName ) );
     }
 
     /* Store the File ID received in the job. */
-    otaAgent.serverFileID = pFileContext->serverFileID;
+    pOtaAgent->serverFileID = pFileContext->serverFileID;
 
     if( err == OtaJobParseErrNone )
     {
@@ -2248,12 +4860,12 @@ static void handleJobParsingError( const OtaFileContext_t * pFileContext,
                         "OtaJobParseErr_t=%s, Job name=%s",
                         OTA_JobParse_strerror( err ), ( const char * ) pFileContext->pJobName ) );
 
-            if( strlen( ( const char * ) otaAgent.pActiveJobName ) > 0u )
+            if( strlen( ( const char * ) pOtaAgent->pActiveJobName ) > 0u )
             {
                 /* Assume control of the job name from the context. */
-                ( void ) memcpy( otaAgent.pActiveJobName, pFileContext->pJobName, OTA_JOB_ID_MAX_SIZE );
+                ( void ) memcpy( pOtaAgent->pActiveJobName, pFileContext->pJobName, OTA_JOB_ID_MAX_SIZE );
 
-                otaErr = otaControlInterface.updateJobStatus( &otaAgent,
+                otaErr = otaControlInterface.updateJobStatus( pOtaAgent,
                                                               JobStatusFailedWithVal,
                                                               ( int32_t ) OtaErrJobParserError,
                                                               ( int32_t ) err );
@@ -2265,10 +4877,10 @@ static void handleJobParsingError( const OtaFileContext_t * pFileContext,
                 }
 
                 /* We don't need the job name memory anymore since we're done with this job. */
-                ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+                ( void ) memset( pOtaAgent->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
 
                 /* Close any open files. */
-                ( void ) otaClose( &( otaAgent.fileContext ) );
+                ( void ) otaClose( &( pOtaAgent->fileContext ) );
             }
 
             break;
@@ -2288,7 +4900,7 @@ static OtaFileContext_t * parseJobDoc( const JsonDocParam_t * pJsonExpectedParam
     OtaJobParseErr_t err = OtaJobParseErrUnknown;
     DocParseErr_t parseError = DocParseErrNone;
     OtaFileContext_t * pFinalFile = NULL;
-    OtaFileContext_t * pFileContext = &( otaAgent.fileContext );
+    OtaFileContext_t * pFileContext = &( pOtaAgent->fileContext );
     JsonDocModel_t otaJobDocModel;
     OtaJobDocument_t jobDoc = { 0 };
 
@@ -2304,10 +4916,24 @@ static OtaFileContext_t * parseJobDoc( const JsonDocParam_t * pJsonExpectedParam
     }
     else
     {
+        /* The document of the active job is parsed for the file being received. */
+        otaJobDocModel.fileParamsIndex = pOtaAgent->fileIndex;
+
         parseError = parseJSONbyModel( pJson, messageLength, &otaJobDocModel );
 
         if( parseError == DocParseErrNone )
         {
+            /* The files past the limit are not received. */
+            pOtaAgent->numJobFiles = otaJobDocModel.numFileParams;
+
+            if( pOtaAgent->numJobFiles > otaconfigMAX_FILES_PER_JOB )
+            {
+                LogWarn( ( "Only receiving the first files of the job: "
+                           "files in job=%u, otaconfigMAX_FILES_PER_JOB=%u",
+                           pOtaAgent->numJobFiles, otaconfigMAX_FILES_PER_JOB ) );
+                pOtaAgent->numJobFiles = otaconfigMAX_FILES_PER_JOB;
+            }
+
             err = validateAndStartJob( pFileContext, &pFinalFile, pUpdateJob );
         }
         else
@@ -2323,14 +4949,14 @@ static OtaFileContext_t * parseJobDoc( const JsonDocParam_t * pJsonExpectedParam
                    OTA_JobParse_strerror( err ), ( const char * ) pFileContext->pJobName ) );
 
         /* Set the job id and length from OTA context. */
-        jobDoc.pJobId = otaAgent.pActiveJobName;
-        jobDoc.jobIdLength = strlen( ( const char * ) otaAgent.pActiveJobName ) + 1U;
+        jobDoc.pJobId = pOtaAgent->pActiveJobName;
+        jobDoc.jobIdLength = strlen( ( const char * ) pOtaAgent->pActiveJobName ) + 1U;
         jobDoc.pJobDocJson = ( const uint8_t * ) pJson;
         jobDoc.jobDocLength = messageLength;
-        jobDoc.fileTypeId = otaAgent.fileContext.fileType;
+        jobDoc.fileTypeId = pOtaAgent->fileContext.fileType;
 
         /* Let the application know to release buffer.*/
-        otaAgent.OtaAppCallback( OtaJobEventReceivedJob, ( const void * ) &jobDoc );
+        pOtaAgent->OtaAppCallback( OtaJobEventReceivedJob, ( const void * ) &jobDoc );
     }
     else
     {
@@ -2346,9 +4972,7 @@ static OtaFileContext_t * parseJobDoc( const JsonDocParam_t * pJsonExpectedParam
 static OtaFileContext_t * getFileContextFromJob( const char * pRawMsg,
                                                  uint32_t messageLength )
 {
-    uint32_t index;
     uint32_t numBlocks;             /* How many data pages are in the expected update image. */
-    uint32_t bitmapLen;             /* Length of the file block bitmap in bytes. */
     OtaFileContext_t * pUpdateFile; /* Pointer to an OTA update context. */
     OtaErr_t err = OtaErrNone;
     OtaPalStatus_t palStatus;
@@ -2362,63 +4986,25 @@ static OtaFileContext_t * getFileContextFromJob( const char * pRawMsg,
     if( updateJob == true )
     {
         LogInfo( ( "Job document for receiving an update received." ) );
+
+        /* The next files are received with the latest document of the job. */
+        ( void ) storeJobDoc( pRawMsg, messageLength );
     }
 
     if( ( updateJob == false ) && ( pUpdateFile != NULL ) && ( platformInSelftest() == false ) )
     {
         /* Calculate how many bytes we need in our bitmap for tracking received blocks.
          * The below calculation requires power of 2 page sizes. */
-        numBlocks = ( pUpdateFile->fileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
-        bitmapLen = ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
-
-        if( pUpdateFile->blockBitmapMaxSize == 0u )
-        {
-            /* LCOV_EXCL_START */
-            if( pUpdateFile->pRxBlockBitmap != NULL )
-            {
-                /* Free any previously allocated bitmap. */
-                otaAgent.pOtaInterface->os.mem.free( pUpdateFile->pRxBlockBitmap );
-            }
+        numBlocks = chooseFileBlockSize( pUpdateFile );
 
-            /* LCOV_EXCL_STOP */
-
-            pUpdateFile->pRxBlockBitmap = ( uint8_t * ) otaAgent.pOtaInterface->os.mem.malloc( bitmapLen );
-        }
-        else
-        {
-            assert( pUpdateFile->pRxBlockBitmap != NULL );
-            ( void ) memset( pUpdateFile->pRxBlockBitmap, 0, pUpdateFile->blockBitmapMaxSize );
-        }
-
-        if( pUpdateFile->pRxBlockBitmap != NULL )
+        if( initBlockBitmap( pUpdateFile, numBlocks ) == true )
         {
-            /* Mark as used any pages in the bitmap that are out of range, based on the file size.
-             * This keeps us from requesting those pages during retry processing or if using a windowed
-             * block request. It also avoids erroneously accepting an out of range data block should it
-             * get past any safety checks.
-             * Files are not always a multiple of 8 pages (8 bits/pages per byte) so some bits of the
-             * last byte may be out of range and those are the bits we want to clear. */
-
-            uint8_t bit = 1U << ( BITS_PER_BYTE - 1U );
-            uint32_t numOutOfRange = ( bitmapLen * BITS_PER_BYTE ) - numBlocks;
-
-            /* Set all bits in the bitmap to the erased state (we use 1 for erased just like flash memory). */
-            ( void ) memset( pUpdateFile->pRxBlockBitmap, ( int32_t ) OTA_ERASED_BLOCKS_VAL, bitmapLen );
-
-            for( index = 0U; index < numOutOfRange; index++ )
-            {
-                pUpdateFile->pRxBlockBitmap[ bitmapLen - 1U ] &= ( uint8_t ) ~bit;
-                bit >>= 1U;
-            }
-
-            pUpdateFile->blocksRemaining = numBlocks; /* Initialize our blocks remaining counter. */
-
             /* Create/Open the OTA file on the file system. */
-            palStatus = otaAgent.pOtaInterface->pal.createFile( pUpdateFile );
+            palStatus = openFileForRx( pUpdateFile, numBlocks );
 
             if( OTA_PAL_MAIN_ERR( palStatus ) != OtaPalSuccess )
             {
-                err = setImageStateWithReason( OtaImageStateAborted, palStatus );
+                err = setImageStateWithReason( pOtaAgent, OtaImageStateAborted, palStatus );
                 ( void ) otaClose( pUpdateFile ); /* Ignore false result since we're setting the pointer to null on the next line. */
                 pUpdateFile = NULL;
             }
@@ -2431,6 +5017,14 @@ static OtaFileContext_t * getFileContextFromJob( const char * pRawMsg,
         }
     }
 
+    /* The next files of the job are parsed from a copy of the document. */
+    if( ( updateJob == false ) && ( pUpdateFile != NULL ) && ( platformInSelftest() == false ) &&
+        ( storeJobDoc( pRawMsg, messageLength ) == false ) )
+    {
+        ( void ) otaClose( pUpdateFile );
+        pUpdateFile = NULL;
+    }
+
     if( err != OtaErrNone )
     {
         LogDebug( ( "Failed to parse the file context from the job document: OtaErr_t=%s",
@@ -2454,10 +5048,10 @@ static bool validateDataBlock( const OtaFileContext_t * pFileContext,
     bool ret = false;
     uint32_t lastBlock = 0;
 
-    lastBlock = ( ( pFileContext->fileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE ) - 1U;
+    lastBlock = OTA_FILE_NUM_BLOCKS( pFileContext ) - 1U;
 
-    if( ( ( blockIndex < lastBlock ) && ( blockSize == OTA_FILE_BLOCK_SIZE ) ) ||
-        ( ( blockIndex == lastBlock ) && ( blockSize == ( pFileContext->fileSize - ( lastBlock * OTA_FILE_BLOCK_SIZE ) ) ) ) )
+    if( ( ( blockIndex < lastBlock ) && ( blockSize == OTA_FILE_BLOCK_SIZE_OF( pFileContext ) ) ) ||
+        ( ( blockIndex == lastBlock ) && ( blockSize == ( pFileContext->fileSize - ( lastBlock * OTA_FILE_BLOCK_SIZE_OF( pFileContext ) ) ) ) ) )
     {
         ret = true;
         LogInfo( ( "Received valid file block: Block index=%u, Size=%u",
@@ -2467,6 +5061,31 @@ static bool validateDataBlock( const OtaFileContext_t * pFileContext,
     return ret;
 }
 
+/* Write a data block to the file, or apply it for a delta update. */
+
+static int32_t writeFileBlock( OtaFileContext_t * pFileContext,
+                               uint32_t offset,
+                               uint8_t * pData,
+                               uint32_t blockSize )
+{
+    int32_t result = 0;
+
+    if( pFileContext->fileType == configOTA_DELTA_UPDATE_FILE_TYPE_ID )
+    {
+        result = ( int32_t ) pOtaAgent->pOtaInterface->pal.patchBlock( pFileContext, offset, pData, blockSize );
+    }
+    else
+    {
+        #if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+            result = writeCombinedBlock( pFileContext, offset, pData, blockSize );
+        #else
+            result = ( int32_t ) pOtaAgent->pOtaInterface->pal.writeBlock( pFileContext, offset, pData, blockSize );
+        #endif
+    }
+
+    return result;
+}
+
 /* Validate the incoming data block and store it in the file context. */
 
 static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
@@ -2478,6 +5097,7 @@ static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
     IngestResult_t eIngestResult = IngestResultUninitialized;
     uint32_t byte = 0;
     uint8_t bitMask = 0;
+    uint32_t numBlocks = OTA_FILE_NUM_BLOCKS( pFileContext );
 
     if( validateDataBlock( pFileContext, uBlockIndex, uBlockSize ) == true )
     {
@@ -2497,6 +5117,24 @@ static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
 
             eIngestResult = IngestResultDuplicate_Continue;
             *pCloseResult = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 ); /* This is a success path. */
+
+            #if ( otaconfigLATENCY_STATS == 1U )
+                pOtaAgent->latency.duplicateBlocks++;
+            #endif
+        }
+        /* The patch of a delta update is applied in order, a block after a gap is requested again. */
+        else if( ( pFileContext->fileType == configOTA_DELTA_UPDATE_FILE_TYPE_ID ) &&
+                 ( uBlockIndex != otaBitmap_FindFirstSet( pFileContext->pRxBlockBitmap, numBlocks, 0U ) ) )
+        {
+            LogWarn( ( "Received a block of a delta update out of order: Block index=%u, Block size=%u",
+                       uBlockIndex, uBlockSize ) );
+
+            eIngestResult = IngestResultOutOfOrder_Continue;
+            *pCloseResult = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 ); /* This is a success path. */
+        }
+        else
+        {
+            /* The block is new. */
         }
     }
     else
@@ -2512,10 +5150,17 @@ static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
     {
         if( pFileContext->pFile != NULL )
         {
-            int32_t iBytesWritten = otaAgent.pOtaInterface->pal.writeBlock( pFileContext,
-                                                                            ( uBlockIndex * OTA_FILE_BLOCK_SIZE ),
-                                                                            pPayload,
-                                                                            uBlockSize );
+            #if ( otaconfigLATENCY_STATS == 1U )
+                uint32_t startTime = otaconfigLATENCY_TIMESTAMP();
+            #endif
+            int32_t iBytesWritten = writeFileBlock( pFileContext,
+                                                    ( uBlockIndex * OTA_FILE_BLOCK_SIZE_OF( pFileContext ) ),
+                                                    pPayload,
+                                                    uBlockSize );
+
+            #if ( otaconfigLATENCY_STATS == 1U )
+                recordLatency( OtaLatencyWrite, startTime );
+            #endif
 
             if( iBytesWritten < 0 )
             {
@@ -2523,11 +5168,21 @@ static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
                 LogError( ( "Failed to ingest received block: IngestResult_t=%d",
                             eIngestResult ) );
             }
+
+            #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+                else if( writeFileSinks( uBlockIndex, pPayload, uBlockSize ) == false )
+                {
+                    eIngestResult = IngestResultWriteBlockFailed;
+                    LogError( ( "Failed to write received block to the file sinks: IngestResult_t=%d",
+                                eIngestResult ) );
+                }
+            #endif
             else
             {
                 /* Mark this block as received in our bitmap. */
                 pFileContext->pRxBlockBitmap[ byte ] &= ( uint8_t ) ~bitMask;
                 pFileContext->blocksRemaining--;
+                updateFileDigest( pFileContext, ( uBlockIndex * OTA_FILE_BLOCK_SIZE_OF( pFileContext ) ), pPayload, uBlockSize );
                 eIngestResult = IngestResultAccepted_Continue;
                 *pCloseResult = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
             }
@@ -2546,6 +5201,7 @@ static IngestResult_t processDataBlock( OtaFileContext_t * pFileContext,
 static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
                                                const uint8_t * pRawMsg,
                                                uint32_t messageSize,
+                                               uint32_t fileOffset,
                                                uint8_t ** pPayload,
                                                uint32_t * pBlockSize,
                                                uint32_t * pBlockIndex )
@@ -2556,39 +5212,84 @@ static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
     int32_t sBlockIndex = 0;
     size_t payloadSize = 0;
 
+    #if ( otaconfigLATENCY_STATS == 1U )
+        uint32_t startTime = 0U;
+    #endif
+
     /* If we are expecting a data block, allocate space for it. */
     if( ( pFileContext->pRxBlockBitmap != NULL ) && ( pFileContext->blocksRemaining > 0U ) )
     {
-        ( void ) otaAgent.pOtaInterface->os.timer.start( OtaRequestTimer,
-                                                         "OtaRequestTimer",
-                                                         otaconfigFILE_REQUEST_WAIT_MS,
-                                                         otaTimerCallback );
+        /* The block moves the deadline of the request, the timer keeps ticking. */
+        ( void ) startRequestTimer();
+
+        #if ( otaconfigZERO_COPY_DATA_BLOCKS == 1U )
+            /* Have the data plane point the payload into the message received. */
+            *pPayload = NULL;
+            payloadSize = ( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE );
+        #else
+            if( pOtaAgent->fileContext.decodeMemMaxSize != 0U )
+            {
+                *pPayload = pOtaAgent->fileContext.pDecodeMem;
+                payloadSize = pOtaAgent->fileContext.decodeMemMaxSize;
+            }
+            else
+            {
+                #if ( otaconfigJOB_ARENA_SIZE > 0U )
+                    /* Take the decode buffer from the arena once for the whole job. */
+                    if( pOtaAgent->fileContext.pDecodeMem == NULL )
+                    {
+                        pOtaAgent->fileContext.pDecodeMem = allocJobBuffer( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE );
+                    }
+
+                    *pPayload = pOtaAgent->fileContext.pDecodeMem;
+                #else
+                    *pPayload = pOtaAgent->pOtaInterface->os.mem.malloc( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE );
+                #endif
+
+                if( *pPayload != NULL )
+                {
+                    payloadSize = ( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE );
+                }
+            }
+        #endif /* if ( otaconfigZERO_COPY_DATA_BLOCKS == 1U ) */
+    }
+    else
+    {
+        eIngestResult = IngestResultUnexpectedBlock;
+    }
 
-        if( otaAgent.fileContext.decodeMemMaxSize != 0U )
+    if( pOtaAgent->requestWindow.blocksPerRange > 0U )
+    {
+        /* Blocks may arrive in any order, the data plane takes the block index
+         * from the offset the application has tagged the block with. */
+        if( ( fileOffset & ( OTA_FILE_BLOCK_SIZE_OF( pFileContext ) - 1U ) ) == 0U )
         {
-            *pPayload = otaAgent.fileContext.pDecodeMem;
-            payloadSize = otaAgent.fileContext.decodeMemMaxSize;
+            sBlockIndex = ( int32_t ) ( fileOffset >> pFileContext->log2BlockSize );
         }
         else
         {
-            *pPayload = otaAgent.pOtaInterface->os.mem.malloc( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE );
-
-            if( *pPayload != NULL )
-            {
-                payloadSize = ( 1UL << otaconfigLOG2_FILE_BLOCK_SIZE );
-            }
+            LogError( ( "File block offset is not aligned to the block size: "
+                        "offset=%u",
+                        fileOffset ) );
+            eIngestResult = IngestResultBadData;
         }
     }
     else
     {
-        eIngestResult = IngestResultUnexpectedBlock;
+        /* The data plane works out the block index on its own. */
+        sBlockIndex = -1;
     }
 
     /* Decode the file block if space is allocated. */
-    if( payloadSize > 0u )
+    if( ( payloadSize > 0u ) && ( eIngestResult == IngestResultUninitialized ) )
     {
+        #if ( otaconfigLATENCY_STATS == 1U )
+            startTime = otaconfigLATENCY_TIMESTAMP();
+        #endif
+
         /* Decode the file block received. */
         if( OtaErrNone != otaDataInterface.decodeFileBlock(
+                pOtaAgent,
                 pRawMsg,
                 messageSize,
                 &lFileId,
@@ -2601,9 +5302,23 @@ static IngestResult_t decodeAndStoreDataBlock( OtaFileContext_t * pFileContext,
         }
         else
         {
+            #if ( otaconfigLATENCY_STATS == 1U )
+                recordLatency( OtaLatencyDecode, startTime );
+            #endif
+
             *pBlockIndex = ( uint32_t ) sBlockIndex;
             *pBlockSize = ( uint32_t ) sBlockSize;
         }
+
+        /* A block still in flight for the previous file of the job is dropped. */
+        if( ( eIngestResult == IngestResultUninitialized ) &&
+            ( lFileId != ( int32_t ) pFileContext->serverFileID ) )
+        {
+            LogWarn( ( "Received a block of another file: "
+                       "File ID=%d, expected File ID=%u",
+                       ( int ) lFileId, pFileContext->serverFileID ) );
+            eIngestResult = IngestResultOtherFile_Continue;
+        }
     }
     else
     {
@@ -2625,6 +5340,11 @@ static IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
     IngestResult_t eIngestResult = IngestResultAccepted_Continue;
     OtaPalMainStatus_t otaPalMainErr;
     OtaPalSubStatus_t otaPalSubErr;
+    bool flushed = true;
+
+    #if ( otaconfigLATENCY_STATS == 1U )
+        uint32_t startTime = 0U;
+    #endif
 
     ( void ) otaPalSubErr; /* For suppressing compiler-warning: unused variable. */
 
@@ -2633,19 +5353,40 @@ static IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
         LogInfo( ( "Received final block of the update." ) );
 
         /* Stop the request timer. */
-        ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+        stopRequestTimer();
 
         /* Free the bitmap now that we're done with the download. */
         if( ( pFileContext->pRxBlockBitmap != NULL ) && ( pFileContext->blockBitmapMaxSize == 0u ) )
         {
             /* Free any previously allocated bitmap. */
-            otaAgent.pOtaInterface->os.mem.free( pFileContext->pRxBlockBitmap );
+            freeJobBuffer( pFileContext->pRxBlockBitmap );
             pFileContext->pRxBlockBitmap = NULL;
         }
 
-        if( pFileContext->pFile != NULL )
+        #if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+            /* Write the blocks still buffered before the file is closed. */
+            if( pFileContext->pFile != NULL )
+            {
+                flushed = flushWriteCombine( pFileContext );
+            }
+        #endif
+
+        if( flushed == false )
         {
-            *pCloseResult = otaAgent.pOtaInterface->pal.closeFile( pFileContext );
+            eIngestResult = IngestResultWriteBlockFailed;
+        }
+        else if( pFileContext->pFile != NULL )
+        {
+            #if ( otaconfigLATENCY_STATS == 1U )
+                startTime = otaconfigLATENCY_TIMESTAMP();
+            #endif
+
+            *pCloseResult = pOtaAgent->pOtaInterface->pal.closeFile( pFileContext );
+
+            #if ( otaconfigLATENCY_STATS == 1U )
+                recordLatency( OtaLatencyClose, startTime );
+            #endif
+
             otaPalMainErr = OTA_PAL_MAIN_ERR( *pCloseResult );
             otaPalSubErr = OTA_PAL_SUB_ERR( *pCloseResult );
 
@@ -2653,6 +5394,11 @@ static IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
             {
                 LogInfo( ( "Received entire update and validated the signature." ) );
                 eIngestResult = IngestResultFileComplete;
+
+                #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+                    /* The sinks received the same blocks, close and validate them too. */
+                    eIngestResult = closeFileSinks( pCloseResult );
+                #endif
             }
             else
             {
@@ -2691,6 +5437,7 @@ static IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
 static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
                                        const uint8_t * pRawMsg,
                                        uint32_t messageSize,
+                                       uint32_t fileOffset,
                                        OtaPalStatus_t * pCloseResult )
 {
     IngestResult_t eIngestResult = IngestResultUninitialized;
@@ -2706,7 +5453,7 @@ static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
 
     /* Decode the received data block. */
     /* If we have a block bitmap available then process the message. */
-    eIngestResult = decodeAndStoreDataBlock( pFileContext, pRawMsg, messageSize, &pPayload, &uBlockSize, &uBlockIndex );
+    eIngestResult = decodeAndStoreDataBlock( pFileContext, pRawMsg, messageSize, fileOffset, &pPayload, &uBlockSize, &uBlockIndex );
 
     /* Validate the data block and process it to store the information.*/
     if( eIngestResult == IngestResultUninitialized )
@@ -2721,10 +5468,11 @@ static IngestResult_t ingestDataBlock( OtaFileContext_t * pFileContext,
     }
 
     /* Free the payload if it's dynamically allocated by us. */
-    if( ( otaAgent.fileContext.decodeMemMaxSize == 0u ) &&
+    if( ( pOtaAgent->fileContext.decodeMemMaxSize == 0u ) &&
+        ( otaconfigZERO_COPY_DATA_BLOCKS == 0U ) &&
         ( pPayload != NULL ) )
     {
-        otaAgent.pOtaInterface->os.mem.free( pPayload );
+        freeJobBuffer( pPayload );
     }
 
     return eIngestResult;
@@ -2737,18 +5485,18 @@ static void agentShutdownCleanup( void )
 {
     uint32_t index;
 
-    otaAgent.state = OtaAgentStateShuttingDown;
+    pOtaAgent->state = OtaAgentStateShuttingDown;
 
     /* Control plane cleanup related to selected protocol. */
     if( otaControlInterface.cleanup != NULL )
     {
-        ( void ) otaControlInterface.cleanup( &otaAgent );
+        ( void ) otaControlInterface.cleanup( pOtaAgent );
     }
 
     /* Data plane cleanup related to selected protocol. */
     if( otaDataInterface.cleanup != NULL )
     {
-        ( void ) otaDataInterface.cleanup( &otaAgent );
+        ( void ) otaDataInterface.cleanup( pOtaAgent );
     }
 
     /*
@@ -2756,13 +5504,13 @@ static void agentShutdownCleanup( void )
      */
     for( index = 0; index < OTA_MAX_FILES; index++ )
     {
-        ( void ) otaClose( &( otaAgent.fileContext ) );
+        ( void ) otaClose( &( pOtaAgent->fileContext ) );
     }
 
     /*
      * Clear active job name.
      */
-    ( void ) memset( otaAgent.pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
+    ( void ) memset( pOtaAgent->pActiveJobName, 0, OTA_JOB_ID_MAX_SIZE );
 }
 
 /*
@@ -2773,7 +5521,7 @@ static void handleUnexpectedEvents( const OtaEventMsg_t * pEventMsg )
     LogError( ( "Received unexpected event: "
                 "Current state=[%s]"
                 ", Event received=[%s]",
-                pOtaAgentStateStrings[ otaAgent.state ],
+                pOtaAgentStateStrings[ pOtaAgent->state ],
                 pOtaEventStrings[ pEventMsg->eventId ] ) );
 
     /* Perform any cleanup operations required for specific unhandled events.*/
@@ -2781,18 +5529,24 @@ static void handleUnexpectedEvents( const OtaEventMsg_t * pEventMsg )
     {
         case OtaAgentEventReceivedJobDocument:
 
-            /* Let the application know to release buffer.*/
-            otaAgent.OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventMsg->pEventData );
+            /* Let the application know to release buffer, unless the agent is shut down already.*/
+            if( pOtaAgent->OtaAppCallback != NULL )
+            {
+                pOtaAgent->OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventMsg->pEventData );
+            }
 
             break;
 
         case OtaAgentEventReceivedFileBlock:
 
-            /* Let the application know to release buffer.*/
-            otaAgent.OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventMsg->pEventData );
+            /* Let the application know to release buffer, unless the agent is shut down already.*/
+            if( pOtaAgent->OtaAppCallback != NULL )
+            {
+                pOtaAgent->OtaAppCallback( OtaJobEventProcessed, ( const void * ) pEventMsg->pEventData );
+            }
 
             /* File block was not processed, increment the statistics. */
-            otaAgent.statistics.otaPacketsDropped++;
+            pOtaAgent->statistics.otaPacketsDropped++;
 
             break;
 
@@ -2811,245 +5565,613 @@ static void executeHandler( uint32_t index,
 {
     OtaErr_t err = OtaErrNone;
 
-    assert( otaTransitionTable[ index ].handler != NULL );
+    assert( otaTransitionTable[ index ].handler != NULL );
+
+    err = otaTransitionTable[ index ].handler( pEventMsg->pEventData );
+
+    if( err == OtaErrNone )
+    {
+        LogDebug( ( "Executing handler for state transition: " ) );
+
+        /*
+         * Update the current state in OTA agent context.
+         */
+        pOtaAgent->state = otaTransitionTable[ index ].nextState;
+    }
+    else
+    {
+        LogDebug( ( "Failed to execute state transition handler: "
+                    "Handler returned error: OtaErr_t=%s",
+                    OTA_Err_strerror( err ) ) );
+    }
+
+    LogInfo( ( "Current State=[%s]"
+               ", Event=[%s]"
+               ", New state=[%s]",
+               pOtaAgentStateStrings[ pOtaAgent->state ],
+               pOtaEventStrings[ pEventMsg->eventId ],
+               pOtaAgentStateStrings[ otaTransitionTable[ index ].nextState ] ) );
+}
+
+static uint32_t searchTransition( const OtaEventMsg_t * pEventMsg )
+{
+    uint32_t transitionTableLen = ( uint32_t ) ( sizeof( otaTransitionTable ) / sizeof( otaTransitionTable[ 0 ] ) );
+    uint32_t i = transitionTableLen;
+    uint32_t state = ( uint32_t ) OtaAgentStateAll;
+
+    if( ( pOtaAgent->state >= OtaAgentStateInit ) && ( pOtaAgent->state < OtaAgentStateAll ) )
+    {
+        state = ( uint32_t ) pOtaAgent->state;
+    }
+
+    if( ( uint32_t ) pEventMsg->eventId < ( uint32_t ) OtaAgentEventMax )
+    {
+        i = otaTransitionIndex[ state ][ pEventMsg->eventId ];
+    }
+
+    return i;
+}
+
+static void initTransitionIndex( void )
+{
+    uint32_t transitionTableLen = ( uint32_t ) ( sizeof( otaTransitionTable ) / sizeof( otaTransitionTable[ 0 ] ) );
+    uint32_t i = transitionTableLen;
+    uint32_t state = 0;
+
+    /* The table must be short enough for its indexes to be stored in a byte. */
+    assert( transitionTableLen <= UINT8_MAX );
+
+    ( void ) memset( otaTransitionIndex, ( int ) transitionTableLen, sizeof( otaTransitionIndex ) );
+
+    /* Walk the table backwards, so that the first entry for a state and event is
+     * the one indexed, as when the table is searched in order. */
+    while( i > 0U )
+    {
+        i--;
+
+        for( state = ( uint32_t ) OtaAgentStateInit; state <= ( uint32_t ) OtaAgentStateAll; state++ )
+        {
+            if( ( otaTransitionTable[ i ].currentState == OtaAgentStateAll ) ||
+                ( ( uint32_t ) otaTransitionTable[ i ].currentState == state ) )
+            {
+                otaTransitionIndex[ state ][ otaTransitionTable[ i ].eventId ] = ( uint8_t ) i;
+            }
+        }
+    }
+}
+
+static void processOtaEvent( const OtaEventMsg_t * pEventMsg )
+{
+    uint32_t i = 0;
+    uint32_t transitionTableLen = ( uint32_t ) ( sizeof( otaTransitionTable ) / sizeof( otaTransitionTable[ 0 ] ) );
+
+    if( pEventMsg->eventId == OtaAgentEventRequestTimerTick )
+    {
+        /*
+         * The ticks of the request timer are counted in any state.
+         */
+        requestTimerTick();
+    }
+    else
+    {
+        /*
+         * The progress timer has expired, whether or not the event is handled in
+         * the current state.
+         */
+        if( pEventMsg->eventId == OtaAgentEventProgressTimer )
+        {
+            pOtaAgent->progressTimerStarted = false;
+        }
+
+        /*
+         * Search transition index if available in the table.
+         */
+        i = searchTransition( pEventMsg );
+
+        if( i < transitionTableLen )
+        {
+            LogDebug( ( "Found valid event handler for state transition: "
+                        "State=[%s], "
+                        "Event=[%s]",
+                        pOtaAgentStateStrings[ pOtaAgent->state ],
+                        pOtaEventStrings[ pEventMsg->eventId ] ) );
+
+            /*
+             * Execute the handler function.
+             */
+            executeHandler( i, pEventMsg );
+        }
+
+        if( i == transitionTableLen )
+        {
+            /*
+             * Handle unexpected events.
+             */
+            handleUnexpectedEvents( pEventMsg );
+        }
+    }
+}
+
+static void receiveAndProcessOtaEvent( void )
+{
+    OtaEventMsg_t eventMsgs[ otaconfigEVENT_BATCH_SIZE ] = { 0 };
+    OtaOsStatus_t osErr = OtaOsSuccess;
+    uint32_t numEvents = 0;
+
+    if( otaAgent.pOtaInterface == NULL )
+    {
+        LogError( ( "Failed to receive event: OS Interface not set" ) );
+    }
+    else
+    {
+        /*
+         * Receive the next events from the OTA event queue to process, all the
+         * pending ones at once if the OS interface can. The queue of the agent
+         * started by OTA_Init holds the events of all the agent instances.
+         */
+        if( otaAgent.pOtaInterface->os.event.recvBatch != NULL )
+        {
+            osErr = otaAgent.pOtaInterface->os.event.recvBatch( NULL, eventMsgs, otaconfigEVENT_BATCH_SIZE, &numEvents, 0 );
+        }
+        else
+        {
+            osErr = otaAgent.pOtaInterface->os.event.recv( NULL, &eventMsgs[ 0 ], 0 );
+            numEvents = 1U;
+        }
+
+        if( numEvents > otaconfigEVENT_BATCH_SIZE )
+        {
+            numEvents = otaconfigEVENT_BATCH_SIZE;
+        }
+
+        if( osErr == OtaOsSuccess )
+        {
+            ( void ) exchangeFlag( &eventsProcessing, true );
+            processOtaEvents( eventMsgs, numEvents );
+            ( void ) exchangeFlag( &eventsProcessing, false );
+        }
+    }
+}
+
+static void processOtaEvents( OtaEventMsg_t * pEventMsgs,
+                              uint32_t numEvents )
+{
+    uint32_t i = 0;
+
+    for( i = 0U; i < numEvents; i++ )
+    {
+        if( eventInstanceStale( &pEventMsgs[ i ] ) == true )
+        {
+            /* The instance was shut down after the event was signaled, its
+             * context may be reused, so the event is not switched to it. */
+            LogWarn( ( "Dropped the event of an agent instance shut down: "
+                       "Event=[%s]",
+                       pOtaEventStrings[ pEventMsgs[ i ].eventId ] ) );
+        }
+        else
+        {
+            switchAgent( pEventMsgs[ i ].pAgentCtx );
+
+            #if ( otaconfigLATENCY_STATS == 1U )
+                recordLatency( OtaLatencyQueueWait, pEventMsgs[ i ].timestamp );
+            #endif
+
+            /* The events received with the one that stopped the agent, and
+             * those of an instance shut down, are not processed, but their
+             * buffers are released. */
+            if( ( pOtaAgent->state == OtaAgentStateStopped ) && ( ( i > 0U ) || ( pOtaAgent != &otaAgent ) ) )
+            {
+                handleUnexpectedEvents( &pEventMsgs[ i ] );
+            }
+            else
+            {
+                processOtaEvent( &pEventMsgs[ i ] );
+            }
+        }
+    }
+
+    switchAgent( NULL );
+}
+
+void OTA_EventProcessingTask( void * pUnused )
+{
+    ( void ) pUnused;
+
+    /*
+     * OTA Agent is ready to receive and process events so update the state to ready.
+     */
+    otaAgent.state = OtaAgentStateReady;
+
+    while( otaAgent.state != OtaAgentStateStopped )
+    {
+        receiveAndProcessOtaEvent();
+    }
+}
+
+static uint32_t pollOtaEvents( uint32_t maxEvents )
+{
+    OtaEventMsg_t eventMsgs[ otaconfigEVENT_BATCH_SIZE ] = { 0 };
+    OtaOsStatus_t osErr = OtaOsSuccess;
+    uint32_t numEvents = 0;
+    uint32_t numProcessed = 0;
+    uint32_t batchSize = 0;
+    bool polling = true;
+
+    while( ( polling == true ) && ( numProcessed < maxEvents ) && ( otaAgent.state != OtaAgentStateStopped ) )
+    {
+        batchSize = maxEvents - numProcessed;
+
+        if( batchSize > otaconfigEVENT_BATCH_SIZE )
+        {
+            batchSize = otaconfigEVENT_BATCH_SIZE;
+        }
 
-    err = otaTransitionTable[ index ].handler( pEventMsg->pEventData );
+        numEvents = 0U;
+        osErr = otaAgent.pOtaInterface->os.event.poll( NULL, eventMsgs, batchSize, &numEvents );
 
-    if( err == OtaErrNone )
-    {
-        LogDebug( ( "Executing handler for state transition: " ) );
+        if( numEvents > batchSize )
+        {
+            numEvents = batchSize;
+        }
 
-        /*
-         * Update the current state in OTA agent context.
-         */
-        otaAgent.state = otaTransitionTable[ index ].nextState;
-    }
-    else
-    {
-        LogDebug( ( "Failed to execute state transition handler: "
-                    "Handler returned error: OtaErr_t=%s",
-                    OTA_Err_strerror( err ) ) );
+        if( ( osErr != OtaOsSuccess ) || ( numEvents == 0U ) )
+        {
+            polling = false;
+        }
+        else
+        {
+            processOtaEvents( eventMsgs, numEvents );
+            numProcessed += numEvents;
+        }
     }
 
-    LogInfo( ( "Current State=[%s]"
-               ", Event=[%s]"
-               ", New state=[%s]",
-               pOtaAgentStateStrings[ otaAgent.state ],
-               pOtaEventStrings[ pEventMsg->eventId ],
-               pOtaAgentStateStrings[ otaTransitionTable[ index ].nextState ] ) );
+    return numProcessed;
 }
 
-static uint32_t searchTransition( const OtaEventMsg_t * pEventMsg )
+uint32_t OTA_Poll( uint32_t maxEvents )
 {
-    uint32_t transitionTableLen = ( uint32_t ) ( sizeof( otaTransitionTable ) / sizeof( otaTransitionTable[ 0 ] ) );
-    uint32_t i = 0;
+    uint32_t numProcessed = 0;
 
-    for( i = 0; i < transitionTableLen; i++ )
+    if( ( otaAgent.state == OtaAgentStateStopped ) || ( otaAgent.pOtaInterface == NULL ) ||
+        ( otaAgent.pOtaInterface->os.event.poll == NULL ) )
+    {
+        LogError( ( "Failed to poll events: "
+                    "The agent is not initialized, or the OS interface can't poll events." ) );
+    }
+    else if( exchangeFlag( &eventsProcessing, true ) == true )
+    {
+        LogError( ( "Failed to poll events: The agent is processing events." ) );
+    }
+    else
     {
-        if( ( ( otaTransitionTable[ i ].currentState == otaAgent.state ) ||
-              ( otaTransitionTable[ i ].currentState == OtaAgentStateAll ) ) &&
-            ( otaTransitionTable[ i ].eventId == pEventMsg->eventId ) )
+        /* The agent is run by the caller from now on, as it would be by the agent task. */
+        if( otaAgent.state == OtaAgentStateInit )
         {
-            break;
+            otaAgent.state = OtaAgentStateReady;
         }
+
+        ( void ) exchangeFlag( &eventsPolled, true );
+        numProcessed = pollOtaEvents( maxEvents );
+        ( void ) exchangeFlag( &eventsProcessing, false );
     }
 
-    return i;
+    return numProcessed;
 }
 
-static void receiveAndProcessOtaEvent( void )
+bool OTA_ProcessEvent( const OtaEventMsg_t * const pEventMsg )
 {
+    return OTA_InstanceProcessEvent( &otaAgent, pEventMsg );
+}
+
+bool OTA_InstanceProcessEvent( OtaAgentContext_t * pAgentCtx,
+                               const OtaEventMsg_t * const pEventMsg )
+{
+    bool retVal = false;
+    bool queueEmpty = false;
     OtaEventMsg_t eventMsg = { 0 };
-    uint32_t i = 0;
-    uint32_t transitionTableLen = ( uint32_t ) ( sizeof( otaTransitionTable ) / sizeof( otaTransitionTable[ 0 ] ) );
 
-    if( otaAgent.pOtaInterface == NULL )
+    if( ( pAgentCtx == NULL ) || ( pEventMsg == NULL ) )
     {
-        LogError( ( "Failed to receive event: OS Interface not set" ) );
+        LogError( ( "Failed to process event: Invalid parameters." ) );
+    }
+    else if( ( loadFlag( &eventsPolled ) == false ) || ( exchangeFlag( &eventsProcessing, true ) == true ) )
+    {
+        /* Called while the agent is not run with OTA_Poll, back from the
+         * agent while it processes an event, or from another task while the
+         * events are polled, so the event waits in the queue. */
+        retVal = OTA_InstanceSignalEvent( pAgentCtx, pEventMsg );
     }
     else
     {
-        /*
-         * Receive the next event from the OTA event queue to process.
-         */
-        if( otaAgent.pOtaInterface->os.event.recv( NULL, &eventMsg, 0 ) == OtaOsSuccess )
-        {
-            /*
-             * Search transition index if available in the table.
-             */
-            i = searchTransition( &eventMsg );
+        /* The events waiting in the queue were signaled first, so they are
+         * processed first, to keep the blocks and the control events in order.
+         * Only a batch of them is processed, so that the work done from the
+         * callback of the caller is bounded, the queue is empty if the batch
+         * is not full. */
+        queueEmpty = ( pollOtaEvents( otaconfigEVENT_BATCH_SIZE ) < otaconfigEVENT_BATCH_SIZE );
 
-            if( i < transitionTableLen )
-            {
-                LogDebug( ( "Found valid event handler for state transition: "
-                            "State=[%s], "
-                            "Event=[%s]",
-                            pOtaAgentStateStrings[ otaAgent.state ],
-                            pOtaEventStrings[ eventMsg.eventId ] ) );
+        if( ( otaAgent.state == OtaAgentStateStopped ) || ( pAgentCtx->state == OtaAgentStateStopped ) )
+        {
+            LogError( ( "Failed to process event: The agent is stopped." ) );
+        }
+        else if( queueEmpty == false )
+        {
+            /* Events may still wait in the queue, the event waits behind them. */
+            retVal = OTA_InstanceSignalEvent( pAgentCtx, pEventMsg );
+        }
+        else
+        {
+            eventMsg = *pEventMsg;
+            eventMsg.pAgentCtx = ( pAgentCtx != &otaAgent ) ? pAgentCtx : NULL;
 
-                /*
-                 * Execute the handler function.
-                 */
-                executeHandler( i, &eventMsg );
-            }
+            #if ( otaconfigLATENCY_STATS == 1U )
+                eventMsg.timestamp = otaconfigLATENCY_TIMESTAMP();
+            #endif
 
-            if( i == transitionTableLen )
+            /* No queue to go through, the block is queued and processed at once. */
+            if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
             {
-                /*
-                 * Handle unexpected events.
-                 */
-                handleUnexpectedEvents( &eventMsg );
+                pAgentCtx->statistics.otaPacketsReceived++;
+                pAgentCtx->statistics.otaPacketsQueued++;
             }
+
+            processOtaEvents( &eventMsg, 1U );
+            retVal = true;
         }
+
+        ( void ) exchangeFlag( &eventsProcessing, false );
     }
+
+    return retVal;
 }
 
-void OTA_EventProcessingTask( void * pUnused )
+bool OTA_SignalEvent( const OtaEventMsg_t * const pEventMsg )
 {
-    ( void ) pUnused;
-
-    /*
-     * OTA Agent is ready to receive and process events so update the state to ready.
-     */
-    otaAgent.state = OtaAgentStateReady;
-
-    while( otaAgent.state != OtaAgentStateStopped )
-    {
-        receiveAndProcessOtaEvent();
-    }
+    return OTA_InstanceSignalEvent( &otaAgent, pEventMsg );
 }
 
-bool OTA_SignalEvent( const OtaEventMsg_t * const pEventMsg )
+bool OTA_InstanceSignalEvent( OtaAgentContext_t * pAgentCtx,
+                              const OtaEventMsg_t * const pEventMsg )
 {
     bool retVal = false;
     OtaOsStatus_t err = OtaOsSuccess;
+    OtaEventMsg_t eventMsg = { 0 };
 
-    /* Check if file block received and update statistics.*/
-    if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
+    if( ( pAgentCtx == NULL ) || ( pEventMsg == NULL ) )
+    {
+        LogError( ( "Failed to signal event: Invalid parameters." ) );
+    }
+    else if( ( otaAgent.state == OtaAgentStateStopped ) || ( pAgentCtx->state == OtaAgentStateStopped ) )
     {
-        otaAgent.statistics.otaPacketsReceived++;
+        /* No task receives the events of a stopped agent. */
+        LogError( ( "Failed to signal event: The agent is stopped." ) );
     }
+    else
+    {
+        eventMsg = *pEventMsg;
 
-    err = otaAgent.pOtaInterface->os.event.send( NULL, pEventMsg, 0 );
+        /* Tag the event with the instance it is for, the agent task receives the
+         * events of all the instances from the same queue. */
+        eventMsg.pAgentCtx = ( pAgentCtx != &otaAgent ) ? pAgentCtx : NULL;
 
-    if( err == OtaOsSuccess )
-    {
-        retVal = true;
-        LogDebug( ( "Added event message to OTA event queue." ) );
+        #if ( otaconfigLATENCY_STATS == 1U )
+            eventMsg.timestamp = otaconfigLATENCY_TIMESTAMP();
+        #endif
+
+        #if ( otaconfigMAX_NUM_AGENTS > 1U )
+            if( pAgentCtx->agentIndex < otaconfigMAX_NUM_AGENTS )
+            {
+                eventMsg.generation = agentGenerations[ pAgentCtx->agentIndex ];
+            }
+        #endif
 
+        /* Check if file block received and update statistics.*/
         if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
         {
-            otaAgent.statistics.otaPacketsQueued++;
+            pAgentCtx->statistics.otaPacketsReceived++;
         }
-    }
-    else
-    {
-        retVal = false;
-        LogError( ( "Failed to add even message to OTA event queue: "
-                    "send returned error: "
-                    "OtaOsStatus_t=%s",
-                    OTA_OsStatus_strerror( err ) ) );
 
-        if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
+        err = otaAgent.pOtaInterface->os.event.send( NULL, &eventMsg, 0 );
+
+        if( err == OtaOsSuccess )
+        {
+            retVal = true;
+            LogDebug( ( "Added event message to OTA event queue." ) );
+
+            if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
+            {
+                pAgentCtx->statistics.otaPacketsQueued++;
+            }
+        }
+        else
         {
-            otaAgent.statistics.otaPacketsDropped++;
+            retVal = false;
+            LogError( ( "Failed to add even message to OTA event queue: "
+                        "send returned error: "
+                        "OtaOsStatus_t=%s",
+                        OTA_OsStatus_strerror( err ) ) );
+
+            if( pEventMsg->eventId == OtaAgentEventReceivedFileBlock )
+            {
+                pAgentCtx->statistics.otaPacketsDropped++;
+            }
         }
     }
 
     return retVal;
 }
 
-static void initializeAppBuffers( OtaAppBuffer_t * pOtaBuffer )
+static void initializeAppBuffers( OtaAgentContext_t * pAgentCtx,
+                                  OtaAppBuffer_t * pOtaBuffer )
 {
     /* Initialize update file path buffer from application buffer.*/
     if( ( pOtaBuffer->pUpdateFilePath != NULL ) && ( pOtaBuffer->updateFilePathsize > 0u ) )
     {
-        otaAgent.fileContext.pFilePath = pOtaBuffer->pUpdateFilePath;
-        otaAgent.fileContext.filePathMaxSize = pOtaBuffer->updateFilePathsize;
+        pAgentCtx->fileContext.pFilePath = pOtaBuffer->pUpdateFilePath;
+        pAgentCtx->fileContext.filePathMaxSize = pOtaBuffer->updateFilePathsize;
     }
     else
     {
-        otaAgent.fileContext.filePathMaxSize = 0;
+        pAgentCtx->fileContext.filePathMaxSize = 0;
     }
 
     /* Initialize certificate file path buffer from application buffer.*/
     if( ( pOtaBuffer->pCertFilePath != NULL ) && ( pOtaBuffer->certFilePathSize > 0u ) )
     {
-        otaAgent.fileContext.pCertFilepath = pOtaBuffer->pCertFilePath;
-        otaAgent.fileContext.certFilePathMaxSize = pOtaBuffer->certFilePathSize;
+        pAgentCtx->fileContext.pCertFilepath = pOtaBuffer->pCertFilePath;
+        pAgentCtx->fileContext.certFilePathMaxSize = pOtaBuffer->certFilePathSize;
     }
     else
     {
-        otaAgent.fileContext.certFilePathMaxSize = 0;
+        pAgentCtx->fileContext.certFilePathMaxSize = 0;
     }
 
     /* Initialize stream name buffer from application buffer.*/
     if( ( pOtaBuffer->pStreamName != NULL ) && ( pOtaBuffer->streamNameSize > 0u ) )
     {
-        otaAgent.fileContext.pStreamName = pOtaBuffer->pStreamName;
-        otaAgent.fileContext.streamNameMaxSize = pOtaBuffer->streamNameSize;
+        pAgentCtx->fileContext.pStreamName = pOtaBuffer->pStreamName;
+        pAgentCtx->fileContext.streamNameMaxSize = pOtaBuffer->streamNameSize;
     }
     else
     {
-        otaAgent.fileContext.streamNameMaxSize = 0;
+        pAgentCtx->fileContext.streamNameMaxSize = 0;
     }
 
     /* Initialize file bitmap buffer from application buffer.*/
     if( ( pOtaBuffer->pDecodeMemory != NULL ) && ( pOtaBuffer->decodeMemorySize > 0u ) )
     {
-        otaAgent.fileContext.pDecodeMem = pOtaBuffer->pDecodeMemory;
-        otaAgent.fileContext.decodeMemMaxSize = pOtaBuffer->decodeMemorySize;
+        pAgentCtx->fileContext.pDecodeMem = pOtaBuffer->pDecodeMemory;
+        pAgentCtx->fileContext.decodeMemMaxSize = pOtaBuffer->decodeMemorySize;
     }
     else
     {
-        otaAgent.fileContext.decodeMemMaxSize = 0;
+        pAgentCtx->fileContext.decodeMemMaxSize = 0;
     }
 
     /* Initialize file bitmap buffer from application buffer.*/
     if( ( pOtaBuffer->pFileBitmap != NULL ) && ( pOtaBuffer->fileBitmapSize > 0u ) )
     {
-        otaAgent.fileContext.pRxBlockBitmap = pOtaBuffer->pFileBitmap;
-        otaAgent.fileContext.blockBitmapMaxSize = pOtaBuffer->fileBitmapSize;
+        pAgentCtx->fileContext.pRxBlockBitmap = pOtaBuffer->pFileBitmap;
+        pAgentCtx->fileContext.blockBitmapMaxSize = pOtaBuffer->fileBitmapSize;
     }
     else
     {
-        otaAgent.fileContext.blockBitmapMaxSize = 0;
+        pAgentCtx->fileContext.blockBitmapMaxSize = 0;
     }
 
     /* Initialize url buffer from application buffer.*/
     if( ( pOtaBuffer->pUrl != NULL ) && ( pOtaBuffer->urlSize > 0u ) )
     {
-        otaAgent.fileContext.pUpdateUrlPath = pOtaBuffer->pUrl;
-        otaAgent.fileContext.updateUrlMaxSize = pOtaBuffer->urlSize;
+        pAgentCtx->fileContext.pUpdateUrlPath = pOtaBuffer->pUrl;
+        pAgentCtx->fileContext.updateUrlMaxSize = pOtaBuffer->urlSize;
     }
     else
     {
-        otaAgent.fileContext.updateUrlMaxSize = 0;
+        pAgentCtx->fileContext.updateUrlMaxSize = 0;
     }
 
     /* Initialize auth scheme buffer from application buffer.*/
     if( ( pOtaBuffer->pAuthScheme != NULL ) && ( pOtaBuffer->authSchemeSize > 0u ) )
     {
-        otaAgent.fileContext.pAuthScheme = pOtaBuffer->pAuthScheme;
-        otaAgent.fileContext.authSchemeMaxSize = pOtaBuffer->authSchemeSize;
+        pAgentCtx->fileContext.pAuthScheme = pOtaBuffer->pAuthScheme;
+        pAgentCtx->fileContext.authSchemeMaxSize = pOtaBuffer->authSchemeSize;
     }
     else
     {
-        otaAgent.fileContext.authSchemeMaxSize = 0;
+        pAgentCtx->fileContext.authSchemeMaxSize = 0;
     }
 }
 
-static void initializeLocalBuffers( void )
+static void initializeLocalBuffers( OtaAgentContext_t * pAgentCtx )
 {
     /* Initialize JOB Id buffer .*/
-    otaAgent.fileContext.pJobName = pJobNameBuffer;
-    otaAgent.fileContext.jobNameMaxSize = ( uint16_t ) sizeof( pJobNameBuffer );
+    pAgentCtx->fileContext.pJobName = pAgentCtx->pJobNameBuffer;
+    pAgentCtx->fileContext.jobNameMaxSize = ( uint16_t ) sizeof( pAgentCtx->pJobNameBuffer );
 
     /* Initialize protocol buffers .*/
-    otaAgent.fileContext.pProtocols = pProtocolBuffer;
-    otaAgent.fileContext.protocolMaxSize = ( uint16_t ) sizeof( pProtocolBuffer );
+    pAgentCtx->fileContext.pProtocols = pAgentCtx->pProtocolBuffer;
+    pAgentCtx->fileContext.protocolMaxSize = ( uint16_t ) sizeof( pAgentCtx->pProtocolBuffer );
+
+    pAgentCtx->fileContext.pSignature = &pAgentCtx->sig256Buffer;
+}
+
+static OtaErr_t initAgentContext( OtaAgentContext_t * pAgentCtx,
+                                  OtaAppBuffer_t * pOtaBuffer,
+                                  OtaInterfaces_t * pOtaInterfaces,
+                                  const uint8_t * pThingName,
+                                  OtaAppCallback_t OtaAppCallback )
+{
+    OtaErr_t returnStatus = OtaErrUninitialized;
+
+    /*
+     * Reset all the statistics counters.
+     */
+    pAgentCtx->statistics.otaPacketsReceived = 0;
+    pAgentCtx->statistics.otaPacketsDropped = 0;
+    pAgentCtx->statistics.otaPacketsQueued = 0;
+    pAgentCtx->statistics.otaPacketsProcessed = 0;
+
+    #if ( otaconfigLATENCY_STATS == 1U )
+        ( void ) memset( &( pAgentCtx->latency ), 0, sizeof( pAgentCtx->latency ) );
+    #endif
+
+    /* The block size is adapted to the link again from the largest one. */
+    pAgentCtx->log2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE;
+    pAgentCtx->requestTimeouts = 0;
+
+    #if ( otaconfigJOB_ARENA_SIZE > 0U )
+        /* Each instance takes the buffers of its jobs from its own arena. */
+        pAgentCtx->jobArena.pBase = JOB_ARENA_STORAGE( pAgentCtx );
+        pAgentCtx->jobArena.size = otaconfigJOB_ARENA_SIZE;
+        pAgentCtx->jobArena.used = 0U;
+    #endif
+
+    /*
+     * Initialize OTA interfaces in OTA Agent context..
+     */
+    pAgentCtx->pOtaInterface = pOtaInterfaces;
+
+    /* Initialize application buffers. */
+    initializeAppBuffers( pAgentCtx, pOtaBuffer );
+
+    /* Initialize local buffers. */
+    initializeLocalBuffers( pAgentCtx );
+
+    /* Initialize ota application callback.*/
+    pAgentCtx->OtaAppCallback = OtaAppCallback;
+
+    /*
+     * The current OTA image state as set by the OTA agent.
+     */
+    pAgentCtx->imageState = OtaImageStateUnknown;
+
+    if( pThingName == NULL )
+    {
+        LogError( ( "Error: Thing name is NULL.\r\n" ) );
+    }
+    else
+    {
+        uint32_t strLength = ( uint32_t ) ( strlen( ( const char * ) pThingName ) );
+
+        if( strLength <= otaconfigMAX_THINGNAME_LEN )
+        {
+            /*
+             * Store the Thing name to be used for topics later. Include zero terminator
+             * when saving the Thing name.
+             */
+            ( void ) memcpy( pAgentCtx->pThingName, pThingName, strLength + 1UL );
+
+            /* The cached topics were rendered with the previous Thing name. */
+            ( void ) memset( &( pAgentCtx->requestCache ), 0, sizeof( pAgentCtx->requestCache ) );
+            returnStatus = OtaErrNone;
+        }
+        else
+        {
+            LogError( ( "Error: Thing name is too long.\r\n" ) );
+        }
+    }
 
-    otaAgent.fileContext.pSignature = &sig256Buffer;
+    return returnStatus;
 }
 
 /*
@@ -3080,61 +6202,27 @@ OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
          */
         setControlInterface( &otaControlInterface );
 
-        /*
-         * Reset all the statistics counters.
-         */
-        otaAgent.statistics.otaPacketsReceived = 0;
-        otaAgent.statistics.otaPacketsDropped = 0;
-        otaAgent.statistics.otaPacketsQueued = 0;
-        otaAgent.statistics.otaPacketsProcessed = 0;
-
-        /*
-         * Initialize OTA interfaces in OTA Agent context..
-         */
-        otaAgent.pOtaInterface = pOtaInterfaces;
-
-        /* Initialize application buffers. */
-        initializeAppBuffers( pOtaBuffer );
+        /* Put all the event buffers of the pool back in the free list, unless
+         * the instances still running hold some of them. */
+        if( instancesRunning() == false )
+        {
+            OTA_EventBufferInit();
+        }
 
-        /* Initialize local buffers. */
-        initializeLocalBuffers();
+        /* Run by the agent task until OTA_Poll is called. */
+        ( void ) exchangeFlag( &eventsPolled, false );
 
-        /* Initialize ota application callback.*/
-        otaAgent.OtaAppCallback = OtaAppCallback;
+        /* Index the state transitions, so that each event is dispatched in constant time. */
+        initTransitionIndex();
 
-        /*
-         * The current OTA image state as set by the OTA agent.
-         */
-        otaAgent.imageState = OtaImageStateUnknown;
+        /* Initialize the context of the agent. */
+        returnStatus = initAgentContext( &otaAgent, pOtaBuffer, pOtaInterfaces, pThingName, OtaAppCallback );
 
         /*
          * Initialize OTA event interface.
          */
         ( void ) otaAgent.pOtaInterface->os.event.init( NULL );
 
-        if( pThingName == NULL )
-        {
-            LogError( ( "Error: Thing name is NULL.\r\n" ) );
-        }
-        else
-        {
-            uint32_t strLength = ( uint32_t ) ( strlen( ( const char * ) pThingName ) );
-
-            if( strLength <= otaconfigMAX_THINGNAME_LEN )
-            {
-                /*
-                 * Store the Thing name to be used for topics later. Include zero terminator
-                 * when saving the Thing name.
-                 */
-                ( void ) memcpy( otaAgent.pThingName, pThingName, strLength + 1UL );
-                returnStatus = OtaErrNone;
-            }
-            else
-            {
-                LogError( ( "Error: Thing name is too long.\r\n" ) );
-            }
-        }
-
         if( returnStatus == OtaErrNone )
         {
             /* OTA Task is not running yet so update the state to init directly in OTA context. */
@@ -3145,6 +6233,11 @@ OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
     else
     {
         ( void ) memset( &otaAgent.statistics, 0, sizeof( otaAgent.statistics ) );
+
+        #if ( otaconfigLATENCY_STATS == 1U )
+            ( void ) memset( &otaAgent.latency, 0, sizeof( otaAgent.latency ) );
+        #endif
+
         returnStatus = OtaErrNone;
     }
 
@@ -3156,6 +6249,13 @@ OtaErr_t OTA_Init( OtaAppBuffer_t * pOtaBuffer,
  */
 OtaState_t OTA_Shutdown( uint32_t ticksToWait,
                          uint8_t unsubscribeFlag )
+{
+    return shutdownAgent( &otaAgent, ticksToWait, unsubscribeFlag );
+}
+
+static OtaState_t shutdownAgent( OtaAgentContext_t * pAgentCtx,
+                                 uint32_t ticksToWait,
+                                 uint8_t unsubscribeFlag )
 {
     OtaEventMsg_t eventMsg = { 0 };
     uint32_t ticks = ticksToWait;
@@ -3164,15 +6264,15 @@ OtaState_t OTA_Shutdown( uint32_t ticksToWait,
                 "ticks=%u",
                 ticks ) );
 
-    if( otaAgent.state == OtaAgentStateInit )
+    if( pAgentCtx->state == OtaAgentStateInit )
     {
         /* When in init state, the OTA state machine is not running yet. So directly set state to
          * stopped. */
-        otaAgent.state = OtaAgentStateStopped;
+        pAgentCtx->state = OtaAgentStateStopped;
     }
-    else if( ( otaAgent.state != OtaAgentStateStopped ) && ( otaAgent.state != OtaAgentStateShuttingDown ) ) /* LCOV_EXCL_BR_LINE */
+    else if( ( pAgentCtx->state != OtaAgentStateStopped ) && ( pAgentCtx->state != OtaAgentStateShuttingDown ) ) /* LCOV_EXCL_BR_LINE */
     {
-        otaAgent.unsubscribeOnShutdown = unsubscribeFlag;
+        pAgentCtx->unsubscribeOnShutdown = unsubscribeFlag;
 
         /*
          * Send shutdown signal to OTA Agent task.
@@ -3180,7 +6280,7 @@ OtaState_t OTA_Shutdown( uint32_t ticksToWait,
         eventMsg.eventId = OtaAgentEventShutdown;
 
         /* Send signal to OTA task. */
-        if( OTA_SignalEvent( &eventMsg ) == false )
+        if( OTA_InstanceSignalEvent( pAgentCtx, &eventMsg ) == false )
         {
             LogError( ( "Failed to signal the OTA Agent to shutdown: "
                         "OTA_SignalEvent returned false." ) );
@@ -3190,7 +6290,7 @@ OtaState_t OTA_Shutdown( uint32_t ticksToWait,
             /*
              * Wait for the OTA agent to complete shutdown, if requested.
              */
-            while( ( ticks > 0U ) && ( otaAgent.state != OtaAgentStateStopped ) ) /* LCOV_EXCL_BR_LINE */
+            while( ( ticks > 0U ) && ( pAgentCtx->state != OtaAgentStateStopped ) ) /* LCOV_EXCL_BR_LINE */
             {
                 ticks--;
             }
@@ -3200,14 +6300,14 @@ OtaState_t OTA_Shutdown( uint32_t ticksToWait,
     {
         LogDebug( ( "Ignoring request to shutdown OTA Agent: "
                     "OTA Agent is already in state [%s]",
-                    pOtaAgentStateStrings[ otaAgent.state ] ) );
+                    pOtaAgentStateStrings[ pAgentCtx->state ] ) );
     }
 
     LogDebug( ( "Number of ticks remaining when OTA Agent shutdown: "
                 "ticks=%u",
                 ticks ) );
 
-    return otaAgent.state;
+    return pAgentCtx->state;
 }
 
 /*
@@ -3218,6 +6318,16 @@ OtaState_t OTA_GetState( void )
     return otaAgent.state;
 }
 
+/*
+ * Return the current state of an agent instance.
+ */
+OtaState_t OTA_InstanceGetState( const OtaAgentContext_t * pAgentCtx )
+{
+    assert( pAgentCtx != NULL );
+
+    return pAgentCtx->state;
+}
+
 /*
  * Return the details of the packets received.
  */
@@ -3234,7 +6344,77 @@ OtaErr_t OTA_GetStatistics( OtaAgentStatistics_t * pStatistics )
     return err;
 }
 
+#if ( otaconfigLATENCY_STATS == 1U )
+    OtaErr_t OTA_GetLatencyStatistics( OtaLatencyStatistics_t * pStatistics )
+    {
+        OtaErr_t err = OtaErrInvalidArg;
+
+        if( pStatistics != NULL )
+        {
+            *pStatistics = otaAgent.latency;
+            err = OtaErrNone;
+        }
+
+        return err;
+    }
+#endif
+
+OtaErr_t OTA_AddFileSink( OtaFileContext_t * pFileSink )
+{
+    return addFileSink( &otaAgent, pFileSink );
+}
+
+static OtaErr_t addFileSink( OtaAgentContext_t * pAgentCtx,
+                             OtaFileContext_t * pFileSink )
+{
+    OtaErr_t err = OtaErrInvalidArg;
+
+    #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+        if( pFileSink == NULL )
+        {
+            LogError( ( "Failed to add file sink: Invalid argument." ) );
+        }
+        else if( pAgentCtx->fileContext.pFile != NULL )
+        {
+            LogError( ( "Failed to add file sink: A file is being received." ) );
+        }
+        else if( pAgentCtx->numFileSinks >= otaconfigMAX_NUM_FILE_SINKS )
+        {
+            LogError( ( "Failed to add file sink: "
+                        "All the sinks are added: "
+                        "otaconfigMAX_NUM_FILE_SINKS=%u",
+                        ( unsigned ) otaconfigMAX_NUM_FILE_SINKS ) );
+        }
+        else
+        {
+            /* The files of the sinks are created with the file of the next job. */
+            pFileSink->pFile = NULL;
+
+            if( pFileSink->blockBitmapMaxSize == 0u )
+            {
+                pFileSink->pRxBlockBitmap = NULL;
+            }
+
+            pAgentCtx->pFileSinks[ pAgentCtx->numFileSinks ] = pFileSink;
+            pAgentCtx->numFileSinks++;
+            err = OtaErrNone;
+        }
+    #else /* if ( otaconfigMAX_NUM_FILE_SINKS > 0U ) */
+        ( void ) pAgentCtx;
+        ( void ) pFileSink;
+
+        LogError( ( "Failed to add file sink: otaconfigMAX_NUM_FILE_SINKS is 0." ) );
+    #endif /* if ( otaconfigMAX_NUM_FILE_SINKS > 0U ) */
+
+    return err;
+}
+
 OtaErr_t OTA_CheckForUpdate( void )
+{
+    return OTA_InstanceCheckForUpdate( &otaAgent );
+}
+
+OtaErr_t OTA_InstanceCheckForUpdate( OtaAgentContext_t * pAgentCtx )
 {
     OtaErr_t retVal = OtaErrNone;
     OtaEventMsg_t eventMsg = { 0 };
@@ -3246,7 +6426,7 @@ OtaErr_t OTA_CheckForUpdate( void )
      */
     eventMsg.eventId = OtaAgentEventRequestJobDocument;
 
-    if( OTA_SignalEvent( &eventMsg ) == false )
+    if( OTA_InstanceSignalEvent( pAgentCtx, &eventMsg ) == false )
     {
         retVal = OtaErrSignalEventFailed;
     }
@@ -3321,7 +6501,7 @@ OtaErr_t OTA_SetImageState( OtaImageState_t state )
             /*
              * Set the image state as rejected.
              */
-            err = setImageStateWithReason( state, 0U );
+            err = setImageStateWithReason( &otaAgent, state, 0U );
 
             break;
 
@@ -3330,7 +6510,7 @@ OtaErr_t OTA_SetImageState( OtaImageState_t state )
             /*
              * Set the image state as accepted.
              */
-            err = setImageStateWithReason( state, 0U );
+            err = setImageStateWithReason( &otaAgent, state, 0U );
 
             break;
 
@@ -3372,7 +6552,7 @@ OtaErr_t OTA_Suspend( void )
     if( otaAgent.state != OtaAgentStateStopped )
     {
         /* Stop the request timer. */
-        ( void ) otaAgent.pOtaInterface->os.timer.stop( OtaRequestTimer );
+        ( void ) otaAgent.pOtaInterface->os.timer.stop( agentTimerId( &otaAgent, OtaRequestTimer ) );
 
         /*
          * Send event to OTA agent task.
@@ -3423,6 +6603,115 @@ OtaErr_t OTA_Resume( void )
     return err;
 }
 
+/*
+ * Public API to start an additional agent instance, run by the task of the
+ * agent started by OTA_Init.
+ */
+OtaErr_t OTA_InstanceInit( OtaAgentContext_t * pAgentCtx,
+                           OtaAppBuffer_t * pOtaBuffer,
+                           OtaInterfaces_t * pOtaInterfaces,
+                           const uint8_t * pThingName,
+                           OtaAppCallback_t OtaAppCallback )
+{
+    OtaErr_t returnStatus = OtaErrInvalidArg;
+    uint32_t agentIndex = otaconfigMAX_NUM_AGENTS;
+    uint32_t index = 0;
+
+    if( ( pAgentCtx == NULL ) || ( pAgentCtx == &otaAgent ) || ( pOtaBuffer == NULL ) || ( pOtaInterfaces == NULL ) )
+    {
+        LogError( ( "Failed to start OTA agent instance: Invalid argument." ) );
+    }
+    else if( otaAgent.state == OtaAgentStateStopped )
+    {
+        returnStatus = OtaErrAgentStopped;
+
+        LogError( ( "Failed to start OTA agent instance: "
+                    "The agent running the instances is stopped: "
+                    "OtaErr_t=%s",
+                    OTA_Err_strerror( returnStatus ) ) );
+    }
+    else
+    {
+        /* Keep the index of an instance already running, or take the first free one. */
+        for( index = 1U; index < otaconfigMAX_NUM_AGENTS; index++ )
+        {
+            if( pOtaAgents[ index ] == pAgentCtx )
+            {
+                agentIndex = index;
+            }
+        }
+
+        for( index = 1U; ( index < otaconfigMAX_NUM_AGENTS ) && ( agentIndex == otaconfigMAX_NUM_AGENTS ); index++ )
+        {
+            if( pOtaAgents[ index ] == NULL )
+            {
+                agentIndex = index;
+            }
+        }
+
+        if( agentIndex == otaconfigMAX_NUM_AGENTS )
+        {
+            LogError( ( "Failed to start OTA agent instance: "
+                        "All the instances are running: "
+                        "otaconfigMAX_NUM_AGENTS=%u",
+                        ( unsigned ) otaconfigMAX_NUM_AGENTS ) );
+        }
+        else if( pOtaAgents[ agentIndex ] == pAgentCtx )
+        {
+            /* The instance is already running, just reset the statistics. */
+            ( void ) memset( &pAgentCtx->statistics, 0, sizeof( pAgentCtx->statistics ) );
+            returnStatus = OtaErrNone;
+        }
+        else
+        {
+            /* Start from the same context as the agent started by OTA_Init. */
+            ( void ) memset( pAgentCtx, 0, sizeof( *pAgentCtx ) );
+            pAgentCtx->agentIndex = agentIndex;
+            pAgentCtx->numOfBlocksToReceive = 1U;
+            pAgentCtx->unsubscribeOnShutdown = 1U;
+
+            returnStatus = initAgentContext( pAgentCtx, pOtaBuffer, pOtaInterfaces, pThingName, OtaAppCallback );
+
+            if( returnStatus == OtaErrNone )
+            {
+                #if ( otaconfigMAX_NUM_AGENTS > 1U )
+                    ( void ) memset( &otaDataInterfaces[ agentIndex ], 0, sizeof( otaDataInterfaces[ agentIndex ] ) );
+                #endif
+
+                /* The task of the agent started by OTA_Init is running the instance, it
+                 * is ready to receive events. */
+                pAgentCtx->state = OtaAgentStateReady;
+                pOtaAgents[ agentIndex ] = pAgentCtx;
+            }
+        }
+    }
+
+    return returnStatus;
+}
+
+/*
+ * Public API to shutdown an agent instance.
+ */
+OtaState_t OTA_InstanceShutdown( OtaAgentContext_t * pAgentCtx,
+                                 uint32_t ticksToWait,
+                                 uint8_t unsubscribeFlag )
+{
+    assert( pAgentCtx != NULL );
+
+    return shutdownAgent( pAgentCtx, ticksToWait, unsubscribeFlag );
+}
+
+/*
+ * Public API to add a file sink to an agent instance.
+ */
+OtaErr_t OTA_InstanceAddFileSink( OtaAgentContext_t * pAgentCtx,
+                                  OtaFileContext_t * pFileSink )
+{
+    assert( pAgentCtx != NULL );
+
+    return addFileSink( pAgentCtx, pFileSink );
+}
+
 /*-----------------------------------------------------------*/
 
 const char * OTA_Err_strerror( OtaErr_t err )
@@ -27,6 +27,7 @@
 
 #include "ota_base64_private.h"
 #include <assert.h>
+#include <stdbool.h>
 
 /**
  * @brief Number to represent both line feed and carriage return symbols in the
@@ -64,6 +65,11 @@
  */
 #define MAX_NUM_BASE64_DATA                      4U
 
+/**
+ * @brief Number of octets decoded from a group of four Base64 symbols.
+ */
+#define NUM_OCTETS_PER_GROUP                     3U
+
 /**
  * @brief Maximum number of padding symbols in a string of encoded data that is considered valid.
  */
@@ -402,7 +408,81 @@ static Base64Status_t decodeBase64IndexBuffer( uint32_t * pBase64IndexBuffer,
 }
 
 /**
- * @brief Decode Base64 encoded data.
+ * @brief         Decode the groups of four Base64 digits at the start of the
+ *                encoded data, stopping at the first group that contains a
+ *                formatting or invalid symbol.
+ *
+ * Each group is looked up in pBase64SymbolToIndexMap and validated with a
+ * single check, since every value past the range of Base64 digits has the
+ * same high bit set. The symbols that stop the loop are left for the symbol
+ * by symbol decoder, which reports the errors and handles the padding.
+ *
+ * @param[in]     pEncodedData Pointer to the Base64 encoded data to decode.
+ * @param[in]     encodedLen Length of the pEncodedData buffer.
+ * @param[out]    pDest Pointer to a buffer used for storing the decoded data.
+ * @param[in]     destLen Length of the pDest buffer.
+ * @param[in,out] pOutputLen Pointer to the index of pDest where the output
+ *                should be written.
+ *
+ * @return        Number of encoded symbols decoded.
+ */
+static size_t decodeBase64Groups( const uint8_t * pEncodedData,
+                                  const size_t encodedLen,
+                                  uint8_t * pDest,
+                                  const size_t destLen,
+                                  size_t * pOutputLen )
+{
+    size_t numDecoded = 0;
+    size_t outputLen;
+    uint32_t base64IndexBuffer;
+    uint32_t firstIndex;
+    uint32_t secondIndex;
+    uint32_t thirdIndex;
+    uint32_t fourthIndex;
+    bool groupIsValid = true;
+
+    assert( pEncodedData != NULL );
+    assert( pDest != NULL );
+    assert( pOutputLen != NULL );
+    assert( *pOutputLen <= destLen );
+
+    outputLen = *pOutputLen;
+
+    while( ( groupIsValid == true ) &&
+           ( ( encodedLen - numDecoded ) >= MAX_NUM_BASE64_DATA ) &&
+           ( ( destLen - outputLen ) >= NUM_OCTETS_PER_GROUP ) )
+    {
+        firstIndex = pBase64SymbolToIndexMap[ pEncodedData[ numDecoded ] ];
+        secondIndex = pBase64SymbolToIndexMap[ pEncodedData[ numDecoded + 1U ] ];
+        thirdIndex = pBase64SymbolToIndexMap[ pEncodedData[ numDecoded + 2U ] ];
+        fourthIndex = pBase64SymbolToIndexMap[ pEncodedData[ numDecoded + 3U ] ];
+
+        if( ( firstIndex | secondIndex | thirdIndex | fourthIndex ) > VALID_BASE64_SYMBOL_INDEX_RANGE_MAX )
+        {
+            groupIsValid = false;
+        }
+        else
+        {
+            base64IndexBuffer = ( firstIndex << ( 3 * SEXTET_SIZE ) ) |
+                                ( secondIndex << ( 2 * SEXTET_SIZE ) ) |
+                                ( thirdIndex << SEXTET_SIZE ) |
+                                fourthIndex;
+
+            pDest[ outputLen ] = ( uint8_t ) ( base64IndexBuffer >> SIZE_OF_TWO_OCTETS ) & 0xFFU;
+            pDest[ outputLen + 1U ] = ( uint8_t ) ( base64IndexBuffer >> SIZE_OF_ONE_OCTET ) & 0xFFU;
+            pDest[ outputLen + 2U ] = ( uint8_t ) base64IndexBuffer & 0xFFU;
+            outputLen += NUM_OCTETS_PER_GROUP;
+            numDecoded += MAX_NUM_BASE64_DATA;
+        }
+    }
+
+    *pOutputLen = outputLen;
+    return numDecoded;
+}
+
+/**
+ * @brief Decode Base64 encoded data, optionally decoding whole groups of
+ *        Base64 digits with decodeBase64Groups.
  *
  * @param[out] pDest Pointer to a buffer for storing the decoded result.
  * @param[in]  destLen Length of the pDest buffer.
@@ -410,6 +490,8 @@ static Base64Status_t decodeBase64IndexBuffer( uint32_t * pBase64IndexBuffer,
  * @param[in]  pEncodedData Pointer to a buffer containing the Base64 encoded
  *             data that is intended to be decoded.
  * @param[in]  encodedLen Length of the pEncodedData buffer.
+ * @param[in]  decodeGroups Set to true to decode groups of four Base64 digits
+ *             at once whenever the symbols decoded so far allow it.
  *
  * @return     One of the following:
  *             - #Base64Success if the Base64 encoded data was valid
@@ -417,11 +499,12 @@ static Base64Status_t decodeBase64IndexBuffer( uint32_t * pBase64IndexBuffer,
  *             - An error code defined in ota_base64_private.h if the
  *               encoded data or input parameters are invalid.
  */
-Base64Status_t base64Decode( uint8_t * pDest,
-                             const size_t destLen,
-                             size_t * pResultLen,
-                             const uint8_t * pEncodedData,
-                             const size_t encodedLen )
+static Base64Status_t decodeBase64Data( uint8_t * pDest,
+                                        const size_t destLen,
+                                        size_t * pResultLen,
+                                        const uint8_t * pEncodedData,
+                                        const size_t encodedLen,
+                                        bool decodeGroups )
 {
     uint32_t base64IndexBuffer = 0;
     uint32_t numDataInBuffer = 0;
@@ -446,8 +529,28 @@ Base64Status_t base64Decode( uint8_t * pDest,
            ( pCurrBase64Symbol < ( pEncodedData + encodedLen ) ) )
     {
         uint8_t base64Index = 0;
+        uint8_t base64AsciiSymbol = 0;
+
+        /* Groups of four Base64 digits can only be decoded at once when no
+         * symbol is pending in the buffer and no padding or whitespace was
+         * seen, as any digit after those is an ordering error. */
+        if( ( decodeGroups == true ) && ( numDataInBuffer == 0U ) &&
+            ( numPadding == 0 ) && ( numWhitespace == 0 ) )
+        {
+            pCurrBase64Symbol += decodeBase64Groups( pCurrBase64Symbol,
+                                                     ( size_t ) ( ( pEncodedData + encodedLen ) - pCurrBase64Symbol ),
+                                                     pDest,
+                                                     destLen,
+                                                     &outputLen );
+
+            if( pCurrBase64Symbol == ( pEncodedData + encodedLen ) )
+            {
+                break;
+            }
+        }
+
         /* Read in the next Ascii character that represents the current Base64 symbol. */
-        uint8_t base64AsciiSymbol = *pCurrBase64Symbol++;
+        base64AsciiSymbol = *pCurrBase64Symbol++;
         /* Get the Base64 index that represents the Base64 symbol. */
         base64Index = pBase64SymbolToIndexMap[ base64AsciiSymbol ];
 
@@ -513,4 +616,29 @@ Base64Status_t base64Decode( uint8_t * pDest,
     return returnVal;
 }
 
+/**
+ * @brief Decode Base64 encoded data.
+ *
+ * @param[out] pDest Pointer to a buffer for storing the decoded result.
+ * @param[in]  destLen Length of the pDest buffer.
+ * @param[out] pResultLen Pointer to the length of the decoded result.
+ * @param[in]  pEncodedData Pointer to a buffer containing the Base64 encoded
+ *             data that is intended to be decoded.
+ * @param[in]  encodedLen Length of the pEncodedData buffer.
+ *
+ * @return     One of the following:
+ *             - #Base64Success if the Base64 encoded data was valid
+ *               and successfully decoded.
+ *             - An error code defined in ota_base64_private.h if the
+ *               encoded data or input parameters are invalid.
+ */
+Base64Status_t base64Decode( uint8_t * pDest,
+                             const size_t destLen,
+                             size_t * pResultLen,
+                             const uint8_t * pEncodedData,
+                             const size_t encodedLen )
+{
+    return decodeBase64Data( pDest, destLen, pResultLen, pEncodedData, encodedLen, true );
+}
+
 /*-----------------------------------------------------------*/
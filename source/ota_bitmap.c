@@ -0,0 +1,220 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_bitmap.c
+ * @brief Word at a time scanning of the block bitmap.
+ *
+ * The bitmap is read 32 bits at a time. The bytes are assembled into a word
+ * with the lowest byte first, so bit i of the bitmap is bit ( i % 32 ) of
+ * word ( i / 32 ) on any target and the bitmap does not need to be aligned.
+ * Bits past the end of the bitmap read as 0.
+ */
+
+/* Standard library includes. */
+#include <stddef.h>
+#include <stdint.h>
+
+/* OTA includes. */
+#include "ota_bitmap_private.h"
+
+/**
+ * @brief Log base 2 of the number of bits in a bitmap word.
+ */
+#define LOG2_BITS_PER_WORD    5U
+
+/**
+ * @brief Number of bits in a bitmap word.
+ */
+#define BITS_PER_WORD         ( ( uint32_t ) 1U << LOG2_BITS_PER_WORD )
+
+/**
+ * @brief Read the word of the bitmap that starts at a given bit.
+ *
+ * @param[in] pBitmap The bitmap.
+ * @param[in] numBits Number of bits in the bitmap.
+ * @param[in] wordBit Index of the first bit of the word, a multiple of BITS_PER_WORD.
+ *
+ * @return The word, with the bits past the end of the bitmap cleared.
+ */
+static uint32_t loadWord( const uint8_t * pBitmap,
+                          uint32_t numBits,
+                          uint32_t wordBit );
+
+/**
+ * @brief Count the zero bits below the lowest bit set.
+ *
+ * @param[in] word A word that is not 0.
+ *
+ * @return Index of the lowest bit set.
+ */
+static uint32_t countTrailingZeros( uint32_t word );
+
+/**
+ * @brief Count the bits set in a word.
+ *
+ * @param[in] word The word.
+ *
+ * @return Number of bits set.
+ */
+static uint32_t countBitsSet( uint32_t word );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t loadWord( const uint8_t * pBitmap,
+                          uint32_t numBits,
+                          uint32_t wordBit )
+{
+    uint32_t word = 0;
+    uint32_t byteIndex = wordBit >> 3U;
+    uint32_t numBytes = ( numBits + 7U ) >> 3U;
+    uint32_t shift = 0;
+
+    for( shift = 0; ( shift < BITS_PER_WORD ) && ( byteIndex < numBytes ); shift += 8U )
+    {
+        word |= ( uint32_t ) pBitmap[ byteIndex ] << shift;
+        byteIndex++;
+    }
+
+    if( ( numBits - wordBit ) < BITS_PER_WORD )
+    {
+        word &= ( ( uint32_t ) 1U << ( numBits - wordBit ) ) - 1U;
+    }
+
+    return word;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t countTrailingZeros( uint32_t word )
+{
+    uint32_t count = 0;
+
+    #if defined( __GNUC__ )
+        count = ( uint32_t ) __builtin_ctz( word );
+    #else
+        uint32_t value = word;
+
+        while( ( value & 1U ) == 0U )
+        {
+            value >>= 1U;
+            count++;
+        }
+    #endif
+
+    return count;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t countBitsSet( uint32_t word )
+{
+    uint32_t count = 0;
+
+    #if defined( __GNUC__ )
+        count = ( uint32_t ) __builtin_popcount( word );
+    #else
+        count = word - ( ( word >> 1U ) & 0x55555555U );
+        count = ( count & 0x33333333U ) + ( ( count >> 2U ) & 0x33333333U );
+        count = ( ( ( count + ( count >> 4U ) ) & 0x0F0F0F0FU ) * 0x01010101U ) >> 24U;
+    #endif
+
+    return count;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t otaBitmap_FindFirstSet( const uint8_t * pBitmap,
+                                 uint32_t numBits,
+                                 uint32_t startBit )
+{
+    uint32_t found = numBits;
+    uint32_t wordBit = startBit & ~( BITS_PER_WORD - 1U );
+    uint32_t mask = 0xFFFFFFFFU << ( startBit & ( BITS_PER_WORD - 1U ) );
+    uint32_t word = 0;
+
+    while( ( pBitmap != NULL ) && ( found == numBits ) && ( wordBit < numBits ) )
+    {
+        /* Ignore the bits of the first word that are before the start. */
+        word = loadWord( pBitmap, numBits, wordBit ) & mask;
+        mask = 0xFFFFFFFFU;
+
+        if( word != 0U )
+        {
+            found = wordBit + countTrailingZeros( word );
+        }
+
+        wordBit += BITS_PER_WORD;
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t otaBitmap_RunLength( const uint8_t * pBitmap,
+                              uint32_t numBits,
+                              uint32_t startBit,
+                              uint32_t maxLength )
+{
+    uint32_t length = 0;
+    uint32_t bit = startBit;
+    uint32_t available = 0;
+    uint32_t ones = 0;
+    uint32_t word = 0;
+
+    while( ( pBitmap != NULL ) && ( bit < numBits ) && ( length < maxLength ) )
+    {
+        /* Bring the bit to the bottom of its word and count the ones from there. */
+        word = loadWord( pBitmap, numBits, bit & ~( BITS_PER_WORD - 1U ) ) >> ( bit & ( BITS_PER_WORD - 1U ) );
+        available = BITS_PER_WORD - ( bit & ( BITS_PER_WORD - 1U ) );
+        ones = ( ~word != 0U ) ? countTrailingZeros( ~word ) : BITS_PER_WORD;
+
+        length += ones;
+        bit += ones;
+
+        if( ones < available )
+        {
+            /* The run ends in this word. */
+            break;
+        }
+    }
+
+    return ( length < maxLength ) ? length : maxLength;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t otaBitmap_CountSet( const uint8_t * pBitmap,
+                             uint32_t numBits )
+{
+    uint32_t count = 0;
+    uint32_t wordBit = 0;
+
+    while( ( pBitmap != NULL ) && ( wordBit < numBits ) )
+    {
+        count += countBitsSet( loadWord( pBitmap, numBits, wordBit ) );
+        wordBit += BITS_PER_WORD;
+    }
+
+    return count;
+}
@@ -26,6 +26,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "cbor.h"
 #include "ota_cbor_private.h"
 
@@ -34,6 +35,50 @@
  */
 #define OTA_CBOR_GETSTREAMREQUEST_ITEM_COUNT    6
 
+/**
+ * @brief Number of bits the major type of a CBOR data item is shifted by in
+ * its initial byte.
+ */
+#define CBOR_MAJOR_TYPE_SHIFT                   5U
+
+/**
+ * @brief Mask of the additional information in the initial byte of a CBOR
+ * data item.
+ */
+#define CBOR_ADDITIONAL_INFO_MASK               0x1FU
+
+/*
+ * CBOR major types handled by the Get Stream response decoder.
+ */
+#define CBOR_MAJOR_TYPE_UNSIGNED_INT            0U /*!< Major type of an unsigned integer. */
+#define CBOR_MAJOR_TYPE_NEGATIVE_INT            1U /*!< Major type of a negative integer. */
+#define CBOR_MAJOR_TYPE_BYTE_STRING             2U /*!< Major type of a byte string. */
+#define CBOR_MAJOR_TYPE_TEXT_STRING             3U /*!< Major type of a text string. */
+#define CBOR_MAJOR_TYPE_MAP                     5U /*!< Major type of a map. */
+
+/*
+ * Additional information values giving the size of the argument that follows
+ * the initial byte.
+ */
+#define CBOR_ARGUMENT_ONE_BYTE                  24U /*!< One byte argument. */
+#define CBOR_ARGUMENT_TWO_BYTES                 25U /*!< Two byte argument. */
+#define CBOR_ARGUMENT_FOUR_BYTES                26U /*!< Four byte argument. */
+
+/**
+ * @brief Initial byte of a text string of one character, which all the keys
+ * of the Get Stream response are.
+ */
+#define CBOR_ONE_CHARACTER_KEY_HEAD             0x61U
+
+/*
+ * Flags of the fields of the Get Stream response found by the decoder.
+ */
+#define GETSTREAMRESPONSE_FILEID_FOUND          0x1U /*!< File id found. */
+#define GETSTREAMRESPONSE_BLOCKID_FOUND         0x2U /*!< Block id found. */
+#define GETSTREAMRESPONSE_BLOCKSIZE_FOUND       0x4U /*!< Block size found. */
+#define GETSTREAMRESPONSE_PAYLOAD_FOUND         0x8U /*!< Payload found. */
+#define GETSTREAMRESPONSE_ALL_FOUND             0xFU /*!< All the fields found. */
+
 /* ========================================================================== */
 
 /**
@@ -58,52 +103,355 @@ static CborError checkDataType( CborType expectedType,
 }
 
 /**
- * @brief Decode a Get Stream response message from AWS IoT OTA.
+ * @brief Helper function to point to the bytes of a byte string in place.
+ *
+ * The bytes of a byte string encoded with its length up front are contiguous
+ * in the message buffer and end where the next value starts.
+ *
+ * @param[in] cborValue Byte string value.
+ * @param[in] length Length of the byte string.
+ * @param[out] pPayload Pointer to the first byte of the byte string.
+ * @return CborError
+ */
+static CborError getByteStringSpan( const CborValue * cborValue,
+                                    size_t length,
+                                    uint8_t ** pPayload )
+{
+    CborError cborResult = CborNoError;
+    CborValue nextValue = *cborValue;
+
+    /* A string split in chunks is not contiguous and can't be lent in place. */
+    if( false == cbor_value_is_length_known( cborValue ) )
+    {
+        cborResult = CborErrorUnknownLength;
+    }
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_value_advance( &nextValue );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        /* The message buffer is owned by the caller, who writes the payload
+         * out without changing it. */
+        /* coverity[misra_c_2012_rule_11_8_violation] */
+        *pPayload = ( uint8_t * ) ( cbor_value_get_next_byte( &nextValue ) - length );
+    }
+
+    return cborResult;
+}
+
+/**
+ * @brief Helper function to read the initial byte and the argument of a CBOR
+ * data item.
+ *
+ * Indefinite lengths and 8 byte arguments are not supported.
+ *
+ * @param[in] pMessageBuffer Message holding the data item.
+ * @param[in] messageSize Size of the message.
+ * @param[in,out] pOffset Offset of the data item in the message, moved past
+ * its argument.
+ * @param[out] pMajorType Major type of the data item.
+ * @param[out] pArgument Argument of the data item.
+ * @return true if the data item was read, otherwise false.
+ */
+static bool readCborItemHead( const uint8_t * pMessageBuffer,
+                              size_t messageSize,
+                              size_t * pOffset,
+                              uint8_t * pMajorType,
+                              uint32_t * pArgument )
+{
+    bool result = true;
+    size_t offset = *pOffset;
+    size_t argumentSize = 0;
+    uint8_t additionalInfo = 0;
+    uint32_t argument = 0;
+
+    if( offset >= messageSize )
+    {
+        result = false;
+    }
+    else
+    {
+        *pMajorType = pMessageBuffer[ offset ] >> CBOR_MAJOR_TYPE_SHIFT;
+        additionalInfo = pMessageBuffer[ offset ] & CBOR_ADDITIONAL_INFO_MASK;
+        offset++;
+
+        if( additionalInfo < CBOR_ARGUMENT_ONE_BYTE )
+        {
+            argument = additionalInfo;
+        }
+        else if( additionalInfo == CBOR_ARGUMENT_ONE_BYTE )
+        {
+            argumentSize = 1U;
+        }
+        else if( additionalInfo == CBOR_ARGUMENT_TWO_BYTES )
+        {
+            argumentSize = 2U;
+        }
+        else if( additionalInfo == CBOR_ARGUMENT_FOUR_BYTES )
+        {
+            argumentSize = 4U;
+        }
+        else
+        {
+            result = false;
+        }
+    }
+
+    if( ( result == true ) && ( argumentSize > ( messageSize - offset ) ) )
+    {
+        result = false;
+    }
+
+    while( ( result == true ) && ( argumentSize > 0U ) )
+    {
+        argument = ( argument << 8 ) | pMessageBuffer[ offset ];
+        offset++;
+        argumentSize--;
+    }
+
+    if( result == true )
+    {
+        *pArgument = argument;
+        *pOffset = offset;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Helper function to read a CBOR integer that fits in an int32_t.
+ *
+ * @param[in] majorType Major type of the data item.
+ * @param[in] argument Argument of the data item.
+ * @param[out] pValue Value of the integer.
+ * @return true if the data item is such an integer, otherwise false.
+ */
+static bool readCborInt32( uint8_t majorType,
+                           uint32_t argument,
+                           int32_t * pValue )
+{
+    bool result = false;
+
+    /* An argument with the top bit set does not fit in an int32_t either
+     * way, a negative integer being encoded as -1 - argument. */
+    if( argument <= ( uint32_t ) INT32_MAX )
+    {
+        if( majorType == CBOR_MAJOR_TYPE_UNSIGNED_INT )
+        {
+            *pValue = ( int32_t ) argument;
+            result = true;
+        }
+        else if( majorType == CBOR_MAJOR_TYPE_NEGATIVE_INT )
+        {
+            *pValue = -1 - ( int32_t ) argument;
+            result = true;
+        }
+        else
+        {
+            /* Not an integer. */
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Decode a Get Stream response message in a single pass over the
+ * message, without tinycbor.
+ *
+ * The response from AWS IoT Streams is a definite length map with one
+ * character keys and integer or string values. Only this layout is decoded
+ * here; a message using anything else, such as indefinite lengths, long keys,
+ * tags, floats or nested containers, or repeating a key, is not decoded so
+ * that the caller falls back to tinycbor.
+ * Messages that tinycbor rejects are never decoded here.
  *
  * @param[in] pMessageBuffer message to decode.
  * @param[in] messageSize size of the message to decode.
  * @param[out] pFileId Decoded file id value.
  * @param[out] pBlockId Decoded block id value.
  * @param[out] pBlockSize Decoded block size value.
- * @param[out] pPayload Buffer for the decoded payload.
+ * @param[in,out] pPayload Buffer for the decoded payload, or pointer to NULL
+ * to point to the payload within pMessageBuffer.
  * @param[in,out] pPayloadSize maximum size of the buffer as in and actual
  * payload size for the decoded payload as out.
  *
- * @return TRUE when success, otherwise FALSE.
+ * @return true if the message was decoded, otherwise false.
  */
-bool OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pMessageBuffer,
-                                               size_t messageSize,
-                                               int32_t * pFileId,
-                                               int32_t * pBlockId,
-                                               int32_t * pBlockSize,
-                                               uint8_t ** pPayload,
-                                               size_t * pPayloadSize )
+static bool decodeGetStreamResponseDirect( const uint8_t * pMessageBuffer,
+                                           size_t messageSize,
+                                           int32_t * pFileId,
+                                           int32_t * pBlockId,
+                                           int32_t * pBlockSize,
+                                           uint8_t ** pPayload,
+                                           size_t * pPayloadSize )
 {
-    CborError cborResult = CborNoError;
-    CborParser cborParser;
-    CborValue cborValue, cborMap;
-    size_t payloadSizeReceived = 0;
+    bool result = true;
+    size_t offset = 0;
+    uint8_t majorType = 0;
+    uint32_t numPairs = 0;
+    uint32_t argument = 0;
+    uint32_t fieldsFound = 0;
+    uint32_t field = 0;
+    uint32_t i = 0;
+    uint8_t key = 0;
+    int32_t fileId = 0;
+    int32_t blockId = 0;
+    int32_t blockSize = 0;
+    size_t payloadOffset = 0;
+    size_t payloadSize = 0;
+
+    result = readCborItemHead( pMessageBuffer, messageSize, &offset, &majorType, &numPairs ) &&
+             ( majorType == CBOR_MAJOR_TYPE_MAP );
+
+    for( i = 0; ( result == true ) && ( i < numPairs ); i++ )
+    {
+        /* Match the one character key by value. */
+        if( ( ( messageSize - offset ) < 2U ) || ( pMessageBuffer[ offset ] != CBOR_ONE_CHARACTER_KEY_HEAD ) )
+        {
+            result = false;
+        }
+        else
+        {
+            key = pMessageBuffer[ offset + 1U ];
+            offset += 2U;
+            result = readCborItemHead( pMessageBuffer, messageSize, &offset, &majorType, &argument );
+        }
 
-    if( ( pFileId == NULL ) ||
-        ( pBlockId == NULL ) ||
-        ( pBlockSize == NULL ) ||
-        ( pPayload == NULL ) ||
-        ( pPayloadSize == NULL ) ||
-        ( pMessageBuffer == NULL ) )
+        if( result == true )
+        {
+            field = 0;
+
+            if( key == ( uint8_t ) OTA_CBOR_FILEID_KEY[ 0 ] )
+            {
+                field = GETSTREAMRESPONSE_FILEID_FOUND;
+                result = readCborInt32( majorType, argument, &fileId );
+            }
+            else if( key == ( uint8_t ) OTA_CBOR_BLOCKID_KEY[ 0 ] )
+            {
+                field = GETSTREAMRESPONSE_BLOCKID_FOUND;
+                result = readCborInt32( majorType, argument, &blockId );
+            }
+            else if( key == ( uint8_t ) OTA_CBOR_BLOCKSIZE_KEY[ 0 ] )
+            {
+                field = GETSTREAMRESPONSE_BLOCKSIZE_FOUND;
+                result = readCborInt32( majorType, argument, &blockSize );
+            }
+            else if( key == ( uint8_t ) OTA_CBOR_BLOCKPAYLOAD_KEY[ 0 ] )
+            {
+                field = GETSTREAMRESPONSE_PAYLOAD_FOUND;
+                payloadOffset = offset;
+                payloadSize = argument;
+                result = ( majorType == CBOR_MAJOR_TYPE_BYTE_STRING );
+            }
+            else
+            {
+                /* Any other key is skipped when its value is an integer or
+                 * a string. */
+                result = ( majorType == CBOR_MAJOR_TYPE_UNSIGNED_INT ) ||
+                         ( majorType == CBOR_MAJOR_TYPE_NEGATIVE_INT ) ||
+                         ( majorType == CBOR_MAJOR_TYPE_BYTE_STRING ) ||
+                         ( majorType == CBOR_MAJOR_TYPE_TEXT_STRING );
+            }
+
+            if( ( fieldsFound & field ) != 0U )
+            {
+                result = false;
+            }
+
+            fieldsFound |= field;
+        }
+
+        /* Step over the contents of strings. */
+        if( ( result == true ) &&
+            ( ( majorType == CBOR_MAJOR_TYPE_BYTE_STRING ) || ( majorType == CBOR_MAJOR_TYPE_TEXT_STRING ) ) )
+        {
+            if( argument > ( messageSize - offset ) )
+            {
+                result = false;
+            }
+            else
+            {
+                offset += argument;
+            }
+        }
+    }
+
+    if( ( result == true ) &&
+        ( ( fieldsFound != GETSTREAMRESPONSE_ALL_FOUND ) || ( payloadSize > *pPayloadSize ) ) )
     {
-        cborResult = CborUnknownError;
+        result = false;
     }
 
-    /* Initialize the parser. */
-    if( CborNoError == cborResult )
+    if( result == true )
     {
-        cborResult = cbor_parser_init( pMessageBuffer,
-                                       messageSize,
-                                       0,
-                                       &cborParser,
-                                       &cborMap );
+        *pFileId = fileId;
+        *pBlockId = blockId;
+        *pBlockSize = blockSize;
+
+        if( *pPayload == NULL )
+        {
+            /* The message buffer is owned by the caller, who writes the
+             * payload out without changing it. */
+            /* coverity[misra_c_2012_rule_11_8_violation] */
+            *pPayload = ( uint8_t * ) &( pMessageBuffer[ payloadOffset ] );
+        }
+        else
+        {
+            ( void ) memcpy( *pPayload, &( pMessageBuffer[ payloadOffset ] ), payloadSize );
+
+            /* Terminate the copy when there is room, as tinycbor does. */
+            if( payloadSize < *pPayloadSize )
+            {
+                ( *pPayload )[ payloadSize ] = 0U;
+            }
+        }
+
+        *pPayloadSize = payloadSize;
     }
 
+    return result;
+}
+
+/**
+ * @brief Decode a Get Stream response message with tinycbor.
+ *
+ * @param[in] pMessageBuffer message to decode.
+ * @param[in] messageSize size of the message to decode.
+ * @param[out] pFileId Decoded file id value.
+ * @param[out] pBlockId Decoded block id value.
+ * @param[out] pBlockSize Decoded block size value.
+ * @param[in,out] pPayload Buffer for the decoded payload. If it points to
+ * NULL, it is set to point to the payload within pMessageBuffer instead of
+ * copying it.
+ * @param[in,out] pPayloadSize maximum size of the buffer as in and actual
+ * payload size for the decoded payload as out.
+ *
+ * @return CborError
+ */
+static CborError decodeGetStreamResponseCbor( const uint8_t * pMessageBuffer,
+                                              size_t messageSize,
+                                              int32_t * pFileId,
+                                              int32_t * pBlockId,
+                                              int32_t * pBlockSize,
+                                              uint8_t ** pPayload,
+                                              size_t * pPayloadSize )
+{
+    CborError cborResult = CborNoError;
+    CborParser cborParser;
+    CborValue cborValue, cborMap;
+    size_t payloadSizeReceived = 0;
+
+    /* Initialize the parser. */
+    cborResult = cbor_parser_init( pMessageBuffer,
+                                   messageSize,
+                                   0,
+                                   &cborParser,
+                                   &cborMap );
+
     /* Get the outer element and confirm that it's a "map," i.e., a set of
      * CBOR key/value pairs. */
     if( CborNoError == cborResult )
@@ -206,56 +554,118 @@ bool OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pMessageBuffer,
 
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_value_copy_byte_string( &cborValue,
-                                                  *pPayload,
-                                                  pPayloadSize,
-                                                  NULL );
+        if( *pPayload == NULL )
+        {
+            /* Lend the payload in place to save copying it. */
+            cborResult = getByteStringSpan( &cborValue,
+                                            payloadSizeReceived,
+                                            pPayload );
+        }
+        else
+        {
+            cborResult = cbor_value_copy_byte_string( &cborValue,
+                                                      *pPayload,
+                                                      pPayloadSize,
+                                                      NULL );
+        }
+    }
+
+    return cborResult;
+}
+
+/**
+ * @brief Decode a Get Stream response message from AWS IoT OTA.
+ *
+ * The message is decoded in a single pass when it has the layout sent by AWS
+ * IoT Streams, and with tinycbor otherwise.
+ *
+ * @param[in] pMessageBuffer message to decode.
+ * @param[in] messageSize size of the message to decode.
+ * @param[out] pFileId Decoded file id value.
+ * @param[out] pBlockId Decoded block id value.
+ * @param[out] pBlockSize Decoded block size value.
+ * @param[in,out] pPayload Buffer for the decoded payload. If it points to
+ * NULL, it is set to point to the payload within pMessageBuffer instead of
+ * copying it.
+ * @param[in,out] pPayloadSize maximum size of the buffer as in and actual
+ * payload size for the decoded payload as out.
+ *
+ * @return TRUE when success, otherwise FALSE.
+ */
+bool OTA_CBOR_Decode_GetStreamResponseMessage( const uint8_t * pMessageBuffer,
+                                               size_t messageSize,
+                                               int32_t * pFileId,
+                                               int32_t * pBlockId,
+                                               int32_t * pBlockSize,
+                                               uint8_t ** pPayload,
+                                               size_t * pPayloadSize )
+{
+    CborError cborResult = CborNoError;
+
+    if( ( pFileId == NULL ) ||
+        ( pBlockId == NULL ) ||
+        ( pBlockSize == NULL ) ||
+        ( pPayload == NULL ) ||
+        ( pPayloadSize == NULL ) ||
+        ( pMessageBuffer == NULL ) )
+    {
+        cborResult = CborUnknownError;
+    }
+
+    /* Fall back to tinycbor for any other layout of the message. */
+    if( ( CborNoError == cborResult ) &&
+        ( false == decodeGetStreamResponseDirect( pMessageBuffer,
+                                                  messageSize,
+                                                  pFileId,
+                                                  pBlockId,
+                                                  pBlockSize,
+                                                  pPayload,
+                                                  pPayloadSize ) ) )
+    {
+        cborResult = decodeGetStreamResponseCbor( pMessageBuffer,
+                                                  messageSize,
+                                                  pFileId,
+                                                  pBlockId,
+                                                  pBlockSize,
+                                                  pPayload,
+                                                  pPayloadSize );
     }
 
     return CborNoError == cborResult;
 }
 
 /**
- * @brief Create an encoded Get Stream Request message for the AWS IoT OTA
- * service. The service allows block count or block bitmap to be requested,
- * but not both.
+ * @brief Encode the map header and the fields of a Get Stream Request message
+ * that stay the same for all the requests of a file.
  *
- * @param[in,out] pMessageBuffer Buffer to store the encoded message.
- * @param[in] messageBufferSize Size of the buffer to store the encoded message.
- * @param[out] pEncodedMessageSize Size of the final encoded message.
+ * @param[in,out] pMessageBuffer Buffer to store the encoded prefix.
+ * @param[in] messageBufferSize Size of the buffer to store the encoded prefix.
+ * @param[out] pEncodedPrefixSize Size of the encoded prefix.
  * @param[in] pClientToken Client token in the encoded message.
  * @param[in] fileId Value of file id in the encoded message.
  * @param[in] blockSize Value of block size in the encoded message.
- * @param[in] blockOffset Value of block offset in the encoded message.
- * @param[in] pBlockBitmap bitmap in the encoded message.
- * @param[in] blockBitmapSize Size of the provided bitmap buffer.
- * @param[in] numOfBlocksRequested number of blocks to request in the encoded message.
  *
  * @return TRUE when success, otherwise FALSE.
  */
-bool OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pMessageBuffer,
-                                              size_t messageBufferSize,
-                                              size_t * pEncodedMessageSize,
-                                              const char * pClientToken,
-                                              int32_t fileId,
-                                              int32_t blockSize,
-                                              int32_t blockOffset,
-                                              uint8_t * pBlockBitmap,
-                                              size_t blockBitmapSize,
-                                              int32_t numOfBlocksRequested )
+bool OTA_CBOR_Encode_GetStreamRequestPrefix( uint8_t * pMessageBuffer,
+                                             size_t messageBufferSize,
+                                             size_t * pEncodedPrefixSize,
+                                             const char * pClientToken,
+                                             int32_t fileId,
+                                             int32_t blockSize )
 {
     CborError cborResult = CborNoError;
     CborEncoder cborEncoder, cborMapEncoder;
 
     if( ( pMessageBuffer == NULL ) ||
-        ( pEncodedMessageSize == NULL ) ||
-        ( pClientToken == NULL ) ||
-        ( pBlockBitmap == NULL ) )
+        ( pEncodedPrefixSize == NULL ) ||
+        ( pClientToken == NULL ) )
     {
         cborResult = CborUnknownError;
     }
 
-    /* Initialize the CBOR encoder. */
+    /* Initialize the CBOR encoder. The map is left open, the remaining
+     * fields are encoded by OTA_CBOR_Encode_GetStreamRequestFields. */
     if( CborNoError == cborResult )
     {
         cbor_encoder_init( &cborEncoder,
@@ -306,29 +716,85 @@ bool OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pMessageBuffer,
                                       blockSize );
     }
 
+    /* Get the encoded size. The map encoder holds the end of the data. */
+    if( CborNoError == cborResult )
+    {
+        *pEncodedPrefixSize = cbor_encoder_get_buffer_size( &cborMapEncoder,
+                                                            pMessageBuffer );
+    }
+
+    return CborNoError == cborResult;
+}
+
+/**
+ * @brief Encode the fields of a Get Stream Request message that change with
+ * every request, after a prefix from OTA_CBOR_Encode_GetStreamRequestPrefix.
+ *
+ * @param[in,out] pMessageBuffer Buffer holding the encoded prefix, the fields
+ * are encoded right after it.
+ * @param[in] messageBufferSize Size of the buffer to store the encoded message.
+ * @param[out] pEncodedMessageSize Size of the final encoded message.
+ * @param[in] prefixSize Size of the encoded prefix at the start of the buffer.
+ * @param[in] blockOffset Value of block offset in the encoded message.
+ * @param[in] pBlockBitmap bitmap in the encoded message.
+ * @param[in] blockBitmapSize Size of the provided bitmap buffer.
+ * @param[in] numOfBlocksRequested number of blocks to request in the encoded message.
+ *
+ * @return TRUE when success, otherwise FALSE.
+ */
+bool OTA_CBOR_Encode_GetStreamRequestFields( uint8_t * pMessageBuffer,
+                                             size_t messageBufferSize,
+                                             size_t * pEncodedMessageSize,
+                                             size_t prefixSize,
+                                             int32_t blockOffset,
+                                             uint8_t * pBlockBitmap,
+                                             size_t blockBitmapSize,
+                                             int32_t numOfBlocksRequested )
+{
+    CborError cborResult = CborNoError;
+    CborEncoder cborEncoder;
+
+    if( ( pMessageBuffer == NULL ) ||
+        ( pEncodedMessageSize == NULL ) ||
+        ( pBlockBitmap == NULL ) ||
+        ( prefixSize >= messageBufferSize ) )
+    {
+        cborResult = CborUnknownError;
+    }
+
+    /* The fields are the last items of the map opened by the prefix, so they
+     * are encoded one after the other from the end of the prefix. */
+    if( CborNoError == cborResult )
+    {
+        cbor_encoder_init( &cborEncoder,
+                           &pMessageBuffer[ prefixSize ],
+                           messageBufferSize - prefixSize,
+                           0 );
+    }
+
     /* Encode the block offset key and value. */
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_text_stringz( &cborMapEncoder,
+        cborResult = cbor_encode_text_stringz( &cborEncoder,
                                                OTA_CBOR_BLOCKOFFSET_KEY );
     }
 
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_int( &cborMapEncoder,
+        cborResult = cbor_encode_int( &cborEncoder,
                                       blockOffset );
     }
 
     /* Encode the block bitmap key and value. */
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_text_stringz( &cborMapEncoder,
+        cborResult = cbor_encode_text_stringz( &cborEncoder,
                                                OTA_CBOR_BLOCKBITMAP_KEY );
     }
 
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_byte_string( &cborMapEncoder,
+        cborResult = cbor_encode_byte_string( &cborEncoder,
                                               pBlockBitmap,
                                               blockBitmapSize );
     }
@@ -336,29 +802,79 @@ bool OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pMessageBuffer,
     /* Encode the number of blocks requested key and value. */
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_text_stringz( &cborMapEncoder,
+        cborResult = cbor_encode_text_stringz( &cborEncoder,
                                                OTA_CBOR_NUMBEROFBLOCKS_KEY );
     }
 
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encode_int( &cborMapEncoder,
+        cborResult = cbor_encode_int( &cborEncoder,
                                       numOfBlocksRequested );
     }
 
-    /* Close the encoder. */
+    /* Get the encoded size. */
     if( CborNoError == cborResult )
     {
-        cborResult = cbor_encoder_close_container_checked( &cborEncoder,
-                                                           &cborMapEncoder );
+        *pEncodedMessageSize = prefixSize + cbor_encoder_get_buffer_size( &cborEncoder,
+                                                                          &pMessageBuffer[ prefixSize ] );
     }
 
-    /* Get the encoded size. */
-    if( CborNoError == cborResult )
+    return CborNoError == cborResult;
+}
+
+/**
+ * @brief Create an encoded Get Stream Request message for the AWS IoT OTA
+ * service. The service allows block count or block bitmap to be requested,
+ * but not both.
+ *
+ * @param[in,out] pMessageBuffer Buffer to store the encoded message.
+ * @param[in] messageBufferSize Size of the buffer to store the encoded message.
+ * @param[out] pEncodedMessageSize Size of the final encoded message.
+ * @param[in] pClientToken Client token in the encoded message.
+ * @param[in] fileId Value of file id in the encoded message.
+ * @param[in] blockSize Value of block size in the encoded message.
+ * @param[in] blockOffset Value of block offset in the encoded message.
+ * @param[in] pBlockBitmap bitmap in the encoded message.
+ * @param[in] blockBitmapSize Size of the provided bitmap buffer.
+ * @param[in] numOfBlocksRequested number of blocks to request in the encoded message.
+ *
+ * @return TRUE when success, otherwise FALSE.
+ */
+bool OTA_CBOR_Encode_GetStreamRequestMessage( uint8_t * pMessageBuffer,
+                                              size_t messageBufferSize,
+                                              size_t * pEncodedMessageSize,
+                                              const char * pClientToken,
+                                              int32_t fileId,
+                                              int32_t blockSize,
+                                              int32_t blockOffset,
+                                              uint8_t * pBlockBitmap,
+                                              size_t blockBitmapSize,
+                                              int32_t numOfBlocksRequested )
+{
+    bool result = false;
+    size_t prefixSize = 0;
+
+    if( pBlockBitmap != NULL )
     {
-        *pEncodedMessageSize = cbor_encoder_get_buffer_size( &cborEncoder,
-                                                             pMessageBuffer );
+        result = OTA_CBOR_Encode_GetStreamRequestPrefix( pMessageBuffer,
+                                                         messageBufferSize,
+                                                         &prefixSize,
+                                                         pClientToken,
+                                                         fileId,
+                                                         blockSize );
     }
 
-    return CborNoError == cborResult;
+    if( result == true )
+    {
+        result = OTA_CBOR_Encode_GetStreamRequestFields( pMessageBuffer,
+                                                         messageBufferSize,
+                                                         pEncodedMessageSize,
+                                                         prefixSize,
+                                                         blockOffset,
+                                                         pBlockBitmap,
+                                                         blockBitmapSize,
+                                                         numOfBlocksRequested );
+    }
+
+    return result;
 }
@@ -0,0 +1,214 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_event_buffer.c
+ * @brief Lock-free pool of event data buffers.
+ *
+ * The free buffers are kept in a ring with one more slot than there are
+ * buffers, so a full ring can be told from an empty one. Acquiring a buffer
+ * only moves the head and releasing one only moves the tail. With a single
+ * context acquiring and a single context releasing, neither needs a lock.
+ * Each side publishes its index with a release store after it is done with
+ * the slot, and reads the index of the other side with an acquire load.
+ */
+
+/* Standard library includes. */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* OTA includes. */
+#include "ota.h"
+#include "ota_event_buffer.h"
+
+#if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+
+/**
+ * @brief Number of slots in the ring of free buffers.
+ */
+    #define OTA_EVENT_BUFFER_RING_SIZE    ( otaconfigEVENT_BUFFER_POOL_SIZE + 1U )
+
+    #if defined( __GNUC__ )
+
+/**
+ * @brief Read the index published by the other side of the ring.
+ */
+        #define LOAD_ACQUIRE( pIndex )            __atomic_load_n( ( pIndex ), __ATOMIC_ACQUIRE )
+
+/**
+ * @brief Publish an index to the other side of the ring.
+ */
+        #define STORE_RELEASE( pIndex, value )    __atomic_store_n( ( pIndex ), ( value ), __ATOMIC_RELEASE )
+    #else
+
+/* Other compilers keep the volatile accesses in order, which single core
+ * targets rely on. */
+        #define LOAD_ACQUIRE( pIndex )            ( *( pIndex ) )
+        #define STORE_RELEASE( pIndex, value )    ( *( pIndex ) = ( value ) )
+    #endif
+
+/**
+ * @brief Buffers of the pool.
+ */
+    static OtaEventData_t eventBuffers[ otaconfigEVENT_BUFFER_POOL_SIZE ];
+
+/**
+ * @brief Ring of the free buffers.
+ */
+    static OtaEventData_t * volatile pFreeBuffers[ OTA_EVENT_BUFFER_RING_SIZE ];
+
+/**
+ * @brief Slot of the next buffer to acquire. Only moved by OTA_EventBufferGet.
+ */
+    static volatile uint32_t freeHead = 0;
+
+/**
+ * @brief Slot to put the next buffer released in. Only moved by OTA_EventBufferFree.
+ */
+    static volatile uint32_t freeTail = 0;
+
+/**
+ * @brief Highest number of buffers acquired at the same time.
+ */
+    static volatile uint32_t highWatermark = 0;
+
+/**
+ * @brief Number of times no buffer was available.
+ */
+    static volatile uint32_t exhaustedCount = 0;
+
+#endif /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+
+/*-----------------------------------------------------------*/
+
+void OTA_EventBufferInit( void )
+{
+    #if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+        uint32_t index = 0;
+
+        for( index = 0; index < otaconfigEVENT_BUFFER_POOL_SIZE; index++ )
+        {
+            eventBuffers[ index ].bufferUsed = false;
+            pFreeBuffers[ index ] = &( eventBuffers[ index ] );
+        }
+
+        STORE_RELEASE( &freeHead, 0U );
+        STORE_RELEASE( &freeTail, otaconfigEVENT_BUFFER_POOL_SIZE );
+        highWatermark = 0;
+        exhaustedCount = 0;
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+OtaEventData_t * OTA_EventBufferGet( void )
+{
+    OtaEventData_t * pBuffer = NULL;
+
+    #if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+        uint32_t head = freeHead;
+        uint32_t inUse = 0;
+
+        /* The slots up to the tail hold the buffers released so far. */
+        if( head != LOAD_ACQUIRE( &freeTail ) )
+        {
+            pBuffer = pFreeBuffers[ head ];
+            pBuffer->bufferUsed = true;
+
+            /* Publish the new head only after the buffer has been taken out of its slot. */
+            STORE_RELEASE( &freeHead, ( head + 1U ) % OTA_EVENT_BUFFER_RING_SIZE );
+
+            inUse = otaconfigEVENT_BUFFER_POOL_SIZE - OTA_EventBufferFreeCount();
+
+            if( inUse > highWatermark )
+            {
+                highWatermark = inUse;
+            }
+        }
+        else
+        {
+            exhaustedCount++;
+        }
+    #endif /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+
+    return pBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+void OTA_EventBufferFree( OtaEventData_t * const pBuffer )
+{
+    #if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+        uint32_t tail = freeTail;
+        uintptr_t offset = ( uintptr_t ) pBuffer - ( uintptr_t ) &( eventBuffers[ 0 ] );
+        uintptr_t index = offset / sizeof( OtaEventData_t );
+
+        /* Only take back buffers of the pool that are in use. The index is
+         * checked rather than the pointer, which can't be compared with the
+         * pool unless it points in it. */
+        if( ( index < otaconfigEVENT_BUFFER_POOL_SIZE ) &&
+            ( pBuffer == &( eventBuffers[ index ] ) ) &&
+            ( pBuffer->bufferUsed == true ) )
+        {
+            pBuffer->bufferUsed = false;
+            pFreeBuffers[ tail ] = pBuffer;
+
+            /* Publish the new tail only after the buffer has been put in its slot. */
+            STORE_RELEASE( &freeTail, ( tail + 1U ) % OTA_EVENT_BUFFER_RING_SIZE );
+        }
+    #else
+        ( void ) pBuffer;
+    #endif /* if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) */
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t OTA_EventBufferFreeCount( void )
+{
+    uint32_t freeCount = 0;
+
+    #if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+        freeCount = ( LOAD_ACQUIRE( &freeTail ) + OTA_EVENT_BUFFER_RING_SIZE - LOAD_ACQUIRE( &freeHead ) ) % OTA_EVENT_BUFFER_RING_SIZE;
+    #endif
+
+    return freeCount;
+}
+
+/*-----------------------------------------------------------*/
+
+void OTA_GetEventBufferStatistics( OtaEventBufferStatistics_t * pStatistics )
+{
+    if( pStatistics != NULL )
+    {
+        pStatistics->poolSize = otaconfigEVENT_BUFFER_POOL_SIZE;
+        pStatistics->buffersInUse = otaconfigEVENT_BUFFER_POOL_SIZE - OTA_EventBufferFreeCount();
+
+        #if ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U )
+            pStatistics->highWatermark = highWatermark;
+            pStatistics->exhausted = exhaustedCount;
+        #else
+            pStatistics->highWatermark = 0;
+            pStatistics->exhausted = 0;
+        #endif
+    }
+}
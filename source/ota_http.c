@@ -34,12 +34,22 @@
 #include "ota.h"
 #include "ota_private.h"
 #include "ota_http_private.h"
+#include "ota_bitmap_private.h"
 
 /**
- * @brief Track the current block for HTTP requests
+ * @brief Request the missing blocks that fit in the sliding request window.
  *
+ * Sends one range request for each run of contiguous missing blocks, starting
+ * at the request frontier, until the window is full. A run is at most
+ * blocksPerRange blocks long. Once the frontier has passed the last block the
+ * search wraps to the start of the file, which re-requests blocks that were
+ * lost in flight.
+ *
+ * @param[in] pAgentCtx The OTA agent context.
+ *
+ * @return The OTA error code. See OTA Agent error codes information in ota.h.
  */
-static uint32_t currBlock;
+static OtaErr_t requestWindowRanges( OtaAgentContext_t * pAgentCtx );
 
 /*
  * Init file transfer by initializing the http module with the pre-signed url.
@@ -56,6 +66,9 @@ OtaErr_t initFileTransfer_Http( OtaAgentContext_t * pAgentCtx )
     /* File context from OTA agent. */
     fileContext = &( pAgentCtx->fileContext );
 
+    /* Start from the first block. */
+    pAgentCtx->currBlock = 0;
+
     /* Get pre-signed URL from pAgentCtx. */
     pURL = ( char * ) fileContext->pUpdateUrlPath;
 
@@ -68,20 +81,112 @@ OtaErr_t initFileTransfer_Http( OtaAgentContext_t * pAgentCtx )
                     "OtaHttpStatus_t=%s"
                     , OTA_HTTP_strerror( httpStatus ) ) );
     }
+    else
+    {
+        #if ( ( otaconfigHTTP_MAX_BLOCKS_PER_RANGE > 0U ) && ( otaconfigMAX_REQUEST_WINDOW_SIZE > 0U ) )
+            /* Open the sliding request window so several ranges can be pending at once. */
+            pAgentCtx->requestWindow.windowSize = ( otaconfigINITIAL_REQUEST_WINDOW_SIZE < otaconfigMAX_REQUEST_WINDOW_SIZE ) ?
+                                                  otaconfigINITIAL_REQUEST_WINDOW_SIZE : otaconfigMAX_REQUEST_WINDOW_SIZE;
+            pAgentCtx->requestWindow.threshold = otaconfigMAX_REQUEST_WINDOW_SIZE;
+            pAgentCtx->requestWindow.blocksPerRange = otaconfigHTTP_MAX_BLOCKS_PER_RANGE;
+        #endif
+    }
 
     return ( httpStatus == OtaHttpSuccess ) ? OtaErrNone : OtaErrInitFileTransferFailed;
 }
 
+static OtaErr_t requestWindowRanges( OtaAgentContext_t * pAgentCtx )
+{
+    OtaHttpStatus_t httpStatus = OtaHttpSuccess;
+    OtaFileContext_t * pFileContext = NULL;
+    OtaRequestWindow_t * pWindow = NULL;
+    uint32_t numBlocks = 0;
+    uint32_t blockIndex = 0;
+    uint32_t runLength = 0;
+    uint32_t maxRunLength = 0;
+    uint32_t rangeEnd = 0;
+    bool wrapped = false;
+
+    pFileContext = &( pAgentCtx->fileContext );
+    pWindow = &( pAgentCtx->requestWindow );
+    numBlocks = OTA_FILE_NUM_BLOCKS( pFileContext );
+
+    if( pWindow->nextBlock >= numBlocks )
+    {
+        pWindow->nextBlock = 0;
+        wrapped = true;
+    }
+
+    blockIndex = pWindow->nextBlock;
+
+    while( ( httpStatus == OtaHttpSuccess ) &&
+           ( pWindow->blocksInFlight < pWindow->windowSize ) &&
+           ( pFileContext->pRxBlockBitmap != NULL ) )
+    {
+        /* Skip the blocks already received. */
+        blockIndex = otaBitmap_FindFirstSet( pFileContext->pRxBlockBitmap, numBlocks, blockIndex );
+
+        if( blockIndex >= numBlocks )
+        {
+            if( wrapped == true )
+            {
+                break;
+            }
+
+            /* Nothing left after the frontier, go back for the blocks that never arrived. */
+            blockIndex = 0;
+            wrapped = true;
+        }
+        else
+        {
+            maxRunLength = pWindow->windowSize - pWindow->blocksInFlight;
+
+            if( maxRunLength > pWindow->blocksPerRange )
+            {
+                maxRunLength = pWindow->blocksPerRange;
+            }
+
+            /* Extend the range over the missing blocks that follow. */
+            runLength = otaBitmap_RunLength( pFileContext->pRxBlockBitmap, numBlocks, blockIndex, maxRunLength );
+
+            rangeEnd = ( ( blockIndex + runLength ) < numBlocks ) ?
+                       ( ( ( blockIndex + runLength ) << pFileContext->log2BlockSize ) - 1U ) :
+                       ( pFileContext->fileSize - 1U );
+
+            httpStatus = pAgentCtx->pOtaInterface->http.request( blockIndex << pFileContext->log2BlockSize, rangeEnd );
+
+            if( httpStatus == OtaHttpSuccess )
+            {
+                pWindow->blocksInFlight += runLength;
+                blockIndex += runLength;
+            }
+            else
+            {
+                LogError( ( "Error occured while requesting data range:"
+                            "OtaHttpStatus_t=%s"
+                            , OTA_HTTP_strerror( httpStatus ) ) );
+            }
+        }
+    }
+
+    pWindow->nextBlock = blockIndex;
+
+    return ( httpStatus == OtaHttpSuccess ) ? OtaErrNone : OtaErrRequestFileBlockFailed;
+}
+
 /*
  * Check for next available OTA job from the job service.
  */
 OtaErr_t requestDataBlock_Http( OtaAgentContext_t * pAgentCtx )
 {
+    OtaErr_t err = OtaErrNone;
     OtaHttpStatus_t httpStatus = OtaHttpSuccess;
 
     /* Values for the "Range" field in HTTP header. */
     uint32_t rangeStart = 0;
     uint32_t rangeEnd = 0;
+    uint32_t numBlocks = 0;
+    uint32_t firstMissing = 0;
 
     OtaFileContext_t * fileContext = NULL;
 
@@ -90,36 +195,57 @@ OtaErr_t requestDataBlock_Http( OtaAgentContext_t * pAgentCtx )
 
     fileContext = &( pAgentCtx->fileContext );
 
-    /* Calculate ranges. */
-    rangeStart = currBlock * OTA_FILE_BLOCK_SIZE;
-
-    if( fileContext->blocksRemaining == 1U )
+    if( ( pAgentCtx->requestWindow.windowSize > 0U ) && ( pAgentCtx->requestWindow.blocksPerRange > 0U ) )
     {
-        rangeEnd = fileContext->fileSize - 1U;
+        /* Keep as many ranges pending as the window allows. */
+        err = requestWindowRanges( pAgentCtx );
     }
     else
     {
-        rangeEnd = rangeStart + OTA_FILE_BLOCK_SIZE - 1U;
+        numBlocks = OTA_FILE_NUM_BLOCKS( fileContext );
+        firstMissing = otaBitmap_FindFirstSet( fileContext->pRxBlockBitmap, numBlocks, 0 );
+
+        /* Carry on from the first block still missing, so a transfer that
+         * was resumed or lost a block does not ask for blocks received. */
+        if( firstMissing < numBlocks )
+        {
+            pAgentCtx->currBlock = firstMissing;
+        }
+
+        /* Calculate ranges. */
+        rangeStart = pAgentCtx->currBlock * OTA_FILE_BLOCK_SIZE_OF( fileContext );
+
+        if( ( fileContext->blocksRemaining == 1U ) || ( ( pAgentCtx->currBlock + 1U ) == numBlocks ) )
+        {
+            rangeEnd = fileContext->fileSize - 1U;
+        }
+        else
+        {
+            rangeEnd = rangeStart + OTA_FILE_BLOCK_SIZE_OF( fileContext ) - 1U;
+        }
+
+        /* Request file data over HTTP using the rangeStart and rangeEnd. */
+        httpStatus = pAgentCtx->pOtaInterface->http.request( rangeStart, rangeEnd );
+
+        if( httpStatus != OtaHttpSuccess )
+        {
+            LogError( ( "Error occured while requesting data block:"
+                        "OtaHttpStatus_t=%s"
+                        , OTA_HTTP_strerror( httpStatus ) ) );
+            err = OtaErrRequestFileBlockFailed;
+        }
     }
 
-    /* Request file data over HTTP using the rangeStart and rangeEnd. */
-    httpStatus = pAgentCtx->pOtaInterface->http.request( rangeStart, rangeEnd );
-
-    if( httpStatus != OtaHttpSuccess )
-    {
-        LogError( ( "Error occured while requesting data block:"
-                    "OtaHttpStatus_t=%s"
-                    , OTA_HTTP_strerror( httpStatus ) ) );
-    }
-
-    return ( httpStatus == OtaHttpSuccess ) ? OtaErrNone : OtaErrRequestFileBlockFailed;
+    return err;
 }
 
 /*
  * HTTP file block does not need to decode the block, only increment
- * number of blocks received.
+ * number of blocks received. Blocks received out of order keep the block
+ * index passed in.
  */
-OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
+OtaErr_t decodeFileBlock_Http( OtaAgentContext_t * pAgentCtx,
+                               const uint8_t * pMessageBuffer,
                                size_t messageSize,
                                int32_t * pFileId,
                                int32_t * pBlockId,
@@ -129,7 +255,7 @@ OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
 {
     OtaErr_t err = OtaErrNone;
 
-    assert( pMessageBuffer != NULL && pFileId != NULL && pBlockId != NULL &&
+    assert( pAgentCtx != NULL && pMessageBuffer != NULL && pFileId != NULL && pBlockId != NULL &&
             pBlockSize != NULL && pPayload != NULL && pPayloadSize != NULL );
 
     if( messageSize > OTA_FILE_BLOCK_SIZE )
@@ -140,17 +266,32 @@ OtaErr_t decodeFileBlock_Http( const uint8_t * pMessageBuffer,
     }
     else
     {
-        *pFileId = 0;
-        *pBlockId = ( int32_t ) currBlock;
+        /* The body answers the request for the file being received. */
+        *pFileId = ( int32_t ) pAgentCtx->fileContext.serverFileID;
         *pBlockSize = ( int32_t ) messageSize;
 
         /* The data received over HTTP does not require any decoding. */
-        ( void ) memcpy( *pPayload, pMessageBuffer, messageSize );
+        if( *pPayload == NULL )
+        {
+            /* Lend the body in place, the caller writes it out without changing it. */
+            /* coverity[misra_c_2012_rule_11_8_violation] */
+            *pPayload = ( uint8_t * ) pMessageBuffer;
+        }
+        else
+        {
+            ( void ) memcpy( *pPayload, pMessageBuffer, messageSize );
+        }
 
         *pPayloadSize = messageSize;
 
-        /* Current block is processed, set the file block to next. */
-        currBlock++;
+        /* Blocks received out of order come with their index already set. */
+        if( *pBlockId < 0 )
+        {
+            *pBlockId = ( int32_t ) pAgentCtx->currBlock;
+
+            /* Current block is processed, set the file block to next. */
+            pAgentCtx->currBlock++;
+        }
     }
 
     return err;
@@ -166,9 +307,6 @@ OtaErr_t cleanupData_Http( const OtaAgentContext_t * pAgentCtx )
     assert( pAgentCtx != NULL && pAgentCtx->pOtaInterface != NULL );
     httpStatus = pAgentCtx->pOtaInterface->http.deinit();
 
-    /* Reset currBlock. */
-    currBlock = 0;
-
     return ( httpStatus == OtaHttpSuccess ) ? OtaErrNone : OtaErrCleanupDataFailed;
 }
 
@@ -0,0 +1,96 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_job_arena.c
+ * @brief Memory arena holding the buffers of one OTA job.
+ *
+ * Buffers are handed out from the arena by moving a single offset forward, so
+ * taking a buffer never allocates and never fails once the arena exists, as
+ * long as there is room left in it. The whole arena is freed in one call.
+ */
+
+/* Standard library includes. */
+#include <stddef.h>
+#include <stdint.h>
+
+/* OTA includes. */
+#include "ota_job_arena_private.h"
+
+/*-----------------------------------------------------------*/
+
+void * otaJobArena_Alloc( OtaJobArena_t * pArena,
+                          const OtaMallocInterface_t * pMem,
+                          size_t size )
+{
+    void * pBuffer = NULL;
+    size_t alignedSize = 0U;
+
+    if( ( pArena != NULL ) && ( size > 0U ) && ( size <= pArena->size ) )
+    {
+        /* A static arena is never allocated. */
+        if( ( pArena->pBase == NULL ) && ( pMem != NULL ) )
+        {
+            pArena->pBase = pMem->malloc( pArena->size );
+            pArena->used = 0U;
+        }
+
+        /* Round up the size so that the next buffer is aligned as well. The size
+         * is at most the arena size here, so this cannot wrap around. */
+        alignedSize = ( size + ( OTA_JOB_ARENA_ALIGNMENT - 1U ) ) & ~( ( size_t ) OTA_JOB_ARENA_ALIGNMENT - 1U );
+
+        if( pArena->pBase != NULL )
+        {
+            if( alignedSize > ( pArena->size - pArena->used ) )
+            {
+                /* The last buffer may still fit without its padding. */
+                alignedSize = size;
+            }
+
+            if( alignedSize <= ( pArena->size - pArena->used ) )
+            {
+                pBuffer = &( pArena->pBase[ pArena->used ] );
+                pArena->used += alignedSize;
+            }
+        }
+    }
+
+    return pBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+void otaJobArena_Release( OtaJobArena_t * pArena,
+                          const OtaMallocInterface_t * pMem )
+{
+    if( pArena != NULL )
+    {
+        /* A static arena keeps its storage. */
+        if( ( pArena->pBase != NULL ) && ( pMem != NULL ) )
+        {
+            pMem->free( pArena->pBase );
+            pArena->pBase = NULL;
+        }
+
+        pArena->used = 0U;
+    }
+}
@@ -35,6 +35,7 @@
 #include "ota.h"
 #include "ota_private.h"
 #include "ota_cbor_private.h"
+#include "ota_bitmap_private.h"
 
 /* Private include. */
 #include "ota_mqtt_private.h"
@@ -67,9 +68,7 @@
  */
 static const char pOtaJobsGetNextTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_JOBS_NEXT_GET;                 /*!< Topic template to request next job. */
 static const char pOtaJobsNotifyNextTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_JOBS_NOTIFY_NEXT;           /*!< Topic template to notify next . */
-static const char pOtaJobStatusTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_JOBS "%s"MQTT_API_UPDATE;        /*!< Topic template to update the current job. */
 static const char pOtaStreamDataTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_STREAMS "%s"MQTT_API_DATA_CBOR; /*!< Topic template to receive data over a stream. */
-static const char pOtaGetStreamTopicTemplate[] = MQTT_API_THINGS "%s"MQTT_API_STREAMS "%s"MQTT_API_GET_CBOR;   /*!< Topic template to request next data over a stream. */
 
 static const char pOtaGetNextJobMsgTemplate[] = "{\"clientToken\":\"%u:%s\"}";                                 /*!< Used to specify client token id to authenticate job. */
 static const char pOtaStringReceive[] = "\"receive\"";                                                         /*!< Used to build the job receive template. */
@@ -120,7 +119,6 @@ static const char asciiDigits[] =
  * These are used to calculate the static size of buffers used to store MQTT
  * topic and message strings. Each length is in terms of bytes. */
 #define U32_MAX_LEN            10U                                              /*!< Maximum number of output digits of an unsigned long value. */
-#define JOB_NAME_MAX_LEN       128U                                             /*!< Maximum length of the name of job documents received from the server. */
 #define STREAM_NAME_MAX_LEN    44U                                              /*!< Maximum length for the name of MQTT streams. */
 #define NULL_CHAR_LEN          1U                                               /*!< Size of a single null character used to terminate topics and messages. */
 
@@ -130,9 +128,7 @@ static const char asciiDigits[] =
 #define TOPIC_PLUS_THINGNAME_LEN( topic )    ( CONST_STRLEN( topic ) + otaconfigMAX_THINGNAME_LEN + NULL_CHAR_LEN )              /*!< Calculate max buffer size based on topic template and thing name length. */
 #define TOPIC_GET_NEXT_BUFFER_SIZE       ( TOPIC_PLUS_THINGNAME_LEN( pOtaJobsGetNextTopicTemplate ) )                            /*!< Max buffer size for `jobs/$next/get` topic. */
 #define TOPIC_NOTIFY_NEXT_BUFFER_SIZE    ( TOPIC_PLUS_THINGNAME_LEN( pOtaJobsNotifyNextTopicTemplate ) )                         /*!< Max buffer size for `jobs/notify-next` topic. */
-#define TOPIC_JOB_STATUS_BUFFER_SIZE     ( TOPIC_PLUS_THINGNAME_LEN( pOtaJobStatusTopicTemplate ) + JOB_NAME_MAX_LEN )           /*!< Max buffer size for `jobs/<job_name>/update` topic. */
 #define TOPIC_STREAM_DATA_BUFFER_SIZE    ( TOPIC_PLUS_THINGNAME_LEN( pOtaStreamDataTopicTemplate ) + STREAM_NAME_MAX_LEN )       /*!< Max buffer size for `streams/<stream_name>/data/cbor` topic. */
-#define TOPIC_GET_STREAM_BUFFER_SIZE     ( TOPIC_PLUS_THINGNAME_LEN( pOtaGetStreamTopicTemplate ) + STREAM_NAME_MAX_LEN )        /*!< Max buffer size for `streams/<stream_name>/get/cbor` topic. */
 #define MSG_GET_NEXT_BUFFER_SIZE         ( TOPIC_PLUS_THINGNAME_LEN( pOtaGetNextJobMsgTemplate ) + U32_MAX_LEN )                 /*!< Max buffer size for message of `jobs/$next/get topic`. */
 
 /**
@@ -159,6 +155,23 @@ static OtaMqttStatus_t unsubscribeFromDataStream( const OtaAgentContext_t * pAge
  */
 static OtaMqttStatus_t unsubscribeFromJobNotificationTopic( const OtaAgentContext_t * pAgentCtx );
 
+/**
+ * @brief Render the job status topic of the active job in the request cache,
+ * unless the topic already cached is the one of the active job.
+ *
+ * @param[in] pAgentCtx Agent context which provides the details for the thing and job.
+ */
+static void cacheStatusTopic( OtaAgentContext_t * pAgentCtx );
+
+/**
+ * @brief Render the get stream topic and encode the fixed fields of the data
+ * requests of the current file in the request cache, unless already done.
+ *
+ * @param[in] pAgentCtx Agent context which provides the details for the thing and file.
+ * @return bool true if the cache holds the topic and the request prefix.
+ */
+static bool cacheStreamRequest( OtaAgentContext_t * pAgentCtx );
+
 /**
  * @brief Publish a message to the job status topic.
  *
@@ -217,6 +230,48 @@ static uint32_t prvBuildStatusMessageFinish( char * pMsgBuffer,
                                              int32_t reason,
                                              int32_t subReason );
 
+/**
+ * @brief Select the next blocks to request within the sliding request window.
+ *
+ * Picks as many blocks as there are free slots in the window among the blocks
+ * that are still missing and not requested yet, starting at the request
+ * frontier. Once the frontier has passed the last block the search wraps to
+ * the start of the file, which re-requests blocks that were lost in flight.
+ * The selected blocks are set in a bitmap that starts at the first of them.
+ *
+ * @param[in] pFileContext File context with the bitmap of blocks received.
+ * @param[in,out] pWindow Request window, the frontier and the number of blocks in flight are updated.
+ * @param[out] pBitmap Bitmap of the selected blocks.
+ * @param[in] bitmapSize Size of the buffer pointed to by pBitmap.
+ * @param[out] pBlockOffset Index of the block represented by the first bit of pBitmap.
+ * @param[out] pBitmapLen Number of bytes of pBitmap used.
+ * @return uint32_t Number of blocks selected.
+ */
+static uint32_t selectWindowBlocks( const OtaFileContext_t * pFileContext,
+                                    OtaRequestWindow_t * pWindow,
+                                    uint8_t * pBitmap,
+                                    uint32_t bitmapSize,
+                                    uint32_t * pBlockOffset,
+                                    uint32_t * pBitmapLen );
+
+/**
+ * @brief Find the part of the block bitmap to send in a data request.
+ *
+ * The part starts at the byte of the first missing block and ends at the byte
+ * that holds the last of the blocks to request, so the bytes of blocks already
+ * received are not sent.
+ *
+ * @param[in] pRxBlockBitmap Bitmap of the blocks still missing.
+ * @param[in] numBlocks Number of blocks in the file.
+ * @param[in] numBlocksToRequest Number of blocks the request asks for.
+ * @param[out] pFirstByte Index of the first byte of the part to send.
+ * @return uint32_t Number of bytes of the part to send.
+ */
+static uint32_t compactBlockBitmap( const uint8_t * pRxBlockBitmap,
+                                    uint32_t numBlocks,
+                                    uint32_t numBlocksToRequest,
+                                    uint32_t * pFirstByte );
+
 /**
  * @brief Build a string from a set of strings
  *
@@ -512,19 +567,17 @@ static OtaMqttStatus_t unsubscribeFromJobNotificationTopic( const OtaAgentContex
 }
 
 /*
- * Publish a message to the job status topic.
+ * Render the job status topic of the active job, once per job.
  */
-static OtaMqttStatus_t publishStatusMessage( OtaAgentContext_t * pAgentCtx,
-                                             const char * pMsg,
-                                             uint32_t msgSize,
-                                             uint8_t qos )
+static void cacheStatusTopic( OtaAgentContext_t * pAgentCtx )
 {
-    OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
+    OtaRequestCache_t * pCache = NULL;
+    size_t thingNameLen = 0;
+    size_t jobNameLen = 0;
+    size_t jobNameOffset = 0;
     size_t topicLen = 0;
+    bool cached = false;
 
-    /* This buffer is used to store the generated MQTT topic. The static size
-     * is calculated from the template and the corresponding parameters. */
-    char pTopicBuffer[ TOPIC_JOB_STATUS_BUFFER_SIZE ];
     /* NULL-terminated list of topic string parts. */
     const char * topicStringParts[] =
     {
@@ -537,21 +590,113 @@ static OtaMqttStatus_t publishStatusMessage( OtaAgentContext_t * pAgentCtx,
     };
 
     assert( pAgentCtx != NULL );
-    /* pMsg is a static buffer of size "OTA_STATUS_MSG_MAX_SIZE". */
-    assert( pMsg != NULL );
 
-    /* Build the dynamic job status topic . */
+    pCache = &( pAgentCtx->requestCache );
+    thingNameLen = strlen( ( const char * ) pAgentCtx->pThingName );
+    jobNameLen = strlen( ( const char * ) pAgentCtx->pActiveJobName );
+    jobNameOffset = CONST_STRLEN( MQTT_API_THINGS ) + thingNameLen + CONST_STRLEN( MQTT_API_JOBS );
 
-    topicStringParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
-    topicStringParts[ 3 ] = ( const char * ) pAgentCtx->pActiveJobName;
+    /* The thing name does not change, so a topic of the same length is for a
+     * job name of the same length, which only has to be compared. */
+    if( ( pCache->statusTopicLength > 0U ) &&
+        ( ( size_t ) pCache->statusTopicLength == ( jobNameOffset + jobNameLen + CONST_STRLEN( MQTT_API_UPDATE ) ) ) )
+    {
+        cached = ( memcmp( &( pCache->pStatusTopic[ jobNameOffset ] ), pAgentCtx->pActiveJobName, jobNameLen ) == 0 );
+    }
 
-    topicLen = stringBuilder(
-        pTopicBuffer,
-        sizeof( pTopicBuffer ),
-        topicStringParts );
+    if( cached == false )
+    {
+        topicStringParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
+        topicStringParts[ 3 ] = ( const char * ) pAgentCtx->pActiveJobName;
 
-    /* The buffer is static and the size is calculated to fit. */
-    assert( ( topicLen > 0U ) && ( topicLen < sizeof( pTopicBuffer ) ) );
+        topicLen = stringBuilder(
+            pCache->pStatusTopic,
+            sizeof( pCache->pStatusTopic ),
+            topicStringParts );
+
+        /* The buffer size is calculated to fit the thing and job names. */
+        assert( ( topicLen > 0U ) && ( topicLen < sizeof( pCache->pStatusTopic ) ) );
+
+        pCache->statusTopicLength = ( uint16_t ) topicLen;
+    }
+}
+
+/*
+ * Render the get stream topic and request prefix of the current file, once per file.
+ */
+static bool cacheStreamRequest( OtaAgentContext_t * pAgentCtx )
+{
+    OtaRequestCache_t * pCache = NULL;
+    size_t topicLen = 0;
+    bool result = true;
+
+    /* NULL-terminated list of topic string parts. */
+    const char * pTopicParts[] =
+    {
+        MQTT_API_THINGS,
+        NULL, /* Thing Name not available at compile time, initialized below. */
+        MQTT_API_STREAMS,
+        NULL, /* Stream Name not available at compile time, initialized below. */
+        MQTT_API_GET_CBOR,
+        NULL
+    };
+
+    assert( pAgentCtx != NULL );
+
+    pCache = &( pAgentCtx->requestCache );
+
+    if( pCache->streamTopicLength == 0U )
+    {
+        pTopicParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
+        pTopicParts[ 3 ] = ( const char * ) pAgentCtx->fileContext.pStreamName;
+
+        topicLen = stringBuilder(
+            pCache->pStreamTopic,
+            sizeof( pCache->pStreamTopic ),
+            pTopicParts );
+
+        /* The buffer size is calculated to fit the thing and stream names. */
+        assert( ( topicLen > 0U ) && ( topicLen < sizeof( pCache->pStreamTopic ) ) );
+
+        pCache->streamTopicLength = ( uint16_t ) topicLen;
+    }
+
+    if( pCache->requestPrefixLength == 0U )
+    {
+        result = OTA_CBOR_Encode_GetStreamRequestPrefix( pCache->pRequestPrefix,
+                                                         sizeof( pCache->pRequestPrefix ),
+                                                         &( pCache->requestPrefixLength ),
+                                                         OTA_CLIENT_TOKEN,
+                                                         ( int32_t ) pAgentCtx->fileContext.serverFileID,
+                                                         ( int32_t ) OTA_FILE_BLOCK_SIZE_OF( &( pAgentCtx->fileContext ) ) );
+
+        if( result == false )
+        {
+            pCache->requestPrefixLength = 0U;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Publish a message to the job status topic.
+ */
+static OtaMqttStatus_t publishStatusMessage( OtaAgentContext_t * pAgentCtx,
+                                             const char * pMsg,
+                                             uint32_t msgSize,
+                                             uint8_t qos )
+{
+    OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
+    const char * pTopicBuffer = NULL;
+
+    assert( pAgentCtx != NULL );
+    /* pMsg is a static buffer of size "OTA_STATUS_MSG_MAX_SIZE". */
+    assert( pMsg != NULL );
+
+    /* The job status topic is only built again when the active job changes. */
+    cacheStatusTopic( pAgentCtx );
+    pTopicBuffer = pAgentCtx->requestCache.pStatusTopic;
 
     /* Publish the status message. */
     LogDebug( ( "Attempting to publish MQTT status message: "
@@ -559,7 +704,7 @@ static OtaMqttStatus_t publishStatusMessage( OtaAgentContext_t * pAgentCtx,
                 pMsg ) );
 
     mqttStatus = pAgentCtx->pOtaInterface->mqtt.publish( pTopicBuffer,
-                                                         ( uint16_t ) topicLen,
+                                                         pAgentCtx->requestCache.statusTopicLength,
                                                          &pMsg[ 0 ],
                                                          msgSize,
                                                          qos );
@@ -614,28 +759,23 @@ static uint32_t buildStatusMessageReceiving( char * pMsgBuffer,
     /* This function is only called when a file is received, so it can't be NULL. */
     assert( pOTAFileCtx != NULL );
 
-    numBlocks = ( pOTAFileCtx->fileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
+    numBlocks = OTA_FILE_NUM_BLOCKS( pOTAFileCtx );
     received = numBlocks - pOTAFileCtx->blocksRemaining;
 
-    /* Output a status update once in a while. */
-    if( ( received % otaconfigOTA_UPDATE_STATUS_FREQUENCY ) == 0U )
-    {
-        payloadStringParts[ 0 ] = pOtaJobStatusStrings[ status ];
-        payloadStringParts[ 3 ] = receivedString;
-        payloadStringParts[ 5 ] = numBlocksString;
-
-        ( void ) stringBuilderUInt32Decimal( receivedString, sizeof( receivedString ), received );
-        ( void ) stringBuilderUInt32Decimal( numBlocksString, sizeof( numBlocksString ), received );
+    payloadStringParts[ 0 ] = pOtaJobStatusStrings[ status ];
+    payloadStringParts[ 3 ] = receivedString;
+    payloadStringParts[ 5 ] = numBlocksString;
 
+    ( void ) stringBuilderUInt32Decimal( receivedString, sizeof( receivedString ), received );
+    ( void ) stringBuilderUInt32Decimal( numBlocksString, sizeof( numBlocksString ), numBlocks );
 
-        msgSize = ( uint32_t ) stringBuilder(
-            pMsgBuffer,
-            msgBufferSize,
-            payloadStringParts );
+    msgSize = ( uint32_t ) stringBuilder(
+        pMsgBuffer,
+        msgBufferSize,
+        payloadStringParts );
 
-        /* The buffer is static and the size is calculated to fit. */
-        assert( ( msgSize > 0U ) && ( msgSize < msgBufferSize ) );
-    }
+    /* The buffer is static and the size is calculated to fit. */
+    assert( ( msgSize > 0U ) && ( msgSize < msgBufferSize ) );
 
     return msgSize;
 }
@@ -996,6 +1136,11 @@ OtaErr_t initFileTransfer_Mqtt( OtaAgentContext_t * pAgentCtx )
     pTopicParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
     pTopicParts[ 3 ] = ( const char * ) pFileContext->pStreamName;
 
+    /* The stream and file ID of a new file are set, render them again with
+     * the first data request. */
+    pAgentCtx->requestCache.streamTopicLength = 0U;
+    pAgentCtx->requestCache.requestPrefixLength = 0U;
+
     topicLen = ( uint16_t ) stringBuilder(
         pRxStreamTopic,
         sizeof( pRxStreamTopic ),
@@ -1014,6 +1159,13 @@ OtaErr_t initFileTransfer_Mqtt( OtaAgentContext_t * pAgentCtx )
                     "topic=%s",
                     pRxStreamTopic ) );
         result = OtaErrNone;
+
+        #if ( otaconfigMAX_REQUEST_WINDOW_SIZE > 0U )
+            /* Open the sliding request window so more blocks are requested as each one arrives. */
+            pAgentCtx->requestWindow.windowSize = ( otaconfigINITIAL_REQUEST_WINDOW_SIZE < otaconfigMAX_REQUEST_WINDOW_SIZE ) ?
+                                                  otaconfigINITIAL_REQUEST_WINDOW_SIZE : otaconfigMAX_REQUEST_WINDOW_SIZE;
+            pAgentCtx->requestWindow.threshold = otaconfigMAX_REQUEST_WINDOW_SIZE;
+        #endif
     }
     else
     {
@@ -1028,6 +1180,128 @@ OtaErr_t initFileTransfer_Mqtt( OtaAgentContext_t * pAgentCtx )
     return result;
 }
 
+static uint32_t selectWindowBlocks( const OtaFileContext_t * pFileContext,
+                                    OtaRequestWindow_t * pWindow,
+                                    uint8_t * pBitmap,
+                                    uint32_t bitmapSize,
+                                    uint32_t * pBlockOffset,
+                                    uint32_t * pBitmapLen )
+{
+    uint32_t numBlocks = 0;
+    uint32_t freeSlots = 0;
+    uint32_t selected = 0;
+    uint32_t blockIndex = 0;
+    uint32_t bitIndex = 0;
+    uint32_t blockOffset = 0;
+    uint32_t span = 0;
+    bool wrapped = false;
+
+    assert( ( pFileContext != NULL ) && ( pWindow != NULL ) && ( pBitmap != NULL ) );
+    assert( ( pBlockOffset != NULL ) && ( pBitmapLen != NULL ) );
+
+    numBlocks = OTA_FILE_NUM_BLOCKS( pFileContext );
+    freeSlots = ( pWindow->windowSize > pWindow->blocksInFlight ) ? ( pWindow->windowSize - pWindow->blocksInFlight ) : 0U;
+
+    ( void ) memset( pBitmap, 0, bitmapSize );
+
+    if( pWindow->nextBlock >= numBlocks )
+    {
+        pWindow->nextBlock = 0;
+        wrapped = true;
+    }
+
+    blockIndex = pWindow->nextBlock;
+
+    while( ( freeSlots > selected ) && ( pFileContext->pRxBlockBitmap != NULL ) )
+    {
+        /* Skip the blocks already received. */
+        blockIndex = otaBitmap_FindFirstSet( pFileContext->pRxBlockBitmap, numBlocks, blockIndex );
+
+        if( blockIndex >= numBlocks )
+        {
+            if( ( selected > 0U ) || ( wrapped == true ) )
+            {
+                break;
+            }
+
+            /* Nothing left after the frontier, go back for the blocks that never arrived. */
+            blockIndex = 0;
+            wrapped = true;
+        }
+        else
+        {
+            if( selected == 0U )
+            {
+                blockOffset = blockIndex;
+            }
+
+            bitIndex = blockIndex - blockOffset;
+
+            /* Stop when the block does not fit in the request bitmap. */
+            if( ( bitIndex >> LOG2_BITS_PER_BYTE ) >= bitmapSize )
+            {
+                break;
+            }
+
+            pBitmap[ bitIndex >> LOG2_BITS_PER_BYTE ] |= ( uint8_t ) ( 1U << ( bitIndex % BITS_PER_BYTE ) );
+            span = bitIndex + 1U;
+            selected++;
+            blockIndex++;
+        }
+    }
+
+    pWindow->nextBlock = blockIndex;
+    pWindow->blocksInFlight += selected;
+
+    *pBlockOffset = blockOffset;
+    *pBitmapLen = ( span + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+
+    return selected;
+}
+
+static uint32_t compactBlockBitmap( const uint8_t * pRxBlockBitmap,
+                                    uint32_t numBlocks,
+                                    uint32_t numBlocksToRequest,
+                                    uint32_t * pFirstByte )
+{
+    uint32_t firstBlock = 0;
+    uint32_t lastBlock = 0;
+    uint32_t nextBlock = 0;
+    uint32_t missing = 1;
+    uint32_t firstByte = 0;
+    uint32_t bitmapLen = 0;
+
+    assert( ( pRxBlockBitmap != NULL ) && ( pFirstByte != NULL ) );
+
+    firstBlock = otaBitmap_FindFirstSet( pRxBlockBitmap, numBlocks, 0 );
+
+    if( firstBlock < numBlocks )
+    {
+        /* Find the last block the service will send. */
+        lastBlock = firstBlock;
+        nextBlock = otaBitmap_FindFirstSet( pRxBlockBitmap, numBlocks, lastBlock + 1U );
+
+        while( ( missing < numBlocksToRequest ) && ( nextBlock < numBlocks ) )
+        {
+            lastBlock = nextBlock;
+            missing++;
+            nextBlock = otaBitmap_FindFirstSet( pRxBlockBitmap, numBlocks, lastBlock + 1U );
+        }
+
+        firstByte = firstBlock >> LOG2_BITS_PER_BYTE;
+        bitmapLen = ( lastBlock >> LOG2_BITS_PER_BYTE ) + 1U - firstByte;
+    }
+    else
+    {
+        /* No block is missing, keep the whole bitmap. */
+        bitmapLen = ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+    }
+
+    *pFirstByte = firstByte;
+
+    return bitmapLen;
+}
+
 /*
  * Request file block by publishing to the get stream topic.
  */
@@ -1036,72 +1310,88 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx )
     OtaErr_t result = OtaErrRequestFileBlockFailed;
     OtaMqttStatus_t mqttStatus = OtaMqttSuccess;
     size_t msgSizeFromStream = 0;
-    uint32_t blockSize = OTA_FILE_BLOCK_SIZE;
     uint32_t numBlocks = 0;
     uint32_t bitmapLen = 0;
+    uint32_t blockOffset = 0;
+    uint32_t firstByte = 0;
+    uint32_t numBlocksToRequest = otaconfigMAX_NUM_BLOCKS_REQUEST;
     uint32_t msgSizeToPublish = 0;
-    uint32_t topicLen = 0;
     bool cborEncodeRet = false;
-    char pMsg[ OTA_REQUEST_MSG_MAX_SIZE ];
-
-    /* This buffer is used to store the generated MQTT topic. The static size
-     * is calculated from the template and the corresponding parameters. */
-    char pTopicBuffer[ TOPIC_GET_STREAM_BUFFER_SIZE ];
+    uint8_t pMsg[ OTA_REQUEST_MSG_MAX_SIZE ];
+    uint8_t pWindowBitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+    uint8_t * pBitmap = NULL;
     const OtaFileContext_t * pFileContext = NULL;
-
-    /* NULL-terminated list of topic string parts. */
-    const char * pTopicParts[] =
-    {
-        MQTT_API_THINGS,
-        NULL, /* Thing Name not available at compile time, initialized below. */
-        MQTT_API_STREAMS,
-        NULL, /* Stream Name not available at compile time, initialized below. */
-        MQTT_API_GET_CBOR,
-        NULL
-    };
+    const OtaRequestCache_t * pCache = NULL;
 
     assert( pAgentCtx != NULL );
 
     /* Get the current file context. */
     pFileContext = &( pAgentCtx->fileContext );
+    pCache = &( pAgentCtx->requestCache );
 
-    pTopicParts[ 1 ] = ( const char * ) pAgentCtx->pThingName;
-    pTopicParts[ 3 ] = ( const char * ) pFileContext->pStreamName;
+    if( pAgentCtx->requestWindow.windowSize > 0U )
+    {
+        /* Only ask for the blocks that fit in the free slots of the window. */
+        numBlocksToRequest = selectWindowBlocks( pFileContext,
+                                                 &( pAgentCtx->requestWindow ),
+                                                 pWindowBitmap,
+                                                 sizeof( pWindowBitmap ),
+                                                 &blockOffset,
+                                                 &bitmapLen );
+        pBitmap = pWindowBitmap;
+    }
+    else
+    {
+        numBlocks = OTA_FILE_NUM_BLOCKS( pFileContext );
+        bitmapLen = ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
+        pBitmap = pFileContext->pRxBlockBitmap;
+
+        if( ( otaconfigCOMPACT_BLOCK_BITMAP == 1U ) && ( pBitmap != NULL ) )
+        {
+            /* Only send the bitmap from the first missing block on. */
+            bitmapLen = compactBlockBitmap( pBitmap, numBlocks, numBlocksToRequest, &firstByte );
+            blockOffset = firstByte << LOG2_BITS_PER_BYTE;
+            pBitmap = &( pBitmap[ firstByte ] );
+        }
+    }
 
     /* Reset number of blocks requested. */
-    pAgentCtx->numOfBlocksToReceive = otaconfigMAX_NUM_BLOCKS_REQUEST;
-
-    numBlocks = ( pFileContext->fileSize + ( OTA_FILE_BLOCK_SIZE - 1U ) ) >> otaconfigLOG2_FILE_BLOCK_SIZE;
-    bitmapLen = ( numBlocks + ( BITS_PER_BYTE - 1U ) ) >> LOG2_BITS_PER_BYTE;
-
-    cborEncodeRet = OTA_CBOR_Encode_GetStreamRequestMessage( ( uint8_t * ) pMsg,
-                                                             sizeof( pMsg ),
-                                                             &msgSizeFromStream,
-                                                             OTA_CLIENT_TOKEN,
-                                                             ( int32_t ) pFileContext->serverFileID,
-                                                             ( int32_t ) blockSize,
-                                                             0,
-                                                             pFileContext->pRxBlockBitmap,
-                                                             bitmapLen,
-                                                             ( int32_t ) otaconfigMAX_NUM_BLOCKS_REQUEST );
+    pAgentCtx->numOfBlocksToReceive = numBlocksToRequest;
 
-    if( cborEncodeRet == true )
+    if( numBlocksToRequest == 0U )
     {
-        msgSizeToPublish = ( uint32_t ) msgSizeFromStream;
-
-        /* Try to build the dynamic data REQUEST topic to publish to. */
+        /* The window is full, the next block received will open it again. */
+        LogDebug( ( "Request window is full, no block requested." ) );
+        result = OtaErrNone;
+    }
+    else
+    {
+        /* Only the fields that change with each request are encoded, after
+         * the topic and the fixed fields cached for the file. */
+        cborEncodeRet = cacheStreamRequest( pAgentCtx );
 
-        topicLen = ( uint32_t ) stringBuilder(
-            pTopicBuffer,
-            sizeof( pTopicBuffer ),
-            pTopicParts );
+        if( cborEncodeRet == true )
+        {
+            ( void ) memcpy( pMsg, pCache->pRequestPrefix, pCache->requestPrefixLength );
+
+            cborEncodeRet = OTA_CBOR_Encode_GetStreamRequestFields( pMsg,
+                                                                    sizeof( pMsg ),
+                                                                    &msgSizeFromStream,
+                                                                    pCache->requestPrefixLength,
+                                                                    ( int32_t ) blockOffset,
+                                                                    pBitmap,
+                                                                    bitmapLen,
+                                                                    ( int32_t ) numBlocksToRequest );
+        }
+    }
 
-        /* The buffer is static and the size is calculated to fit. */
-        assert( ( topicLen > 0U ) && ( topicLen < sizeof( pTopicBuffer ) ) );
+    if( cborEncodeRet == true )
+    {
+        msgSizeToPublish = ( uint32_t ) msgSizeFromStream;
 
-        mqttStatus = pAgentCtx->pOtaInterface->mqtt.publish( pTopicBuffer,
-                                                             ( uint16_t ) topicLen,
-                                                             &pMsg[ 0 ],
+        mqttStatus = pAgentCtx->pOtaInterface->mqtt.publish( pCache->pStreamTopic,
+                                                             pCache->streamTopicLength,
+                                                             ( const char * ) pMsg,
                                                              msgSizeToPublish,
                                                              0 );
 
@@ -1109,7 +1399,7 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx )
         {
             LogInfo( ( "Published to MQTT topic to request the next block: "
                        "topic=%s",
-                       pTopicBuffer ) );
+                       pCache->pStreamTopic ) );
             result = OtaErrNone;
         }
         else
@@ -1120,11 +1410,15 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx )
                         OTA_MQTT_strerror( mqttStatus ) ) );
         }
     }
-    else
+    else if( numBlocksToRequest > 0U )
     {
         result = OtaErrFailedToEncodeCbor;
         LogError( ( "Failed to CBOR encode stream request message: "
-                    "OTA_CBOR_Encode_GetStreamRequestMessage returned error." ) );
+                    "OTA_CBOR_Encode_GetStreamRequestFields returned error." ) );
+    }
+    else
+    {
+        /* Nothing was requested. */
     }
 
     return result;
@@ -1133,7 +1427,8 @@ OtaErr_t requestFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx )
 /*
  * Decode a cbor encoded fileblock received from streaming service.
  */
-OtaErr_t decodeFileBlock_Mqtt( const uint8_t * pMessageBuffer,
+OtaErr_t decodeFileBlock_Mqtt( OtaAgentContext_t * pAgentCtx,
+                               const uint8_t * pMessageBuffer,
                                size_t messageSize,
                                int32_t * pFileId,
                                int32_t * pBlockId,
@@ -1144,13 +1439,16 @@ OtaErr_t decodeFileBlock_Mqtt( const uint8_t * pMessageBuffer,
     OtaErr_t result = OtaErrFailedToDecodeCbor;
     bool cborDecodeRet = false;
 
+    /* The block carries its own index. */
+    ( void ) pAgentCtx;
+
     /* Decode the CBOR content. */
     cborDecodeRet = OTA_CBOR_Decode_GetStreamResponseMessage( pMessageBuffer,
                                                               messageSize,
                                                               pFileId,
                                                               pBlockId,   /* CBOR requires pointer to int and our block indices never exceed 31 bits. */
                                                               pBlockSize, /* CBOR requires pointer to int and our block sizes never exceed 31 bits. */
-                                                              pPayload,   /* This payload gets malloc'd by OTA_CBOR_Decode_GetStreamResponseMessage(). We must free it. */
+                                                              pPayload,   /* Copied to the buffer given by the caller, or lent in place if there is none. */
                                                               pPayloadSize );
 
     if( cborDecodeRet == true )
@@ -30,6 +30,7 @@
 #include "FreeRTOS.h"
 #include "timers.h"
 #include "queue.h"
+#include "semphr.h"
 
 /* OTA OS POSIX Interface Includes.*/
 #include "ota_os_freertos.h"
@@ -39,8 +40,9 @@
 #include "ota_private.h"
 
 /* OTA Event queue attributes.*/
-#define MAX_MESSAGES    20
-#define MAX_MSG_SIZE    sizeof( OtaEventMsg_t )
+#define MAX_MESSAGES            20
+#define MAX_CONTROL_MESSAGES    8
+#define MAX_MSG_SIZE            sizeof( OtaEventMsg_t )
 
 /* Array containing pointer to the OTA event structures used to send events to the OTA task. */
 static OtaEventMsg_t queueData[ MAX_MESSAGES ];
@@ -51,16 +53,27 @@ static StaticQueue_t staticQueue;
 /* The queue control handle.  .*/
 static QueueHandle_t otaEventQueue;
 
+/* The control events, received before the file blocks of otaEventQueue, so
+ * that the file blocks neither delay them nor leave them without room.*/
+static OtaEventMsg_t controlQueueData[ MAX_CONTROL_MESSAGES ];
+static StaticQueue_t staticControlQueue;
+static QueueHandle_t otaControlQueue;
+
+/* Number of events in both queues, the OTA task waits on it.*/
+static StaticSemaphore_t staticEventCount;
+static SemaphoreHandle_t otaEventCount;
+
+/* Receive an event counted by otaEventCount, the control events first.*/
+static BaseType_t receiveCountedEvent( void * pEventMsg );
+
 /* OTA App Timer callback.*/
 static OtaTimerCallback_t otaTimerCallback;
 
-/* OTA Timer handles.*/
-static TimerHandle_t otaTimer[ OtaNumOfTimers ];
+/* OTA Timer handles, for the timers of all the agent instances.*/
+static TimerHandle_t otaTimer[ OTA_NUM_TIMER_IDS ];
 
-/* OTA Timer callbacks.*/
-static void requestTimerCallback( TimerHandle_t T );
-static void selfTestTimerCallback( TimerHandle_t T );
-void ( * timerCallback[ OtaNumOfTimers ] )( TimerHandle_t T ) = { requestTimerCallback, selfTestTimerCallback };
+/* OTA Timer callback.*/
+static void timerCallback( TimerHandle_t T );
 
 OtaOsStatus_t OtaInitEvent_FreeRTOS( OtaEventContext_t * pEventCtx )
 {
@@ -72,8 +85,15 @@ OtaOsStatus_t OtaInitEvent_FreeRTOS( OtaEventContext_t * pEventCtx )
                                         ( UBaseType_t ) MAX_MSG_SIZE,
                                         ( uint8_t * ) queueData,
                                         &staticQueue );
-
-    if( otaEventQueue == NULL )
+    otaControlQueue = xQueueCreateStatic( ( UBaseType_t ) MAX_CONTROL_MESSAGES,
+                                          ( UBaseType_t ) MAX_MSG_SIZE,
+                                          ( uint8_t * ) controlQueueData,
+                                          &staticControlQueue );
+    otaEventCount = xSemaphoreCreateCountingStatic( ( UBaseType_t ) ( OTA_NUM_MSG_Q_ENTRIES + MAX_CONTROL_MESSAGES ),
+                                                    ( UBaseType_t ) 0,
+                                                    &staticEventCount );
+
+    if( ( otaEventQueue == NULL ) || ( otaControlQueue == NULL ) || ( otaEventCount == NULL ) )
     {
         otaOsStatus = OtaOsEventQueueCreateFailed;
 
@@ -96,15 +116,22 @@ OtaOsStatus_t OtaSendEvent_FreeRTOS( OtaEventContext_t * pEventCtx,
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
     BaseType_t retVal = pdFALSE;
+    QueueHandle_t queue = otaEventQueue;
 
     ( void ) pEventCtx;
     ( void ) timeout;
 
-    /* Send the event to OTA event queue.*/
-    retVal = xQueueSendToBack( otaEventQueue, pEventMsg, ( TickType_t ) 0 );
+    if( OTA_IS_CONTROL_EVENT( ( const OtaEventMsg_t * ) pEventMsg ) )
+    {
+        queue = otaControlQueue;
+    }
+
+    /* Send the event to OTA event queue, then count it for the OTA task.*/
+    retVal = xQueueSendToBack( queue, pEventMsg, ( TickType_t ) 0 );
 
     if( retVal == pdTRUE )
     {
+        ( void ) xSemaphoreGive( otaEventCount );
         LogDebug( ( "OTA Event Sent." ) );
     }
     else
@@ -133,7 +160,10 @@ OtaOsStatus_t OtaReceiveEvent_FreeRTOS( OtaEventContext_t * pEventCtx,
     ( void ) pEventCtx;
     ( void ) timeout;
 
-    retVal = xQueueReceive( otaEventQueue, &buff, portMAX_DELAY );
+    if( xSemaphoreTake( otaEventCount, portMAX_DELAY ) == pdTRUE )
+    {
+        retVal = receiveCountedEvent( &buff );
+    }
 
     if( retVal == pdTRUE )
     {
@@ -154,6 +184,49 @@ OtaOsStatus_t OtaReceiveEvent_FreeRTOS( OtaEventContext_t * pEventCtx,
     return otaOsStatus;
 }
 
+OtaOsStatus_t OtaReceiveEvents_FreeRTOS( OtaEventContext_t * pEventCtx,
+                                         void * pEventMsgs,
+                                         uint32_t maxEvents,
+                                         uint32_t * pNumEvents,
+                                         uint32_t timeout )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    uint8_t * pDst = pEventMsgs;
+    uint32_t numEvents = 0;
+
+    ( void ) pEventCtx;
+    ( void ) timeout;
+
+    /* Wait for the next event, then take the pending ones without blocking. */
+    if( ( xSemaphoreTake( otaEventCount, portMAX_DELAY ) == pdTRUE ) &&
+        ( receiveCountedEvent( pDst ) == pdTRUE ) )
+    {
+        numEvents = 1U;
+
+        while( ( numEvents < maxEvents ) &&
+               ( xSemaphoreTake( otaEventCount, ( TickType_t ) 0 ) == pdTRUE ) &&
+               ( receiveCountedEvent( &pDst[ numEvents * MAX_MSG_SIZE ] ) == pdTRUE ) )
+        {
+            numEvents++;
+        }
+
+        LogDebug( ( "OTA Events received: %u", ( unsigned ) numEvents ) );
+    }
+    else
+    {
+        otaOsStatus = OtaOsEventQueueReceiveFailed;
+
+        LogError( ( "Failed to receive event from OTA Event Queue: "
+                    "xQueueReceive returned error: "
+                    "OtaOsStatus_t=%i ",
+                    otaOsStatus ) );
+    }
+
+    *pNumEvents = numEvents;
+
+    return otaOsStatus;
+}
+
 OtaOsStatus_t OtaDeinitEvent_FreeRTOS( OtaEventContext_t * pEventCtx )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
@@ -168,40 +241,46 @@ OtaOsStatus_t OtaDeinitEvent_FreeRTOS( OtaEventContext_t * pEventCtx )
         LogDebug( ( "OTA Event Queue Deleted." ) );
     }
 
+    if( otaControlQueue != NULL )
+    {
+        vQueueDelete( otaControlQueue );
+    }
+
+    if( otaEventCount != NULL )
+    {
+        vSemaphoreDelete( otaEventCount );
+    }
+
     return otaOsStatus;
 }
 
-static void selfTestTimerCallback( TimerHandle_t T )
+static BaseType_t receiveCountedEvent( void * pEventMsg )
 {
-    ( void ) T;
-
-    LogDebug( ( "Self-test expired within %ums\r\n",
-                otaconfigSELF_TEST_RESPONSE_WAIT_MS ) );
+    /* The event is counted once it is in a queue, so one of them has it.*/
+    BaseType_t retVal = xQueueReceive( otaControlQueue, pEventMsg, ( TickType_t ) 0 );
 
-    if( otaTimerCallback != NULL )
+    if( retVal != pdTRUE )
     {
-        otaTimerCallback( OtaSelfTestTimer );
-    }
-    else
-    {
-        LogWarn( ( "Self-test timer event unhandled.\r\n" ) );
+        retVal = xQueueReceive( otaEventQueue, pEventMsg, ( TickType_t ) 0 );
     }
+
+    return retVal;
 }
 
-static void requestTimerCallback( TimerHandle_t T )
+static void timerCallback( TimerHandle_t T )
 {
-    ( void ) T;
+    /* The timer id is kept as the id of the FreeRTOS timer. */
+    OtaTimerId_t otaTimerId = ( OtaTimerId_t ) ( uintptr_t ) pvTimerGetTimerID( T );
 
-    LogDebug( ( "Request timer expired in %ums \r\n",
-                otaconfigFILE_REQUEST_WAIT_MS ) );
+    LogDebug( ( "OTA Timer expired for Timerid=%i.\r\n", otaTimerId ) );
 
     if( otaTimerCallback != NULL )
     {
-        otaTimerCallback( OtaRequestTimer );
+        otaTimerCallback( otaTimerId );
     }
     else
     {
-        LogWarn( ( "Request timer event unhandled.\r\n" ) );
+        LogWarn( ( "OTA Timer event unhandled for Timerid=%i.\r\n", otaTimerId ) );
     }
 }
 
@@ -215,7 +294,7 @@ OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerId_t otaTimerId,
 
     configASSERT( callback != NULL );
     configASSERT( pTimerName != NULL );
-    configASSERT( ( otaTimerId >= OtaRequestTimer ) && ( otaTimerId < OtaNumOfTimers ) );
+    configASSERT( ( otaTimerId >= OtaRequestTimer ) && ( ( uint32_t ) otaTimerId < OTA_NUM_TIMER_IDS ) );
 
     /* Set OTA lib callback. */
     otaTimerCallback = callback;
@@ -227,8 +306,8 @@ OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerId_t otaTimerId,
         otaTimer[ otaTimerId ] = xTimerCreate( pTimerName,
                                                pdMS_TO_TICKS( timeout ),
                                                pdFALSE,
-                                               NULL,
-                                               timerCallback[ otaTimerId ] );
+                                               ( void * ) ( uintptr_t ) otaTimerId,
+                                               timerCallback );
 
         if( otaTimer[ otaTimerId ] == NULL )
         {
@@ -287,7 +366,7 @@ OtaOsStatus_t OtaStopTimer_FreeRTOS( OtaTimerId_t otaTimerId )
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
     BaseType_t retVal = pdFALSE;
 
-    configASSERT( ( otaTimerId >= OtaRequestTimer ) && ( otaTimerId < OtaNumOfTimers ) );
+    configASSERT( ( otaTimerId >= OtaRequestTimer ) && ( ( uint32_t ) otaTimerId < OTA_NUM_TIMER_IDS ) );
 
     if( otaTimer[ otaTimerId ] != NULL )
     {
@@ -321,7 +400,7 @@ OtaOsStatus_t OtaDeleteTimer_FreeRTOS( OtaTimerId_t otaTimerId )
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
     BaseType_t retVal = pdFALSE;
 
-    configASSERT( ( otaTimerId >= OtaRequestTimer ) && ( otaTimerId < OtaNumOfTimers ) );
+    configASSERT( ( otaTimerId >= OtaRequestTimer ) && ( ( uint32_t ) otaTimerId < OTA_NUM_TIMER_IDS ) );
 
     if( otaTimer[ otaTimerId ] != NULL )
     {
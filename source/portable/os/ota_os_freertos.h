@@ -51,6 +51,9 @@ OtaOsStatus_t OtaInitEvent_FreeRTOS( OtaEventContext_t * pEventCtx );
  * @brief Sends an OTA event.
  *
  * This function sends an event to OTA library event handler on FreeRTOS platforms.
+ * The control events go to a queue of their own, received before the queue of
+ * the file blocks, so that the file blocks neither delay them nor fill the
+ * room they need. It requires configUSE_COUNTING_SEMAPHORES.
  *
  * @param[pEventCtx]     Pointer to the OTA event context.
  *
@@ -81,6 +84,30 @@ OtaOsStatus_t OtaReceiveEvent_FreeRTOS( OtaEventContext_t * pEventCtx,
                                         void * pEventMsg,
                                         uint32_t timeout );
 
+/**
+ * @brief Receive the pending OTA events.
+ *
+ * This function waits for the next event, then receives the events already
+ * pending without blocking on FreeRTOS platforms.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsgs]    Pointer to store maxEvents messages.
+ *
+ * @param[maxEvents]     The maximum number of events to receive.
+ *
+ * @param[pNumEvents]    Pointer to store the number of events received.
+ *
+ * @param[timeout]       The maximum amount of time the task should block.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t OtaReceiveEvents_FreeRTOS( OtaEventContext_t * pEventCtx,
+                                         void * pEventMsgs,
+                                         uint32_t maxEvents,
+                                         uint32_t * pNumEvents,
+                                         uint32_t timeout );
+
 /**
  * @brief Deinitialize the OTA Events mechanism.
  *
@@ -99,7 +126,7 @@ OtaOsStatus_t OtaDeinitEvent_FreeRTOS( OtaEventContext_t * pEventCtx );
  *
  * This function starts the timer or resets it if it is already started on FreeRTOS platforms.
  *
- * @param[otaTimerId]       Timer ID of type otaTimerId_t.
+ * @param[otaTimerId]       Timer ID of type otaTimerId_t, below OTA_NUM_TIMER_IDS.
  *
  * @param[pTimerName]       Timer name.
  *
@@ -119,7 +146,7 @@ OtaOsStatus_t OtaStartTimer_FreeRTOS( OtaTimerId_t otaTimerId,
  *
  * This function stops the timer on FreeRTOS platforms.
  *
- * @param[otaTimerId]     Timer ID of type otaTimerId_t.
+ * @param[otaTimerId]     Timer ID of type otaTimerId_t, below OTA_NUM_TIMER_IDS.
  *
  * @return                OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
@@ -130,7 +157,7 @@ OtaOsStatus_t OtaStopTimer_FreeRTOS( OtaTimerId_t otaTimerId );
  *
  * This function deletes a timer for POSIX platforms.
  *
- * @param[otaTimerId]       Timer ID of type otaTimerId_t.
+ * @param[otaTimerId]       Timer ID of type otaTimerId_t, below OTA_NUM_TIMER_IDS.
  *
  * @return                  OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
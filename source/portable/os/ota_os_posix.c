@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <assert.h>
 
 /* MISRA rule 21.5 prohibits the use of signal.h because of undefined behavior. However, this
  * implementation is on POSIX, which has well defined behavior. We're using the timer functionality
@@ -40,6 +41,7 @@
 /* Posix includes. */
 #include <sys/types.h>
 #include <mqueue.h>
+#include <pthread.h>
 
 /* OTA OS POSIX Interface Includes.*/
 #include "ota_os_posix.h"
@@ -52,20 +54,61 @@
 #define MAX_MESSAGES      10
 #define MAX_MSG_SIZE      sizeof( OtaEventMsg_t )
 
-static void requestTimerCallback( union sigval arg );
-static void selfTestTimerCallback( union sigval arg );
+/* Number of messages of the queue kept for the control events, the file
+ * blocks are not sent when only these are left.*/
+#define MAX_CONTROL_MESSAGES    3
+
+/* Priorities of the messages, the control events are received first.*/
+#define DATA_PRIORITY           0U
+#define CONTROL_PRIORITY        1U
+
+/* An event of the in-process ring, with the position it can next be sent or
+ * received at. */
+typedef struct RingEventSlot
+{
+    uint32_t sequence;
+    OtaEventMsg_t eventMsg;
+} RingEventSlot_t;
+
+/* A lane of the in-process ring. The senders claim a position with a compare
+ * and swap, and only the OTA agent task receives.*/
+typedef struct EventRing
+{
+    RingEventSlot_t * pSlots;
+    uint32_t size;
+    uint32_t sendPosition;
+    uint32_t receivePosition;
+} EventRing_t;
+
+static void timerCallback( union sigval arg );
 
 static OtaTimerCallback_t otaTimerCallback;
 
 /* OTA Event queue attributes.*/
 static mqd_t otaEventQueue;
 
-/* OTA Timer handles.*/
-static timer_t otaTimers[ OtaNumOfTimers ];
-static timer_t * pOtaTimers[ OtaNumOfTimers ] = { 0 };
-
-/* OTA Timer callbacks.*/
-static void ( * timerCallback[ OtaNumOfTimers ] )( union sigval arg ) = { requestTimerCallback, selfTestTimerCallback };
+/* In-process event ring, with a lane for the control events that is received
+ * before the lane of the file blocks. The OTA agent task sleeps on the
+ * condition variable when both are empty.*/
+static RingEventSlot_t dataRingSlots[ OTA_POSIX_EVENT_RING_SIZE ];
+static RingEventSlot_t controlRingSlots[ OTA_POSIX_CONTROL_RING_SIZE ];
+static EventRing_t dataRing = { dataRingSlots, OTA_POSIX_EVENT_RING_SIZE, 0, 0 };
+static EventRing_t controlRing = { controlRingSlots, OTA_POSIX_CONTROL_RING_SIZE, 0, 0 };
+static uint32_t ringReceiverWaiting;
+static bool ringInitialized = false;
+static pthread_mutex_t ringMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ringCondition = PTHREAD_COND_INITIALIZER;
+
+static void initRing( EventRing_t * pRing );
+static bool sendRingEvent( EventRing_t * pRing,
+                           const void * pEventMsg );
+static bool receiveFromRing( EventRing_t * pRing,
+                             void * pEventMsg );
+static bool receiveRingEvent( void * pEventMsg );
+
+/* OTA Timer handles, for the timers of all the agent instances.*/
+static timer_t otaTimers[ OTA_NUM_TIMER_IDS ];
+static timer_t * pOtaTimers[ OTA_NUM_TIMER_IDS ] = { 0 };
 
 OtaOsStatus_t Posix_OtaInitEvent( OtaEventContext_t * pEventCtx )
 {
@@ -116,27 +159,50 @@ OtaOsStatus_t Posix_OtaSendEvent( OtaEventContext_t * pEventCtx,
                                   unsigned int timeout )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    struct mq_attr attr;
+    unsigned int priority = CONTROL_PRIORITY;
 
     ( void ) pEventCtx;
     ( void ) timeout;
 
-    /* Send the event to OTA event queue.*/
-    errno = 0;
-
-    if( mq_send( otaEventQueue, pEventMsg, MAX_MSG_SIZE, 0 ) == -1 )
+    /* The control events are received before the file blocks, and the file
+     * blocks leave room in the queue for them.*/
+    if( !OTA_IS_CONTROL_EVENT( ( const OtaEventMsg_t * ) pEventMsg ) )
     {
-        otaOsStatus = OtaOsEventQueueSendFailed;
+        priority = DATA_PRIORITY;
 
-        LogError( ( "Failed to send event to OTA Event Queue: "
-                    "mq_send returned error: "
-                    "OtaOsStatus_t=%i "
-                    ",errno=%s",
-                    otaOsStatus,
-                    strerror( errno ) ) );
+        if( ( mq_getattr( otaEventQueue, &attr ) == 0 ) &&
+            ( attr.mq_curmsgs >= ( MAX_MESSAGES - MAX_CONTROL_MESSAGES ) ) )
+        {
+            otaOsStatus = OtaOsEventQueueSendFailed;
+
+            LogError( ( "Failed to send file block to OTA Event Queue: "
+                        "The messages left are kept for control events: "
+                        "OtaOsStatus_t=%i",
+                        otaOsStatus ) );
+        }
     }
-    else
+
+    if( otaOsStatus == OtaOsSuccess )
     {
-        LogDebug( ( "OTA Event Sent." ) );
+        /* Send the event to OTA event queue.*/
+        errno = 0;
+
+        if( mq_send( otaEventQueue, pEventMsg, MAX_MSG_SIZE, priority ) == -1 )
+        {
+            otaOsStatus = OtaOsEventQueueSendFailed;
+
+            LogError( ( "Failed to send event to OTA Event Queue: "
+                        "mq_send returned error: "
+                        "OtaOsStatus_t=%i "
+                        ",errno=%s",
+                        otaOsStatus,
+                        strerror( errno ) ) );
+        }
+        else
+        {
+            LogDebug( ( "OTA Event Sent." ) );
+        }
     }
 
     return otaOsStatus;
@@ -178,6 +244,106 @@ OtaOsStatus_t Posix_OtaReceiveEvent( OtaEventContext_t * pEventCtx,
     return otaOsStatus;
 }
 
+OtaOsStatus_t Posix_OtaReceiveEvents( OtaEventContext_t * pEventCtx,
+                                      void * pEventMsgs,
+                                      uint32_t maxEvents,
+                                      uint32_t * pNumEvents,
+                                      uint32_t timeout )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    char * pDst = pEventMsgs;
+    struct mq_attr attr;
+    uint32_t numEvents = 0;
+    uint32_t numPending = 0;
+
+    ( void ) pEventCtx;
+    ( void ) timeout;
+
+    /* Wait for the next event from OTA event queue, received in place.*/
+    errno = 0;
+
+    if( mq_receive( otaEventQueue, pDst, MAX_MSG_SIZE, NULL ) == -1 )
+    {
+        otaOsStatus = OtaOsEventQueueReceiveFailed;
+
+        LogError( ( "Failed to receive OTA Event: "
+                    "mq_reqeive returned error: "
+                    "OtaOsStatus_t=%i "
+                    ",errno=%s",
+                    otaOsStatus,
+                    strerror( errno ) ) );
+    }
+    else
+    {
+        numEvents = 1U;
+
+        /* Only the OTA agent task receives from the queue, so the events pending
+         * now can be received without blocking.*/
+        if( mq_getattr( otaEventQueue, &attr ) == 0 )
+        {
+            numPending = ( uint32_t ) attr.mq_curmsgs;
+        }
+
+        while( ( numEvents < maxEvents ) && ( numPending > 0U ) &&
+               ( mq_receive( otaEventQueue, &pDst[ numEvents * MAX_MSG_SIZE ], MAX_MSG_SIZE, NULL ) != -1 ) )
+        {
+            numEvents++;
+            numPending--;
+        }
+
+        LogDebug( ( "OTA Events received: %u", ( unsigned ) numEvents ) );
+    }
+
+    *pNumEvents = numEvents;
+
+    return otaOsStatus;
+}
+
+OtaOsStatus_t Posix_OtaPollEvents( OtaEventContext_t * pEventCtx,
+                                   void * pEventMsgs,
+                                   uint32_t maxEvents,
+                                   uint32_t * pNumEvents )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    char * pDst = pEventMsgs;
+    struct timespec noWait = { 0 };
+    uint32_t numEvents = 0;
+    bool polling = true;
+
+    ( void ) pEventCtx;
+
+    /* A time in the past, so that an empty queue is reported at once.*/
+    while( ( polling == true ) && ( numEvents < maxEvents ) )
+    {
+        errno = 0;
+
+        if( mq_timedreceive( otaEventQueue, &pDst[ numEvents * MAX_MSG_SIZE ], MAX_MSG_SIZE, NULL, &noWait ) != -1 )
+        {
+            numEvents++;
+        }
+        else
+        {
+            polling = false;
+
+            if( errno != ETIMEDOUT )
+            {
+                otaOsStatus = OtaOsEventQueueReceiveFailed;
+
+                LogError( ( "Failed to poll OTA Events: "
+                            "mq_timedreceive returned error: "
+                            "OtaOsStatus_t=%i "
+                            ",errno=%s",
+                            otaOsStatus,
+                            strerror( errno ) ) );
+            }
+        }
+    }
+
+    *pNumEvents = numEvents;
+
+    return otaOsStatus;
+}
+
 OtaOsStatus_t Posix_OtaDeinitEvent( OtaEventContext_t * pEventCtx )
 {
     OtaOsStatus_t otaOsStatus = OtaOsSuccess;
@@ -206,37 +372,304 @@ OtaOsStatus_t Posix_OtaDeinitEvent( OtaEventContext_t * pEventCtx )
     return otaOsStatus;
 }
 
-static void selfTestTimerCallback( union sigval arg )
+/* Give all the positions of a lane of the ring to the senders. */
+static void initRing( EventRing_t * pRing )
 {
-    ( void ) arg;
+    uint32_t i = 0;
 
-    LogDebug( ( "Self-test expired within %ums\r\n",
-                otaconfigSELF_TEST_RESPONSE_WAIT_MS ) );
+    /* The positions wrap around with the ring only if its size is a power of 2.*/
+    assert( ( pRing->size & ( pRing->size - 1U ) ) == 0U );
 
-    if( otaTimerCallback != NULL )
+    for( i = 0; i < pRing->size; i++ )
     {
-        otaTimerCallback( OtaSelfTestTimer );
+        pRing->pSlots[ i ].sequence = i;
+    }
+
+    pRing->sendPosition = 0;
+    pRing->receivePosition = 0;
+}
+
+OtaOsStatus_t Posix_OtaInitRingEvent( OtaEventContext_t * pEventCtx )
+{
+    ( void ) pEventCtx;
+
+    ( void ) pthread_mutex_lock( &ringMutex );
+
+    initRing( &controlRing );
+    initRing( &dataRing );
+    __atomic_store_n( &ringInitialized, true, __ATOMIC_RELEASE );
+
+    ( void ) pthread_mutex_unlock( &ringMutex );
+
+    LogDebug( ( "OTA Event ring created." ) );
+
+    return OtaOsSuccess;
+}
+
+/* Send an event to a lane of the ring, unless it is full. */
+static bool sendRingEvent( EventRing_t * pRing,
+                           const void * pEventMsg )
+{
+    RingEventSlot_t * pSlot = NULL;
+    uint32_t position = 0;
+    uint32_t sequence = 0;
+    bool sent = false;
+    bool sending = true;
+
+    /* Claim the next position, unless the event at it has not been received yet.*/
+    position = __atomic_load_n( &pRing->sendPosition, __ATOMIC_RELAXED );
+
+    while( sending == true )
+    {
+        pSlot = &pRing->pSlots[ position & ( pRing->size - 1U ) ];
+        sequence = __atomic_load_n( &pSlot->sequence, __ATOMIC_ACQUIRE );
+
+        if( sequence == position )
+        {
+            if( __atomic_compare_exchange_n( &pRing->sendPosition, &position, position + 1U, true,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            {
+                sent = true;
+                sending = false;
+            }
+        }
+        else if( ( int32_t ) ( sequence - position ) < 0 )
+        {
+            /* The ring is full.*/
+            sending = false;
+        }
+        else
+        {
+            /* Another sender claimed the position.*/
+            position = __atomic_load_n( &pRing->sendPosition, __ATOMIC_RELAXED );
+        }
+    }
+
+    if( sent == true )
+    {
+        ( void ) memcpy( &pSlot->eventMsg, pEventMsg, MAX_MSG_SIZE );
+        __atomic_store_n( &pSlot->sequence, position + 1U, __ATOMIC_RELEASE );
+    }
+
+    return sent;
+}
+
+OtaOsStatus_t Posix_OtaSendRingEvent( OtaEventContext_t * pEventCtx,
+                                      const void * pEventMsg,
+                                      unsigned int timeout )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsEventQueueSendFailed;
+    EventRing_t * pRing = &dataRing;
+
+    ( void ) pEventCtx;
+    ( void ) timeout;
+
+    /* The file blocks are not let to fill the lane of the control events.*/
+    if( OTA_IS_CONTROL_EVENT( ( const OtaEventMsg_t * ) pEventMsg ) )
+    {
+        pRing = &controlRing;
+    }
+
+    if( ( __atomic_load_n( &ringInitialized, __ATOMIC_ACQUIRE ) == true ) &&
+        ( sendRingEvent( pRing, pEventMsg ) == true ) )
+    {
+        otaOsStatus = OtaOsSuccess;
+
+        /* The receiver either sees the event, or it said it is waiting before looking.*/
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+        if( __atomic_load_n( &ringReceiverWaiting, __ATOMIC_RELAXED ) != 0U )
+        {
+            ( void ) pthread_mutex_lock( &ringMutex );
+            ( void ) pthread_cond_signal( &ringCondition );
+            ( void ) pthread_mutex_unlock( &ringMutex );
+        }
+
+        LogDebug( ( "OTA Event Sent." ) );
     }
     else
     {
-        LogWarn( ( "Self-test timer event unhandled.\r\n" ) );
+        LogError( ( "Failed to send event to OTA Event ring: "
+                    "OtaOsStatus_t=%i ",
+                    otaOsStatus ) );
     }
+
+    return otaOsStatus;
+}
+
+/* Receive the next event from a lane of the ring, if there is one. */
+static bool receiveFromRing( EventRing_t * pRing,
+                             void * pEventMsg )
+{
+    RingEventSlot_t * pSlot = &pRing->pSlots[ pRing->receivePosition & ( pRing->size - 1U ) ];
+    bool received = false;
+
+    if( __atomic_load_n( &pSlot->sequence, __ATOMIC_ACQUIRE ) == ( pRing->receivePosition + 1U ) )
+    {
+        ( void ) memcpy( pEventMsg, &pSlot->eventMsg, MAX_MSG_SIZE );
+
+        /* Give the slot back to the senders, for the next time around the ring.*/
+        __atomic_store_n( &pSlot->sequence, pRing->receivePosition + pRing->size, __ATOMIC_RELEASE );
+        pRing->receivePosition++;
+        received = true;
+    }
+
+    return received;
+}
+
+/* Receive the next event from the ring, the control events first. */
+static bool receiveRingEvent( void * pEventMsg )
+{
+    bool received = receiveFromRing( &controlRing, pEventMsg );
+
+    if( received == false )
+    {
+        received = receiveFromRing( &dataRing, pEventMsg );
+    }
+
+    return received;
+}
+
+OtaOsStatus_t Posix_OtaReceiveRingEvent( OtaEventContext_t * pEventCtx,
+                                         void * pEventMsg,
+                                         uint32_t timeout )
+{
+    uint32_t numEvents = 0;
+
+    return Posix_OtaReceiveRingEvents( pEventCtx, pEventMsg, 1U, &numEvents, timeout );
+}
+
+OtaOsStatus_t Posix_OtaReceiveRingEvents( OtaEventContext_t * pEventCtx,
+                                          void * pEventMsgs,
+                                          uint32_t maxEvents,
+                                          uint32_t * pNumEvents,
+                                          uint32_t timeout )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    uint8_t * pDst = pEventMsgs;
+    uint32_t numEvents = 0;
+    bool received = false;
+
+    ( void ) pEventCtx;
+    ( void ) timeout;
+
+    if( __atomic_load_n( &ringInitialized, __ATOMIC_ACQUIRE ) == false )
+    {
+        otaOsStatus = OtaOsEventQueueReceiveFailed;
+
+        LogError( ( "Failed to receive OTA Event: "
+                    "The event ring is not initialized: "
+                    "OtaOsStatus_t=%i ",
+                    otaOsStatus ) );
+    }
+    else
+    {
+        received = receiveRingEvent( pDst );
+
+        /* Wait for the next event, saying so before looking at the ring again.*/
+        if( received == false )
+        {
+            ( void ) pthread_mutex_lock( &ringMutex );
+            __atomic_store_n( &ringReceiverWaiting, 1U, __ATOMIC_RELAXED );
+            __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+            received = receiveRingEvent( pDst );
+
+            while( received == false )
+            {
+                ( void ) pthread_cond_wait( &ringCondition, &ringMutex );
+                received = receiveRingEvent( pDst );
+            }
+
+            __atomic_store_n( &ringReceiverWaiting, 0U, __ATOMIC_RELAXED );
+            ( void ) pthread_mutex_unlock( &ringMutex );
+        }
+
+        numEvents = 1U;
+
+        while( ( numEvents < maxEvents ) && ( receiveRingEvent( &pDst[ numEvents * MAX_MSG_SIZE ] ) == true ) )
+        {
+            numEvents++;
+        }
+
+        LogDebug( ( "OTA Events received: %u", ( unsigned ) numEvents ) );
+    }
+
+    *pNumEvents = numEvents;
+
+    return otaOsStatus;
+}
+
+OtaOsStatus_t Posix_OtaPollRingEvents( OtaEventContext_t * pEventCtx,
+                                       void * pEventMsgs,
+                                       uint32_t maxEvents,
+                                       uint32_t * pNumEvents )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+    uint8_t * pDst = pEventMsgs;
+    uint32_t numEvents = 0;
+
+    ( void ) pEventCtx;
+
+    if( __atomic_load_n( &ringInitialized, __ATOMIC_ACQUIRE ) == false )
+    {
+        otaOsStatus = OtaOsEventQueueReceiveFailed;
+
+        LogError( ( "Failed to poll OTA Events: "
+                    "The event ring is not initialized: "
+                    "OtaOsStatus_t=%i ",
+                    otaOsStatus ) );
+    }
+    else
+    {
+        while( ( numEvents < maxEvents ) && ( receiveRingEvent( &pDst[ numEvents * MAX_MSG_SIZE ] ) == true ) )
+        {
+            numEvents++;
+        }
+    }
+
+    *pNumEvents = numEvents;
+
+    return otaOsStatus;
+}
+
+OtaOsStatus_t Posix_OtaDeinitRingEvent( OtaEventContext_t * pEventCtx )
+{
+    OtaOsStatus_t otaOsStatus = OtaOsSuccess;
+
+    ( void ) pEventCtx;
+
+    if( __atomic_exchange_n( &ringInitialized, false, __ATOMIC_ACQ_REL ) == false )
+    {
+        otaOsStatus = OtaOsEventQueueDeleteFailed;
+
+        LogError( ( "Failed to delete OTA Event ring: "
+                    "The event ring is not initialized: "
+                    "OtaOsStatus_t=%i ",
+                    otaOsStatus ) );
+    }
+    else
+    {
+        LogDebug( ( "OTA Event ring deleted." ) );
+    }
+
+    return otaOsStatus;
 }
 
-static void requestTimerCallback( union sigval arg )
+static void timerCallback( union sigval arg )
 {
-    ( void ) arg;
+    /* The timer id is passed in the signal value. */
+    OtaTimerId_t otaTimerId = ( OtaTimerId_t ) arg.sival_int;
 
-    LogDebug( ( "Request timer expired in %ums \r\n",
-                otaconfigFILE_REQUEST_WAIT_MS ) );
+    LogDebug( ( "OTA Timer expired for Timerid=%i.\r\n", otaTimerId ) );
 
     if( otaTimerCallback != NULL )
     {
-        otaTimerCallback( OtaRequestTimer );
+        otaTimerCallback( otaTimerId );
     }
     else
     {
-        LogWarn( ( "Request timer event unhandled.\r\n" ) );
+        LogWarn( ( "OTA Timer event unhandled for Timerid=%i.\r\n", otaTimerId ) );
     }
 }
 
@@ -259,14 +692,16 @@ OtaOsStatus_t Posix_OtaStartTimer( OtaTimerId_t otaTimerId,
 
     /* Set attributes. */
     sgEvent.sigev_notify = SIGEV_THREAD;
-    sgEvent.sigev_value.sival_ptr = otaTimers[ otaTimerId ];
-    sgEvent.sigev_notify_function = timerCallback[ otaTimerId ];
+    sgEvent.sigev_value.sival_int = ( int ) otaTimerId;
+    sgEvent.sigev_notify_function = timerCallback;
 
     /* Set OTA lib callback. */
     otaTimerCallback = callback;
 
-    /* Set timeout attributes.*/
+    /* Set timeout attributes, with the milliseconds below a second, as the
+     * ticks of the request timer can be shorter than that. */
     timerAttr.it_value.tv_sec = ( time_t ) timeout / 1000;
+    timerAttr.it_value.tv_nsec = ( long ) ( timeout % 1000U ) * 1000000L;
 
     /* Create timer if required.*/
     if( pOtaTimers[ otaTimerId ] == NULL )
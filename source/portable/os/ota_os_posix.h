@@ -42,6 +42,22 @@ struct OtaTimerContext
     OtaTimerId_t timerId;
 };
 
+/**
+ * @brief Number of file blocks held by the in-process event ring. It must be
+ * a power of 2.
+ */
+#ifndef OTA_POSIX_EVENT_RING_SIZE
+    #define OTA_POSIX_EVENT_RING_SIZE    32U
+#endif
+
+/**
+ * @brief Number of control events held by the in-process event ring, next to
+ * the file blocks. It must be a power of 2.
+ */
+#ifndef OTA_POSIX_CONTROL_RING_SIZE
+    #define OTA_POSIX_CONTROL_RING_SIZE    8U
+#endif
+
 /**
  * @brief Initialize the OTA events.
  *
@@ -57,6 +73,9 @@ OtaOsStatus_t Posix_OtaInitEvent( OtaEventContext_t * pEventCtx );
  * @brief Sends an OTA event.
  *
  * This function sends an event to OTA library event handler for POSIX platforms.
+ * The control events are received before the file blocks already queued, and
+ * a file block is not sent when the queue only has room left for a few
+ * control events.
  *
  * @param[pEventCtx]     Pointer to the OTA event context.
  *
@@ -87,6 +106,48 @@ OtaOsStatus_t Posix_OtaReceiveEvent( OtaEventContext_t * pEventCtx,
                                      void * pEventMsg,
                                      uint32_t timeout );
 
+/**
+ * @brief Receive the pending OTA events.
+ *
+ * This function waits for the next event, then receives the events already
+ * pending without blocking on POSIX platforms.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsgs]    Pointer to store maxEvents messages.
+ *
+ * @param[maxEvents]     The maximum number of events to receive.
+ *
+ * @param[pNumEvents]    Pointer to store the number of events received.
+ *
+ * @param[timeout]       The maximum amount of time the task should block.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaReceiveEvents( OtaEventContext_t * pEventCtx,
+                                      void * pEventMsgs,
+                                      uint32_t maxEvents,
+                                      uint32_t * pNumEvents,
+                                      uint32_t timeout );
+
+/**
+ * @brief Receive the pending OTA events without waiting.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsgs]    Pointer to store maxEvents messages.
+ *
+ * @param[maxEvents]     The maximum number of events to receive.
+ *
+ * @param[pNumEvents]    Pointer to store the number of events received.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaPollEvents( OtaEventContext_t * pEventCtx,
+                                   void * pEventMsgs,
+                                   uint32_t maxEvents,
+                                   uint32_t * pNumEvents );
+
 /**
  * @brief Deinitialize the OTA Events mechanism.
  *
@@ -99,13 +160,108 @@ OtaOsStatus_t Posix_OtaReceiveEvent( OtaEventContext_t * pEventCtx,
  */
 OtaOsStatus_t Posix_OtaDeinitEvent( OtaEventContext_t * pEventCtx );
 
+/**
+ * @brief Initialize the OTA events in process memory.
+ *
+ * This function initializes a ring of events in process memory, as an
+ * alternative to the POSIX message queue. Events can be sent from any thread
+ * without a system call, and only the OTA agent task receives them. The ring
+ * has two lanes: OTA_POSIX_CONTROL_RING_SIZE control events, received first,
+ * and OTA_POSIX_EVENT_RING_SIZE file blocks, so that the file blocks never
+ * delay or crowd out the control and timer events. An event sent while its
+ * lane is full is dropped.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaInitRingEvent( OtaEventContext_t * pEventCtx );
+
+/**
+ * @brief Sends an OTA event to the in-process event ring.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsg]     Event to be sent to the OTA handler.
+ *
+ * @param[timeout]       The maximum amount of time (msec) the task should block.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaSendRingEvent( OtaEventContext_t * pEventCtx,
+                                      const void * pEventMsg,
+                                      unsigned int timeout );
+
+/**
+ * @brief Receive an OTA event from the in-process event ring.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsg]     Pointer to store message.
+ *
+ * @param[timeout]       The maximum amount of time the task should block.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaReceiveRingEvent( OtaEventContext_t * pEventCtx,
+                                         void * pEventMsg,
+                                         uint32_t timeout );
+
+/**
+ * @brief Receive the pending OTA events from the in-process event ring.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsgs]    Pointer to store maxEvents messages.
+ *
+ * @param[maxEvents]     The maximum number of events to receive.
+ *
+ * @param[pNumEvents]    Pointer to store the number of events received.
+ *
+ * @param[timeout]       The maximum amount of time the task should block.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaReceiveRingEvents( OtaEventContext_t * pEventCtx,
+                                          void * pEventMsgs,
+                                          uint32_t maxEvents,
+                                          uint32_t * pNumEvents,
+                                          uint32_t timeout );
+
+/**
+ * @brief Receive the pending OTA events from the in-process event ring without waiting.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @param[pEventMsgs]    Pointer to store maxEvents messages.
+ *
+ * @param[maxEvents]     The maximum number of events to receive.
+ *
+ * @param[pNumEvents]    Pointer to store the number of events received.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaPollRingEvents( OtaEventContext_t * pEventCtx,
+                                       void * pEventMsgs,
+                                       uint32_t maxEvents,
+                                       uint32_t * pNumEvents );
+
+/**
+ * @brief Deinitialize the OTA events in process memory.
+ *
+ * @param[pEventCtx]     Pointer to the OTA event context.
+ *
+ * @return               OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
+ */
+OtaOsStatus_t Posix_OtaDeinitRingEvent( OtaEventContext_t * pEventCtx );
+
 
 /**
  * @brief Start timer.
  *
  * This function starts the timer or resets it if it is already started for POSIX platforms.
  *
- * @param[otaTimerId]       Timer ID of type otaTimerId_t.
+ * @param[otaTimerId]       Timer ID of type otaTimerId_t, below OTA_NUM_TIMER_IDS.
  *
  * @param[pTimerName]       Timer name.
  *
@@ -125,7 +281,7 @@ OtaOsStatus_t Posix_OtaStartTimer( OtaTimerId_t otaTimerId,
  *
  * This function stops the timer fro POSIX platforms.
  *
- * @param[otaTimerId]     Timer ID of type otaTimerId_t.
+ * @param[otaTimerId]     Timer ID of type otaTimerId_t, below OTA_NUM_TIMER_IDS.
  *
  * @return                OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
@@ -136,7 +292,7 @@ OtaOsStatus_t Posix_OtaStopTimer( OtaTimerId_t otaTimerId );
  *
  * This function deletes a timer for POSIX platforms.
  *
- * @param[otaTimerId]       Timer ID of type otaTimerId_t.
+ * @param[otaTimerId]       Timer ID of type otaTimerId_t, below OTA_NUM_TIMER_IDS.
  *
  * @return                  OtaOsStatus_t, OtaOsSuccess if success , other error code on failure.
  */
@@ -0,0 +1,406 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_pal_posix.c
+ * @brief Example implementation of the OTA PAL for POSIX. The file received is
+ * allocated on the disk when it is created and mapped, so that the blocks are
+ * written with a copy each instead of a seek and a write.
+ */
+
+/* Standard Includes.*/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+/* Posix includes. */
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* OTA PAL POSIX Interface Includes.*/
+#include "ota_pal_posix.h"
+
+/* A file open for writing, mapped into memory. */
+typedef struct PalFile
+{
+    int fd;
+    uint8_t * pMapping;
+    uint32_t size;
+    bool inUse;
+} PalFile_t;
+
+/* The files open, pointed to by the pFile member of their file context. */
+static PalFile_t palFiles[ OTA_PAL_POSIX_MAX_OPEN_FILES ];
+
+/* The function checking the signatures of the files received. */
+static Posix_OtaPalCheckSignature_t palCheckSignature = NULL;
+
+/* Get the file open for a file context, NULL if there is none. */
+static PalFile_t * getPalFile( const OtaFileContext_t * const pFileContext )
+{
+    PalFile_t * pPalFile = NULL;
+    uint32_t i = 0;
+
+    if( pFileContext != NULL )
+    {
+        for( i = 0U; i < OTA_PAL_POSIX_MAX_OPEN_FILES; i++ )
+        {
+            if( ( palFiles[ i ].inUse == true ) && ( ( const void * ) pFileContext->pFile == ( const void * ) &palFiles[ i ] ) )
+            {
+                pPalFile = &palFiles[ i ];
+            }
+        }
+    }
+
+    return pPalFile;
+}
+
+/* Unmap and close a file, and release it. */
+static OtaPalStatus_t closePalFile( OtaFileContext_t * const pFileContext,
+                                    PalFile_t * pPalFile )
+{
+    OtaPalStatus_t status = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+
+    if( munmap( pPalFile->pMapping, pPalFile->size ) != 0 )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalFileClose, errno );
+    }
+
+    if( close( pPalFile->fd ) != 0 )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalFileClose, errno );
+    }
+
+    ( void ) memset( pPalFile, 0, sizeof( *pPalFile ) );
+    pFileContext->pFile = NULL;
+
+    return status;
+}
+
+void Posix_OtaPalSetSignatureCheck( Posix_OtaPalCheckSignature_t checkSignature )
+{
+    palCheckSignature = checkSignature;
+}
+
+OtaPalStatus_t Posix_OtaPalAbort( OtaFileContext_t * const pFileContext )
+{
+    OtaPalStatus_t status = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    PalFile_t * pPalFile = getPalFile( pFileContext );
+
+    if( pFileContext == NULL )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalNullFileContext, 0 );
+    }
+    else if( pPalFile != NULL )
+    {
+        status = closePalFile( pFileContext, pPalFile );
+
+        /* The part of the file received is of no use. */
+        if( unlink( ( const char * ) pFileContext->pFilePath ) != 0 )
+        {
+            status = OTA_PAL_COMBINE_ERR( OtaPalFileAbort, errno );
+        }
+    }
+    else
+    {
+        /* The file is not open, there is nothing to abort. */
+        pFileContext->pFile = NULL;
+    }
+
+    return status;
+}
+
+OtaPalStatus_t Posix_OtaPalCreateFileForRx( OtaFileContext_t * const pFileContext )
+{
+    OtaPalStatus_t status = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    PalFile_t * pPalFile = NULL;
+    void * pMapping = MAP_FAILED;
+    int fd = -1;
+    int err = 0;
+    uint32_t i = 0;
+
+    if( pFileContext == NULL )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalNullFileContext, 0 );
+    }
+    else if( ( pFileContext->pFilePath == NULL ) || ( pFileContext->fileSize == 0U ) )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, 0 );
+    }
+    else
+    {
+        for( i = 0U; ( i < OTA_PAL_POSIX_MAX_OPEN_FILES ) && ( pPalFile == NULL ); i++ )
+        {
+            if( palFiles[ i ].inUse == false )
+            {
+                pPalFile = &palFiles[ i ];
+            }
+        }
+
+        if( pPalFile == NULL )
+        {
+            LogError( ( "Failed to create file: No more than %u files can be open.",
+                        ( unsigned ) OTA_PAL_POSIX_MAX_OPEN_FILES ) );
+            status = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, 0 );
+        }
+    }
+
+    if( pPalFile != NULL )
+    {
+        fd = open( ( const char * ) pFileContext->pFilePath, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+
+        if( fd < 0 )
+        {
+            status = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, errno );
+        }
+        else
+        {
+            /* Allocate the whole file now, the blocks written to the mapping
+             * can't run out of space then. */
+            err = posix_fallocate( fd, 0, ( off_t ) pFileContext->fileSize );
+
+            if( err == ENOSPC )
+            {
+                status = OTA_PAL_COMBINE_ERR( OtaPalRxFileTooLarge, err );
+            }
+            else if( err != 0 )
+            {
+                status = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, err );
+            }
+            else
+            {
+                pMapping = mmap( NULL, pFileContext->fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+
+                if( pMapping == MAP_FAILED )
+                {
+                    status = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, errno );
+                }
+            }
+        }
+
+        if( OTA_PAL_MAIN_ERR( status ) == OtaPalSuccess )
+        {
+            pPalFile->fd = fd;
+            pPalFile->pMapping = ( uint8_t * ) pMapping;
+            pPalFile->size = pFileContext->fileSize;
+            pPalFile->inUse = true;
+
+            /* The file context holds a stdio file on Linux, it points to the
+             * mapped file instead. */
+            pFileContext->pFile = ( FILE * ) ( void * ) pPalFile;
+        }
+        else
+        {
+            LogError( ( "Failed to create file: "
+                        "OtaPalStatus_t=%u, "
+                        "errno=%s",
+                        ( unsigned ) status,
+                        strerror( ( int ) OTA_PAL_SUB_ERR( status ) ) ) );
+
+            if( fd >= 0 )
+            {
+                ( void ) close( fd );
+                ( void ) unlink( ( const char * ) pFileContext->pFilePath );
+            }
+        }
+    }
+
+    return status;
+}
+
+OtaPalStatus_t Posix_OtaPalCloseFile( OtaFileContext_t * const pFileContext )
+{
+    OtaPalStatus_t status = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    OtaPalStatus_t closeStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    PalFile_t * pPalFile = getPalFile( pFileContext );
+
+    if( pFileContext == NULL )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalNullFileContext, 0 );
+    }
+    else if( pPalFile == NULL )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
+    }
+    else
+    {
+        /* Write the whole file to the disk once, with the blocks of the
+         * mapping first, then the size allocated. */
+        if( msync( pPalFile->pMapping, pPalFile->size, MS_SYNC ) != 0 )
+        {
+            status = OTA_PAL_COMBINE_ERR( OtaPalFileClose, errno );
+        }
+        else if( fdatasync( pPalFile->fd ) != 0 )
+        {
+            status = OTA_PAL_COMBINE_ERR( OtaPalFileClose, errno );
+        }
+        else if( palCheckSignature == NULL )
+        {
+            LogError( ( "Failed to check the signature of the file: No signature check set." ) );
+            status = OTA_PAL_COMBINE_ERR( OtaPalSignatureCheckFailed, 0 );
+        }
+        else
+        {
+            /* The digest is computed on the pages still mapped. */
+            status = palCheckSignature( pFileContext, pPalFile->pMapping, pPalFile->size );
+        }
+
+        closeStatus = closePalFile( pFileContext, pPalFile );
+
+        if( OTA_PAL_MAIN_ERR( status ) != OtaPalSuccess )
+        {
+            /* A file failing the check can't be activated. */
+            ( void ) unlink( ( const char * ) pFileContext->pFilePath );
+        }
+        else
+        {
+            status = closeStatus;
+        }
+    }
+
+    return status;
+}
+
+int16_t Posix_OtaPalWriteBlock( OtaFileContext_t * const pFileContext,
+                                uint32_t offset,
+                                uint8_t * const pData,
+                                uint32_t blockSize )
+{
+    int16_t written = -1;
+    const PalFile_t * pPalFile = getPalFile( pFileContext );
+
+    if( ( pPalFile != NULL ) && ( pData != NULL ) && ( blockSize <= ( uint32_t ) INT16_MAX ) &&
+        ( offset <= pPalFile->size ) && ( blockSize <= ( pPalFile->size - offset ) ) )
+    {
+        ( void ) memcpy( &( pPalFile->pMapping[ offset ] ), pData, blockSize );
+        written = ( int16_t ) blockSize;
+    }
+    else
+    {
+        LogError( ( "Failed to write block: "
+                    "offset=%u, "
+                    "blockSize=%u",
+                    ( unsigned ) offset,
+                    ( unsigned ) blockSize ) );
+    }
+
+    return written;
+}
+
+OtaPalStatus_t Posix_OtaPalActivateNewImage( OtaFileContext_t * const pFileContext )
+{
+    /* The application restarts itself on the new image. */
+    return Posix_OtaPalResetDevice( pFileContext );
+}
+
+OtaPalStatus_t Posix_OtaPalResetDevice( OtaFileContext_t * const pFileContext )
+{
+    ( void ) pFileContext;
+
+    /* A Linux gateway is not reset by the OTA agent. */
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+OtaPalStatus_t Posix_OtaPalSetPlatformImageState( OtaFileContext_t * const pFileContext,
+                                                  OtaImageState_t eState )
+{
+    OtaPalStatus_t status = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    uint32_t state = ( uint32_t ) eState;
+    FILE * pStateFile = NULL;
+
+    ( void ) pFileContext;
+
+    if( ( eState == OtaImageStateUnknown ) || ( eState > OtaLastImageState ) )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalBadImageState, 0 );
+    }
+    else
+    {
+        pStateFile = fopen( OTA_PAL_POSIX_IMAGE_STATE_FILE, "wb" );
+
+        if( pStateFile == NULL )
+        {
+            status = OTA_PAL_COMBINE_ERR( OtaPalBadImageState, errno );
+        }
+        else
+        {
+            if( fwrite( &state, sizeof( state ), 1, pStateFile ) != 1U )
+            {
+                status = OTA_PAL_COMBINE_ERR( OtaPalBadImageState, errno );
+            }
+
+            if( fclose( pStateFile ) != 0 )
+            {
+                status = OTA_PAL_COMBINE_ERR( OtaPalBadImageState, errno );
+            }
+        }
+    }
+
+    return status;
+}
+
+OtaPalImageState_t Posix_OtaPalGetPlatformImageState( OtaFileContext_t * const pFileContext )
+{
+    OtaPalImageState_t imageState = OtaPalImageStateValid;
+    uint32_t state = ( uint32_t ) OtaImageStateAccepted;
+    FILE * pStateFile = NULL;
+
+    ( void ) pFileContext;
+
+    /* Without a state, the image is the one the device was installed with. */
+    pStateFile = fopen( OTA_PAL_POSIX_IMAGE_STATE_FILE, "rb" );
+
+    if( pStateFile != NULL )
+    {
+        if( fread( &state, sizeof( state ), 1, pStateFile ) != 1U )
+        {
+            state = ( uint32_t ) OtaImageStateUnknown;
+        }
+
+        ( void ) fclose( pStateFile );
+    }
+
+    switch( state )
+    {
+        case OtaImageStateTesting:
+            imageState = OtaPalImageStatePendingCommit;
+            break;
+
+        case OtaImageStateAccepted:
+            imageState = OtaPalImageStateValid;
+            break;
+
+        case OtaImageStateRejected:
+        case OtaImageStateAborted:
+            imageState = OtaPalImageStateInvalid;
+            break;
+
+        default:
+            imageState = OtaPalImageStateUnknown;
+            break;
+    }
+
+    return imageState;
+}
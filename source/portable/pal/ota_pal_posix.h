@@ -0,0 +1,179 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_pal_posix.h
+ * @brief Function declarations for the example OTA PAL for POSIX, which
+ * receives the file in a memory mapping of it.
+ */
+
+#ifndef OTA_PAL_POSIX_H_
+#define OTA_PAL_POSIX_H_
+
+/* Standard library include. */
+#include <stdint.h>
+
+/* OTA library interface include. */
+#include "ota_platform_interface.h"
+
+/**
+ * @brief Number of files the PAL can have open at once, the file of the
+ * update and those of the file sinks.
+ */
+#ifndef OTA_PAL_POSIX_MAX_OPEN_FILES
+    #define OTA_PAL_POSIX_MAX_OPEN_FILES    ( 1U + otaconfigMAX_NUM_FILE_SINKS )
+#endif
+
+/**
+ * @brief Path of the file storing the state of the image.
+ */
+#ifndef OTA_PAL_POSIX_IMAGE_STATE_FILE
+    #define OTA_PAL_POSIX_IMAGE_STATE_FILE    "PlatformImageState.txt"
+#endif
+
+/**
+ * @brief Check the signature of a file received.
+ *
+ * The function is called when the file is closed, with the whole file still
+ * mapped, so the digest is computed without reading the file again.
+ *
+ * @param[pFileContext]  OTA file context of the file, with its signature.
+ *
+ * @param[pFileData]     The content of the file.
+ *
+ * @param[fileSize]      Size of the file in bytes.
+ *
+ * @return               OtaPalSuccess if the signature is valid, OtaPalSignatureCheckFailed
+ *                       or another error code otherwise.
+ */
+typedef OtaPalStatus_t ( * Posix_OtaPalCheckSignature_t )( OtaFileContext_t * const pFileContext,
+                                                          const uint8_t * pFileData,
+                                                          uint32_t fileSize );
+
+/**
+ * @brief Set the function checking the signature of the files received.
+ *
+ * The PAL has no crypto library of its own. Every file fails the check until
+ * the function is set.
+ *
+ * @param[checkSignature]  The function checking the signatures, NULL to fail every file.
+ */
+void Posix_OtaPalSetSignatureCheck( Posix_OtaPalCheckSignature_t checkSignature );
+
+/**
+ * @brief Abort an OTA transfer.
+ *
+ * Unmaps and closes the file being received, and removes it.
+ *
+ * @param[pFileContext]  OTA file context information.
+ *
+ * @return               OtaPalSuccess if success, other error code on failure.
+ */
+OtaPalStatus_t Posix_OtaPalAbort( OtaFileContext_t * const pFileContext );
+
+/**
+ * @brief Create a new receive file.
+ *
+ * The file is allocated to its full size on the disk, so that the blocks
+ * can't fail to be written for lack of space, and mapped for writing.
+ *
+ * @param[pFileContext]  OTA file context information.
+ *
+ * @return               OtaPalSuccess if success, OtaPalRxFileTooLarge if the disk
+ *                       has no room for the file, other error code on failure.
+ */
+OtaPalStatus_t Posix_OtaPalCreateFileForRx( OtaFileContext_t * const pFileContext );
+
+/**
+ * @brief Authenticate and close the receive file.
+ *
+ * The mapping is written to the disk once, then the signature is checked on
+ * the mapped file. A file failing the check is removed.
+ *
+ * @param[pFileContext]  OTA file context information.
+ *
+ * @return               OtaPalSuccess if success, other error code on failure.
+ */
+OtaPalStatus_t Posix_OtaPalCloseFile( OtaFileContext_t * const pFileContext );
+
+/**
+ * @brief Write a block of data to the file at the given offset.
+ *
+ * The block is copied into the mapping, without a system call.
+ *
+ * @param[pFileContext]  OTA file context information.
+ *
+ * @param[offset]        Offset in the file of the block.
+ *
+ * @param[pData]         The block.
+ *
+ * @param[blockSize]     Size of the block in bytes.
+ *
+ * @return               The number of bytes written, -1 on failure.
+ */
+int16_t Posix_OtaPalWriteBlock( OtaFileContext_t * const pFileContext,
+                                uint32_t offset,
+                                uint8_t * const pData,
+                                uint32_t blockSize );
+
+/**
+ * @brief Activate the file received.
+ *
+ * @param[pFileContext]  OTA file context information.
+ *
+ * @return               OtaPalSuccess, the application restarts itself on the new image.
+ */
+OtaPalStatus_t Posix_OtaPalActivateNewImage( OtaFileContext_t * const pFileContext );
+
+/**
+ * @brief Reset the device.
+ *
+ * @param[pFileContext]  OTA file context information.
+ *
+ * @return               OtaPalSuccess, the device is not reset by the PAL.
+ */
+OtaPalStatus_t Posix_OtaPalResetDevice( OtaFileContext_t * const pFileContext );
+
+/**
+ * @brief Set the state of the image, in OTA_PAL_POSIX_IMAGE_STATE_FILE.
+ *
+ * @param[pFileContext]  OTA file context information.
+ *
+ * @param[eState]        The state of the image.
+ *
+ * @return               OtaPalSuccess if success, OtaPalBadImageState if the state
+ *                       is out of range, other error code on failure.
+ */
+OtaPalStatus_t Posix_OtaPalSetPlatformImageState( OtaFileContext_t * const pFileContext,
+                                                  OtaImageState_t eState );
+
+/**
+ * @brief Get the state of the image, from OTA_PAL_POSIX_IMAGE_STATE_FILE.
+ *
+ * @param[pFileContext]  OTA file context information.
+ *
+ * @return               The state of the image, OtaPalImageStateValid if no state
+ *                       was set.
+ */
+OtaPalImageState_t Posix_OtaPalGetPlatformImageState( OtaFileContext_t * const pFileContext );
+
+#endif /* ifndef OTA_PAL_POSIX_H_ */
@@ -0,0 +1,164 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file benchmark.h
+ * @brief Simulated streaming service, transport shims and RAM PAL shared by
+ * the OTA agent benchmark.
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* OTA library includes. */
+#include "ota.h"
+
+/**
+ * @brief Model of the network between the device and the service.
+ *
+ * Only the MQTT streams are subject to loss, reordering and duplication, the
+ * HTTP ranges are received over TCP, which hides them as extra latency.
+ */
+typedef struct BenchmarkNetwork
+{
+    const char * pName;        /*!< @brief Name of the network in the report. */
+    uint32_t rttMs;            /*!< @brief Round trip time between a request and its first block. */
+    uint32_t lossPercent;      /*!< @brief Percentage of the blocks lost on the way to the device. */
+    uint32_t reorderPercent;   /*!< @brief Percentage of the blocks held back by up to one more round trip. */
+    uint32_t duplicatePercent; /*!< @brief Percentage of the blocks received twice. */
+    uint32_t linkKbps;         /*!< @brief Rate of the link to the device in kbit/s, 0 when unlimited. */
+} BenchmarkNetwork_t;
+
+/**
+ * @brief Counters of the simulated service for one download.
+ */
+typedef struct BenchmarkCounters
+{
+    uint32_t requests;       /*!< @brief Block requests received from the agent. */
+    uint32_t blocksSent;     /*!< @brief Blocks sent, including the lost and duplicated ones. */
+    uint32_t blocksLost;     /*!< @brief Blocks lost by the network. */
+    uint32_t duplicatesSent; /*!< @brief Extra copies of blocks sent. */
+    uint32_t bufferDrops;    /*!< @brief Blocks dropped because no event buffer was free. */
+    uint32_t queueDrops;     /*!< @brief Blocks dropped because the event queue was full. */
+} BenchmarkCounters_t;
+
+/**
+ * @brief Get the time of the monotonic clock.
+ *
+ * @return Time in nanoseconds.
+ */
+uint64_t Benchmark_TimeNs( void );
+
+/**
+ * @brief Start serving an image to the agent.
+ *
+ * The job document is sent when the agent asks for the next job, the blocks
+ * are then sent as the agent requests them, over the network modeled.
+ *
+ * @param[in] pNetwork Network between the device and the service.
+ * @param[in] pImage Image served.
+ * @param[in] imageSize Size of the image in bytes.
+ * @param[in] useHttp true to serve the image over HTTP, false over MQTT.
+ * @param[in] seed Seed of the random numbers, so the runs can be repeated.
+ *
+ * @return true if the service is started.
+ */
+bool Benchmark_ServiceStart( const BenchmarkNetwork_t * pNetwork,
+                             const uint8_t * pImage,
+                             uint32_t imageSize,
+                             bool useHttp,
+                             uint32_t seed );
+
+/**
+ * @brief Stop the service and drop the blocks still on the way.
+ *
+ * @param[out] pCounters Counters of the download.
+ */
+void Benchmark_ServiceStop( BenchmarkCounters_t * pCounters );
+
+/**
+ * @brief MQTT interface of the agent, connected to the simulated service.
+ */
+OtaMqttStatus_t Benchmark_MqttSubscribe( const char * pTopicFilter,
+                                         uint16_t topicFilterLength,
+                                         uint8_t ucQoS );
+
+/**
+ * @copydoc Benchmark_MqttSubscribe
+ */
+OtaMqttStatus_t Benchmark_MqttUnsubscribe( const char * pTopicFilter,
+                                           uint16_t topicFilterLength,
+                                           uint8_t ucQoS );
+
+/**
+ * @copydoc Benchmark_MqttSubscribe
+ */
+OtaMqttStatus_t Benchmark_MqttPublish( const char * const pacTopic,
+                                       uint16_t usTopicLen,
+                                       const char * pcMsg,
+                                       uint32_t ulMsgSize,
+                                       uint8_t ucQoS );
+
+/**
+ * @brief HTTP interface of the agent, connected to the simulated service.
+ */
+OtaHttpStatus_t Benchmark_HttpInit( char * pUrl );
+
+/**
+ * @copydoc Benchmark_HttpInit
+ */
+OtaHttpStatus_t Benchmark_HttpRequest( uint32_t rangeStart,
+                                       uint32_t rangeEnd );
+
+/**
+ * @copydoc Benchmark_HttpInit
+ */
+OtaHttpStatus_t Benchmark_HttpDeinit( void );
+
+/**
+ * @brief Prepare the RAM PAL to receive an image.
+ *
+ * @param[in] pImage Image the file received is compared to when it is closed.
+ * @param[in] imageSize Size of the image in bytes.
+ *
+ * @return true if the RAM file is allocated.
+ */
+bool Benchmark_PalInit( const uint8_t * pImage,
+                        uint32_t imageSize );
+
+/**
+ * @brief Release the RAM file of the PAL.
+ */
+void Benchmark_PalDeinit( void );
+
+/**
+ * @brief Set the PAL interface of the agent to the RAM PAL.
+ *
+ * @param[out] pPal PAL interface to set.
+ */
+void Benchmark_PalSetInterface( OtaPalInterface_t * pPal );
+
+#endif /* ifndef BENCHMARK_H_ */
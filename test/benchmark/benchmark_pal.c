@@ -0,0 +1,163 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file benchmark_pal.c
+ * @brief PAL of the benchmark, the file is received in RAM and compared to
+ * the image served when it is closed.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "benchmark.h"
+
+/**
+ * @brief File being received, NULL when no file is open.
+ */
+static uint8_t * pRamFile = NULL;
+
+/**
+ * @brief Image the file received must match.
+ */
+static const uint8_t * pExpectedImage = NULL;
+
+/**
+ * @brief Size of the image in bytes.
+ */
+static uint32_t expectedImageSize = 0;
+
+static OtaPalStatus_t palAbort( OtaFileContext_t * const pFileContext )
+{
+    pFileContext->pFile = NULL;
+
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+static OtaPalStatus_t palCreateFile( OtaFileContext_t * const pFileContext )
+{
+    OtaPalStatus_t status = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, 0 );
+
+    if( ( pRamFile != NULL ) && ( pFileContext->fileSize == expectedImageSize ) )
+    {
+        ( void ) memset( pRamFile, 0, expectedImageSize );
+        pFileContext->pFile = ( FILE * ) pRamFile;
+        status = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    }
+
+    return status;
+}
+
+static OtaPalStatus_t palCloseFile( OtaFileContext_t * const pFileContext )
+{
+    OtaPalStatus_t status = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+
+    /* The image is not signed, the file is checked against the image instead. */
+    if( memcmp( pRamFile, pExpectedImage, expectedImageSize ) != 0 )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalSignatureCheckFailed, 0 );
+    }
+
+    pFileContext->pFile = NULL;
+
+    return status;
+}
+
+static int16_t palWriteBlock( OtaFileContext_t * const pFileContext,
+                              uint32_t offset,
+                              uint8_t * const pData,
+                              uint32_t blockSize )
+{
+    int16_t written = -1;
+
+    ( void ) pFileContext;
+
+    if( ( offset <= expectedImageSize ) && ( blockSize <= ( expectedImageSize - offset ) ) )
+    {
+        ( void ) memcpy( &( pRamFile[ offset ] ), pData, blockSize );
+        written = ( int16_t ) blockSize;
+    }
+
+    return written;
+}
+
+static OtaPalStatus_t palActivate( OtaFileContext_t * const pFileContext )
+{
+    ( void ) pFileContext;
+
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+static OtaPalStatus_t palReset( OtaFileContext_t * const pFileContext )
+{
+    ( void ) pFileContext;
+
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+static OtaPalStatus_t palSetImageState( OtaFileContext_t * const pFileContext,
+                                        OtaImageState_t eState )
+{
+    ( void ) pFileContext;
+    ( void ) eState;
+
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+static OtaPalImageState_t palGetImageState( OtaFileContext_t * const pFileContext )
+{
+    ( void ) pFileContext;
+
+    return OtaPalImageStateValid;
+}
+
+bool Benchmark_PalInit( const uint8_t * pImage,
+                        uint32_t imageSize )
+{
+    pRamFile = malloc( imageSize );
+    pExpectedImage = pImage;
+    expectedImageSize = imageSize;
+
+    return pRamFile != NULL;
+}
+
+void Benchmark_PalDeinit( void )
+{
+    free( pRamFile );
+    pRamFile = NULL;
+}
+
+void Benchmark_PalSetInterface( OtaPalInterface_t * pPal )
+{
+    ( void ) memset( pPal, 0, sizeof( *pPal ) );
+
+    pPal->abort = palAbort;
+    pPal->createFile = palCreateFile;
+    pPal->closeFile = palCloseFile;
+    pPal->writeBlock = palWriteBlock;
+    pPal->activate = palActivate;
+    pPal->reset = palReset;
+    pPal->setPlatformImageState = palSetImageState;
+    pPal->getPlatformImageState = palGetImageState;
+}
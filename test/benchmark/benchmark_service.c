@@ -0,0 +1,845 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file benchmark_service.c
+ * @brief Simulated jobs and streaming service, and the MQTT and HTTP shims
+ * connecting the agent to it.
+ *
+ * The service answers the requests of the agent as the AWS IoT Jobs and
+ * Streams services would. The messages it sends are held in a queue sorted by
+ * the time they reach the device, which a delivery thread empties into the
+ * event buffers of the agent as that time comes.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX includes. */
+#include <pthread.h>
+
+/* tinyCBOR include. */
+#include "cbor.h"
+
+/* OTA library includes. */
+#include "ota_cbor_private.h"
+#include "ota_event_buffer.h"
+
+#include "benchmark.h"
+
+/**
+ * @brief Maximum number of messages on the way to the device.
+ */
+#define BENCHMARK_MAX_DELIVERIES      4096U
+
+/**
+ * @brief Maximum size of the job document.
+ */
+#define BENCHMARK_JOB_DOC_MAX_SIZE    1024U
+
+/**
+ * @brief Number of nanoseconds in a millisecond.
+ */
+#define NS_PER_MS                     1000000U
+
+/**
+ * @brief Number of nanoseconds in a second.
+ */
+#define NS_PER_S                      1000000000U
+
+/**
+ * @brief Number of entries of the Get Stream Response message.
+ */
+#define GET_STREAM_RESPONSE_ITEM_COUNT    4U
+
+/**
+ * @brief Start of the job document served, up to the protocol of the file.
+ */
+#define JOB_DOC_PREFIX                                                                                          \
+    "{\"clientToken\":\"0:benchmark\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-benchmark\"," \
+    "\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,"          \
+    "\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":"
+
+/**
+ * @brief Signature of the file in the job document, the RAM PAL does not check it.
+ */
+#define JOB_DOC_SIGNATURE \
+    "\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\""
+
+/**
+ * @brief Job document of an image served over MQTT.
+ */
+#define JOB_DOC_MQTT                                                                                                 \
+    JOB_DOC_PREFIX "{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-benchmark\",\"files\":[{\"filepath\":\"/benchmark/image\"," \
+    "\"filesize\":%lu,\"fileid\":0,\"certfile\":\"benchmark.crt\"," JOB_DOC_SIGNATURE "}] }}}}"
+
+/**
+ * @brief Job document of an image served over HTTP.
+ */
+#define JOB_DOC_HTTP                                                                                                   \
+    JOB_DOC_PREFIX "{\"protocols\":[\"HTTP\"],\"files\":[{\"filepath\":\"/benchmark/image\",\"filesize\":%lu,\"fileid\":0," \
+    "\"certfile\":\"benchmark.crt\",\"update_data_url\":\"https://benchmark/image.bin\","                              \
+    "\"auth_scheme\":\"aws.s3.presigned\"," JOB_DOC_SIGNATURE "}] }}}}"
+
+/**
+ * @brief A message on the way to the device.
+ */
+typedef struct BenchmarkDelivery
+{
+    uint64_t dueNs;      /*!< @brief Time the message reaches the device. */
+    uint32_t offset;     /*!< @brief Offset of the block in the image. */
+    uint32_t length;     /*!< @brief Size of the block. */
+    uint32_t blockSize;  /*!< @brief Size of the blocks requested, the last one may be shorter. */
+    int32_t fileId;      /*!< @brief File id the block was requested for. */
+    bool isJobDocument;  /*!< @brief true for the job document, false for a block. */
+} BenchmarkDelivery_t;
+
+/**
+ * @brief Network the messages are sent over.
+ */
+static const BenchmarkNetwork_t * pServiceNetwork = NULL;
+
+/**
+ * @brief Image served.
+ */
+static const uint8_t * pServedImage = NULL;
+
+/**
+ * @brief Size of the image served.
+ */
+static uint32_t servedImageSize = 0;
+
+/**
+ * @brief true if the image is served over HTTP.
+ */
+static bool servedOverHttp = false;
+
+/**
+ * @brief State of the random numbers.
+ */
+static uint32_t randomState = 1;
+
+/**
+ * @brief Messages on the way to the device, a heap ordered by the time they arrive.
+ */
+static BenchmarkDelivery_t deliveries[ BENCHMARK_MAX_DELIVERIES ];
+
+/**
+ * @brief Number of messages on the way to the device.
+ */
+static uint32_t numDeliveries = 0;
+
+/**
+ * @brief Time the link to the device is done sending the messages queued.
+ */
+static uint64_t linkFreeNs = 0;
+
+/**
+ * @brief true while the service is started.
+ */
+static bool serviceRunning = false;
+
+/**
+ * @brief true once the job document has been sent.
+ */
+static bool jobDocumentSent = false;
+
+/**
+ * @brief Job document served.
+ */
+static char jobDocument[ BENCHMARK_JOB_DOC_MAX_SIZE ];
+
+/**
+ * @brief Length of the job document.
+ */
+static uint32_t jobDocumentLength = 0;
+
+/**
+ * @brief Counters of the download.
+ */
+static BenchmarkCounters_t serviceCounters;
+
+/**
+ * @brief Lock of the state of the service, taken by the agent and the delivery thread.
+ *
+ * It is never destroyed, the agent still publishes while it shuts down after
+ * the service is stopped.
+ */
+static pthread_mutex_t serviceLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Signaled when a message is queued or the service is stopped.
+ */
+static pthread_cond_t serviceCond;
+
+/**
+ * @brief true once the condition of the service is initialized.
+ */
+static bool serviceCondInitialized = false;
+
+/**
+ * @brief Thread delivering the messages to the agent.
+ */
+static pthread_t deliveryThread;
+
+/**
+ * @brief Get the next random number.
+ *
+ * @return Random number.
+ */
+static uint32_t nextRandom( void );
+
+/**
+ * @brief Draw whether an event of a given probability happens.
+ *
+ * @param[in] percent Probability of the event in percent.
+ *
+ * @return true if the event happens.
+ */
+static bool happens( uint32_t percent );
+
+/**
+ * @brief Add a message to the ones on the way to the device.
+ *
+ * @param[in] pDelivery Message added.
+ */
+static void pushDelivery( const BenchmarkDelivery_t * pDelivery );
+
+/**
+ * @brief Remove the message that reaches the device first.
+ *
+ * @param[out] pDelivery Message removed.
+ */
+static void popDelivery( BenchmarkDelivery_t * pDelivery );
+
+/**
+ * @brief Send a block of the image over the network.
+ *
+ * The block waits for the link to be free after the request reached the
+ * service, then takes the time to be sent on the link and half a round trip.
+ *
+ * @param[in] offset Offset of the block in the image.
+ * @param[in] length Size of the block.
+ * @param[in] blockSize Size of the blocks requested.
+ * @param[in] fileId File id the block is requested for.
+ * @param[in] lossy true if the block can be lost, reordered or duplicated.
+ */
+static void sendBlock( uint32_t offset,
+                       uint32_t length,
+                       uint32_t blockSize,
+                       int32_t fileId,
+                       bool lossy );
+
+/**
+ * @brief Send the blocks of a Get Stream Request message.
+ *
+ * @param[in] pMessage Message published by the agent.
+ * @param[in] messageSize Size of the message.
+ */
+static void handleStreamRequest( const uint8_t * pMessage,
+                                 size_t messageSize );
+
+/**
+ * @brief Encode a block in a Get Stream Response message.
+ *
+ * @param[in] pDelivery Block to encode.
+ * @param[out] pBuffer Event buffer the message is encoded in.
+ *
+ * @return true if the message is encoded.
+ */
+static bool encodeStreamResponse( const BenchmarkDelivery_t * pDelivery,
+                                  OtaEventData_t * pBuffer );
+
+/**
+ * @brief Give a message that reached the device to the agent.
+ *
+ * @param[in] pDelivery Message given.
+ */
+static void deliver( const BenchmarkDelivery_t * pDelivery );
+
+/**
+ * @brief Thread delivering the messages to the agent as they reach the device.
+ *
+ * @param[in] pArgs Unused.
+ *
+ * @return NULL.
+ */
+static void * deliveryTask( void * pArgs );
+
+/**
+ * @brief Check if a topic ends with a suffix.
+ *
+ * @param[in] pTopic Topic checked.
+ * @param[in] topicLength Length of the topic.
+ * @param[in] pSuffix Suffix looked for.
+ *
+ * @return true if the topic ends with the suffix.
+ */
+static bool topicEndsWith( const char * pTopic,
+                           uint16_t topicLength,
+                           const char * pSuffix );
+
+/*-----------------------------------------------------------*/
+
+uint64_t Benchmark_TimeNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * NS_PER_S ) + ( uint64_t ) now.tv_nsec;
+}
+
+static uint32_t nextRandom( void )
+{
+    /* Xorshift, the same seed gives the same losses on every run. */
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+static bool happens( uint32_t percent )
+{
+    return ( percent > 0U ) && ( ( nextRandom() % 100U ) < percent );
+}
+
+static void pushDelivery( const BenchmarkDelivery_t * pDelivery )
+{
+    uint32_t child = numDeliveries;
+    uint32_t parent = 0;
+
+    if( numDeliveries < BENCHMARK_MAX_DELIVERIES )
+    {
+        numDeliveries++;
+
+        while( child > 0U )
+        {
+            parent = ( child - 1U ) / 2U;
+
+            if( deliveries[ parent ].dueNs <= pDelivery->dueNs )
+            {
+                break;
+            }
+
+            deliveries[ child ] = deliveries[ parent ];
+            child = parent;
+        }
+
+        deliveries[ child ] = *pDelivery;
+        ( void ) pthread_cond_signal( &serviceCond );
+    }
+    else
+    {
+        /* As if the broker ran out of memory. */
+        serviceCounters.blocksLost++;
+    }
+}
+
+static void popDelivery( BenchmarkDelivery_t * pDelivery )
+{
+    BenchmarkDelivery_t last;
+    uint32_t parent = 0;
+    uint32_t child = 1;
+
+    *pDelivery = deliveries[ 0 ];
+    numDeliveries--;
+    last = deliveries[ numDeliveries ];
+
+    while( child < numDeliveries )
+    {
+        if( ( ( child + 1U ) < numDeliveries ) && ( deliveries[ child + 1U ].dueNs < deliveries[ child ].dueNs ) )
+        {
+            child++;
+        }
+
+        if( last.dueNs <= deliveries[ child ].dueNs )
+        {
+            break;
+        }
+
+        deliveries[ parent ] = deliveries[ child ];
+        parent = child;
+        child = ( 2U * child ) + 1U;
+    }
+
+    deliveries[ parent ] = last;
+}
+
+static void sendBlock( uint32_t offset,
+                       uint32_t length,
+                       uint32_t blockSize,
+                       int32_t fileId,
+                       bool lossy )
+{
+    BenchmarkDelivery_t delivery;
+    uint64_t halfRttNs = ( uint64_t ) pServiceNetwork->rttMs * ( NS_PER_MS / 2U );
+    uint64_t departNs = Benchmark_TimeNs() + halfRttNs;
+
+    ( void ) memset( &delivery, 0, sizeof( delivery ) );
+
+    /* The blocks are sent one after the other on the link. */
+    if( departNs < linkFreeNs )
+    {
+        departNs = linkFreeNs;
+    }
+
+    if( pServiceNetwork->linkKbps > 0U )
+    {
+        departNs += ( ( uint64_t ) length * 8000000U ) / pServiceNetwork->linkKbps;
+    }
+
+    linkFreeNs = departNs;
+
+    delivery.dueNs = departNs + halfRttNs;
+    delivery.offset = offset;
+    delivery.length = length;
+    delivery.blockSize = blockSize;
+    delivery.fileId = fileId;
+    serviceCounters.blocksSent++;
+
+    if( ( lossy == true ) && happens( pServiceNetwork->lossPercent ) )
+    {
+        serviceCounters.blocksLost++;
+    }
+    else
+    {
+        if( ( lossy == true ) && happens( pServiceNetwork->reorderPercent ) )
+        {
+            /* Held back by up to one more round trip, the blocks after it overtake it. */
+            delivery.dueNs += nextRandom() % ( ( 2U * halfRttNs ) + 1U );
+        }
+
+        pushDelivery( &delivery );
+
+        if( ( lossy == true ) && happens( pServiceNetwork->duplicatePercent ) )
+        {
+            delivery.dueNs += nextRandom() % ( halfRttNs + 1U );
+            serviceCounters.duplicatesSent++;
+            pushDelivery( &delivery );
+        }
+    }
+}
+
+static void handleStreamRequest( const uint8_t * pMessage,
+                                 size_t messageSize )
+{
+    CborParser parser;
+    CborValue map, value;
+    uint8_t bitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+    size_t bitmapSize = 0;
+    int fileId = 0;
+    int blockSize = 0;
+    int blockOffset = 0;
+    int numBlocks = 0;
+    uint32_t numImageBlocks = 0;
+    uint32_t block = 0;
+    uint32_t bit = 0;
+    uint32_t blocksSent = 0;
+    uint32_t length = 0;
+    CborError cborResult = CborNoError;
+
+    cborResult = cbor_parser_init( pMessage, messageSize, 0, &parser, &map );
+
+    if( ( CborNoError == cborResult ) && !cbor_value_is_map( &map ) )
+    {
+        cborResult = CborErrorIllegalType;
+    }
+
+    if( CborNoError == cborResult )
+    {
+        ( void ) cbor_value_map_find_value( &map, OTA_CBOR_FILEID_KEY, &value );
+        cborResult = cbor_value_get_int( &value, &fileId );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        ( void ) cbor_value_map_find_value( &map, OTA_CBOR_BLOCKSIZE_KEY, &value );
+        cborResult = cbor_value_get_int( &value, &blockSize );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        ( void ) cbor_value_map_find_value( &map, OTA_CBOR_BLOCKOFFSET_KEY, &value );
+        cborResult = cbor_value_get_int( &value, &blockOffset );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        ( void ) cbor_value_map_find_value( &map, OTA_CBOR_NUMBEROFBLOCKS_KEY, &value );
+        cborResult = cbor_value_get_int( &value, &numBlocks );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        ( void ) cbor_value_map_find_value( &map, OTA_CBOR_BLOCKBITMAP_KEY, &value );
+        bitmapSize = sizeof( bitmap );
+        cborResult = ( cbor_value_get_type( &value ) == CborByteStringType ) ?
+                     cbor_value_copy_byte_string( &value, bitmap, &bitmapSize, NULL ) :
+                     CborErrorIllegalType;
+    }
+
+    if( ( CborNoError == cborResult ) && ( blockSize > 0 ) && ( blockOffset >= 0 ) )
+    {
+        serviceCounters.requests++;
+        numImageBlocks = ( servedImageSize + ( uint32_t ) blockSize - 1U ) / ( uint32_t ) blockSize;
+
+        /* Bit i of the bitmap asks for block blockOffset + i, the first
+         * numBlocks blocks asked for are sent. */
+        for( bit = 0; ( bit < ( bitmapSize * 8U ) ) && ( blocksSent < ( uint32_t ) numBlocks ); bit++ )
+        {
+            block = ( uint32_t ) blockOffset + bit;
+
+            if( block >= numImageBlocks )
+            {
+                break;
+            }
+
+            if( ( bitmap[ bit / 8U ] & ( 1U << ( bit % 8U ) ) ) != 0U )
+            {
+                length = servedImageSize - ( block * ( uint32_t ) blockSize );
+                length = ( length < ( uint32_t ) blockSize ) ? length : ( uint32_t ) blockSize;
+                sendBlock( block * ( uint32_t ) blockSize, length, ( uint32_t ) blockSize, ( int32_t ) fileId, true );
+                blocksSent++;
+            }
+        }
+    }
+}
+
+static bool encodeStreamResponse( const BenchmarkDelivery_t * pDelivery,
+                                  OtaEventData_t * pBuffer )
+{
+    CborEncoder encoder, mapEncoder;
+    CborError cborResult = CborNoError;
+
+    cbor_encoder_init( &encoder, pBuffer->data, sizeof( pBuffer->data ), 0 );
+    cborResult = cbor_encoder_create_map( &encoder, &mapEncoder, GET_STREAM_RESPONSE_ITEM_COUNT );
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_encode_text_stringz( &mapEncoder, OTA_CBOR_FILEID_KEY );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_encode_int( &mapEncoder, pDelivery->fileId );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_encode_text_stringz( &mapEncoder, OTA_CBOR_BLOCKID_KEY );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_encode_int( &mapEncoder, pDelivery->offset / pDelivery->blockSize );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_encode_text_stringz( &mapEncoder, OTA_CBOR_BLOCKSIZE_KEY );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_encode_int( &mapEncoder, pDelivery->length );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_encode_text_stringz( &mapEncoder, OTA_CBOR_BLOCKPAYLOAD_KEY );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_encode_byte_string( &mapEncoder, &( pServedImage[ pDelivery->offset ] ), pDelivery->length );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        cborResult = cbor_encoder_close_container_checked( &encoder, &mapEncoder );
+    }
+
+    if( CborNoError == cborResult )
+    {
+        pBuffer->dataLength = ( uint32_t ) cbor_encoder_get_buffer_size( &encoder, pBuffer->data );
+    }
+
+    return CborNoError == cborResult;
+}
+
+static void deliver( const BenchmarkDelivery_t * pDelivery )
+{
+    OtaEventMsg_t eventMsg = { 0 };
+    OtaEventData_t * pBuffer = OTA_EventBufferGet();
+    bool ready = true;
+
+    if( pBuffer == NULL )
+    {
+        serviceCounters.bufferDrops++;
+    }
+    else
+    {
+        eventMsg.pEventData = pBuffer;
+        pBuffer->fileOffset = 0;
+
+        if( pDelivery->isJobDocument == true )
+        {
+            ( void ) memcpy( pBuffer->data, jobDocument, jobDocumentLength );
+            pBuffer->dataLength = jobDocumentLength;
+            eventMsg.eventId = OtaAgentEventReceivedJobDocument;
+        }
+        else if( servedOverHttp == true )
+        {
+            ( void ) memcpy( pBuffer->data, &( pServedImage[ pDelivery->offset ] ), pDelivery->length );
+            pBuffer->dataLength = pDelivery->length;
+            pBuffer->fileOffset = pDelivery->offset;
+            eventMsg.eventId = OtaAgentEventReceivedFileBlock;
+        }
+        else
+        {
+            ready = encodeStreamResponse( pDelivery, pBuffer );
+            eventMsg.eventId = OtaAgentEventReceivedFileBlock;
+        }
+
+        if( ( ready == false ) || ( OTA_SignalEvent( &eventMsg ) == false ) )
+        {
+            OTA_EventBufferFree( pBuffer );
+            serviceCounters.queueDrops++;
+        }
+    }
+}
+
+static void * deliveryTask( void * pArgs )
+{
+    BenchmarkDelivery_t delivery;
+    struct timespec dueTime;
+    uint64_t nowNs = 0;
+
+    ( void ) pArgs;
+
+    ( void ) pthread_mutex_lock( &serviceLock );
+
+    while( serviceRunning == true )
+    {
+        nowNs = Benchmark_TimeNs();
+
+        if( numDeliveries == 0U )
+        {
+            ( void ) pthread_cond_wait( &serviceCond, &serviceLock );
+        }
+        else if( deliveries[ 0 ].dueNs > nowNs )
+        {
+            dueTime.tv_sec = ( time_t ) ( deliveries[ 0 ].dueNs / NS_PER_S );
+            dueTime.tv_nsec = ( long ) ( deliveries[ 0 ].dueNs % NS_PER_S );
+            ( void ) pthread_cond_timedwait( &serviceCond, &serviceLock, &dueTime );
+        }
+        else
+        {
+            /* The agent only takes the lock to publish, which never waits on
+             * the event queue, so the message is delivered with it held. */
+            popDelivery( &delivery );
+            deliver( &delivery );
+        }
+    }
+
+    ( void ) pthread_mutex_unlock( &serviceLock );
+
+    return NULL;
+}
+
+bool Benchmark_ServiceStart( const BenchmarkNetwork_t * pNetwork,
+                             const uint8_t * pImage,
+                             uint32_t imageSize,
+                             bool useHttp,
+                             uint32_t seed )
+{
+    pthread_condattr_t condAttr;
+    bool started = false;
+
+    pServiceNetwork = pNetwork;
+    pServedImage = pImage;
+    servedImageSize = imageSize;
+    servedOverHttp = useHttp;
+    randomState = ( seed != 0U ) ? seed : 1U;
+    numDeliveries = 0;
+    linkFreeNs = 0;
+    jobDocumentSent = false;
+    ( void ) memset( &serviceCounters, 0, sizeof( serviceCounters ) );
+
+    jobDocumentLength = ( uint32_t ) sprintf( jobDocument,
+                                              ( useHttp == true ) ? JOB_DOC_HTTP : JOB_DOC_MQTT,
+                                              ( unsigned long ) imageSize );
+
+    /* The due times are taken from the monotonic clock. */
+    if( serviceCondInitialized == false )
+    {
+        ( void ) pthread_condattr_init( &condAttr );
+        ( void ) pthread_condattr_setclock( &condAttr, CLOCK_MONOTONIC );
+        ( void ) pthread_cond_init( &serviceCond, &condAttr );
+        ( void ) pthread_condattr_destroy( &condAttr );
+        serviceCondInitialized = true;
+    }
+
+    serviceRunning = true;
+
+    if( pthread_create( &deliveryThread, NULL, deliveryTask, NULL ) == 0 )
+    {
+        started = true;
+    }
+    else
+    {
+        serviceRunning = false;
+    }
+
+    return started;
+}
+
+void Benchmark_ServiceStop( BenchmarkCounters_t * pCounters )
+{
+    ( void ) pthread_mutex_lock( &serviceLock );
+    serviceRunning = false;
+    ( void ) pthread_cond_signal( &serviceCond );
+    ( void ) pthread_mutex_unlock( &serviceLock );
+
+    ( void ) pthread_join( deliveryThread, NULL );
+
+    *pCounters = serviceCounters;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool topicEndsWith( const char * pTopic,
+                           uint16_t topicLength,
+                           const char * pSuffix )
+{
+    size_t suffixLength = strlen( pSuffix );
+
+    return ( topicLength >= suffixLength ) &&
+           ( memcmp( &( pTopic[ topicLength - suffixLength ] ), pSuffix, suffixLength ) == 0 );
+}
+
+OtaMqttStatus_t Benchmark_MqttSubscribe( const char * pTopicFilter,
+                                         uint16_t topicFilterLength,
+                                         uint8_t ucQoS )
+{
+    ( void ) pTopicFilter;
+    ( void ) topicFilterLength;
+    ( void ) ucQoS;
+
+    return OtaMqttSuccess;
+}
+
+OtaMqttStatus_t Benchmark_MqttUnsubscribe( const char * pTopicFilter,
+                                           uint16_t topicFilterLength,
+                                           uint8_t ucQoS )
+{
+    ( void ) pTopicFilter;
+    ( void ) topicFilterLength;
+    ( void ) ucQoS;
+
+    return OtaMqttSuccess;
+}
+
+OtaMqttStatus_t Benchmark_MqttPublish( const char * const pacTopic,
+                                       uint16_t usTopicLen,
+                                       const char * pcMsg,
+                                       uint32_t ulMsgSize,
+                                       uint8_t ucQoS )
+{
+    BenchmarkDelivery_t delivery;
+
+    ( void ) ucQoS;
+
+    ( void ) pthread_mutex_lock( &serviceLock );
+
+    if( serviceRunning == false )
+    {
+        /* Nothing to answer once the download is over. */
+    }
+    else if( topicEndsWith( pacTopic, usTopicLen, "/get/cbor" ) == true )
+    {
+        handleStreamRequest( ( const uint8_t * ) pcMsg, ulMsgSize );
+    }
+    else if( ( topicEndsWith( pacTopic, usTopicLen, "/jobs/$next/get" ) == true ) && ( jobDocumentSent == false ) )
+    {
+        ( void ) memset( &delivery, 0, sizeof( delivery ) );
+        delivery.dueNs = Benchmark_TimeNs() + ( ( uint64_t ) pServiceNetwork->rttMs * NS_PER_MS );
+        delivery.isJobDocument = true;
+        jobDocumentSent = true;
+        pushDelivery( &delivery );
+    }
+    else
+    {
+        /* The job status updates are not answered. */
+    }
+
+    ( void ) pthread_mutex_unlock( &serviceLock );
+
+    return OtaMqttSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+OtaHttpStatus_t Benchmark_HttpInit( char * pUrl )
+{
+    ( void ) pUrl;
+
+    return OtaHttpSuccess;
+}
+
+OtaHttpStatus_t Benchmark_HttpRequest( uint32_t rangeStart,
+                                       uint32_t rangeEnd )
+{
+    OtaHttpStatus_t status = OtaHttpRequestFailed;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+
+    ( void ) pthread_mutex_lock( &serviceLock );
+
+    if( ( serviceRunning == true ) && ( rangeStart <= rangeEnd ) && ( rangeEnd < servedImageSize ) )
+    {
+        serviceCounters.requests++;
+
+        /* The range is received over TCP, in block sized reads of the response. */
+        for( offset = rangeStart; offset <= rangeEnd; offset += length )
+        {
+            length = rangeEnd + 1U - offset;
+            length = ( length < OTA_FILE_BLOCK_SIZE ) ? length : OTA_FILE_BLOCK_SIZE;
+            sendBlock( offset, length, OTA_FILE_BLOCK_SIZE, 0, false );
+        }
+
+        status = OtaHttpSuccess;
+    }
+
+    ( void ) pthread_mutex_unlock( &serviceLock );
+
+    return status;
+}
+
+OtaHttpStatus_t Benchmark_HttpDeinit( void )
+{
+    return OtaHttpSuccess;
+}
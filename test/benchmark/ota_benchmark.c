@@ -0,0 +1,532 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_benchmark.c
+ * @brief Benchmark of the OTA agent on the POSIX port.
+ *
+ * An image is downloaded over MQTT and over HTTP from the simulated service
+ * for each network modeled, and one CSV line is printed per download:
+ *
+ *  - time_ms: time from the start of the agent to the image being ready to
+ *    activate, the job document included.
+ *  - blocks_per_s: blocks of the image over that time.
+ *  - cpu_us_per_block: CPU time of the agent task over the blocks of the image.
+ *  - peak_heap: largest number of bytes the agent allocated at once through
+ *    the memory interface.
+ *
+ * Usage: ota_benchmark_<variant> [network|all] [image size in KB]
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX includes. */
+#include <pthread.h>
+
+/* OTA library includes. */
+#include "ota.h"
+#include "ota_appversion32.h"
+#include "ota_event_buffer.h"
+#include "ota_os_posix.h"
+
+#include "benchmark.h"
+
+/**
+ * @brief Thing name of the device.
+ */
+#define BENCHMARK_THING_NAME        "benchmark"
+
+/**
+ * @brief Size of the image downloaded when none is given, in KB.
+ */
+#define BENCHMARK_IMAGE_SIZE_KB     64U
+
+/**
+ * @brief Largest image that can be downloaded, in KB, the bitmap of the agent
+ * tracks a limited number of blocks.
+ */
+#define BENCHMARK_MAX_IMAGE_KB      ( OTA_MAX_BLOCK_BITMAP_SIZE * 8U * ( OTA_FILE_BLOCK_SIZE / 1024U ) )
+
+/**
+ * @brief Time a download is given before it is abandoned, in seconds.
+ */
+#define BENCHMARK_RUN_TIMEOUT_S     300
+
+/**
+ * @brief Seed of the random losses of the network.
+ */
+#define BENCHMARK_SEED              0x4f544131U
+
+/**
+ * @brief Size of the paths, names and URL buffers given to the agent.
+ */
+#define BENCHMARK_NAME_BUFFER_SIZE  128U
+
+/**
+ * @brief Size of the authorization scheme buffer given to the agent.
+ */
+#define BENCHMARK_AUTH_SCHEME_SIZE  32U
+
+/**
+ * @brief Number of nanoseconds in a microsecond.
+ */
+#define NS_PER_US                   1000U
+
+/**
+ * @brief Number of nanoseconds in a millisecond.
+ */
+#define NS_PER_MS                   1000000U
+
+/**
+ * @brief Firmware version of the application, required by the library.
+ */
+const AppVersion32_t appFirmwareVersion =
+{
+    .u.x.major = 1,
+    .u.x.minor = 0,
+    .u.x.build = 0,
+};
+
+/**
+ * @brief Signature key of the job documents served, required by the library.
+ */
+const char OTA_JsonFileSignatureKey[ OTA_FILE_SIG_KEY_STR_MAX_LENGTH ] = "sig-sha256-ecdsa";
+
+/**
+ * @brief Networks the image is downloaded over.
+ */
+static const BenchmarkNetwork_t networks[] =
+{
+    /* Name        RTT  Loss Reorder Duplicate Link kbit/s */
+    { "ideal",     0U,   0U, 0U,     0U,       0U      },
+    { "lan",       2U,   0U, 0U,     0U,       100000U },
+    { "cellular",  150U, 1U, 5U,     1U,       1000U   },
+    { "lossy",     300U, 5U, 20U,    5U,       250U    }
+};
+
+/**
+ * @brief Result of a download.
+ */
+typedef struct BenchmarkResult
+{
+    bool finished;   /*!< @brief true once the agent is done with the job. */
+    bool succeeded;  /*!< @brief true if the image was received and matches the one served. */
+    uint64_t endNs;  /*!< @brief Time the agent was done. */
+    uint64_t cpuNs;  /*!< @brief CPU time of the agent task when it was done. */
+} BenchmarkResult_t;
+
+/**
+ * @brief Result of the download running.
+ */
+static BenchmarkResult_t runResult;
+
+/**
+ * @brief Lock of the result of the download running.
+ */
+static pthread_mutex_t resultLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Signaled when the download running is done.
+ */
+static pthread_cond_t resultCond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Header of the memory allocated for the agent, holding its size.
+ */
+typedef union BenchmarkHeapHeader
+{
+    size_t size;           /*!< @brief Size of the memory allocated. */
+    long double alignment; /*!< @brief Keeps the memory after the header aligned for any type. */
+} BenchmarkHeapHeader_t;
+
+/**
+ * @brief Bytes allocated by the agent.
+ */
+static size_t heapInUse = 0;
+
+/**
+ * @brief Largest number of bytes allocated by the agent at once.
+ */
+static size_t heapPeak = 0;
+
+/**
+ * @brief Lock of the heap counters.
+ */
+static pthread_mutex_t heapLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Buffers of the paths, names and URL of the job.
+ */
+static uint8_t updateFilePath[ BENCHMARK_NAME_BUFFER_SIZE ];
+static uint8_t certFilePath[ BENCHMARK_NAME_BUFFER_SIZE ];   /*!< @copydoc updateFilePath */
+static uint8_t streamName[ BENCHMARK_NAME_BUFFER_SIZE ];     /*!< @copydoc updateFilePath */
+static uint8_t updateUrl[ BENCHMARK_NAME_BUFFER_SIZE ];      /*!< @copydoc updateFilePath */
+static uint8_t authScheme[ BENCHMARK_AUTH_SCHEME_SIZE ];     /*!< @copydoc updateFilePath */
+
+/**
+ * @brief Buffer the blocks are decoded in.
+ */
+static uint8_t decodeMemory[ OTA_FILE_BLOCK_SIZE ];
+
+/**
+ * @brief Bitmap of the blocks received.
+ */
+static uint8_t fileBitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+static void * benchmarkMalloc( size_t size )
+{
+    BenchmarkHeapHeader_t * pHeader = malloc( sizeof( BenchmarkHeapHeader_t ) + size );
+    void * pMemory = NULL;
+
+    if( pHeader != NULL )
+    {
+        pHeader->size = size;
+        pMemory = &( pHeader[ 1 ] );
+
+        ( void ) pthread_mutex_lock( &heapLock );
+        heapInUse += size;
+        heapPeak = ( heapInUse > heapPeak ) ? heapInUse : heapPeak;
+        ( void ) pthread_mutex_unlock( &heapLock );
+    }
+
+    return pMemory;
+}
+
+static void benchmarkFree( void * ptr )
+{
+    BenchmarkHeapHeader_t * pHeader = NULL;
+
+    if( ptr != NULL )
+    {
+        pHeader = &( ( ( BenchmarkHeapHeader_t * ) ptr )[ -1 ] );
+
+        ( void ) pthread_mutex_lock( &heapLock );
+        heapInUse -= pHeader->size;
+        ( void ) pthread_mutex_unlock( &heapLock );
+
+        free( pHeader );
+    }
+}
+
+static uint64_t threadCpuNs( void )
+{
+    struct timespec cpuTime;
+
+    ( void ) clock_gettime( CLOCK_THREAD_CPUTIME_ID, &cpuTime );
+
+    return ( ( uint64_t ) cpuTime.tv_sec * ( NS_PER_MS * 1000U ) ) + ( uint64_t ) cpuTime.tv_nsec;
+}
+
+static void finishRun( bool succeeded )
+{
+    /* The callback runs in the agent task, so its CPU time is the agent's. */
+    uint64_t cpuNs = threadCpuNs();
+
+    ( void ) pthread_mutex_lock( &resultLock );
+
+    if( runResult.finished == false )
+    {
+        runResult.finished = true;
+        runResult.succeeded = succeeded;
+        runResult.endNs = Benchmark_TimeNs();
+        runResult.cpuNs = cpuNs;
+        ( void ) pthread_cond_signal( &resultCond );
+    }
+
+    ( void ) pthread_mutex_unlock( &resultLock );
+}
+
+static void appCallback( OtaJobEvent_t event,
+                         const void * pData )
+{
+    switch( event )
+    {
+        case OtaJobEventProcessed:
+            OTA_EventBufferFree( ( OtaEventData_t * ) pData );
+            break;
+
+        case OtaJobEventActivate:
+        case OtaJobEventUpdateComplete:
+            finishRun( true );
+            break;
+
+        case OtaJobEventFail:
+            finishRun( false );
+            break;
+
+        default:
+            /* The other events do not end the download. */
+            break;
+    }
+}
+
+static void * agentTask( void * pArgs )
+{
+    ( void ) pArgs;
+
+    OTA_EventProcessingTask( NULL );
+
+    return NULL;
+}
+
+static void sleepMs( uint32_t ms )
+{
+    struct timespec delay;
+
+    delay.tv_sec = ( time_t ) ( ms / 1000U );
+    delay.tv_nsec = ( long ) ( ms % 1000U ) * ( long ) NS_PER_MS;
+    ( void ) nanosleep( &delay, NULL );
+}
+
+static void setInterfaces( OtaInterfaces_t * pInterfaces,
+                           OtaAppBuffer_t * pAppBuffer )
+{
+    ( void ) memset( pInterfaces, 0, sizeof( *pInterfaces ) );
+    ( void ) memset( pAppBuffer, 0, sizeof( *pAppBuffer ) );
+
+    pInterfaces->os.event.init = Posix_OtaInitRingEvent;
+    pInterfaces->os.event.send = Posix_OtaSendRingEvent;
+    pInterfaces->os.event.recv = Posix_OtaReceiveRingEvent;
+    pInterfaces->os.event.deinit = Posix_OtaDeinitRingEvent;
+    pInterfaces->os.event.recvBatch = Posix_OtaReceiveRingEvents;
+
+    pInterfaces->os.timer.start = Posix_OtaStartTimer;
+    pInterfaces->os.timer.stop = Posix_OtaStopTimer;
+    pInterfaces->os.timer.delete = Posix_OtaDeleteTimer;
+
+    pInterfaces->os.mem.malloc = benchmarkMalloc;
+    pInterfaces->os.mem.free = benchmarkFree;
+
+    pInterfaces->mqtt.subscribe = Benchmark_MqttSubscribe;
+    pInterfaces->mqtt.unsubscribe = Benchmark_MqttUnsubscribe;
+    pInterfaces->mqtt.publish = Benchmark_MqttPublish;
+
+    pInterfaces->http.init = Benchmark_HttpInit;
+    pInterfaces->http.request = Benchmark_HttpRequest;
+    pInterfaces->http.deinit = Benchmark_HttpDeinit;
+
+    Benchmark_PalSetInterface( &( pInterfaces->pal ) );
+
+    pAppBuffer->pUpdateFilePath = updateFilePath;
+    pAppBuffer->updateFilePathsize = sizeof( updateFilePath );
+    pAppBuffer->pCertFilePath = certFilePath;
+    pAppBuffer->certFilePathSize = sizeof( certFilePath );
+    pAppBuffer->pStreamName = streamName;
+    pAppBuffer->streamNameSize = sizeof( streamName );
+    pAppBuffer->pDecodeMemory = decodeMemory;
+    pAppBuffer->decodeMemorySize = sizeof( decodeMemory );
+    pAppBuffer->pFileBitmap = fileBitmap;
+    pAppBuffer->fileBitmapSize = sizeof( fileBitmap );
+    pAppBuffer->pUrl = updateUrl;
+    pAppBuffer->urlSize = sizeof( updateUrl );
+    pAppBuffer->pAuthScheme = authScheme;
+    pAppBuffer->authSchemeSize = sizeof( authScheme );
+}
+
+static bool runDownload( const BenchmarkNetwork_t * pNetwork,
+                         bool useHttp,
+                         const uint8_t * pImage,
+                         uint32_t imageSize )
+{
+    OtaInterfaces_t interfaces;
+    OtaAppBuffer_t appBuffer;
+    OtaEventMsg_t eventMsg = { 0 };
+    BenchmarkCounters_t counters;
+    pthread_t agentThread;
+    struct timespec deadline;
+    uint64_t startNs = 0;
+    uint32_t numBlocks = ( imageSize + OTA_FILE_BLOCK_SIZE - 1U ) / OTA_FILE_BLOCK_SIZE;
+    double elapsedMs = 0.0;
+    bool started = false;
+
+    setInterfaces( &interfaces, &appBuffer );
+    ( void ) memset( &runResult, 0, sizeof( runResult ) );
+    heapInUse = 0;
+    heapPeak = 0;
+
+    if( Benchmark_PalInit( pImage, imageSize ) == true )
+    {
+        if( Benchmark_ServiceStart( pNetwork, pImage, imageSize, useHttp, BENCHMARK_SEED ) == true )
+        {
+            if( OTA_Init( &appBuffer, &interfaces, ( const uint8_t * ) BENCHMARK_THING_NAME, appCallback ) == OtaErrNone )
+            {
+                started = ( pthread_create( &agentThread, NULL, agentTask, NULL ) == 0 );
+            }
+
+            if( started == true )
+            {
+                /* The agent must be ready before it is started, or shut down. */
+                while( OTA_GetState() == OtaAgentStateInit )
+                {
+                    sleepMs( 1U );
+                }
+
+                startNs = Benchmark_TimeNs();
+                eventMsg.eventId = OtaAgentEventStart;
+                ( void ) OTA_SignalEvent( &eventMsg );
+
+                ( void ) clock_gettime( CLOCK_REALTIME, &deadline );
+                deadline.tv_sec += BENCHMARK_RUN_TIMEOUT_S;
+
+                ( void ) pthread_mutex_lock( &resultLock );
+
+                while( runResult.finished == false )
+                {
+                    if( pthread_cond_timedwait( &resultCond, &resultLock, &deadline ) != 0 )
+                    {
+                        /* Abandoned, reported as a timeout below. */
+                        runResult.finished = true;
+                        runResult.endNs = Benchmark_TimeNs();
+                        runResult.cpuNs = 0;
+                    }
+                }
+
+                ( void ) pthread_mutex_unlock( &resultLock );
+            }
+
+            Benchmark_ServiceStop( &counters );
+
+            if( started == true )
+            {
+                /* The shutdown event is lost if the queue is full of blocks, send it again. */
+                while( OTA_GetState() != OtaAgentStateStopped )
+                {
+                    ( void ) OTA_Shutdown( 0, 0 );
+                    sleepMs( 1U );
+                }
+
+                ( void ) pthread_join( agentThread, NULL );
+            }
+        }
+
+        Benchmark_PalDeinit();
+    }
+
+    if( started == true )
+    {
+        elapsedMs = ( double ) ( runResult.endNs - startNs ) / ( double ) NS_PER_MS;
+
+        printf( "%lu,%lu,%lu,%s,%s,%lu,%lu,%.1f,%.1f,%.2f,%lu,%lu,%lu,%lu,%lu,%lu,%s\n",
+                ( unsigned long ) OTA_FILE_BLOCK_SIZE,
+                ( unsigned long ) otaconfigMAX_REQUEST_WINDOW_SIZE,
+                ( unsigned long ) otaconfigEVENT_BUFFER_POOL_SIZE,
+                ( useHttp == true ) ? "http" : "mqtt",
+                pNetwork->pName,
+                ( unsigned long ) imageSize,
+                ( unsigned long ) numBlocks,
+                elapsedMs,
+                ( elapsedMs > 0.0 ) ? ( ( double ) numBlocks * 1000.0 / elapsedMs ) : 0.0,
+                ( double ) runResult.cpuNs / ( double ) NS_PER_US / ( double ) numBlocks,
+                ( unsigned long ) heapPeak,
+                ( unsigned long ) counters.requests,
+                ( unsigned long ) counters.blocksSent,
+                ( unsigned long ) counters.blocksLost,
+                ( unsigned long ) counters.duplicatesSent,
+                ( unsigned long ) ( counters.bufferDrops + counters.queueDrops ),
+                ( runResult.succeeded == true ) ? "ok" : ( ( runResult.cpuNs == 0U ) ? "timeout" : "failed" ) );
+        ( void ) fflush( stdout );
+    }
+    else
+    {
+        printf( "# Failed to start the download over %s on the %s network.\n",
+                ( useHttp == true ) ? "http" : "mqtt",
+                pNetwork->pName );
+    }
+
+    return ( started == true ) && ( runResult.succeeded == true );
+}
+
+int main( int argc,
+          char ** argv )
+{
+    const char * pNetworkName = "all";
+    unsigned long imageSizeKb = BENCHMARK_IMAGE_SIZE_KB;
+    uint8_t * pImage = NULL;
+    uint32_t imageSize = 0;
+    uint32_t randomState = BENCHMARK_SEED;
+    uint32_t i = 0;
+    bool allSucceeded = true;
+    bool networkFound = false;
+
+    if( argc > 1 )
+    {
+        pNetworkName = argv[ 1 ];
+    }
+
+    if( argc > 2 )
+    {
+        imageSizeKb = strtoul( argv[ 2 ], NULL, 10 );
+    }
+
+    if( ( imageSizeKb == 0U ) || ( imageSizeKb > BENCHMARK_MAX_IMAGE_KB ) )
+    {
+        printf( "Usage: %s [network|all] [image size in KB, 1 to %u]\n", argv[ 0 ], BENCHMARK_MAX_IMAGE_KB );
+        return EXIT_FAILURE;
+    }
+
+    /* Leave the last block short, so that it is exercised too. */
+    imageSize = ( ( uint32_t ) imageSizeKb * 1024U ) - 123U;
+    pImage = malloc( imageSize );
+
+    if( pImage == NULL )
+    {
+        return EXIT_FAILURE;
+    }
+
+    /* Fill the image with noise, a block written at the wrong offset fails the comparison. */
+    for( i = 0; i < imageSize; i++ )
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        pImage[ i ] = ( uint8_t ) randomState;
+    }
+
+    printf( "block_size,window,buffers,protocol,network,bytes,blocks,time_ms,blocks_per_s,"
+            "cpu_us_per_block,peak_heap,requests,sent,lost,duplicates,drops,result\n" );
+
+    for( i = 0; i < ( sizeof( networks ) / sizeof( networks[ 0 ] ) ); i++ )
+    {
+        if( ( strcmp( pNetworkName, "all" ) == 0 ) || ( strcmp( pNetworkName, networks[ i ].pName ) == 0 ) )
+        {
+            networkFound = true;
+            allSucceeded = runDownload( &networks[ i ], false, pImage, imageSize ) && allSucceeded;
+            allSucceeded = runDownload( &networks[ i ], true, pImage, imageSize ) && allSucceeded;
+        }
+    }
+
+    free( pImage );
+
+    if( networkFound == false )
+    {
+        printf( "Unknown network: %s\n", pNetworkName );
+        allSucceeded = false;
+    }
+
+    return ( allSucceeded == true ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,62 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_config.h
+ * @brief OTA user configurable settings of the benchmark.
+ *
+ * The block size, request window and event buffers are set by each benchmark
+ * target, see test/benchmark/CMakeLists.txt.
+ */
+
+#ifndef OTA_CONFIG_H_
+#define OTA_CONFIG_H_
+
+/* Serve the image over both MQTT and HTTP. */
+#define configENABLED_DATA_PROTOCOLS            ( OTA_DATA_OVER_MQTT | OTA_DATA_OVER_HTTP )
+
+/* Receive 4 KB blocks unless the target sets another size. */
+#ifndef otaconfigLOG2_FILE_BLOCK_SIZE
+    #define otaconfigLOG2_FILE_BLOCK_SIZE       12U
+#endif
+
+/* Request one block at a time unless the target opens a window. */
+#ifndef otaconfigMAX_REQUEST_WINDOW_SIZE
+    #define otaconfigMAX_REQUEST_WINDOW_SIZE    0U
+#endif
+
+/* The blocks are received in event buffers from the pool. */
+#ifndef otaconfigEVENT_BUFFER_POOL_SIZE
+    #define otaconfigEVENT_BUFFER_POOL_SIZE     2U
+#endif
+
+#if ( otaconfigEVENT_BUFFER_POOL_SIZE == 0U )
+    #error "The benchmark receives the blocks in event buffers, otaconfigEVENT_BUFFER_POOL_SIZE must be greater than 0."
+#endif
+
+/* Ask for up to 4 blocks in each HTTP range when a window is open. */
+#define otaconfigHTTP_MAX_BLOCKS_PER_RANGE      4U
+
+/* Request the lost blocks again after 1 s, the deadline is checked every 250 ms. */
+#define otaconfigFILE_REQUEST_WAIT_MS           1000U
+
+#endif /* _OTA_CONFIG_H_ */
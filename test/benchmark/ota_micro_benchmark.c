@@ -0,0 +1,314 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_micro_benchmark.c
+ * @brief Benchmarks of internal functions of the OTA library.
+ *
+ * The sources are built with the static qualifiers removed, as for the unit
+ * tests, and one CSV line is printed per function timed:
+ *
+ *  - iterations: number of calls timed.
+ *  - ns_per_call: wall time of a call.
+ *
+ * Usage: ota_micro_benchmark
+ */
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* OTA library includes. */
+#include "ota.h"
+#include "ota_appversion32.h"
+#include "ota_base64_private.h"
+#include "ota_os_posix.h"
+
+/**
+ * @brief Nanoseconds in a second.
+ */
+#define NS_PER_S                        1000000000U
+
+/**
+ * @brief Size of the data decoded by the Base64 benchmark, the size of a large
+ * signature.
+ */
+#define BASE64_BENCHMARK_DECODED_LEN    512U
+
+/**
+ * @brief Size of the Base64 encoding of the decoded data.
+ */
+#define BASE64_BENCHMARK_ENCODED_LEN    ( ( ( BASE64_BENCHMARK_DECODED_LEN + 2U ) / 3U ) * 4U )
+
+/**
+ * @brief Number of times the data is decoded with each decoding path.
+ */
+#define BASE64_BENCHMARK_ITERATIONS     20000U
+
+/**
+ * @brief Number of transitions of the agent looked up.
+ */
+#define TRANSITION_BENCHMARK_ITERATIONS 10000000U
+
+/**
+ * @brief Number of events sent and received through each event interface.
+ */
+#define EVENT_BENCHMARK_ITERATIONS      200000U
+
+extern OtaAgentContext_t otaAgent;
+extern uint32_t searchTransition( const OtaEventMsg_t * pEventMsg );
+extern void initTransitionIndex( void );
+
+/**
+ * @brief Firmware version of the application, required by the library.
+ */
+const AppVersion32_t appFirmwareVersion =
+{
+    .u.x.major = 1,
+    .u.x.minor = 0,
+    .u.x.build = 0,
+};
+
+/**
+ * @brief Signature key of the job document, required by the library.
+ */
+const char OTA_JsonFileSignatureKey[ OTA_FILE_SIG_KEY_STR_MAX_LENGTH ] = "sig-sha256-ecdsa";
+
+extern Base64Status_t decodeBase64Data( uint8_t * pDest,
+                                        const size_t destLen,
+                                        size_t * pResultLen,
+                                        const uint8_t * pEncodedData,
+                                        const size_t encodedLen,
+                                        bool decodeGroups );
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Monotonic time in nanoseconds.
+ */
+static uint64_t timeNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * NS_PER_S ) + ( uint64_t ) now.tv_nsec;
+}
+
+/**
+ * @brief Encode data in Base64.
+ */
+static void base64Encode( uint8_t * pDest,
+                          const uint8_t * pData,
+                          size_t dataLen )
+{
+    static const char base64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t group = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    for( i = 0; i < dataLen; i += 3U )
+    {
+        group = ( uint32_t ) pData[ i ] << 16;
+        group |= ( ( i + 1U ) < dataLen ) ? ( ( uint32_t ) pData[ i + 1U ] << 8 ) : 0U;
+        group |= ( ( i + 2U ) < dataLen ) ? ( uint32_t ) pData[ i + 2U ] : 0U;
+
+        pDest[ j++ ] = ( uint8_t ) base64Digits[ ( group >> 18 ) & 0x3FU ];
+        pDest[ j++ ] = ( uint8_t ) base64Digits[ ( group >> 12 ) & 0x3FU ];
+        pDest[ j++ ] = ( ( i + 1U ) < dataLen ) ? ( uint8_t ) base64Digits[ ( group >> 6 ) & 0x3FU ] : ( uint8_t ) '=';
+        pDest[ j++ ] = ( ( i + 2U ) < dataLen ) ? ( uint8_t ) base64Digits[ group & 0x3FU ] : ( uint8_t ) '=';
+    }
+}
+
+/**
+ * @brief Time decoding a signature sized buffer with one of the decoding paths
+ * and print the result.
+ */
+static bool benchmarkBase64Decode( const char * pName,
+                                   bool decodeGroups )
+{
+    uint8_t pData[ BASE64_BENCHMARK_DECODED_LEN ] = { 0 };
+    uint8_t pEncodedData[ BASE64_BENCHMARK_ENCODED_LEN ] = { 0 };
+    uint8_t pDecodedData[ BASE64_BENCHMARK_DECODED_LEN ] = { 0 };
+    size_t resultLen = 0;
+    bool succeeded = true;
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    uint32_t i = 0;
+
+    for( i = 0; i < sizeof( pData ); i++ )
+    {
+        pData[ i ] = ( uint8_t ) ( ( i * 7U ) + 3U );
+    }
+
+    base64Encode( pEncodedData, pData, sizeof( pData ) );
+
+    start = timeNs();
+
+    for( i = 0; ( i < BASE64_BENCHMARK_ITERATIONS ) && ( succeeded == true ); i++ )
+    {
+        succeeded = ( decodeBase64Data( pDecodedData,
+                                        sizeof( pDecodedData ),
+                                        &resultLen,
+                                        pEncodedData,
+                                        sizeof( pEncodedData ),
+                                        decodeGroups ) == Base64Success );
+    }
+
+    elapsed = timeNs() - start;
+
+    if( ( succeeded == true ) && ( resultLen == sizeof( pData ) ) )
+    {
+        printf( "%s,%u,%.1f\n",
+                pName,
+                ( unsigned ) BASE64_BENCHMARK_ITERATIONS,
+                ( double ) elapsed / ( double ) BASE64_BENCHMARK_ITERATIONS );
+    }
+    else
+    {
+        fprintf( stderr, "%s: decoding failed\n", pName );
+        succeeded = false;
+    }
+
+    return succeeded;
+}
+
+/**
+ * @brief Time finding the transition of a file block event, the event handled
+ * most often by the agent, and print the result.
+ */
+static bool benchmarkTransitionLookup( void )
+{
+    OtaEventMsg_t eventMsg = { 0 };
+    uint32_t transition = 0;
+    bool succeeded = true;
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    uint32_t i = 0;
+
+    initTransitionIndex();
+
+    otaAgent.state = OtaAgentStateWaitingForFileBlock;
+    eventMsg.eventId = OtaAgentEventReceivedFileBlock;
+    transition = searchTransition( &eventMsg );
+
+    start = timeNs();
+
+    for( i = 0; i < TRANSITION_BENCHMARK_ITERATIONS; i++ )
+    {
+        /* Check every result, so that the lookups are not optimized away. */
+        if( searchTransition( &eventMsg ) != transition )
+        {
+            succeeded = false;
+        }
+    }
+
+    elapsed = timeNs() - start;
+
+    otaAgent.state = OtaAgentStateInit;
+
+    if( succeeded == true )
+    {
+        printf( "transition_lookup,%u,%.1f\n",
+                ( unsigned ) TRANSITION_BENCHMARK_ITERATIONS,
+                ( double ) elapsed / ( double ) TRANSITION_BENCHMARK_ITERATIONS );
+    }
+    else
+    {
+        fprintf( stderr, "transition_lookup: inconsistent transitions\n" );
+    }
+
+    return succeeded;
+}
+
+/**
+ * @brief Time sending an event and receiving it back through an event interface
+ * of the POSIX port and print the result.
+ */
+static bool benchmarkEventInterface( const char * pName,
+                                     const OtaEventInterface_t * pEvent )
+{
+    OtaEventMsg_t eventMsg = { 0 };
+    bool succeeded = false;
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    uint32_t i = 0;
+
+    if( pEvent->init( NULL ) == OtaOsSuccess )
+    {
+        succeeded = true;
+        start = timeNs();
+
+        for( i = 0; ( i < EVENT_BENCHMARK_ITERATIONS ) && ( succeeded == true ); i++ )
+        {
+            succeeded = ( pEvent->send( NULL, &eventMsg, 0 ) == OtaOsSuccess ) &&
+                        ( pEvent->recv( NULL, &eventMsg, 0 ) == OtaOsSuccess );
+        }
+
+        elapsed = timeNs() - start;
+        ( void ) pEvent->deinit( NULL );
+    }
+
+    if( succeeded == true )
+    {
+        printf( "%s,%u,%.1f\n",
+                pName,
+                ( unsigned ) EVENT_BENCHMARK_ITERATIONS,
+                ( double ) elapsed / ( double ) EVENT_BENCHMARK_ITERATIONS );
+    }
+    else
+    {
+        fprintf( stderr, "%s: sending or receiving an event failed\n", pName );
+    }
+
+    return succeeded;
+}
+
+int main( void )
+{
+    OtaEventInterface_t queueEvent = { 0 };
+    OtaEventInterface_t ringEvent = { 0 };
+    bool allSucceeded = true;
+
+    queueEvent.init = Posix_OtaInitEvent;
+    queueEvent.send = Posix_OtaSendEvent;
+    queueEvent.recv = Posix_OtaReceiveEvent;
+    queueEvent.deinit = Posix_OtaDeinitEvent;
+
+    ringEvent.init = Posix_OtaInitRingEvent;
+    ringEvent.send = Posix_OtaSendRingEvent;
+    ringEvent.recv = Posix_OtaReceiveRingEvent;
+    ringEvent.deinit = Posix_OtaDeinitRingEvent;
+
+    printf( "benchmark,iterations,ns_per_call\n" );
+
+    allSucceeded = benchmarkBase64Decode( "base64_decode_groups", true ) && allSucceeded;
+    allSucceeded = benchmarkBase64Decode( "base64_decode_symbols", false ) && allSucceeded;
+    allSucceeded = benchmarkTransitionLookup() && allSucceeded;
+    allSucceeded = benchmarkEventInterface( "posix_queue_send_receive", &queueEvent ) && allSucceeded;
+    allSucceeded = benchmarkEventInterface( "posix_ring_send_receive", &ringEvent ) && allSucceeded;
+
+    return ( allSucceeded == true ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
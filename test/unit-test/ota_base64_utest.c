@@ -25,12 +25,21 @@
  * @brief Unit tests for functions in ota_base64.c
  */
 
+#include <stdbool.h>
 #include <string.h>
 #include "unity.h"
 
 /* For accessing OTA private functions and error codes. */
 #include "ota_base64_private.h"
 
+/* Static function in ota_base64.c made visible for testing. */
+extern Base64Status_t decodeBase64Data( uint8_t * pDest,
+                                        const size_t destLen,
+                                        size_t * pResultLen,
+                                        const uint8_t * pEncodedData,
+                                        const size_t encodedLen,
+                                        bool decodeGroups );
+
 /* Testing Constants. */
 
 /* Buffer size that is large enough to hold the result of decoding any test string. */
@@ -140,6 +149,17 @@
 #define BASE64_INVALID_DATA_PADDING_AT_MIDDLE_ENCODED                 "Rk9P=QkFS"
 #define BASE64_INVALID_DATA_PADDING_AT_MIDDLE_ENCODED_LEN             ( sizeof( BASE64_INVALID_DATA_PADDING_AT_MIDDLE_ENCODED ) - 1U )
 
+/* Symbols the encoded data is built from when comparing the two decoding paths, including
+ * formatting and invalid symbols. */
+#define BASE64_TEST_SYMBOLS                                           "ABCDQRSTgw09+/= \n\r*"
+#define BASE64_TEST_SYMBOLS_LEN                                       ( sizeof( BASE64_TEST_SYMBOLS ) - 1U )
+
+/* Longest encoded data used when comparing the two decoding paths. */
+#define BASE64_TEST_MAX_ENCODED_LEN                                   24U
+
+/* Number of encoded strings compared between the two decoding paths. */
+#define BASE64_TEST_NUM_COMPARISONS                                   20000U
+
 /* ============================   UNITY FIXTURES ============================ */
 
 void setUp( void )
@@ -655,4 +675,56 @@ void test_OTA_base64Decode_InvalidPaddingPlacement( void )
     TEST_ASSERT_EQUAL_INT( Base64InvalidSymbolOrdering, result );
 }
 
+/**
+ * @brief Test that decoding groups of Base64 digits at once gives the same
+ *        result and error codes as decoding the data symbol by symbol.
+ */
+void test_OTA_base64Decode_GroupsMatchSymbolDecoding( void )
+{
+    uint8_t pEncodedData[ BASE64_TEST_MAX_ENCODED_LEN ] = { 0 };
+    uint8_t pGroupsResult[ BASE64_DEFAULT_TEST_DECODING_BUFFER_SIZE ] = { 0 };
+    uint8_t pSymbolsResult[ BASE64_DEFAULT_TEST_DECODING_BUFFER_SIZE ] = { 0 };
+    size_t groupsResultLen = 0;
+    size_t symbolsResultLen = 0;
+    size_t encodedLen = 0;
+    size_t destLen = 0;
+    uint32_t seed = 1U;
+    uint32_t i = 0;
+    size_t j = 0;
+    Base64Status_t groupsStatus = Base64Success;
+    Base64Status_t symbolsStatus = Base64Success;
+
+    for( i = 0; i < BASE64_TEST_NUM_COMPARISONS; i++ )
+    {
+        /* Mostly Base64 digits, with a formatting or invalid symbol now and then. */
+        seed = ( seed * 1103515245U ) + 12345U;
+        encodedLen = ( seed >> 16 ) % ( BASE64_TEST_MAX_ENCODED_LEN + 1U );
+        destLen = ( seed >> 8 ) % ( BASE64_DEFAULT_TEST_DECODING_BUFFER_SIZE + 1U );
+
+        for( j = 0; j < encodedLen; j++ )
+        {
+            seed = ( seed * 1103515245U ) + 12345U;
+            pEncodedData[ j ] = ( uint8_t ) ( ( ( seed >> 16 ) % 8U ) != 0U ?
+                                              BASE64_TEST_SYMBOLS[ ( seed >> 20 ) % 14U ] :
+                                              BASE64_TEST_SYMBOLS[ ( seed >> 20 ) % BASE64_TEST_SYMBOLS_LEN ] );
+        }
+
+        groupsResultLen = 0;
+        symbolsResultLen = 0;
+        memset( pGroupsResult, '\0', sizeof( pGroupsResult ) );
+        memset( pSymbolsResult, '\0', sizeof( pSymbolsResult ) );
+
+        groupsStatus = decodeBase64Data( pGroupsResult, destLen, &groupsResultLen, pEncodedData, encodedLen, true );
+        symbolsStatus = decodeBase64Data( pSymbolsResult, destLen, &symbolsResultLen, pEncodedData, encodedLen, false );
+
+        TEST_ASSERT_EQUAL_INT( symbolsStatus, groupsStatus );
+        TEST_ASSERT_EQUAL( symbolsResultLen, groupsResultLen );
+
+        if( symbolsStatus == Base64Success )
+        {
+            TEST_ASSERT_EQUAL_UINT8_ARRAY( pSymbolsResult, pGroupsResult, sizeof( pGroupsResult ) );
+        }
+    }
+}
+
 /* ========================================================================== */
@@ -0,0 +1,177 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_bitmap_utest.c
+ * @brief Unit tests for functions in ota_bitmap.c
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "unity.h"
+
+/* For accessing the bitmap functions. */
+#include "ota_bitmap_private.h"
+
+/* Number of bits in the bitmap used by the tests, not a multiple of the word size. */
+#define TEST_BITMAP_BITS     100U
+
+/* Number of bytes in the bitmap used by the tests. */
+#define TEST_BITMAP_BYTES    ( ( TEST_BITMAP_BITS + 7U ) / 8U )
+
+/* Bitmap used by the tests. */
+static uint8_t bitmap[ TEST_BITMAP_BYTES ];
+
+/* ========================================================================== */
+
+static void setBit( uint32_t bit )
+{
+    bitmap[ bit / 8U ] |= ( uint8_t ) ( 1U << ( bit % 8U ) );
+}
+
+static int isBitSet( uint32_t bit )
+{
+    return ( bitmap[ bit / 8U ] & ( 1U << ( bit % 8U ) ) ) != 0U;
+}
+
+/* ============================   UNITY FIXTURES ============================ */
+
+void setUp( void )
+{
+    memset( bitmap, 0, sizeof( bitmap ) );
+}
+
+void tearDown( void )
+{
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that the first bit set is found within a word, across words and
+ *        in the last partial word, and that none is reported past the end.
+ */
+void test_OTA_Bitmap_FindFirstSet( void )
+{
+    TEST_ASSERT_EQUAL_UINT32( TEST_BITMAP_BITS, otaBitmap_FindFirstSet( bitmap, TEST_BITMAP_BITS, 0 ) );
+
+    setBit( 3 );
+    setBit( 40 );
+    setBit( 99 );
+
+    TEST_ASSERT_EQUAL_UINT32( 3, otaBitmap_FindFirstSet( bitmap, TEST_BITMAP_BITS, 0 ) );
+    TEST_ASSERT_EQUAL_UINT32( 3, otaBitmap_FindFirstSet( bitmap, TEST_BITMAP_BITS, 3 ) );
+    TEST_ASSERT_EQUAL_UINT32( 40, otaBitmap_FindFirstSet( bitmap, TEST_BITMAP_BITS, 4 ) );
+    TEST_ASSERT_EQUAL_UINT32( 99, otaBitmap_FindFirstSet( bitmap, TEST_BITMAP_BITS, 41 ) );
+    TEST_ASSERT_EQUAL_UINT32( TEST_BITMAP_BITS, otaBitmap_FindFirstSet( bitmap, TEST_BITMAP_BITS, TEST_BITMAP_BITS ) );
+
+    /* Bits past the number of bits are not part of the bitmap. */
+    TEST_ASSERT_EQUAL_UINT32( 99, otaBitmap_FindFirstSet( bitmap, 99, 41 ) );
+    TEST_ASSERT_EQUAL_UINT32( 99, otaBitmap_FindFirstSet( NULL, 99, 0 ) );
+}
+
+/**
+ * @brief Test that runs of bits set are measured across words and are capped
+ *        by the maximum length and the end of the bitmap.
+ */
+void test_OTA_Bitmap_RunLength( void )
+{
+    uint32_t bit = 0;
+
+    for( bit = 20; bit < 70; bit++ )
+    {
+        setBit( bit );
+    }
+
+    for( bit = 90; bit < TEST_BITMAP_BITS; bit++ )
+    {
+        setBit( bit );
+    }
+
+    TEST_ASSERT_EQUAL_UINT32( 0, otaBitmap_RunLength( bitmap, TEST_BITMAP_BITS, 0, 100 ) );
+    TEST_ASSERT_EQUAL_UINT32( 50, otaBitmap_RunLength( bitmap, TEST_BITMAP_BITS, 20, 100 ) );
+    TEST_ASSERT_EQUAL_UINT32( 38, otaBitmap_RunLength( bitmap, TEST_BITMAP_BITS, 32, 100 ) );
+    TEST_ASSERT_EQUAL_UINT32( 7, otaBitmap_RunLength( bitmap, TEST_BITMAP_BITS, 20, 7 ) );
+    TEST_ASSERT_EQUAL_UINT32( 10, otaBitmap_RunLength( bitmap, TEST_BITMAP_BITS, 90, 100 ) );
+    TEST_ASSERT_EQUAL_UINT32( 5, otaBitmap_RunLength( bitmap, 95, 90, 100 ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, otaBitmap_RunLength( bitmap, TEST_BITMAP_BITS, 90, 0 ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, otaBitmap_RunLength( NULL, TEST_BITMAP_BITS, 90, 100 ) );
+}
+
+/**
+ * @brief Test that the bits set are counted up to the number of bits only.
+ */
+void test_OTA_Bitmap_CountSet( void )
+{
+    TEST_ASSERT_EQUAL_UINT32( 0, otaBitmap_CountSet( bitmap, TEST_BITMAP_BITS ) );
+
+    memset( bitmap, 0xFF, sizeof( bitmap ) );
+    TEST_ASSERT_EQUAL_UINT32( TEST_BITMAP_BITS, otaBitmap_CountSet( bitmap, TEST_BITMAP_BITS ) );
+    TEST_ASSERT_EQUAL_UINT32( 33, otaBitmap_CountSet( bitmap, 33 ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, otaBitmap_CountSet( bitmap, 0 ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, otaBitmap_CountSet( NULL, TEST_BITMAP_BITS ) );
+}
+
+/**
+ * @brief Test the bitmap functions against a bit at a time scan of a bitmap
+ *        with an irregular pattern.
+ */
+void test_OTA_Bitmap_MatchesBitScan( void )
+{
+    uint32_t bit = 0;
+    uint32_t start = 0;
+    uint32_t expected = 0;
+    uint32_t count = 0;
+
+    for( bit = 0; bit < TEST_BITMAP_BITS; bit++ )
+    {
+        if( ( ( bit * 7U ) % 11U ) < 5U )
+        {
+            setBit( bit );
+            count++;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32( count, otaBitmap_CountSet( bitmap, TEST_BITMAP_BITS ) );
+
+    for( start = 0; start < TEST_BITMAP_BITS; start++ )
+    {
+        expected = start;
+
+        while( ( expected < TEST_BITMAP_BITS ) && !isBitSet( expected ) )
+        {
+            expected++;
+        }
+
+        TEST_ASSERT_EQUAL_UINT32( expected, otaBitmap_FindFirstSet( bitmap, TEST_BITMAP_BITS, start ) );
+
+        expected = 0;
+
+        while( ( ( start + expected ) < TEST_BITMAP_BITS ) && isBitSet( start + expected ) )
+        {
+            expected++;
+        }
+
+        TEST_ASSERT_EQUAL_UINT32( expected, otaBitmap_RunLength( bitmap, TEST_BITMAP_BITS, start, TEST_BITMAP_BITS ) );
+    }
+}
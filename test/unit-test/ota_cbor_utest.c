@@ -23,6 +23,7 @@
 /* Standard includes. */
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 /* CBOR and OTA includes. */
 #include "ota.h"
@@ -85,6 +86,74 @@ void test_OTA_CborEncodeStreamRequest()
     }
 }
 
+/**
+ * @brief Test a message encoded from a cached prefix is the same as the one
+ * encoded at once by OTA_CBOR_Encode_GetStreamRequestMessage().
+ *
+ */
+void test_OTA_CborEncodeStreamRequestFromPrefix()
+{
+    uint8_t cborWork[ CBOR_TEST_MESSAGE_BUFFER_SIZE ];
+    uint8_t expectedData[ CBOR_TEST_MESSAGE_BUFFER_SIZE ];
+    uint8_t prefix[ OTA_REQUEST_PREFIX_SIZE ];
+    size_t prefixSize = 0;
+    size_t encodedSize = 0;
+    size_t expectedSize = 0;
+    uint32_t bitmap = CBOR_TEST_BITMAP_VALUE;
+
+    bool result = OTA_CBOR_Encode_GetStreamRequestMessage(
+        expectedData,
+        sizeof( expectedData ),
+        &expectedSize,
+        CBOR_TEST_CLIENTTOKEN_VALUE,
+        1,
+        OTA_FILE_BLOCK_SIZE,
+        8,
+        ( uint8_t * ) &bitmap,
+        sizeof( bitmap ),
+        otaconfigMAX_NUM_BLOCKS_REQUEST );
+
+    TEST_ASSERT_TRUE( result );
+
+    result = OTA_CBOR_Encode_GetStreamRequestPrefix(
+        prefix,
+        sizeof( prefix ),
+        &prefixSize,
+        CBOR_TEST_CLIENTTOKEN_VALUE,
+        1,
+        OTA_FILE_BLOCK_SIZE );
+
+    TEST_ASSERT_TRUE( result );
+
+    memcpy( cborWork, prefix, prefixSize );
+    result = OTA_CBOR_Encode_GetStreamRequestFields(
+        cborWork,
+        sizeof( cborWork ),
+        &encodedSize,
+        prefixSize,
+        8,
+        ( uint8_t * ) &bitmap,
+        sizeof( bitmap ),
+        otaconfigMAX_NUM_BLOCKS_REQUEST );
+
+    TEST_ASSERT_TRUE( result );
+    TEST_ASSERT_EQUAL( expectedSize, encodedSize );
+    TEST_ASSERT_EQUAL_MEMORY( expectedData, cborWork, expectedSize );
+
+    /* The fields do not fit after a prefix that fills the buffer. */
+    result = OTA_CBOR_Encode_GetStreamRequestFields(
+        cborWork,
+        prefixSize,
+        &encodedSize,
+        prefixSize,
+        8,
+        ( uint8_t * ) &bitmap,
+        sizeof( bitmap ),
+        otaconfigMAX_NUM_BLOCKS_REQUEST );
+
+    TEST_ASSERT_FALSE( result );
+}
+
 /**
  * @brief Test OTA_CBOR_Decode_GetStreamResponseMessage() decodes a message correctly.
  *
@@ -143,6 +212,63 @@ void test_OTA_CborDecodeStreamResponse()
     }
 }
 
+/**
+ * @brief Test OTA_CBOR_Decode_GetStreamResponseMessage() lends the payload in
+ * place when no payload buffer is given.
+ *
+ */
+void test_OTA_CborDecodeStreamResponseInPlace()
+{
+    uint8_t blockPayload[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t cborWork[ CBOR_TEST_MESSAGE_BUFFER_SIZE ] = { 0 };
+    size_t encodedSize = 0;
+    int fileId = -1;
+    int blockIndex = -1;
+    int blockSize = -1;
+    uint8_t * pDecodedPayload = NULL;
+    size_t payloadSize = OTA_FILE_BLOCK_SIZE;
+    bool result = false;
+    int i = 0;
+
+    for( i = 0; i < ( int ) sizeof( blockPayload ); i++ )
+    {
+        blockPayload[ i ] = i % UINT8_MAX;
+    }
+
+    result = createOtaStreamingMessage(
+        cborWork,
+        sizeof( cborWork ),
+        CBOR_TEST_BLOCKIDENTITY_VALUE,
+        blockPayload,
+        sizeof( blockPayload ),
+        &encodedSize,
+        true );
+
+    TEST_ASSERT_EQUAL( CborNoError, result );
+
+    result = OTA_CBOR_Decode_GetStreamResponseMessage(
+        cborWork,
+        encodedSize,
+        &fileId,
+        &blockIndex,
+        &blockSize,
+        &pDecodedPayload,
+        &payloadSize );
+
+    TEST_ASSERT_TRUE( result );
+    TEST_ASSERT_EQUAL( CBOR_TEST_BLOCKIDENTITY_VALUE, blockIndex );
+    TEST_ASSERT_EQUAL( OTA_FILE_BLOCK_SIZE, payloadSize );
+
+    /* The payload points into the message instead of being copied. */
+    TEST_ASSERT_TRUE( pDecodedPayload > cborWork );
+    TEST_ASSERT_TRUE( pDecodedPayload + payloadSize <= cborWork + encodedSize );
+
+    for( i = 0; i < ( int ) sizeof( blockPayload ); i++ )
+    {
+        TEST_ASSERT_EQUAL( blockPayload[ i ], pDecodedPayload[ i ] );
+    }
+}
+
 /**
  * @brief Test OTA_CBOR_Encode throws an error with invalid(NULL) parameters.
  *
@@ -385,3 +511,120 @@ void test_OTA_CborDecodeStreamResponse_InvalidMap()
         &payloadSize );
     TEST_ASSERT_FALSE( result );
 }
+
+/**
+ * @brief Test OTA_CBOR_Decode_GetStreamResponseMessage() decodes the keys in
+ * any order and skips the keys it does not use.
+ *
+ */
+void test_OTA_CborDecodeStreamResponseAnyKeyOrder()
+{
+    /* {"p": b"\x01\x02\x03", "c": "ab", "l": 3, "i": 2, "f": -1} */
+    uint8_t message[] =
+    {
+        0xa5, 0x61, 0x70, 0x43, 0x01, 0x02, 0x03, 0x61, 0x63, 0x62, 0x61, 0x62, 0x61, 0x6c, 0x03,
+        0x61, 0x69, 0x02, 0x61, 0x66, 0x20
+    };
+    int fileId = 0;
+    int blockIndex = -1;
+    int blockSize = -1;
+    uint8_t decodedPayload[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t * pDecodedPayload = decodedPayload;
+    size_t payloadSize = sizeof( decodedPayload );
+    bool result = false;
+
+    result = OTA_CBOR_Decode_GetStreamResponseMessage(
+        message,
+        sizeof( message ),
+        &fileId,
+        &blockIndex,
+        &blockSize,
+        &pDecodedPayload,
+        &payloadSize );
+
+    TEST_ASSERT_TRUE( result );
+    TEST_ASSERT_EQUAL( -1, fileId );
+    TEST_ASSERT_EQUAL( 2, blockIndex );
+    TEST_ASSERT_EQUAL( 3, blockSize );
+    TEST_ASSERT_EQUAL( 3, payloadSize );
+    TEST_ASSERT_EQUAL( 0x01, decodedPayload[ 0 ] );
+    TEST_ASSERT_EQUAL( 0x02, decodedPayload[ 1 ] );
+    TEST_ASSERT_EQUAL( 0x03, decodedPayload[ 2 ] );
+}
+
+/**
+ * @brief Test OTA_CBOR_Decode_GetStreamResponseMessage() decodes messages in
+ * other layouts than the one sent by AWS IoT Streams.
+ *
+ */
+void test_OTA_CborDecodeStreamResponseOtherLayouts()
+{
+    /* {"f": 1, "i": 2, "l": 3, "p": b"\x01\x02\x03"} in a map of indefinite length. */
+    uint8_t indefiniteMap[] =
+    {
+        0xbf, 0x61, 0x66, 0x01, 0x61, 0x69, 0x02, 0x61, 0x6c, 0x03, 0x61, 0x70, 0x43, 0x01, 0x02,
+        0x03, 0xff
+    };
+    /* {"f": 1, "f": 5, "i": 2, "l": 3, "p": b"\x01\x02\x03"} */
+    uint8_t repeatedKey[] =
+    {
+        0xa5, 0x61, 0x66, 0x01, 0x61, 0x66, 0x05, 0x61, 0x69, 0x02, 0x61, 0x6c, 0x03, 0x61, 0x70,
+        0x43, 0x01, 0x02, 0x03
+    };
+    /* {"f": 1, "i": 2, "l": 3, "p": b"\x01\x02\x03"} missing the last byte. */
+    uint8_t truncated[] =
+    {
+        0xa4, 0x61, 0x66, 0x01, 0x61, 0x69, 0x02, 0x61, 0x6c, 0x03, 0x61, 0x70, 0x43, 0x01, 0x02
+    };
+    int fileId = -1;
+    int blockIndex = -1;
+    int blockSize = -1;
+    uint8_t * pDecodedPayload = NULL;
+    size_t payloadSize = OTA_FILE_BLOCK_SIZE;
+    bool result = false;
+
+    result = OTA_CBOR_Decode_GetStreamResponseMessage(
+        indefiniteMap,
+        sizeof( indefiniteMap ),
+        &fileId,
+        &blockIndex,
+        &blockSize,
+        &pDecodedPayload,
+        &payloadSize );
+
+    TEST_ASSERT_TRUE( result );
+    TEST_ASSERT_EQUAL( 1, fileId );
+    TEST_ASSERT_EQUAL( 2, blockIndex );
+    TEST_ASSERT_EQUAL( 3, blockSize );
+    TEST_ASSERT_EQUAL( 3, payloadSize );
+    TEST_ASSERT_EQUAL_PTR( &indefiniteMap[ 13 ], pDecodedPayload );
+
+    /* The first of the repeated keys is used. */
+    pDecodedPayload = NULL;
+    payloadSize = OTA_FILE_BLOCK_SIZE;
+    result = OTA_CBOR_Decode_GetStreamResponseMessage(
+        repeatedKey,
+        sizeof( repeatedKey ),
+        &fileId,
+        &blockIndex,
+        &blockSize,
+        &pDecodedPayload,
+        &payloadSize );
+
+    TEST_ASSERT_TRUE( result );
+    TEST_ASSERT_EQUAL( 1, fileId );
+    TEST_ASSERT_EQUAL_PTR( &repeatedKey[ 16 ], pDecodedPayload );
+
+    pDecodedPayload = NULL;
+    payloadSize = OTA_FILE_BLOCK_SIZE;
+    result = OTA_CBOR_Decode_GetStreamResponseMessage(
+        truncated,
+        sizeof( truncated ),
+        &fileId,
+        &blockIndex,
+        &blockSize,
+        &pDecodedPayload,
+        &payloadSize );
+
+    TEST_ASSERT_FALSE( result );
+}
@@ -40,6 +40,57 @@
 /* Use larger number of blocks per mqtt request to increase branch coverage. */
 #define otaconfigMAX_NUM_BLOCKS_REQUEST         4
 
+/* The features below are off by default. ota_default_utest is built with
+ * OTA_UTEST_DEFAULT_CONFIG to leave them off, so that the default paths are
+ * tested too. */
+/* The clock the tests advance by hand to time the stages of the downloads. */
+#include <stdint.h>
+extern uint32_t utestLatencyClock;
+
+#ifndef OTA_UTEST_DEFAULT_CONFIG
+
+    /* Report the progress off the progress timer rather than every few blocks. */
+    #define otaconfigPROGRESS_REPORT_INTERVAL_MS    1000
+
+    /* Keep a few blocks in flight so that the sliding request window is exercised. */
+    #define otaconfigMAX_REQUEST_WINDOW_SIZE        4
+
+    /* Reserve as many event buffers as the request window so the window is not limited by default. */
+    #define otaconfigEVENT_BUFFER_POOL_SIZE         4
+
+    /* Send only the needed part of the block bitmap so that the compact requests are exercised. */
+    #define otaconfigCOMPACT_BLOCK_BITMAP           1
+
+    /* Allow a second agent instance so that instances are exercised. */
+    #define otaconfigMAX_NUM_AGENTS                 2
+
+    /* Allow two file sinks so that one download is written to several files. */
+    #define otaconfigMAX_NUM_FILE_SINKS             2
+
+    /* Allow two files in a job so that both are downloaded in one job run. */
+    #define otaconfigMAX_FILES_PER_JOB              2
+
+    /* Save a checkpoint every 2 blocks so that one is saved part way through the test file. */
+    #define otaconfigCHECKPOINT_INTERVAL_BLOCKS     2
+
+    /* Combine the writes of two 4 KB blocks so that the test file is written with fewer calls. */
+    #define otaconfigWRITE_COMBINE_SIZE             8192U
+
+    /* Let the block size of the files adapt down to 1 KB. */
+    #define otaconfigMIN_LOG2_FILE_BLOCK_SIZE       10U
+
+    /* Carve the buffers of a job out of an arena of each agent instance. */
+    #define otaconfigJOB_ARENA_SIZE                 32768U
+
+    /* Time the stages of the downloads with the clock of the tests. */
+    #define otaconfigLATENCY_STATS                  1U
+    #define otaconfigLATENCY_TIMESTAMP()            ( utestLatencyClock )
+
+    /* Receive the files of type 3 as delta updates. */
+    #define configOTA_DELTA_UPDATE_FILE_TYPE_ID     3U
+
+#endif /* ifndef OTA_UTEST_DEFAULT_CONFIG */
+
 #define LOG_LEVEL_ERROR                         0
 #define LOG_LEVEL_WARN                          1
 #define LOG_LEVEL_INFO                          2
@@ -0,0 +1,146 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_event_buffer_utest.c
+ * @brief Unit tests for functions in ota_event_buffer.c
+ */
+
+#include <stddef.h>
+#include "unity.h"
+
+/* For accessing the OTA event buffer pool. */
+#include "ota.h"
+#include "ota_event_buffer.h"
+
+/* ============================   UNITY FIXTURES ============================ */
+
+void setUp( void )
+{
+    OTA_EventBufferInit();
+}
+
+void tearDown( void )
+{
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that every buffer of the pool can be acquired once and that the
+ *        pool reports when it is empty.
+ */
+void test_OTA_EventBuffer_GetUntilEmpty( void )
+{
+    OtaEventData_t * pBuffers[ otaconfigEVENT_BUFFER_POOL_SIZE ] = { 0 };
+    OtaEventBufferStatistics_t stats = { 0 };
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE, OTA_EventBufferFreeCount() );
+
+    for( i = 0; i < otaconfigEVENT_BUFFER_POOL_SIZE; i++ )
+    {
+        pBuffers[ i ] = OTA_EventBufferGet();
+        TEST_ASSERT_NOT_NULL( pBuffers[ i ] );
+        TEST_ASSERT_TRUE( pBuffers[ i ]->bufferUsed );
+
+        for( j = 0; j < i; j++ )
+        {
+            TEST_ASSERT_NOT_EQUAL( pBuffers[ j ], pBuffers[ i ] );
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32( 0, OTA_EventBufferFreeCount() );
+    TEST_ASSERT_NULL( OTA_EventBufferGet() );
+
+    OTA_GetEventBufferStatistics( &stats );
+    TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE, stats.poolSize );
+    TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE, stats.buffersInUse );
+    TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE, stats.highWatermark );
+    TEST_ASSERT_EQUAL_UINT32( 1, stats.exhausted );
+}
+
+/**
+ * @brief Test that released buffers can be acquired again, many times over
+ *        the ring of free buffers.
+ */
+void test_OTA_EventBuffer_FreeAndReuse( void )
+{
+    OtaEventData_t * pBuffer = NULL;
+    OtaEventBufferStatistics_t stats = { 0 };
+    uint32_t i = 0;
+
+    for( i = 0; i < 3U * otaconfigEVENT_BUFFER_POOL_SIZE; i++ )
+    {
+        pBuffer = OTA_EventBufferGet();
+        TEST_ASSERT_NOT_NULL( pBuffer );
+        TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE - 1U, OTA_EventBufferFreeCount() );
+
+        OTA_EventBufferFree( pBuffer );
+        TEST_ASSERT_FALSE( pBuffer->bufferUsed );
+        TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE, OTA_EventBufferFreeCount() );
+    }
+
+    OTA_GetEventBufferStatistics( &stats );
+    TEST_ASSERT_EQUAL_UINT32( 0, stats.buffersInUse );
+    TEST_ASSERT_EQUAL_UINT32( 1, stats.highWatermark );
+    TEST_ASSERT_EQUAL_UINT32( 0, stats.exhausted );
+}
+
+/**
+ * @brief Test that buffers not in use or not from the pool are not released.
+ */
+void test_OTA_EventBuffer_FreeInvalid( void )
+{
+    OtaEventData_t otherBuffer = { 0 };
+    OtaEventData_t * pBuffer = NULL;
+
+    pBuffer = OTA_EventBufferGet();
+    TEST_ASSERT_NOT_NULL( pBuffer );
+
+    /* A buffer the application owns is ignored, even if marked as used. */
+    otherBuffer.bufferUsed = true;
+    OTA_EventBufferFree( &otherBuffer );
+    TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE - 1U, OTA_EventBufferFreeCount() );
+
+    OTA_EventBufferFree( NULL );
+    TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE - 1U, OTA_EventBufferFreeCount() );
+
+    /* A pointer within a buffer of the pool is not a buffer of the pool. */
+    OTA_EventBufferFree( ( OtaEventData_t * ) ( ( uint8_t * ) pBuffer + 1 ) );
+    TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE - 1U, OTA_EventBufferFreeCount() );
+
+    /* Releasing the same buffer twice only returns it once. */
+    OTA_EventBufferFree( pBuffer );
+    OTA_EventBufferFree( pBuffer );
+    TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE, OTA_EventBufferFreeCount() );
+}
+
+/**
+ * @brief Test that statistics are not written to a NULL pointer.
+ */
+void test_OTA_EventBuffer_StatisticsNull( void )
+{
+    OTA_GetEventBufferStatistics( NULL );
+    TEST_ASSERT_EQUAL_UINT32( otaconfigEVENT_BUFFER_POOL_SIZE, OTA_EventBufferFreeCount() );
+}
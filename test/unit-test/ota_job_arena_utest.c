@@ -0,0 +1,222 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_job_arena_utest.c
+ * @brief Unit tests for functions in ota_job_arena.c
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "unity.h"
+
+/* For accessing the OTA job arena. */
+#include "ota_job_arena_private.h"
+
+/* Size of the arena used by the tests. */
+#define ARENA_SIZE    64U
+
+/* Arena under test. */
+static OtaJobArena_t arena;
+
+/* Memory interface counting the allocations and frees. */
+static OtaMallocInterface_t mem;
+
+/* Number of times the arena was allocated. */
+static uint32_t mallocCount = 0;
+
+/* Number of times the arena was freed. */
+static uint32_t freeCount = 0;
+
+/* ========================================================================== */
+
+static void * mockMalloc( size_t size )
+{
+    mallocCount++;
+
+    return malloc( size );
+}
+
+static void * mockMallocAlwaysFail( size_t size )
+{
+    ( void ) size;
+    mallocCount++;
+
+    return NULL;
+}
+
+static void mockFree( void * ptr )
+{
+    freeCount++;
+
+    free( ptr );
+}
+
+/* ============================   UNITY FIXTURES ============================ */
+
+void setUp( void )
+{
+    arena.pBase = NULL;
+    arena.size = ARENA_SIZE;
+    arena.used = 0U;
+
+    mem.malloc = mockMalloc;
+    mem.free = mockFree;
+
+    mallocCount = 0;
+    freeCount = 0;
+}
+
+void tearDown( void )
+{
+    otaJobArena_Release( &arena, &mem );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that the arena is allocated once, on the first buffer, and that
+ *        the buffers handed out do not overlap.
+ */
+void test_OTA_JobArena_AllocatesOnce( void )
+{
+    uint8_t * pFirst = NULL;
+    uint8_t * pSecond = NULL;
+    uint8_t * pThird = NULL;
+
+    TEST_ASSERT_EQUAL_UINT32( 0, mallocCount );
+
+    pFirst = otaJobArena_Alloc( &arena, &mem, 5U );
+    pSecond = otaJobArena_Alloc( &arena, &mem, 8U );
+    pThird = otaJobArena_Alloc( &arena, &mem, 1U );
+
+    TEST_ASSERT_EQUAL_UINT32( 1, mallocCount );
+    TEST_ASSERT_NOT_NULL( pFirst );
+    TEST_ASSERT_NOT_NULL( pSecond );
+    TEST_ASSERT_NOT_NULL( pThird );
+    TEST_ASSERT_EQUAL_PTR( arena.pBase, pFirst );
+
+    /* Buffers are aligned, so each one starts past the end of the previous one. */
+    TEST_ASSERT_EQUAL_PTR( pFirst + 8U, pSecond );
+    TEST_ASSERT_EQUAL_PTR( pSecond + 8U, pThird );
+    TEST_ASSERT_EQUAL( 24U, arena.used );
+}
+
+/**
+ * @brief Test that a buffer that does not fit is refused without allocating
+ *        more memory, and that the arena can still be filled up to its size.
+ */
+void test_OTA_JobArena_Exhausted( void )
+{
+    uint8_t * pBuffer = NULL;
+
+    TEST_ASSERT_NULL( otaJobArena_Alloc( &arena, &mem, ARENA_SIZE + 1U ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, mallocCount );
+
+    /* Use a size that is not a multiple of the alignment. */
+    arena.size = ARENA_SIZE - 4U;
+
+    pBuffer = otaJobArena_Alloc( &arena, &mem, ARENA_SIZE - 8U );
+    TEST_ASSERT_NOT_NULL( pBuffer );
+
+    /* The padding of the last buffer is not required to fit. */
+    TEST_ASSERT_NULL( otaJobArena_Alloc( &arena, &mem, 5U ) );
+    TEST_ASSERT_NOT_NULL( otaJobArena_Alloc( &arena, &mem, 4U ) );
+    TEST_ASSERT_EQUAL( ARENA_SIZE - 4U, arena.used );
+
+    TEST_ASSERT_NULL( otaJobArena_Alloc( &arena, &mem, 1U ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, mallocCount );
+}
+
+/**
+ * @brief Test that releasing the arena frees it once and that the next buffer
+ *        allocates a new arena.
+ */
+void test_OTA_JobArena_Release( void )
+{
+    TEST_ASSERT_NOT_NULL( otaJobArena_Alloc( &arena, &mem, ARENA_SIZE ) );
+
+    otaJobArena_Release( &arena, &mem );
+    TEST_ASSERT_EQUAL_UINT32( 1, freeCount );
+    TEST_ASSERT_NULL( arena.pBase );
+    TEST_ASSERT_EQUAL( 0U, arena.used );
+
+    /* Releasing again does nothing. */
+    otaJobArena_Release( &arena, &mem );
+    TEST_ASSERT_EQUAL_UINT32( 1, freeCount );
+
+    TEST_ASSERT_NOT_NULL( otaJobArena_Alloc( &arena, &mem, ARENA_SIZE ) );
+    TEST_ASSERT_EQUAL_UINT32( 2, mallocCount );
+}
+
+/**
+ * @brief Test that no buffer is handed out if the arena cannot be allocated
+ *        or for invalid parameters.
+ */
+void test_OTA_JobArena_InvalidParams( void )
+{
+    mem.malloc = mockMallocAlwaysFail;
+    TEST_ASSERT_NULL( otaJobArena_Alloc( &arena, &mem, 1U ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, mallocCount );
+    TEST_ASSERT_NULL( arena.pBase );
+
+    mem.malloc = mockMalloc;
+    TEST_ASSERT_NULL( otaJobArena_Alloc( &arena, &mem, 0U ) );
+    TEST_ASSERT_NULL( otaJobArena_Alloc( NULL, &mem, 1U ) );
+    TEST_ASSERT_NULL( otaJobArena_Alloc( &arena, NULL, 1U ) );
+    TEST_ASSERT_EQUAL_UINT32( 1, mallocCount );
+
+    arena.size = 0U;
+    TEST_ASSERT_NULL( otaJobArena_Alloc( &arena, &mem, 1U ) );
+
+    /* Releasing with invalid parameters does nothing. */
+    otaJobArena_Release( NULL, &mem );
+    otaJobArena_Release( &arena, NULL );
+    TEST_ASSERT_EQUAL_UINT32( 0, freeCount );
+}
+
+/**
+ * @brief Test that a static arena hands out its own storage without a memory
+ *        interface, and keeps it when released.
+ */
+void test_OTA_JobArena_Static( void )
+{
+    static uint8_t storage[ ARENA_SIZE ];
+
+    arena.pBase = storage;
+
+    TEST_ASSERT_EQUAL_PTR( storage, otaJobArena_Alloc( &arena, NULL, 5U ) );
+    TEST_ASSERT_EQUAL_PTR( &storage[ 8 ], otaJobArena_Alloc( &arena, NULL, ARENA_SIZE - 8U ) );
+    TEST_ASSERT_NULL( otaJobArena_Alloc( &arena, NULL, 1U ) );
+
+    otaJobArena_Release( &arena, NULL );
+    TEST_ASSERT_EQUAL_PTR( storage, arena.pBase );
+    TEST_ASSERT_EQUAL( 0U, arena.used );
+
+    TEST_ASSERT_EQUAL_PTR( storage, otaJobArena_Alloc( &arena, NULL, ARENA_SIZE ) );
+    TEST_ASSERT_EQUAL_UINT32( 0, mallocCount );
+    TEST_ASSERT_EQUAL_UINT32( 0, freeCount );
+
+    /* Not freed by tearDown. */
+    arena.pBase = NULL;
+}
@@ -28,6 +28,7 @@
 #include <string.h>
 #include <mqueue.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "unity.h"
 
 /* For accessing OTA private functions and error codes. */
@@ -38,14 +39,20 @@
 #define TIMER_NAME             "dummy_name"
 #define OTA_DEFAULT_TIMEOUT    1000 /*!< Timeout in milliseconds. */
 
+/* Event ring test constants. */
+#define RING_TEST_SENDERS              4                      /*!< Threads sending events at the same time. */
+#define RING_TEST_EVENTS_PER_SENDER    10000                  /*!< Events sent by each thread. */
+
 /* Interfaces for Timer and Event. */
 static OtaTimerInterface_t timer;
 static OtaEventInterface_t event;
 static OtaEventContext_t * pEventContext = NULL;
 static bool timerCallbackInovked = false;
+static OtaTimerId_t timerCallbackId = OtaNumOfTimers;
 
-static void timerCallback()
+static void timerCallback( OtaTimerId_t otaTimerId )
 {
+    timerCallbackId = otaTimerId;
     timerCallbackInovked = true;
 }
 /* ============================   UNITY FIXTURES ============================ */
@@ -59,6 +66,7 @@ void setUp( void )
     event.init = Posix_OtaInitEvent;
     event.send = Posix_OtaSendEvent;
     event.recv = Posix_OtaReceiveEvent;
+    event.recvBatch = Posix_OtaReceiveEvents;
     event.deinit = Posix_OtaDeinitEvent;
     event.pEventContext = pEventContext;
 }
@@ -66,6 +74,7 @@ void setUp( void )
 void tearDown( void )
 {
     timerCallbackInovked = false;
+    timerCallbackId = OtaNumOfTimers;
 }
 
 /* ========================================================================== */
@@ -93,6 +102,135 @@ void test_OTA_posix_SendAndRecvEvent( void )
     TEST_ASSERT_EQUAL( OtaErrNone, result );
 }
 
+/**
+ * @brief Test that the pending events are received in order by a batch receive.
+ */
+void test_OTA_posix_SendAndRecvEvents( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventsToRecv[ 2 ] = { 0 };
+    uint32_t numEvents = 0;
+    OtaErr_t result = OtaErrUninitialized;
+
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    otaEventToSend.eventId = OtaAgentEventStart;
+    result = event.send( event.pEventContext, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    otaEventToSend.eventId = OtaAgentEventSuspend;
+    result = event.send( event.pEventContext, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    otaEventToSend.eventId = OtaAgentEventResume;
+    result = event.send( event.pEventContext, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* No more events than there is room for are received. */
+    result = event.recvBatch( event.pEventContext, otaEventsToRecv, 2, &numEvents, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 2, numEvents );
+    TEST_ASSERT_EQUAL( OtaAgentEventStart, otaEventsToRecv[ 0 ].eventId );
+    TEST_ASSERT_EQUAL( OtaAgentEventSuspend, otaEventsToRecv[ 1 ].eventId );
+
+    /* The receive returns with the events pending, without waiting for more. */
+    result = event.recvBatch( event.pEventContext, otaEventsToRecv, 2, &numEvents, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 1, numEvents );
+    TEST_ASSERT_EQUAL( OtaAgentEventResume, otaEventsToRecv[ 0 ].eventId );
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/**
+ * @brief Test that the control events are received before the file blocks of
+ * the queue, and that the file blocks leave room for them.
+ */
+void test_OTA_posix_EventPriority( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    OtaErr_t result = OtaErrUninitialized;
+    uint32_t numBlocks = 0;
+
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Send file blocks until the queue refuses them. */
+    otaEventToSend.eventId = OtaAgentEventReceivedFileBlock;
+
+    while( event.send( event.pEventContext, &otaEventToSend, 0 ) == OtaOsSuccess )
+    {
+        numBlocks++;
+        TEST_ASSERT_LESS_THAN( 10, numBlocks );
+    }
+
+    TEST_ASSERT_GREATER_THAN( 0, numBlocks );
+
+    otaEventToSend.eventId = OtaAgentEventSuspend;
+    result = event.send( event.pEventContext, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    otaEventToSend.eventId = OtaAgentEventResume;
+    result = event.send( event.pEventContext, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    result = event.recv( event.pEventContext, &otaEventToRecv, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( OtaAgentEventSuspend, otaEventToRecv.eventId );
+    result = event.recv( event.pEventContext, &otaEventToRecv, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( OtaAgentEventResume, otaEventToRecv.eventId );
+    result = event.recv( event.pEventContext, &otaEventToRecv, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( OtaAgentEventReceivedFileBlock, otaEventToRecv.eventId );
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/**
+ * @brief Test that polling the event queue returns the pending events, and
+ * returns at once when there are none.
+ */
+void test_OTA_posix_PollEvents( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventsToRecv[ 2 ] = { 0 };
+    uint32_t numEvents = 0;
+    OtaErr_t result = OtaErrUninitialized;
+
+    result = event.init( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    result = Posix_OtaPollEvents( event.pEventContext, otaEventsToRecv, 2, &numEvents );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 0, numEvents );
+
+    otaEventToSend.eventId = OtaAgentEventStart;
+    result = event.send( event.pEventContext, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    otaEventToSend.eventId = OtaAgentEventSuspend;
+    result = event.send( event.pEventContext, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    otaEventToSend.eventId = OtaAgentEventResume;
+    result = event.send( event.pEventContext, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    result = Posix_OtaPollEvents( event.pEventContext, otaEventsToRecv, 2, &numEvents );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 2, numEvents );
+    TEST_ASSERT_EQUAL( OtaAgentEventStart, otaEventsToRecv[ 0 ].eventId );
+    TEST_ASSERT_EQUAL( OtaAgentEventSuspend, otaEventsToRecv[ 1 ].eventId );
+
+    result = Posix_OtaPollEvents( event.pEventContext, otaEventsToRecv, 2, &numEvents );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 1, numEvents );
+    TEST_ASSERT_EQUAL( OtaAgentEventResume, otaEventsToRecv[ 0 ].eventId );
+
+    result = event.deinit( event.pEventContext );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
 /**
  * @brief Test that the event queue operations do not succeed for invalid operations.
  */
@@ -111,6 +249,227 @@ void test_OTA_posix_InvalidEventQueue( void )
     TEST_ASSERT_EQUAL( OtaOsEventQueueDeleteFailed, result );
 }
 
+/**
+ * @brief Test that the in-process event ring passes events and rejects
+ * invalid operations.
+ */
+void test_OTA_posix_SendAndRecvRingEvent( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventToRecv = { 0 };
+    uint32_t numEvents = 0;
+    OtaErr_t result = OtaErrUninitialized;
+
+    /* Nothing can be sent before the ring is initialized. */
+    result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueSendFailed, result );
+    result = Posix_OtaReceiveRingEvent( NULL, &otaEventToRecv, 0 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueReceiveFailed, result );
+    result = Posix_OtaPollRingEvents( NULL, &otaEventToRecv, 1, &numEvents );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueReceiveFailed, result );
+
+    result = Posix_OtaInitRingEvent( NULL );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    otaEventToSend.eventId = OtaAgentEventStart;
+    result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    result = Posix_OtaReceiveRingEvent( NULL, &otaEventToRecv, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( otaEventToSend.eventId, otaEventToRecv.eventId );
+
+    /* Polling an empty ring returns at once. */
+    result = Posix_OtaPollRingEvents( NULL, &otaEventToRecv, 1, &numEvents );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 0, numEvents );
+
+    otaEventToSend.eventId = OtaAgentEventSuspend;
+    result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    result = Posix_OtaPollRingEvents( NULL, &otaEventToRecv, 1, &numEvents );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( 1, numEvents );
+    TEST_ASSERT_EQUAL( OtaAgentEventSuspend, otaEventToRecv.eventId );
+
+    result = Posix_OtaDeinitRingEvent( NULL );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Try to deinitialize the ring again. */
+    result = Posix_OtaDeinitRingEvent( NULL );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueDeleteFailed, result );
+}
+
+/**
+ * @brief Test that events are dropped when the ring is full, and that a batch
+ * receive takes them in order.
+ */
+void test_OTA_posix_RingEventFull( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventsToRecv[ OTA_POSIX_EVENT_RING_SIZE ] = { 0 };
+    uint32_t numEvents = 0;
+    uintptr_t i = 0;
+    OtaErr_t result = OtaErrUninitialized;
+
+    result = Posix_OtaInitRingEvent( NULL );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* Go around the lane of the file blocks a few times. */
+    otaEventToSend.eventId = OtaAgentEventReceivedFileBlock;
+
+    for( i = 0; i < ( OTA_POSIX_EVENT_RING_SIZE * 3 ) + 1; i++ )
+    {
+        otaEventToSend.pEventData = ( OtaEventData_t * ) i;
+        result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+        result = Posix_OtaReceiveRingEvent( NULL, &otaEventsToRecv[ 0 ], 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+        TEST_ASSERT_EQUAL_PTR( otaEventToSend.pEventData, otaEventsToRecv[ 0 ].pEventData );
+    }
+
+    for( i = 0; i < OTA_POSIX_EVENT_RING_SIZE; i++ )
+    {
+        otaEventToSend.pEventData = ( OtaEventData_t * ) i;
+        result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+    }
+
+    result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueSendFailed, result );
+
+    result = Posix_OtaReceiveRingEvents( NULL, otaEventsToRecv, OTA_POSIX_EVENT_RING_SIZE, &numEvents, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( OTA_POSIX_EVENT_RING_SIZE, numEvents );
+
+    for( i = 0; i < OTA_POSIX_EVENT_RING_SIZE; i++ )
+    {
+        TEST_ASSERT_EQUAL_PTR( ( OtaEventData_t * ) i, otaEventsToRecv[ i ].pEventData );
+    }
+
+    result = Posix_OtaDeinitRingEvent( NULL );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/**
+ * @brief Test that the control events are received before the file blocks of
+ * the ring, and still sent when the file blocks fill their lane.
+ */
+void test_OTA_posix_RingEventLanes( void )
+{
+    OtaEventMsg_t otaEventToSend = { 0 };
+    OtaEventMsg_t otaEventsToRecv[ OTA_POSIX_EVENT_RING_SIZE + 2 ] = { 0 };
+    uint32_t numEvents = 0;
+    uint32_t i = 0;
+    OtaErr_t result = OtaErrUninitialized;
+
+    result = Posix_OtaInitRingEvent( NULL );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    otaEventToSend.eventId = OtaAgentEventReceivedFileBlock;
+
+    for( i = 0; i < OTA_POSIX_EVENT_RING_SIZE; i++ )
+    {
+        result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+    }
+
+    result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaOsEventQueueSendFailed, result );
+
+    otaEventToSend.eventId = OtaAgentEventSuspend;
+    result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    otaEventToSend.eventId = OtaAgentEventResume;
+    result = Posix_OtaSendRingEvent( NULL, &otaEventToSend, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    /* The control events come first, in the order they were sent. */
+    result = Posix_OtaReceiveRingEvents( NULL, otaEventsToRecv, OTA_POSIX_EVENT_RING_SIZE + 2, &numEvents, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+    TEST_ASSERT_EQUAL( OTA_POSIX_EVENT_RING_SIZE + 2, numEvents );
+    TEST_ASSERT_EQUAL( OtaAgentEventSuspend, otaEventsToRecv[ 0 ].eventId );
+    TEST_ASSERT_EQUAL( OtaAgentEventResume, otaEventsToRecv[ 1 ].eventId );
+
+    for( i = 2; i < numEvents; i++ )
+    {
+        TEST_ASSERT_EQUAL( OtaAgentEventReceivedFileBlock, otaEventsToRecv[ i ].eventId );
+    }
+
+    result = Posix_OtaDeinitRingEvent( NULL );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
+/* Send numbered events to the ring, retrying while it is full. */
+static void * ringEventSender( void * pArg )
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    uintptr_t sender = ( uintptr_t ) pArg;
+    uintptr_t i = 0;
+
+    otaEvent.eventId = ( OtaEvent_t ) sender;
+
+    for( i = 0; i < RING_TEST_EVENTS_PER_SENDER; i++ )
+    {
+        otaEvent.pEventData = ( OtaEventData_t * ) i;
+
+        while( Posix_OtaSendRingEvent( NULL, &otaEvent, 0 ) != OtaOsSuccess )
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Test that the events sent by several threads at once are all received,
+ * in the order each thread sent them.
+ */
+void test_OTA_posix_RingEventSenders( void )
+{
+    pthread_t senders[ RING_TEST_SENDERS ];
+    uintptr_t nextEvent[ RING_TEST_SENDERS ] = { 0 };
+    OtaEventMsg_t otaEventsToRecv[ 4 ] = { 0 };
+    uint32_t numEvents = 0;
+    uint32_t received = 0;
+    uint32_t i = 0;
+    uintptr_t sender = 0;
+    OtaErr_t result = OtaErrUninitialized;
+
+    result = Posix_OtaInitRingEvent( NULL );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+    for( sender = 0; sender < RING_TEST_SENDERS; sender++ )
+    {
+        TEST_ASSERT_EQUAL( 0, pthread_create( &senders[ sender ], NULL, ringEventSender, ( void * ) sender ) );
+    }
+
+    while( received < ( RING_TEST_SENDERS * RING_TEST_EVENTS_PER_SENDER ) )
+    {
+        /* The receive waits for the senders when the ring is empty. */
+        result = Posix_OtaReceiveRingEvents( NULL, otaEventsToRecv, 4, &numEvents, 0 );
+        TEST_ASSERT_EQUAL( OtaErrNone, result );
+
+        for( i = 0; i < numEvents; i++ )
+        {
+            sender = ( uintptr_t ) otaEventsToRecv[ i ].eventId;
+            TEST_ASSERT_LESS_THAN( RING_TEST_SENDERS, sender );
+            TEST_ASSERT_EQUAL_PTR( ( OtaEventData_t * ) nextEvent[ sender ], otaEventsToRecv[ i ].pEventData );
+            nextEvent[ sender ]++;
+        }
+
+        received += numEvents;
+    }
+
+    for( sender = 0; sender < RING_TEST_SENDERS; sender++ )
+    {
+        TEST_ASSERT_EQUAL( 0, pthread_join( senders[ sender ], NULL ) );
+    }
+
+    result = Posix_OtaDeinitRingEvent( NULL );
+    TEST_ASSERT_EQUAL( OtaErrNone, result );
+}
+
 void timerCreateAndStop( OtaTimerId_t timer_id )
 {
     OtaErr_t result = OtaErrUninitialized;
@@ -128,6 +487,7 @@ void timerCreateAndStop( OtaTimerId_t timer_id )
     }
 
     TEST_ASSERT_EQUAL( true, timerCallbackInovked );
+    TEST_ASSERT_EQUAL( timer_id, timerCallbackId );
 
     result = timer.stop( timer_id );
     TEST_ASSERT_EQUAL( OtaErrNone, result );
@@ -152,6 +512,14 @@ void test_OTA_posix_SelfTestTimerCreateAndStop( void )
     timerCreateAndStop( OtaSelfTestTimer );
 }
 
+/**
+ * @brief Test the timers of another agent instance are separate from the ones of the agent.
+ */
+void test_OTA_posix_InstanceTimerCreateAndStop( void )
+{
+    timerCreateAndStop( ( OtaTimerId_t ) ( OtaNumOfTimers + OtaRequestTimer ) );
+}
+
 /**
  * @brief Test invalid operations on timers.
  */
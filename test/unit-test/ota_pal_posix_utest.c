@@ -0,0 +1,251 @@
+/*
+ * AWS IoT Over-the-air Update v3.0.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file ota_pal_posix_utest.c
+ * @brief Unit tests for functions in ota_pal_posix.c
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "unity.h"
+
+/* For accessing OTA private functions and error codes. */
+#include "ota.h"
+#include "ota_pal_posix.h"
+
+/* Testing constants. */
+#define TEST_FILE_PATH     "ota_pal_posix_utest.bin"
+#define TEST_FILE_SIZE     10000U
+#define TEST_BLOCK_SIZE    4096U
+
+/* File context of the file received. */
+static OtaFileContext_t fileContext;
+
+/* Content of the file received. */
+static uint8_t pFileContent[ TEST_FILE_SIZE ];
+
+/* Check the file mapped has the content written, in place of the signature. */
+static OtaPalStatus_t checkFileContent( OtaFileContext_t * const pFileContext,
+                                        const uint8_t * pFileData,
+                                        uint32_t fileSize )
+{
+    OtaPalStatus_t status = OTA_PAL_COMBINE_ERR( OtaPalSignatureCheckFailed, 0 );
+
+    if( ( pFileContext == &fileContext ) && ( fileSize == TEST_FILE_SIZE ) &&
+        ( memcmp( pFileData, pFileContent, TEST_FILE_SIZE ) == 0 ) )
+    {
+        status = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+    }
+
+    return status;
+}
+
+/* Write the whole file in blocks, the last one being shorter. */
+static void writeFile( void )
+{
+    uint32_t offset = 0;
+    uint32_t blockSize = 0;
+
+    for( offset = 0U; offset < TEST_FILE_SIZE; offset += blockSize )
+    {
+        blockSize = ( ( TEST_FILE_SIZE - offset ) < TEST_BLOCK_SIZE ) ? ( TEST_FILE_SIZE - offset ) : TEST_BLOCK_SIZE;
+        TEST_ASSERT_EQUAL( blockSize, Posix_OtaPalWriteBlock( &fileContext, offset, &pFileContent[ offset ], blockSize ) );
+    }
+}
+
+/* ============================   UNITY FIXTURES ============================ */
+
+void setUp( void )
+{
+    uint32_t i = 0;
+
+    for( i = 0U; i < TEST_FILE_SIZE; i++ )
+    {
+        pFileContent[ i ] = ( uint8_t ) ( i * 7U );
+    }
+
+    ( void ) memset( &fileContext, 0, sizeof( fileContext ) );
+    fileContext.pFilePath = ( uint8_t * ) TEST_FILE_PATH;
+    fileContext.fileSize = TEST_FILE_SIZE;
+
+    Posix_OtaPalSetSignatureCheck( checkFileContent );
+}
+
+void tearDown( void )
+{
+    ( void ) Posix_OtaPalAbort( &fileContext );
+    ( void ) unlink( TEST_FILE_PATH );
+    ( void ) unlink( OTA_PAL_POSIX_IMAGE_STATE_FILE );
+}
+
+/* ========================================================================== */
+
+/**
+ * @brief Test that the blocks written are in the file once it is closed.
+ */
+void test_OTA_pal_posix_ReceiveFile( void )
+{
+    uint8_t pFileRead[ TEST_FILE_SIZE + 1U ] = { 0 };
+    FILE * pFile = NULL;
+
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( &fileContext ) ) );
+    TEST_ASSERT_NOT_NULL( fileContext.pFile );
+
+    writeFile();
+
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalCloseFile( &fileContext ) ) );
+    TEST_ASSERT_NULL( fileContext.pFile );
+
+    /* The file has the size allocated and the blocks written. */
+    pFile = fopen( TEST_FILE_PATH, "rb" );
+    TEST_ASSERT_NOT_NULL( pFile );
+    TEST_ASSERT_EQUAL( TEST_FILE_SIZE, fread( pFileRead, 1, sizeof( pFileRead ), pFile ) );
+    ( void ) fclose( pFile );
+    TEST_ASSERT_EQUAL_MEMORY( pFileContent, pFileRead, TEST_FILE_SIZE );
+}
+
+/**
+ * @brief Test that a file failing the signature check is removed.
+ */
+void test_OTA_pal_posix_SignatureCheckFails( void )
+{
+    /* The content written differs from the one checked. */
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( &fileContext ) ) );
+    writeFile();
+    pFileContent[ 0 ]++;
+    TEST_ASSERT_EQUAL( OtaPalSignatureCheckFailed, OTA_PAL_MAIN_ERR( Posix_OtaPalCloseFile( &fileContext ) ) );
+    TEST_ASSERT_NULL( fileContext.pFile );
+    TEST_ASSERT_NOT_EQUAL( 0, access( TEST_FILE_PATH, F_OK ) );
+
+    /* Without a signature check every file fails. */
+    Posix_OtaPalSetSignatureCheck( NULL );
+    pFileContent[ 0 ]--;
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( &fileContext ) ) );
+    writeFile();
+    TEST_ASSERT_EQUAL( OtaPalSignatureCheckFailed, OTA_PAL_MAIN_ERR( Posix_OtaPalCloseFile( &fileContext ) ) );
+    TEST_ASSERT_NOT_EQUAL( 0, access( TEST_FILE_PATH, F_OK ) );
+}
+
+/**
+ * @brief Test that the blocks outside of the file and those of a file not
+ * open are not written.
+ */
+void test_OTA_pal_posix_WriteBlockInvalid( void )
+{
+    TEST_ASSERT_EQUAL( -1, Posix_OtaPalWriteBlock( &fileContext, 0, pFileContent, TEST_BLOCK_SIZE ) );
+    TEST_ASSERT_EQUAL( -1, Posix_OtaPalWriteBlock( NULL, 0, pFileContent, TEST_BLOCK_SIZE ) );
+
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( &fileContext ) ) );
+    TEST_ASSERT_EQUAL( -1, Posix_OtaPalWriteBlock( &fileContext, TEST_FILE_SIZE - 1U, pFileContent, 2U ) );
+    TEST_ASSERT_EQUAL( -1, Posix_OtaPalWriteBlock( &fileContext, TEST_FILE_SIZE + 1U, pFileContent, 0U ) );
+    TEST_ASSERT_EQUAL( -1, Posix_OtaPalWriteBlock( &fileContext, 0, NULL, 1U ) );
+    TEST_ASSERT_EQUAL( 1, Posix_OtaPalWriteBlock( &fileContext, TEST_FILE_SIZE - 1U, pFileContent, 1U ) );
+
+    /* A file not open can't be closed. */
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalAbort( &fileContext ) ) );
+    TEST_ASSERT_EQUAL( OtaPalFileClose, OTA_PAL_MAIN_ERR( Posix_OtaPalCloseFile( &fileContext ) ) );
+    TEST_ASSERT_EQUAL( OtaPalNullFileContext, OTA_PAL_MAIN_ERR( Posix_OtaPalCloseFile( NULL ) ) );
+}
+
+/**
+ * @brief Test that aborting removes the file, and succeeds without a file open.
+ */
+void test_OTA_pal_posix_Abort( void )
+{
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalAbort( &fileContext ) ) );
+    TEST_ASSERT_EQUAL( OtaPalNullFileContext, OTA_PAL_MAIN_ERR( Posix_OtaPalAbort( NULL ) ) );
+
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( &fileContext ) ) );
+    TEST_ASSERT_EQUAL( 0, access( TEST_FILE_PATH, F_OK ) );
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalAbort( &fileContext ) ) );
+    TEST_ASSERT_NULL( fileContext.pFile );
+    TEST_ASSERT_NOT_EQUAL( 0, access( TEST_FILE_PATH, F_OK ) );
+}
+
+/**
+ * @brief Test that files are not created without a path, a size, or a slot
+ * left to open them.
+ */
+void test_OTA_pal_posix_CreateFileInvalid( void )
+{
+    OtaFileContext_t otherFiles[ OTA_PAL_POSIX_MAX_OPEN_FILES ];
+    char pPaths[ OTA_PAL_POSIX_MAX_OPEN_FILES ][ 32 ];
+    uint32_t i = 0;
+
+    TEST_ASSERT_EQUAL( OtaPalNullFileContext, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( NULL ) ) );
+
+    fileContext.fileSize = 0;
+    TEST_ASSERT_EQUAL( OtaPalRxFileCreateFailed, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( &fileContext ) ) );
+
+    fileContext.fileSize = TEST_FILE_SIZE;
+    fileContext.pFilePath = ( uint8_t * ) "no_such_directory/file.bin";
+    TEST_ASSERT_EQUAL( OtaPalRxFileCreateFailed, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( &fileContext ) ) );
+    TEST_ASSERT_NULL( fileContext.pFile );
+    fileContext.pFilePath = ( uint8_t * ) TEST_FILE_PATH;
+
+    for( i = 0U; i < OTA_PAL_POSIX_MAX_OPEN_FILES; i++ )
+    {
+        ( void ) snprintf( pPaths[ i ], sizeof( pPaths[ i ] ), "ota_pal_posix_utest_%u.bin", ( unsigned ) i );
+        ( void ) memset( &otherFiles[ i ], 0, sizeof( otherFiles[ i ] ) );
+        otherFiles[ i ].pFilePath = ( uint8_t * ) pPaths[ i ];
+        otherFiles[ i ].fileSize = TEST_FILE_SIZE;
+        TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( &otherFiles[ i ] ) ) );
+    }
+
+    TEST_ASSERT_EQUAL( OtaPalRxFileCreateFailed, OTA_PAL_MAIN_ERR( Posix_OtaPalCreateFileForRx( &fileContext ) ) );
+
+    for( i = 0U; i < OTA_PAL_POSIX_MAX_OPEN_FILES; i++ )
+    {
+        TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalAbort( &otherFiles[ i ] ) ) );
+    }
+}
+
+/**
+ * @brief Test that the image state set is the one read back.
+ */
+void test_OTA_pal_posix_ImageState( void )
+{
+    /* Without a state, the image is valid. */
+    TEST_ASSERT_EQUAL( OtaPalImageStateValid, Posix_OtaPalGetPlatformImageState( &fileContext ) );
+
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalSetPlatformImageState( &fileContext, OtaImageStateTesting ) ) );
+    TEST_ASSERT_EQUAL( OtaPalImageStatePendingCommit, Posix_OtaPalGetPlatformImageState( &fileContext ) );
+
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalSetPlatformImageState( &fileContext, OtaImageStateAccepted ) ) );
+    TEST_ASSERT_EQUAL( OtaPalImageStateValid, Posix_OtaPalGetPlatformImageState( &fileContext ) );
+
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalSetPlatformImageState( &fileContext, OtaImageStateRejected ) ) );
+    TEST_ASSERT_EQUAL( OtaPalImageStateInvalid, Posix_OtaPalGetPlatformImageState( &fileContext ) );
+
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalSetPlatformImageState( &fileContext, OtaImageStateAborted ) ) );
+    TEST_ASSERT_EQUAL( OtaPalImageStateInvalid, Posix_OtaPalGetPlatformImageState( &fileContext ) );
+
+    /* The states out of range are not set. */
+    TEST_ASSERT_EQUAL( OtaPalBadImageState, OTA_PAL_MAIN_ERR( Posix_OtaPalSetPlatformImageState( &fileContext, OtaImageStateUnknown ) ) );
+    TEST_ASSERT_EQUAL( OtaPalBadImageState, OTA_PAL_MAIN_ERR( Posix_OtaPalSetPlatformImageState( &fileContext, ( OtaImageState_t ) ( OtaLastImageState + 1 ) ) ) );
+    TEST_ASSERT_EQUAL( OtaPalImageStateInvalid, Posix_OtaPalGetPlatformImageState( &fileContext ) );
+
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalActivateNewImage( &fileContext ) ) );
+    TEST_ASSERT_EQUAL( OtaPalSuccess, OTA_PAL_MAIN_ERR( Posix_OtaPalResetDevice( &fileContext ) ) );
+}
@@ -40,8 +40,10 @@
 #include "ota.h"
 #include "ota_private.h"
 #include "ota_mqtt_private.h"
+#include "ota_cbor_private.h"
 #include "ota_http_private.h"
 #include "ota_interface_private.h"
+#include "ota_event_buffer.h"
 
 /* test includes. */
 #include "utest_helpers.h"
@@ -58,6 +60,9 @@
 #define JOB_DOC_SELF_TEST_SAME_VERSION    "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob20\",\"status\":\"IN_PROGRESS\",\"statusDetails\":{\"self_test\":\"ready\",\"updatedBy\":\"0x1000001\"},\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
 #define JOB_DOC_SELF_TEST_DOWNGRADE       "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob20\",\"status\":\"IN_PROGRESS\",\"statusDetails\":{\"self_test\":\"ready\",\"updatedBy\":\"0x2000000\"},\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
 #define JOB_DOC_HTTP                      "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob22\",\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"HTTP\"],\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"update_data_url\":\"https://dummy-url.com/ota.bin\",\"auth_scheme\":\"aws.s3.presigned\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
+#define JOB_DOC_HTTP_TWO_FILES            "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob22\",\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"HTTP\"],\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"update_data_url\":\"https://dummy-url.com/ota.bin\",\"auth_scheme\":\"aws.s3.presigned\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}, {\"filepath\":\"/test/config\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":1,\"fileType\":2,\"certfile\":\"test.crt\",\"update_data_url\":\"https://dummy-url.com/config.bin\",\"auth_scheme\":\"aws.s3.presigned\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
+#define JOB_DOC_TWO_FILES                 "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob23\",\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}, {\"filepath\":\"/test/config\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":1,\"fileType\":2,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
+#define JOB_DOC_HTTP_DELTA                "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob22\",\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"HTTP\"],\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"fileType\":3,\"certfile\":\"test.crt\",\"update_data_url\":\"https://dummy-url.com/ota.patch\",\"auth_scheme\":\"aws.s3.presigned\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
 #define JOB_DOC_ONE_BLOCK                 "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob22\",\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"HTTP\"],\"files\":[{\"filepath\":\"/test/demo\",\"filesize\": \"1024\" ,\"fileid\":0,\"certfile\":\"test.crt\",\"update_data_url\":\"https://dummy-url.com/ota.bin\",\"auth_scheme\":\"aws.s3.presigned\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
 #define JOB_DOC_INVALID                   "not a json"
 #define JOB_DOC_INVALID_PROTOCOL          "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob20\",\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"XYZ\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
@@ -70,6 +75,13 @@
 #define JOB_DOC_MISSING_JOB_ID            "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
 #define JOB_DOC_INVALID_JOB_ID            "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"InvalidJobIdExceedingAllowedJobIdLengthInvalidJobIdExceedingAllowedJobIdLengthInvalidJobIdExceedingAllowedJobIdLength\",\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
 #define JOB_DOC_DIFFERENT_FILE_TYPE       "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob20\",\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"fileType\":2,\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
+#define JOB_DOC_REORDERED                 "{ \"execution.jobId\" : \"AFR_OTA-dotted\", \"execution\" : { \"jobDocument\" : { \"afr_ota\" : { \"files\" : [ { \"sig-sha256-ecdsa\" : \"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\", \"certfile\" : \"test.crt\", \"fileid\" : 0, \"filesize\" : " OTA_TEST_FILE_SIZE_STR ", \"filepath\" : \"/test/demo\" }, { \"fileid\" : 1 } ], \"streamname\" : \"AFR_OTA-XYZ\", \"protocols\" : [ \"MQTT\" ] } }, \"status\" : \"QUEUED\", \"jobId\" : \"AFR_OTA-testjob20\" }, \"timestamp\" : 1602795143, \"clientToken\" : \"0:testclient\" }"
+#define JOB_DOC_SECOND_FILE_KEY           "{\"clientToken\":\"0:testclient\",\"timestamp\":1602795143,\"execution\":{\"jobId\":\"AFR_OTA-testjob20\",\"status\":\"QUEUED\",\"queuedAt\":1602795128,\"lastUpdatedAt\":1602795128,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"},{\"filesize\":" OTA_TEST_FILE_SIZE_STR "}] }}}}"
+
+#define JOB_DOC_ESCAPED_STRINGS           "{\"clientToken\":\"\\\"execution\\\":{\\\"jobId\\\":\\\"AFR_OTA-fake\\\"}\",\"ex\\\"ecution\":1,\"execution\":{\"jobId\":\"AFR_OTA-testjob20\",\"status\":\"QUEUED\",\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\\\\\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
+#define JOB_DOC_DEEP_STATUS_DETAILS       "{\"execution\":{\"statusDetails\":{\"a\":{\"b\":{\"c\":{\"d\":{\"e\":{\"f\":{\"g\":{\"h\":{\"i\":{\"jobId\":\"AFR_OTA-deep\"}}}}}}}}}},\"jobId\":\"AFR_OTA-testjob20\",\"status\":\"QUEUED\",\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
+#define JOB_DOC_DUPLICATE_KEYS            "{\"execution\":{\"jobId\":\"AFR_OTA-testjob20\",\"jobId\":\"AFR_OTA-second\",\"status\":\"QUEUED\",\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}},\"execution\":{\"jobId\":\"AFR_OTA-third\"}}"
+#define JOB_DOC_FILES_NOT_OBJECTS         "{\"execution\":{\"jobId\":\"AFR_OTA-testjob20\",\"status\":\"QUEUED\",\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-XYZ\",\"files\":[\"/test/demo\",[{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}],{\"filepath\":\"/test/demo\",\"filesize\":" OTA_TEST_FILE_SIZE_STR ",\"fileid\":0,\"certfile\":\"test.crt\",\"sig-sha256-ecdsa\":\"MEQCIF2QDvww1G/kpRGZ8FYvQrok1bSZvXjXefRk7sqNcyPTAiB4dvGt8fozIY5NC0vUDJ2MY42ZERYEcrbwA4n6q7vrBg==\"}] }}}}"
 
 /* OTA application buffer size. */
 #define OTA_UPDATE_FILE_PATH_SIZE         100
@@ -125,10 +137,43 @@ static OtaEventMsg_t * otaEventQueueEnd = otaEventQueue;
 static OtaEventData_t eventBuffer;
 static bool eventIgnore;
 
+/* HTTP ranges requested. */
+static uint32_t httpRangeStarts[ OTA_TEST_FILE_NUM_BLOCKS ];
+static uint32_t httpRangeEnds[ OTA_TEST_FILE_NUM_BLOCKS ];
+static uint32_t httpRangesRequested = 0;
+
 /* OTA File handle and buffer. */
 static FILE * pOtaFileHandle = NULL;
 static uint8_t pOtaFileBuffer[ OTA_TEST_FILE_SIZE ];
 
+/* File sinks written with the same blocks, and the number of files closed. */
+static OtaFileContext_t fileSinks[ otaconfigMAX_NUM_FILE_SINKS ];
+static uint8_t pFileSinkBuffers[ otaconfigMAX_NUM_FILE_SINKS ][ OTA_TEST_FILE_SIZE ];
+static uint8_t pFileSinkBitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
+static uint32_t filesClosed = 0;
+
+/* Offsets and sizes of the writes to the file, and the number of writes. */
+static uint32_t writeOffsets[ OTA_TEST_FILE_NUM_BLOCKS ];
+static uint32_t writeSizes[ OTA_TEST_FILE_NUM_BLOCKS ];
+static uint32_t writesDone = 0;
+
+/* Number of bytes of the delta update applied. */
+static uint32_t patchedBytes = 0;
+
+/* Number of bytes and blocks given to the streaming digest. */
+static uint32_t digestBytes = 0;
+static uint32_t digestBlocks = 0;
+
+/* Number of checkpoints saved and the blocks remaining in the last one. */
+static uint32_t checkpointsSaved = 0;
+static uint32_t checkpointBlocksRemaining = 0;
+
+/* Block size the checkpoint of a resumed file was saved with. */
+static uint32_t checkpointLog2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE;
+
+/* Last event the application callback was called with at the end of a download. */
+static OtaJobEvent_t lastAppCallbackEvent = OtaLastJobEvent;
+
 /* 2 seconds default wait time for OTA state machine transition. */
 static const int otaDefaultWait = 0;
 
@@ -149,11 +194,17 @@ extern OtaDataInterface_t otaDataInterface;
 extern OtaControlInterface_t otaControlInterface;
 
 /* The OTA job document model. */
-extern const JsonDocParam_t * otaJobDocModelParamStructure;
+extern const JsonDocParam_t otaJobDocModelParamStructure[ OTA_NUM_JOB_PARAMS ];
+
+/* Global static variable defined in ota.c, true while the agent processes events. */
+extern bool eventsProcessing;
 
 /* Static function defined in ota.c for processing events. */
 extern void receiveAndProcessOtaEvent( void );
 
+/* Static function defined in ota.c for finding the transition of an event. */
+extern uint32_t searchTransition( const OtaEventMsg_t * pEventMsg );
+
 /* Static state machine function handlers under test defined in ota.c. */
 extern OtaErr_t initFileHandler( const OtaEventData_t * pEventData );
 extern OtaErr_t requestDataHandler( const OtaEventData_t * pEventData );
@@ -164,7 +215,8 @@ extern OtaErr_t jobNotificationHandler( const OtaEventData_t * pEventData );
 extern OtaErr_t shutdownHandler( const OtaEventData_t * pEventData );
 
 /* Static helper functions under test defined in ota.c. */
-extern OtaErr_t setImageStateWithReason( OtaImageState_t stateToSet,
+extern OtaErr_t setImageStateWithReason( OtaAgentContext_t * pAgentCtx,
+                                         OtaImageState_t stateToSet,
                                          uint32_t reasonToSet );
 extern bool otaClose( OtaFileContext_t * const pFileContext );
 extern bool validateDataBlock( const OtaFileContext_t * pFileContext,
@@ -186,6 +238,10 @@ extern OtaFileContext_t * parseJobDoc( const JsonDocParam_t * pJsonDoc,
 extern DocParseErr_t validateJSON( const char * pJson,
                                    uint32_t messageLength );
 
+extern DocParseErr_t parseJSONbyModel( const char * pJson,
+                                       uint32_t messageLength,
+                                       JsonDocModel_t * pDocModel );
+
 extern IngestResult_t ingestDataBlockCleanup( OtaFileContext_t * pFileContext,
                                               OtaPalStatus_t * pCloseResult );
 
@@ -203,6 +259,25 @@ static void * mockMallocAlwaysFail( size_t size )
     return NULL;
 }
 
+static size_t mallocCount = 0;
+static size_t freeCount = 0;
+
+static void * mockMallocCounted( size_t size )
+{
+    mallocCount++;
+    return malloc( size );
+}
+
+static void mockFreeCounted( void * ptr )
+{
+    if( ptr != NULL )
+    {
+        freeCount++;
+    }
+
+    free( ptr );
+}
+
 static OtaOsStatus_t mockOSEventReset( OtaEventContext_t * unused )
 {
     otaEventQueueEnd = otaEventQueue;
@@ -231,8 +306,7 @@ static OtaOsStatus_t mockOSEventSendThenStop( OtaEventContext_t * unused_1,
     {
         const OtaEventMsg_t * pOtaEvent = pEventMsg;
 
-        otaEventQueueEnd->eventId = pOtaEvent->eventId;
-        otaEventQueueEnd->pEventData = pOtaEvent->pEventData;
+        *otaEventQueueEnd = *pOtaEvent;
         otaEventQueueEnd++;
 
         eventIgnore = true;
@@ -278,8 +352,7 @@ static OtaOsStatus_t mockOSEventSend( OtaEventContext_t * unused_1,
 
     const OtaEventMsg_t * pOtaEvent = pEventMsg;
 
-    otaEventQueueEnd->eventId = pOtaEvent->eventId;
-    otaEventQueueEnd->pEventData = pOtaEvent->pEventData;
+    *otaEventQueueEnd = *pOtaEvent;
     otaEventQueueEnd++;
 
     return OtaOsSuccess;
@@ -310,8 +383,7 @@ static OtaOsStatus_t mockOSEventReceive( OtaEventContext_t * unused_1,
 
     if( otaEventQueueEnd != otaEventQueue )
     {
-        pOtaEvent->eventId = otaEventQueue[ 0 ].eventId;
-        pOtaEvent->pEventData = otaEventQueue[ 0 ].pEventData;
+        *pOtaEvent = otaEventQueue[ 0 ];
         memmove( otaEventQueue, otaEventQueue + 1, sizeof( OtaEventMsg_t ) * ( currQueueSize - 1 ) );
         otaEventQueueEnd--;
     }
@@ -323,6 +395,44 @@ static OtaOsStatus_t mockOSEventReceive( OtaEventContext_t * unused_1,
     return err;
 }
 
+/* Receive all the events in the queue, up to maxEvents. */
+static OtaOsStatus_t mockOSEventReceiveBatch( OtaEventContext_t * unused_1,
+                                              void * pEventMsgs,
+                                              uint32_t maxEvents,
+                                              uint32_t * pNumEvents,
+                                              uint32_t unused_2 )
+{
+    OtaOsStatus_t err = OtaOsSuccess;
+    OtaEventMsg_t * pOtaEvents = pEventMsgs;
+    uint32_t numEvents = 0;
+
+    while( ( numEvents < maxEvents ) &&
+           ( mockOSEventReceive( unused_1, &pOtaEvents[ numEvents ], unused_2 ) == OtaOsSuccess ) )
+    {
+        numEvents++;
+    }
+
+    if( numEvents == 0 )
+    {
+        err = OtaOsEventQueueReceiveFailed;
+    }
+
+    *pNumEvents = numEvents;
+
+    return err;
+}
+
+/* Receive the events in the queue, up to maxEvents, without failing when there are none. */
+static OtaOsStatus_t mockOSEventPoll( OtaEventContext_t * unused,
+                                      void * pEventMsgs,
+                                      uint32_t maxEvents,
+                                      uint32_t * pNumEvents )
+{
+    ( void ) mockOSEventReceiveBatch( unused, pEventMsgs, maxEvents, pNumEvents, 0 );
+
+    return OtaOsSuccess;
+}
+
 static OtaOsStatus_t stubOSTimerStart( OtaTimerId_t timerId,
                                        const char * const pTimerName,
                                        const uint32_t timeout,
@@ -335,6 +445,26 @@ static OtaOsStatus_t stubOSTimerStart( OtaTimerId_t timerId,
     return OtaOsSuccess;
 }
 
+/* Count the number of times the request timer is started. */
+static uint32_t requestTimerStarts = 0;
+
+static OtaOsStatus_t mockOSTimerStartCount( OtaTimerId_t timerId,
+                                            const char * const pTimerName,
+                                            const uint32_t timeout,
+                                            OtaTimerCallback_t callback )
+{
+    ( void ) pTimerName;
+    ( void ) timeout;
+    ( void ) callback;
+
+    if( timerId == OtaRequestTimer )
+    {
+        requestTimerStarts++;
+    }
+
+    return OtaOsSuccess;
+}
+
 static OtaOsStatus_t mockOSTimerInvokeCallback( OtaTimerId_t timerId,
                                                 const char * const pTimerName,
                                                 const uint32_t timeout,
@@ -407,6 +537,32 @@ static OtaMqttStatus_t stubMqttPublish( const char * const unused_1,
     return OtaMqttSuccess;
 }
 
+/* Last message published, recorded by mockMqttPublishRecordMessage, and the number of messages. */
+static char publishedMessage[ OTA_REQUEST_MSG_MAX_SIZE ];
+static uint32_t publishedMessageSize = 0;
+static char publishedTopic[ OTA_CACHED_TOPIC_MAX_SIZE ];
+static uint32_t messagesPublished = 0;
+
+static OtaMqttStatus_t mockMqttPublishRecordMessage( const char * const pTopic,
+                                                     uint16_t topicLen,
+                                                     const char * pMsg,
+                                                     uint32_t msgSize,
+                                                     uint8_t unused_5 )
+{
+    ( void ) unused_5;
+
+    TEST_ASSERT_LESS_THAN( sizeof( publishedTopic ), topicLen );
+    memcpy( publishedTopic, pTopic, topicLen );
+    publishedTopic[ topicLen ] = '\0';
+
+    TEST_ASSERT_LESS_OR_EQUAL( sizeof( publishedMessage ), msgSize );
+    memcpy( publishedMessage, pMsg, msgSize );
+    publishedMessageSize = msgSize;
+    messagesPublished++;
+
+    return OtaMqttSuccess;
+}
+
 OtaErr_t mockControlInterfaceRequestJobAlwaysFail( OtaAgentContext_t * unused )
 {
     ( void ) unused;
@@ -509,6 +665,20 @@ static OtaHttpStatus_t mockHttpRequestAlwaysFail( uint32_t rangeStart,
     return OtaHttpRequestFailed;
 }
 
+static OtaHttpStatus_t mockHttpRequestRecordRange( uint32_t rangeStart,
+                                                   uint32_t rangeEnd )
+{
+    if( httpRangesRequested < OTA_TEST_FILE_NUM_BLOCKS )
+    {
+        httpRangeStarts[ httpRangesRequested ] = rangeStart;
+        httpRangeEnds[ httpRangesRequested ] = rangeEnd;
+    }
+
+    httpRangesRequested++;
+
+    return OtaHttpSuccess;
+}
+
 static OtaHttpStatus_t stubHttpDeinit()
 {
     return OtaHttpSuccess;
@@ -552,6 +722,13 @@ OtaPalStatus_t mockPalCloseFile( OtaFileContext_t * const pFileContext )
     return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
 }
 
+OtaPalStatus_t mockPalCloseFileTimed( OtaFileContext_t * const pFileContext )
+{
+    /* Closing the file takes 1000 ticks of the latency clock. */
+    utestLatencyClock += 1000U;
+    return mockPalCloseFile( pFileContext );
+}
+
 OtaPalStatus_t mockPalCloseFileAlwaysFail( OtaFileContext_t * const pFileContext )
 {
     ( void ) pFileContext;
@@ -564,6 +741,65 @@ OtaPalStatus_t mockPalCloseFileSigCheckFail( OtaFileContext_t * const pFileConte
     return OTA_PAL_COMBINE_ERR( OtaPalSignatureCheckFailed, 0 );
 }
 
+OtaPalStatus_t mockPalSaveCheckpoint( OtaFileContext_t * const pFileContext,
+                                      uint32_t bitmapSize )
+{
+    TEST_ASSERT_EQUAL( 1, bitmapSize );
+
+    checkpointsSaved++;
+    checkpointBlocksRemaining = pFileContext->blocksRemaining;
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+OtaPalStatus_t mockPalDigestUpdate( OtaFileContext_t * const pFileContext,
+                                   const uint8_t * pData,
+                                   uint32_t size )
+{
+    /* The bytes are given in order from the start of the file. */
+    TEST_ASSERT_NOT_NULL( pData );
+    TEST_ASSERT_EQUAL( digestBytes, pFileContext->digestLength );
+
+    digestBytes += size;
+    digestBlocks++;
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+OtaPalStatus_t mockPalResumeFileFirstBlocks( OtaFileContext_t * const pFileContext,
+                                             uint32_t bitmapSize )
+{
+    TEST_ASSERT_TRUE( bitmapSize >= 1U );
+
+    /* The first 2 blocks of the file were received before the checkpoint,
+     * which has the bits out of range set. */
+    pFileContext->pRxBlockBitmap[ 0 ] = 0xFC;
+
+    pOtaFileHandle = ( FILE * ) pOtaFileBuffer;
+    pFileContext->pFile = pOtaFileHandle;
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+OtaPalStatus_t mockPalResumeFileCheckpointBlockSize( OtaFileContext_t * const pFileContext,
+                                                    uint32_t bitmapSize )
+{
+    TEST_ASSERT_TRUE( bitmapSize >= 1U );
+
+    /* The first 2 of the 5 blocks were received before the checkpoint. */
+    pFileContext->log2BlockSize = checkpointLog2BlockSize;
+    pFileContext->pRxBlockBitmap[ 0 ] = 0x1C;
+
+    pOtaFileHandle = ( FILE * ) pOtaFileBuffer;
+    pFileContext->pFile = pOtaFileHandle;
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+OtaPalStatus_t mockPalResumeFileAlwaysFail( OtaFileContext_t * const pFileContext,
+                                            uint32_t bitmapSize )
+{
+    /* Leave a partial bitmap behind, it should not be used. */
+    memset( pFileContext->pRxBlockBitmap, 0, bitmapSize );
+    return OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, 0 );
+}
+
 int16_t mockPalWriteBlock( OtaFileContext_t * const pFileContext,
                            uint32_t offset,
                            uint8_t * const pData,
@@ -580,6 +816,100 @@ int16_t mockPalWriteBlock( OtaFileContext_t * const pFileContext,
     return blockSize;
 }
 
+int16_t mockPalWriteBlockRecord( OtaFileContext_t * const pFileContext,
+                                 uint32_t offset,
+                                 uint8_t * const pData,
+                                 uint32_t blockSize )
+{
+    if( writesDone < OTA_TEST_FILE_NUM_BLOCKS )
+    {
+        writeOffsets[ writesDone ] = offset;
+        writeSizes[ writesDone ] = blockSize;
+    }
+
+    writesDone++;
+    return mockPalWriteBlock( pFileContext, offset, pData, blockSize );
+}
+
+int16_t mockPalWriteBlockTimed( OtaFileContext_t * const pFileContext,
+                                uint32_t offset,
+                                uint8_t * const pData,
+                                uint32_t blockSize )
+{
+    /* Each write takes 100 ticks of the latency clock. */
+    utestLatencyClock += 100U;
+    return mockPalWriteBlock( pFileContext, offset, pData, blockSize );
+}
+
+int16_t mockPalPatchBlock( OtaFileContext_t * const pFileContext,
+                           uint32_t offset,
+                           uint8_t * const pData,
+                           uint32_t blockSize )
+{
+    /* The patch is given in order, store it as the new image. */
+    TEST_ASSERT_EQUAL( patchedBytes, offset );
+
+    patchedBytes += blockSize;
+    return mockPalWriteBlock( pFileContext, offset, pData, blockSize );
+}
+
+int16_t mockPalWriteBlockFileSinks( OtaFileContext_t * const pFileContext,
+                                    uint32_t offset,
+                                    uint8_t * const pData,
+                                    uint32_t blockSize )
+{
+    int16_t result = -1;
+    int idx = 0;
+
+    for( idx = 0; idx < otaconfigMAX_NUM_FILE_SINKS; idx++ )
+    {
+        if( pFileContext == &fileSinks[ idx ] )
+        {
+            TEST_ASSERT_LESS_THAN( OTA_TEST_FILE_SIZE, offset );
+            memcpy( pFileSinkBuffers[ idx ] + offset, pData, blockSize );
+            result = blockSize;
+        }
+    }
+
+    if( result < 0 )
+    {
+        result = mockPalWriteBlock( pFileContext, offset, pData, blockSize );
+    }
+
+    return result;
+}
+
+OtaPalStatus_t mockPalCreateFileSinkFail( OtaFileContext_t * const pFileContext )
+{
+    OtaPalStatus_t result = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, 0 );
+
+    if( pFileContext != &fileSinks[ 1 ] )
+    {
+        result = mockPalCreateFileForRx( pFileContext );
+    }
+
+    return result;
+}
+
+OtaPalStatus_t mockPalCloseFileCount( OtaFileContext_t * const pFileContext )
+{
+    ( void ) pFileContext;
+    filesClosed++;
+    return OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
+}
+
+OtaPalStatus_t mockPalCloseFileSinkSigCheckFail( OtaFileContext_t * const pFileContext )
+{
+    OtaPalStatus_t result = mockPalCloseFileCount( pFileContext );
+
+    if( pFileContext == &fileSinks[ 0 ] )
+    {
+        result = OTA_PAL_COMBINE_ERR( OtaPalSignatureCheckFailed, 0 );
+    }
+
+    return result;
+}
+
 int16_t mockPalWriteBlockAlwaysFail( OtaFileContext_t * const unused1,
                                      uint32_t unused2,
                                      uint8_t * const unused3,
@@ -668,6 +998,11 @@ static void mockAppCallback( OtaJobEvent_t event,
 
     ( void ) pData;
 
+    if( ( event == OtaJobEventActivate ) || ( event == OtaJobEventFail ) )
+    {
+        lastAppCallbackEvent = event;
+    }
+
     if( event == OtaJobEventStartTest )
     {
         OTA_SetImageState( OtaImageStateAccepted );
@@ -706,6 +1041,8 @@ static void otaInterfaceDefault()
     otaInterfaces.os.event.init = mockOSEventReset;
     otaInterfaces.os.event.send = mockOSEventSendThenStop;
     otaInterfaces.os.event.recv = mockOSEventReceive;
+    otaInterfaces.os.event.recvBatch = NULL;
+    otaInterfaces.os.event.poll = NULL;
     otaInterfaces.os.event.deinit = mockOSEventReset;
 
     otaInterfaces.os.timer.start = stubOSTimerStart;
@@ -731,6 +1068,10 @@ static void otaInterfaceDefault()
     otaInterfaces.pal.reset = mockPalResetDevice;
     otaInterfaces.pal.setPlatformImageState = mockPalSetPlatformImageState;
     otaInterfaces.pal.getPlatformImageState = mockPalGetPlatformImageState;
+    otaInterfaces.pal.saveCheckpoint = NULL;
+    otaInterfaces.pal.resumeFile = NULL;
+    otaInterfaces.pal.digestUpdate = NULL;
+    otaInterfaces.pal.patchBlock = NULL;
 }
 
 static void otaAppBufferDefault()
@@ -765,6 +1106,17 @@ static void processEntireQueue()
     }
 }
 
+/* Helper function for processing the ticks of the request timer it takes to time a request out. */
+static void processRequestTimeout()
+{
+    uint32_t tick = 0;
+
+    for( tick = 0; tick < otaconfigREQUEST_TIMER_TICKS; tick++ )
+    {
+        receiveAndProcessOtaEvent();
+    }
+}
+
 static void otaInit( const char * pClientID,
                      OtaAppCallback_t appCallback )
 {
@@ -899,6 +1251,18 @@ void tearDown()
     pOtaJobDoc = NULL;
     pOtaFileHandle = NULL;
     memset( pOtaFileBuffer, 0, OTA_TEST_FILE_SIZE );
+    memset( fileSinks, 0, sizeof( fileSinks ) );
+    memset( pFileSinkBuffers, 0, sizeof( pFileSinkBuffers ) );
+    filesClosed = 0;
+    checkpointsSaved = 0;
+    checkpointBlocksRemaining = 0;
+    checkpointLog2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE;
+    writesDone = 0;
+    digestBytes = 0;
+    digestBlocks = 0;
+    patchedBytes = 0;
+    messagesPublished = 0;
+    lastAppCallbackEvent = OtaLastJobEvent;
     otaInterfaceDefault();
     otaDeinit();
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
@@ -1154,6 +1518,42 @@ void test_OTA_ResumeFailedWhenSuspended()
     TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
 }
 
+/**
+ * @brief Test that the events handled in all states have the same transition
+ * in every state, and that events out of range have no transition.
+ */
+void test_OTA_TransitionForAllStates()
+{
+    OtaEventMsg_t eventMsg = { 0 };
+    uint32_t noTransition = 0;
+    uint32_t suspendTransition = 0;
+    OtaState_t state = OtaAgentStateInit;
+
+    otaInitDefault();
+
+    /* Start is only handled in the ready state. */
+    otaAgent.state = OtaAgentStateStopped;
+    eventMsg.eventId = OtaAgentEventStart;
+    noTransition = searchTransition( &eventMsg );
+
+    otaAgent.state = OtaAgentStateReady;
+    TEST_ASSERT_NOT_EQUAL( noTransition, searchTransition( &eventMsg ) );
+
+    eventMsg.eventId = OtaAgentEventMax;
+    TEST_ASSERT_EQUAL( noTransition, searchTransition( &eventMsg ) );
+
+    eventMsg.eventId = OtaAgentEventSuspend;
+    suspendTransition = searchTransition( &eventMsg );
+
+    for( state = OtaAgentStateInit; state < OtaAgentStateAll; state++ )
+    {
+        otaAgent.state = state;
+        TEST_ASSERT_EQUAL( suspendTransition, searchTransition( &eventMsg ) );
+    }
+
+    otaAgent.state = OtaAgentStateInit;
+}
+
 void test_OTA_Statistics()
 {
     otaGoToState( OtaAgentStateReady );
@@ -1170,6 +1570,33 @@ void test_OTA_Statistics()
     TEST_ASSERT_EQUAL( 0, statistics.otaPacketsDropped );
 }
 
+void test_OTA_LatencyStatisticsQueueWait()
+{
+    #if ( otaconfigLATENCY_STATS == 1U )
+        OtaLatencyStatistics_t latency = { 0 };
+
+        otaGoToState( OtaAgentStateReady );
+        TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+
+        TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_GetLatencyStatistics( NULL ) );
+
+        /* The suspend event waits 50 ticks in the queue. */
+        OTA_Suspend();
+        utestLatencyClock += 50U;
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
+
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_GetLatencyStatistics( &latency ) );
+        TEST_ASSERT_EQUAL( 1, latency.stages[ OtaLatencyQueueWait ].count );
+        TEST_ASSERT_EQUAL( 50, latency.stages[ OtaLatencyQueueWait ].min );
+        TEST_ASSERT_EQUAL( 50, latency.stages[ OtaLatencyQueueWait ].max );
+        TEST_ASSERT_EQUAL( 50, latency.stages[ OtaLatencyQueueWait ].total );
+        TEST_ASSERT_EQUAL( 1, latency.stages[ OtaLatencyQueueWait ].histogram[ 1 ] );
+    #else
+        TEST_IGNORE_MESSAGE( "The latency statistics are off." );
+    #endif
+}
+
 void test_OTA_CheckForUpdate()
 {
     otaGoToState( OtaAgentStateRequestingJob );
@@ -1193,6 +1620,214 @@ void test_OTA_CheckForUpdateFailToSendEvent()
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
 }
 
+void test_OTA_InstanceInitWhenStopped()
+{
+    OtaAgentContext_t instance;
+
+    TEST_ASSERT_EQUAL( OtaErrAgentStopped, OTA_InstanceInit( &instance, &pOtaAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+}
+
+void test_OTA_InstanceInitInvalidArgs()
+{
+    #if ( otaconfigMAX_NUM_AGENTS > 1U )
+        OtaAgentContext_t instance;
+
+        otaGoToState( OtaAgentStateReady );
+
+        TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_InstanceInit( NULL, &pOtaAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+        TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_InstanceInit( &otaAgent, &pOtaAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+        TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_InstanceInit( &instance, NULL, &otaInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+        TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_InstanceInit( &instance, &pOtaAppBuffer, NULL, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+        TEST_ASSERT_EQUAL( OtaErrUninitialized, OTA_InstanceInit( &instance, &pOtaAppBuffer, &otaInterfaces, NULL, mockAppCallback ) );
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no instances." );
+    #endif
+}
+
+/* Test that an instance is run by the task of the agent, next to it. */
+void test_OTA_InstanceStartAndShutdown()
+{
+    #if ( otaconfigMAX_NUM_AGENTS > 1U )
+        OtaAgentContext_t instance;
+        OtaAgentContext_t otherInstance;
+        OtaEventMsg_t otaEvent = { 0 };
+
+        otaGoToState( OtaAgentStateReady );
+
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_InstanceInit( &instance, &pOtaAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+        TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_InstanceGetState( &instance ) );
+        TEST_ASSERT_EQUAL_STRING( "ota_instance", ( const char * ) instance.pThingName );
+
+        /* Only otaconfigMAX_NUM_AGENTS agents can run at once, starting one that runs already only resets its statistics. */
+        TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_InstanceInit( &otherInstance, &pOtaAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_other", mockAppCallback ) );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_InstanceInit( &instance, &pOtaAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+
+        /* The event of the instance goes through the queue of the agent, but only the instance starts. */
+        otaEvent.eventId = OtaAgentEventStart;
+        TEST_ASSERT_EQUAL( true, OTA_InstanceSignalEvent( &instance, &otaEvent ) );
+        TEST_ASSERT_EQUAL_PTR( &instance, otaEventQueue[ 0 ].pAgentCtx );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_InstanceGetState( &instance ) );
+        TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+
+        /* Shutting down the instance leaves the agent running and frees the instance for another one. */
+        mockOSEventReset( NULL );
+        OTA_InstanceShutdown( &instance, otaDefaultWait, unsubscribeFlag );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_InstanceGetState( &instance ) );
+        TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_InstanceInit( &otherInstance, &pOtaAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_other", mockAppCallback ) );
+        TEST_ASSERT_EQUAL( 1, otherInstance.agentIndex );
+
+        mockOSEventReset( NULL );
+        OTA_InstanceShutdown( &otherInstance, otaDefaultWait, unsubscribeFlag );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_InstanceGetState( &otherInstance ) );
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no instances." );
+    #endif
+}
+
+/* Test that the events still queued for an instance shut down do not reach the instance started again. */
+void test_OTA_InstanceShutdownDropsQueuedEvents()
+{
+    #if ( otaconfigMAX_NUM_AGENTS > 1U )
+        OtaAgentContext_t instance;
+        OtaEventMsg_t otaEvent = { 0 };
+
+        otaGoToState( OtaAgentStateReady );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_InstanceInit( &instance, &pOtaAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+
+        /* The instance is started again with the same context before the event behind the shutdown is received. */
+        otaInterfaces.os.event.send = mockOSEventSend;
+        mockOSEventReset( NULL );
+        OTA_InstanceShutdown( &instance, otaDefaultWait, unsubscribeFlag );
+        otaEvent.eventId = OtaAgentEventStart;
+        TEST_ASSERT_EQUAL( true, OTA_InstanceSignalEvent( &instance, &otaEvent ) );
+        TEST_ASSERT_EQUAL( 2, otaEventQueueEnd - otaEventQueue );
+
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_InstanceGetState( &instance ) );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_InstanceInit( &instance, &pOtaAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( 0, otaEventQueueEnd - otaEventQueue );
+        TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_InstanceGetState( &instance ) );
+        TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+
+        mockOSEventReset( NULL );
+        OTA_InstanceShutdown( &instance, otaDefaultWait, unsubscribeFlag );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_InstanceGetState( &instance ) );
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no instances." );
+    #endif
+}
+
+/* Test that the timers of an instance have their own ids and signal the instance. */
+void test_OTA_InstanceRequestTimer()
+{
+    #if ( otaconfigMAX_NUM_AGENTS > 1U )
+        OtaAgentContext_t instance;
+        OtaInterfaces_t instanceInterfaces;
+        OtaEventMsg_t otaEvent = { 0 };
+
+        otaGoToState( OtaAgentStateReady );
+
+        /* The job request of the instance fails, so it starts its request timer, which expires at once. */
+        instanceInterfaces = otaInterfaces;
+        instanceInterfaces.mqtt.publish = stubMqttPublishAlwaysFail;
+        instanceInterfaces.os.timer.start = mockOSTimerInvokeCallback;
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_InstanceInit( &instance, &pOtaAppBuffer, &instanceInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+        instance.state = OtaAgentStateRequestingJob;
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+        otaEvent.eventId = OtaAgentEventRequestJobDocument;
+        TEST_ASSERT_EQUAL( true, OTA_InstanceSignalEvent( &instance, &otaEvent ) );
+        receiveAndProcessOtaEvent();
+
+        TEST_ASSERT_EQUAL( 1, instance.requestMomentum );
+        TEST_ASSERT_EQUAL( 0, otaAgent.requestMomentum );
+        TEST_ASSERT_EQUAL( OtaAgentEventRequestTimerTick, otaEventQueue[ 0 ].eventId );
+        TEST_ASSERT_EQUAL_PTR( &instance, otaEventQueue[ 0 ].pAgentCtx );
+
+        mockOSEventReset( NULL );
+        OTA_InstanceShutdown( &instance, otaDefaultWait, unsubscribeFlag );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_InstanceGetState( &instance ) );
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no instances." );
+    #endif
+}
+
+/* Helper function for signaling an event to an instance and processing it. */
+static void instanceSignalAndProcess( OtaAgentContext_t * pInstance,
+                                      OtaEvent_t eventId,
+                                      OtaEventData_t * pEventData )
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    mockOSEventReset( NULL );
+    otaEvent.eventId = eventId;
+    otaEvent.pEventData = pEventData;
+    TEST_ASSERT_EQUAL( true, OTA_InstanceSignalEvent( pInstance, &otaEvent ) );
+    receiveAndProcessOtaEvent();
+}
+
+/* Test that an instance keeps the buffers of its job when the agent closes its file. */
+void test_OTA_InstanceKeepsBuffersWhenAgentCloses()
+{
+    #if ( otaconfigMAX_NUM_AGENTS > 1U )
+        OtaAgentContext_t instance;
+        OtaAppBuffer_t instanceAppBuffer;
+        OtaEventData_t instanceEventBuffer;
+        uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+        size_t streamingMessageSize = 0;
+        uint32_t blocksRemaining = 0;
+
+        /* Both the agent and the instance allocate all the buffers of their jobs. */
+        memset( &pOtaAppBuffer, 0, sizeof( pOtaAppBuffer ) );
+        memset( &instanceAppBuffer, 0, sizeof( instanceAppBuffer ) );
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_InstanceInit( &instance, &instanceAppBuffer, &otaInterfaces, ( const uint8_t * ) "ota_instance", mockAppCallback ) );
+        instanceSignalAndProcess( &instance, OtaAgentEventStart, NULL );
+        instanceSignalAndProcess( &instance, OtaAgentEventRequestJobDocument, NULL );
+        memcpy( instanceEventBuffer.data, JOB_DOC_A, strlen( JOB_DOC_A ) );
+        instanceEventBuffer.dataLength = strlen( JOB_DOC_A );
+        instanceSignalAndProcess( &instance, OtaAgentEventReceivedJobDocument, &instanceEventBuffer );
+        instanceSignalAndProcess( &instance, OtaAgentEventCreateFile, NULL );
+        instanceSignalAndProcess( &instance, OtaAgentEventRequestFileBlock, NULL );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_InstanceGetState( &instance ) );
+        blocksRemaining = instance.fileContext.blocksRemaining;
+
+        /* The agent closes its file while the instance is still receiving its own. */
+        mockOSEventReset( NULL );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_SetImageState( OtaImageStateAborted ) );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+        #if ( otaconfigJOB_ARENA_SIZE > 0U )
+            TEST_ASSERT_EQUAL( 0, otaAgent.jobArena.used );
+            TEST_ASSERT_NOT_EQUAL( 0, instance.jobArena.used );
+        #endif
+
+        /* The instance still stores its blocks in its own bitmap and decode buffer. */
+        createOtaStreamingMessage( instanceEventBuffer.data, sizeof( instanceEventBuffer.data ), 0, pFileBlock, OTA_FILE_BLOCK_SIZE, &streamingMessageSize, true );
+        instanceEventBuffer.dataLength = streamingMessageSize;
+        instanceSignalAndProcess( &instance, OtaAgentEventReceivedFileBlock, &instanceEventBuffer );
+        TEST_ASSERT_EQUAL( blocksRemaining - 1U, instance.fileContext.blocksRemaining );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_InstanceGetState( &instance ) );
+
+        mockOSEventReset( NULL );
+        OTA_InstanceShutdown( &instance, otaDefaultWait, unsubscribeFlag );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_InstanceGetState( &instance ) );
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no instances." );
+    #endif
+}
+
 void test_OTA_ActivateNewImage()
 {
     otaGoToState( OtaAgentStateReady );
@@ -1339,7 +1974,7 @@ void test_OTA_ImageStateWithReasonPalFail()
 
     otaGoToState( OtaAgentStateReady );
     otaInterfaces.pal.setPlatformImageState = mockPalSetPlatformImageStateAlwaysFail;
-    error = setImageStateWithReason( stateToSet, OtaErrImageStateMismatch );
+    error = setImageStateWithReason( &otaAgent, stateToSet, OtaErrImageStateMismatch );
     TEST_ASSERT_EQUAL( OtaErrNoActiveJob, error );
 }
 
@@ -1366,16 +2001,21 @@ void test_OTA_RequestJobDocumentRetryFail()
     receiveAndProcessOtaEvent();
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
 
-    /* Fail the maximum number of attempts to request a job document. */
-    for( i = 0U; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
+    /* Fail the maximum number of attempts to request a job document, the first
+     * attempt is made for the event. */
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
+
+    /* The other attempts are made when the request times out. */
+    for( i = 1U; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
     {
-        receiveAndProcessOtaEvent();
+        processRequestTimeout();
         TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
     }
 
     /* Attempt to request another job document after failing the maximum number
      * of times, triggering a shutdown event. */
-    receiveAndProcessOtaEvent();
+    processRequestTimeout();
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
 
     /* Shutdown after processing the shutdown event. */
@@ -1544,22 +2184,30 @@ void test_OTA_ProcessJobDocumentValidJson()
     TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
 }
 
-void test_OTA_ProcessJobDocumentPalCreateFileFail()
+/**
+ * @brief Test that the parameters are found in any order and spacing, and that
+ * a key containing the separator is not taken for a key path.
+ */
+void test_OTA_ProcessJobDocumentReorderedKeys()
 {
-    otaInterfaces.pal.createFile = mockPalCreateFileForRxAlwaysFail;
+    pOtaJobDoc = JOB_DOC_REORDERED;
 
     otaGoToState( OtaAgentStateWaitingForJob );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 
     otaReceiveJobDocument();
     receiveAndProcessOtaEvent();
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+    TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
+    TEST_ASSERT_EQUAL_STRING( "AFR_OTA-testjob20", ( const char * ) otaAgent.pActiveJobName );
 }
 
-void test_OTA_ProcessJobDocumentBitmapMallocFail()
+/**
+ * @brief Test that the file parameters are only searched in the first file of
+ * the job document.
+ */
+void test_OTA_ProcessJobDocumentKeyInSecondFile()
 {
-    pOtaAppBuffer.pFileBitmap = NULL;
-    otaInterfaces.os.mem.malloc = mockMallocAlwaysFail;
+    pOtaJobDoc = JOB_DOC_SECOND_FILE_KEY;
 
     otaGoToState( OtaAgentStateWaitingForJob );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
@@ -1569,6 +2217,166 @@ void test_OTA_ProcessJobDocumentBitmapMallocFail()
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
 }
 
+/**
+ * @brief Test that quotes and keys within strings are skipped with the strings,
+ * and that a string may end with an escaped backslash.
+ */
+void test_OTA_ProcessJobDocumentEscapedStrings()
+{
+    pOtaJobDoc = JOB_DOC_ESCAPED_STRINGS;
+
+    otaGoToState( OtaAgentStateWaitingForJob );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+    otaReceiveJobDocument();
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
+    TEST_ASSERT_EQUAL_STRING( "AFR_OTA-testjob20", ( const char * ) otaAgent.pActiveJobName );
+    TEST_ASSERT_EQUAL_STRING( "AFR_OTA-XYZ\\\\", ( const char * ) otaAgent.fileContext.pStreamName );
+}
+
+/**
+ * @brief Test that the objects nested deeper than the walk goes are skipped,
+ * and the keys that follow them are still found.
+ */
+void test_OTA_ProcessJobDocumentPastMaxDepth()
+{
+    pOtaJobDoc = JOB_DOC_DEEP_STATUS_DETAILS;
+
+    otaGoToState( OtaAgentStateWaitingForJob );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+    otaReceiveJobDocument();
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
+    TEST_ASSERT_EQUAL_STRING( "AFR_OTA-testjob20", ( const char * ) otaAgent.pActiveJobName );
+}
+
+/**
+ * @brief Test that the first value of a duplicate key is used, in the same
+ * object or in a duplicate parent object.
+ */
+void test_OTA_ProcessJobDocumentDuplicateKeys()
+{
+    pOtaJobDoc = JOB_DOC_DUPLICATE_KEYS;
+
+    otaGoToState( OtaAgentStateWaitingForJob );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+    otaReceiveJobDocument();
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
+    TEST_ASSERT_EQUAL_STRING( "AFR_OTA-testjob20", ( const char * ) otaAgent.pActiveJobName );
+}
+
+/**
+ * @brief Test that the file parameters are not searched in a file that is not
+ * an object, nor in the objects of the files that follow it.
+ */
+void test_OTA_ProcessJobDocumentFilesNotObjects()
+{
+    pOtaJobDoc = JOB_DOC_FILES_NOT_OBJECTS;
+
+    otaGoToState( OtaAgentStateWaitingForJob );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+    otaReceiveJobDocument();
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+}
+
+/**
+ * @brief Test that a truncated job document is rejected at any length, and
+ * that it is not read past its length.
+ */
+void test_OTA_ParseJobDocumentTruncated()
+{
+    JsonDocModel_t otaJobDocModel;
+    uint32_t length = 0;
+
+    otaInitDefault();
+
+    for( length = 0U; length < ( uint32_t ) strlen( JOB_DOC_A ); length++ )
+    {
+        TEST_ASSERT_EQUAL( DocParseErrNone, initDocModel( &otaJobDocModel,
+                                                          otaJobDocModelParamStructure,
+                                                          ( void * ) &( otaAgent.fileContext ),
+                                                          ( uint32_t ) sizeof( OtaFileContext_t ),
+                                                          OTA_NUM_JOB_PARAMS ) );
+        TEST_ASSERT_NOT_EQUAL( DocParseErrNone, parseJSONbyModel( JOB_DOC_A, length, &otaJobDocModel ) );
+    }
+}
+
+void test_OTA_ProcessJobDocumentPalCreateFileFail()
+{
+    otaInterfaces.pal.createFile = mockPalCreateFileForRxAlwaysFail;
+
+    otaGoToState( OtaAgentStateWaitingForJob );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+    otaReceiveJobDocument();
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+}
+
+void test_OTA_ProcessJobDocumentDeltaNotSupported()
+{
+    #if ( configOTA_DELTA_UPDATE_FILE_TYPE_ID == 3U )
+        pOtaJobDoc = JOB_DOC_HTTP_DELTA;
+
+        otaGoToState( OtaAgentStateWaitingForJob );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+        /* The PAL can't apply the patch, so the job is rejected. */
+        otaReceiveJobDocument();
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+        TEST_ASSERT_NULL( pOtaFileHandle );
+    #else
+        TEST_IGNORE_MESSAGE( "The files of type 3 are not delta updates." );
+    #endif
+}
+
+void test_OTA_ProcessJobDocumentBitmapMallocFail()
+{
+    pOtaAppBuffer.pFileBitmap = NULL;
+    otaInterfaces.os.mem.malloc = mockMallocAlwaysFail;
+
+    otaGoToState( OtaAgentStateWaitingForJob );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+    otaReceiveJobDocument();
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+}
+
+/**
+ * @brief Test that without a job arena the block bitmap is allocated with the
+ * OS interface, and that every buffer of the job is freed when it is aborted.
+ */
+void test_OTA_ProcessJobDocumentBitmapMallocedWithoutArena()
+{
+    #if ( otaconfigJOB_ARENA_SIZE == 0U )
+        pOtaAppBuffer.pFileBitmap = NULL;
+        otaInterfaces.os.mem.malloc = mockMallocCounted;
+        otaInterfaces.os.mem.free = mockFreeCounted;
+        mallocCount = 0;
+        freeCount = 0;
+
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        TEST_ASSERT_NOT_NULL( otaAgent.fileContext.pRxBlockBitmap );
+        TEST_ASSERT_TRUE( mallocCount > 0U );
+
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_SetImageState( OtaImageStateAborted ) );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+        TEST_ASSERT_EQUAL( mallocCount, freeCount );
+    #else
+        TEST_IGNORE_MESSAGE( "The job buffers are taken from the arena." );
+    #endif
+}
+
 void test_OTA_ProcessJobDocumentEventSendFail( void )
 {
     pOtaJobDoc = JOB_DOC_A;
@@ -1633,16 +2441,21 @@ void test_OTA_InitFileTransferRetryFail()
     receiveAndProcessOtaEvent();
     TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
 
-    /* Make the maximum number of failures based on the momentum parameter. */
-    for( i = 0U; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
+    /* Make the maximum number of failures based on the momentum parameter, the
+     * first attempt is made for the event. */
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
+
+    /* The other attempts are made when the request times out. */
+    for( i = 1U; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
     {
-        receiveAndProcessOtaEvent();
+        processRequestTimeout();
         TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
     }
 
     /* Make another attempt after already reaching the maximum number of
      * allowable attempts, which generates a shutdown event. */
-    receiveAndProcessOtaEvent();
+    processRequestTimeout();
     TEST_ASSERT_EQUAL( OtaAgentStateCreatingFile, OTA_GetState() );
 
     /* Shutdown the OTA Agent after processing the event. */
@@ -1735,17 +2548,21 @@ void test_OTA_RequestFileBlockRetryFail()
     receiveAndProcessOtaEvent();
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
 
-    /* Request a file block and fail the maximum number of times. */
-    for( i = 0; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
+    /* Request a file block and fail the maximum number of times, the first
+     * request is made for the event and the others when the request times out. */
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
+
+    for( i = 1; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
     {
-        receiveAndProcessOtaEvent();
+        processRequestTimeout();
         TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
     }
 
     /* The timer triggers as we check for the number of attempts so far. The
      * number of attempts is at the maximum already so we also create a
      * shutdown event. */
-    receiveAndProcessOtaEvent();
+    processRequestTimeout();
     TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
 
     /* Process the timer event. */
@@ -1757,6 +2574,45 @@ void test_OTA_RequestFileBlockRetryFail()
     TEST_ASSERT_EQUAL( OtaAgentStateStopped, OTA_GetState() );
 }
 
+void test_OTA_RequestFileBlockRetryFailShrinksBlockSize()
+{
+    #if ( otaconfigMIN_LOG2_FILE_BLOCK_SIZE < otaconfigLOG2_FILE_BLOCK_SIZE )
+        OtaEventMsg_t otaEvent = { 0 };
+        uint32_t i = 0;
+
+        pOtaJobDoc = JOB_DOC_HTTP;
+        otaGoToState( OtaAgentStateRequestingFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
+
+        otaInterfaces.http.request = mockHttpRequestAlwaysFail;
+        otaInterfaces.os.timer.start = mockOSTimerInvokeCallback;
+        otaInterfaces.os.event.send = mockOSEventSend;
+
+        otaEvent.eventId = OtaAgentEventRequestFileBlock;
+        OTA_SignalEvent( &otaEvent );
+
+        /* Request a file block and fail until the momentum aborts the download. */
+        receiveAndProcessOtaEvent();
+
+        for( i = 0; i < otaconfigMAX_NUM_REQUEST_MOMENTUM; ++i )
+        {
+            TEST_ASSERT_EQUAL( OtaAgentStateRequestingFileBlock, OTA_GetState() );
+            processRequestTimeout();
+        }
+
+        /* The next file is received in smaller blocks after the service stopped answering. */
+        TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE - 1U, otaAgent.log2BlockSize );
+
+        #if ( otaconfigLATENCY_STATS == 1U )
+            /* Every request after the first was sent again without an answer. */
+            TEST_ASSERT_EQUAL( otaconfigMAX_NUM_REQUEST_MOMENTUM - 1U, otaAgent.latency.repeatedRequests );
+            TEST_ASSERT_EQUAL( otaconfigMAX_NUM_REQUEST_MOMENTUM, otaAgent.latency.requestMomentumPeak );
+        #endif
+    #else
+        TEST_IGNORE_MESSAGE( "The block size of the files does not adapt." );
+    #endif
+}
+
 void test_OTA_ReceiveFileBlockEmpty()
 {
     OtaEventMsg_t otaEvent = { 0 };
@@ -1959,27 +2815,84 @@ void test_OTA_ReceiveFileBlockCompleteDifferentFileTypeMqtt()
     test_OTA_ReceiveFileBlockCompleteMqtt();
 }
 
-void test_OTA_ReceiveFileBlockMallocFail()
+void test_OTA_ReceiveFileBlockCompleteBatchedMqtt()
 {
-    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+    otaInterfaces.os.event.recvBatch = mockOSEventReceiveBatch;
+    test_OTA_ReceiveFileBlockCompleteMqtt();
+}
+
+/**
+ * @brief Test that the file blocks received at once are processed back to
+ * back, without starting the request timer again.
+ */
+void test_OTA_ReceiveFileBlocksBatched()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffers[ 3 ];
     uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
     size_t streamingMessageSize = 0;
-    OtaEventData_t eventBuffer;
-    OtaEventMsg_t otaEvent = { 0 };
+    uint32_t idx = 0;
+
+    pOtaJobDoc = JOB_DOC_A;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
 
     otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.event.recvBatch = mockOSEventReceiveBatch;
+    otaInterfaces.os.timer.start = mockOSTimerStartCount;
+    requestTimerStarts = 0;
 
-    /* Pass an invalid values for pDecodeMemory and decodeMemorySize so the
-     * OTA Agent dynamically allocates the buffer instead of using one provided
-     * by the user. */
-    pOtaAppBuffer.pDecodeMemory = NULL;
-    pOtaAppBuffer.decodeMemorySize = 0;
+    for( idx = 0; idx < 3U; idx++ )
+    {
+        createOtaStreamingMessage(
+            pStreamingMessage,
+            sizeof( pStreamingMessage ),
+            idx,
+            pFileBlock,
+            OTA_FILE_BLOCK_SIZE,
+            &streamingMessageSize,
+            true );
 
-    /* Get into the state before receiving a data block. */
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffers[ idx ];
+        memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+        otaEvent.pEventData->dataLength = streamingMessageSize;
+        OTA_SignalEvent( &otaEvent );
+    }
+
+    /* All three blocks are received and processed by a single call. */
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( 3, otaAgent.statistics.otaPacketsProcessed );
+    TEST_ASSERT_EQUAL( 0, requestTimerStarts );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+}
+
+/**
+ * @brief Test that a file block only moves the deadline of the request, which
+ * the ticks of the request timer check.
+ */
+void test_OTA_RequestTimerDeadline()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffer;
+    uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+    size_t streamingMessageSize = 0;
+    uint32_t requestTimeouts = 0;
+    uint32_t tick = 0;
+
+    pOtaJobDoc = JOB_DOC_A;
     otaGoToState( OtaAgentStateWaitingForFileBlock );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    TEST_ASSERT_TRUE( otaAgent.requestTimerTicking );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.timer.start = mockOSTimerStartCount;
+    requestTimerStarts = 0;
+    requestTimeouts = otaAgent.requestTimeouts;
+    mockOSEventReset( NULL );
 
-    /* Create and send the data block. */
     createOtaStreamingMessage(
         pStreamingMessage,
         sizeof( pStreamingMessage ),
@@ -1994,69 +2907,420 @@ void test_OTA_ReceiveFileBlockMallocFail()
     memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
     otaEvent.pEventData->dataLength = streamingMessageSize;
     OTA_SignalEvent( &otaEvent );
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( 1, otaAgent.statistics.otaPacketsProcessed );
+    TEST_ASSERT_EQUAL( 0, requestTimerStarts );
+    mockOSEventReset( NULL );
 
-    /* Set malloc to fail and receive the block. */
-    otaInterfaces.os.mem.malloc = mockMallocAlwaysFail;
+    /* The tick in progress when the block was received is not counted, nor
+     * are the ticks before the deadline. */
+    otaEvent.eventId = OtaAgentEventRequestTimerTick;
+    otaEvent.pEventData = NULL;
+
+    for( tick = 0; tick < otaconfigREQUEST_TIMER_TICKS; tick++ )
+    {
+        OTA_SignalEvent( &otaEvent );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( tick + 1U, requestTimerStarts );
+        TEST_ASSERT_EQUAL( requestTimeouts, otaAgent.requestTimeouts );
+    }
+
+    /* The next tick reaches the deadline, the blocks are requested again. */
+    OTA_SignalEvent( &otaEvent );
     receiveAndProcessOtaEvent();
-    /* Receive the event for closing the file after the failure. */
+    TEST_ASSERT_EQUAL( requestTimeouts + 1U, otaAgent.requestTimeouts );
+    TEST_ASSERT_EQUAL( otaconfigREQUEST_TIMER_TICKS + 1U, requestTimerStarts );
+    TEST_ASSERT_TRUE( otaAgent.requestTimerArmed );
+
+    /* Once the request is stopped, the timer stops at its next tick. */
+    stopRequestTimer();
+    mockOSEventReset( NULL );
+    OTA_SignalEvent( &otaEvent );
     receiveAndProcessOtaEvent();
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+    TEST_ASSERT_EQUAL( otaconfigREQUEST_TIMER_TICKS + 1U, requestTimerStarts );
+    TEST_ASSERT_FALSE( otaAgent.requestTimerTicking );
+    TEST_ASSERT_EQUAL( requestTimeouts + 1U, otaAgent.requestTimeouts );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
 }
 
-void test_OTA_DroppedFileBlock()
+/* Test that a tick of the request timer that can't be signaled is sent again rather than lost. */
+void test_OTA_RequestTimerTickSignalFails()
+{
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    TEST_ASSERT_TRUE( otaAgent.requestTimerTicking );
+
+    otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
+    otaInterfaces.os.timer.start = mockOSTimerStartCount;
+    requestTimerStarts = 0;
+
+    /* The timer is started again to send the tick after the next period. */
+    otaTimerCallback( OtaRequestTimer );
+    TEST_ASSERT_EQUAL( 1, requestTimerStarts );
+    TEST_ASSERT_TRUE( otaAgent.requestTimerTicking );
+
+    /* When the timer can't be started either, the next request starts it. */
+    otaInterfaces.os.timer.start = mockOSTimerStartAlwaysFail;
+    otaTimerCallback( OtaRequestTimer );
+    TEST_ASSERT_FALSE( otaAgent.requestTimerTicking );
+
+    otaInterfaces.os.timer.start = mockOSTimerStartCount;
+    TEST_ASSERT_EQUAL( OtaOsSuccess, startRequestTimer() );
+    TEST_ASSERT_EQUAL( 2, requestTimerStarts );
+    TEST_ASSERT_TRUE( otaAgent.requestTimerTicking );
+}
+
+/**
+ * @brief Test that polling processes no more events than asked for, and returns
+ * when there are none.
+ */
+void test_OTA_Poll()
 {
     OtaEventMsg_t otaEvent = { 0 };
 
     otaInterfaces.os.event.send = mockOSEventSend;
 
-    /* Get ready to receive a block. */
-    otaGoToState( OtaAgentStateWaitingForFileBlock );
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
-    /* No blocks have been received or dropped yet. */
-    TEST_ASSERT_EQUAL( 0, otaAgent.statistics.otaPacketsDropped );
+    /* The OS interface must be able to poll events. */
+    otaInitDefault();
+    TEST_ASSERT_EQUAL( 0, OTA_Poll( 1 ) );
+    TEST_ASSERT_EQUAL( OtaAgentStateInit, OTA_GetState() );
+    otaDeinit();
 
+    otaInterfaces.os.event.poll = mockOSEventPoll;
+    otaInitDefault();
 
-    /* Prepare an event as if we are receiving a data block. */
-    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
-    otaEvent.pEventData = &eventBuffer;
-    otaEvent.pEventData->dataLength = 0;
+    /* The agent is ready to start once polled. */
+    TEST_ASSERT_EQUAL( 0, OTA_Poll( 1 ) );
+    TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
 
-    /* Set the interface to fail sending the data block. */
-    otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
+    /* Starting the agent queues the request for a job, which waits for the next poll. */
+    otaEvent.eventId = OtaAgentEventStart;
+    OTA_SignalEvent( &otaEvent );
+    TEST_ASSERT_EQUAL( 1, OTA_Poll( 1 ) );
+    TEST_ASSERT_EQUAL( OtaAgentStateRequestingJob, OTA_GetState() );
+    TEST_ASSERT_NOT_EQUAL( otaEventQueue, otaEventQueueEnd );
 
-    /* Simulate the application receiving a data block and failing to send it
-     * to the OTA Agent. */
-    TEST_ASSERT_EQUAL( false, OTA_SignalEvent( &otaEvent ) );
-    TEST_ASSERT_EQUAL( 1, otaAgent.statistics.otaPacketsDropped );
-    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 0, OTA_Poll( 0 ) );
+    TEST_ASSERT_NOT_EQUAL( otaEventQueue, otaEventQueueEnd );
 }
 
-void test_OTA_ReceiveFileBlockCompleteHttp()
+/**
+ * @brief Test that a file block is processed at once when the agent is polled,
+ * and queued otherwise.
+ */
+void test_OTA_ProcessFileBlock()
 {
-    OtaEventMsg_t otaEvent;
-    OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS ];
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffers[ 2 ];
     uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
-    int remainingBytes = OTA_TEST_FILE_SIZE;
-    int fileBlockSize = 0;
-    int idx = 0;
+    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+    size_t streamingMessageSize = 0;
 
-    pOtaJobDoc = JOB_DOC_HTTP;
+    pOtaJobDoc = JOB_DOC_A;
     otaGoToState( OtaAgentStateWaitingForFileBlock );
     TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
 
-    /* Set the event send interface to a mock function that allows events to be sent continuously
-     * because we're receiving multiple blocks in this test. */
     otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.event.poll = mockOSEventPoll;
+    mockOSEventReset( NULL );
 
-    /* Fill the file block. */
-    for( idx = 0; idx < ( int ) sizeof( pFileBlock ); idx++ )
-    {
-        pFileBlock[ idx ] = idx % UINT8_MAX;
-    }
-
-    idx = 0;
+    createOtaStreamingMessage(
+        pStreamingMessage,
+        sizeof( pStreamingMessage ),
+        0,
+        pFileBlock,
+        OTA_FILE_BLOCK_SIZE,
+        &streamingMessageSize,
+        true );
 
-    while( remainingBytes >= 0 )
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffers[ 0 ];
+    memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+    otaEvent.pEventData->dataLength = streamingMessageSize;
+
+    /* Run by the agent task, the block goes through the queue. */
+    TEST_ASSERT_TRUE( OTA_ProcessEvent( &otaEvent ) );
+    TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_EQUAL( 0, otaAgent.statistics.otaPacketsProcessed );
+
+    TEST_ASSERT_EQUAL( 1, OTA_Poll( 1 ) );
+    TEST_ASSERT_EQUAL( 1, otaAgent.statistics.otaPacketsProcessed );
+
+    createOtaStreamingMessage(
+        pStreamingMessage,
+        sizeof( pStreamingMessage ),
+        1,
+        pFileBlock,
+        OTA_FILE_BLOCK_SIZE,
+        &streamingMessageSize,
+        true );
+
+    otaEvent.pEventData = &eventBuffers[ 1 ];
+    memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+    otaEvent.pEventData->dataLength = streamingMessageSize;
+
+    /* Once polled, the block is processed without going through the queue. */
+    mockOSEventReset( NULL );
+    TEST_ASSERT_TRUE( OTA_ProcessEvent( &otaEvent ) );
+    TEST_ASSERT_EQUAL( 2, otaAgent.statistics.otaPacketsProcessed );
+    TEST_ASSERT_EQUAL( 2, otaAgent.statistics.otaPacketsReceived );
+    TEST_ASSERT_EQUAL( 2, otaAgent.statistics.otaPacketsQueued );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+}
+
+/**
+ * @brief Test that the blocks waiting in the queue are processed before the one
+ * processed at once, and that the block waits in the queue while the events are
+ * processed.
+ */
+void test_OTA_ProcessFileBlockAfterQueuedBlocks()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffers[ 3 ];
+    uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+    size_t streamingMessageSize = 0;
+    uint32_t blockId = 0;
+
+    pOtaJobDoc = JOB_DOC_A;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.event.poll = mockOSEventPoll;
+    mockOSEventReset( NULL );
+    TEST_ASSERT_EQUAL( 0, OTA_Poll( 1 ) );
+
+    for( blockId = 0U; blockId < 3U; blockId++ )
+    {
+        createOtaStreamingMessage(
+            pStreamingMessage,
+            sizeof( pStreamingMessage ),
+            blockId,
+            pFileBlock,
+            OTA_FILE_BLOCK_SIZE,
+            &streamingMessageSize,
+            true );
+
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffers[ blockId ];
+        memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+        otaEvent.pEventData->dataLength = streamingMessageSize;
+
+        /* The first block is signaled before the second one is processed at once,
+         * the third one comes from another task while the events are processed. */
+        if( blockId == 0U )
+        {
+            TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+        }
+        else if( blockId == 1U )
+        {
+            TEST_ASSERT_TRUE( OTA_ProcessEvent( &otaEvent ) );
+            TEST_ASSERT_EQUAL( 2, otaAgent.statistics.otaPacketsProcessed );
+            TEST_ASSERT_EQUAL( 1, otaAgent.fileContext.blocksRemaining );
+        }
+        else
+        {
+            mockOSEventReset( NULL );
+            eventsProcessing = true;
+            TEST_ASSERT_TRUE( OTA_ProcessEvent( &otaEvent ) );
+            eventsProcessing = false;
+            TEST_ASSERT_EQUAL( 2, otaAgent.statistics.otaPacketsProcessed );
+            TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+        }
+    }
+}
+
+/**
+ * @brief Test that a block waits in the queue, behind the events left there
+ * once a batch of them is processed.
+ */
+void test_OTA_ProcessFileBlockBehindQueuedEvents()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffer;
+    uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+    size_t streamingMessageSize = 0;
+    uint32_t i = 0;
+
+    pOtaJobDoc = JOB_DOC_A;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.os.event.poll = mockOSEventPoll;
+    mockOSEventReset( NULL );
+    TEST_ASSERT_EQUAL( 0, OTA_Poll( 1 ) );
+
+    /* One more event than is processed at once, none is handled in this state. */
+    otaEvent.eventId = OtaAgentEventStart;
+
+    for( i = 0U; i <= otaconfigEVENT_BATCH_SIZE; i++ )
+    {
+        TEST_ASSERT_TRUE( OTA_SignalEvent( &otaEvent ) );
+    }
+
+    createOtaStreamingMessage(
+        pStreamingMessage,
+        sizeof( pStreamingMessage ),
+        0,
+        pFileBlock,
+        OTA_FILE_BLOCK_SIZE,
+        &streamingMessageSize,
+        true );
+
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+    otaEvent.pEventData->dataLength = streamingMessageSize;
+
+    TEST_ASSERT_TRUE( OTA_ProcessEvent( &otaEvent ) );
+    TEST_ASSERT_EQUAL( 0, otaAgent.statistics.otaPacketsProcessed );
+    TEST_ASSERT_EQUAL( 1, otaAgent.statistics.otaPacketsQueued );
+    TEST_ASSERT_EQUAL( 2, otaEventQueueEnd - otaEventQueue );
+
+    /* The event left is processed before the block. */
+    TEST_ASSERT_EQUAL( 1, OTA_Poll( 1 ) );
+    TEST_ASSERT_EQUAL( 0, otaAgent.statistics.otaPacketsProcessed );
+    TEST_ASSERT_EQUAL( 1, OTA_Poll( 1 ) );
+    TEST_ASSERT_EQUAL( 1, otaAgent.statistics.otaPacketsProcessed );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+}
+
+/**
+ * @brief Test that an event can't be processed without the event or the instance.
+ */
+void test_OTA_ProcessEventInvalidParams()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaGoToState( OtaAgentStateReady );
+    otaInterfaces.os.event.poll = mockOSEventPoll;
+    TEST_ASSERT_EQUAL( 0, OTA_Poll( 1 ) );
+
+    otaEvent.eventId = OtaAgentEventStart;
+    TEST_ASSERT_FALSE( OTA_ProcessEvent( NULL ) );
+    TEST_ASSERT_FALSE( OTA_InstanceProcessEvent( NULL, &otaEvent ) );
+    TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+}
+
+/**
+ * @brief Test that an event can't be signaled without the event or the instance, or to a stopped agent.
+ */
+void test_OTA_SignalEventInvalidParams()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaEvent.eventId = OtaAgentEventStart;
+    TEST_ASSERT_FALSE( OTA_SignalEvent( &otaEvent ) );
+
+    otaGoToState( OtaAgentStateReady );
+    otaInterfaces.os.event.send = mockOSEventSend;
+    TEST_ASSERT_FALSE( OTA_SignalEvent( NULL ) );
+    TEST_ASSERT_FALSE( OTA_InstanceSignalEvent( NULL, &otaEvent ) );
+    TEST_ASSERT_EQUAL( 0, otaEventQueueEnd - otaEventQueue );
+    TEST_ASSERT_EQUAL( OtaAgentStateReady, OTA_GetState() );
+}
+
+void test_OTA_ReceiveFileBlockMallocFail()
+{
+    uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+    uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    size_t streamingMessageSize = 0;
+    OtaEventData_t eventBuffer;
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    /* Pass an invalid values for pDecodeMemory and decodeMemorySize so the
+     * OTA Agent dynamically allocates the buffer instead of using one provided
+     * by the user. */
+    pOtaAppBuffer.pDecodeMemory = NULL;
+    pOtaAppBuffer.decodeMemorySize = 0;
+
+    /* Get into the state before receiving a data block. */
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    /* Create and send the data block. */
+    createOtaStreamingMessage(
+        pStreamingMessage,
+        sizeof( pStreamingMessage ),
+        0,
+        pFileBlock,
+        OTA_FILE_BLOCK_SIZE,
+        &streamingMessageSize,
+        true );
+
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+    otaEvent.pEventData->dataLength = streamingMessageSize;
+    OTA_SignalEvent( &otaEvent );
+
+    /* Set malloc to fail and receive the block. */
+    otaInterfaces.os.mem.malloc = mockMallocAlwaysFail;
+    receiveAndProcessOtaEvent();
+    /* Receive the event for closing the file after the failure. */
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+}
+
+void test_OTA_DroppedFileBlock()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    /* Get ready to receive a block. */
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    /* No blocks have been received or dropped yet. */
+    TEST_ASSERT_EQUAL( 0, otaAgent.statistics.otaPacketsDropped );
+
+
+    /* Prepare an event as if we are receiving a data block. */
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    otaEvent.pEventData->dataLength = 0;
+
+    /* Set the interface to fail sending the data block. */
+    otaInterfaces.os.event.send = mockOSEventSendAlwaysFail;
+
+    /* Simulate the application receiving a data block and failing to send it
+     * to the OTA Agent. */
+    TEST_ASSERT_EQUAL( false, OTA_SignalEvent( &otaEvent ) );
+    TEST_ASSERT_EQUAL( 1, otaAgent.statistics.otaPacketsDropped );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+}
+
+void test_OTA_ReceiveFileBlockCompleteHttp()
+{
+    OtaEventMsg_t otaEvent;
+    OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS ];
+    uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    int remainingBytes = OTA_TEST_FILE_SIZE;
+    int fileBlockSize = 0;
+    int idx = 0;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    /* Set the event send interface to a mock function that allows events to be sent continuously
+     * because we're receiving multiple blocks in this test. */
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    /* Fill the file block. */
+    for( idx = 0; idx < ( int ) sizeof( pFileBlock ); idx++ )
+    {
+        pFileBlock[ idx ] = idx % UINT8_MAX;
+    }
+
+    idx = 0;
+
+    while( remainingBytes >= 0 )
     {
         fileBlockSize = min( ( uint32_t ) remainingBytes, OTA_FILE_BLOCK_SIZE );
         otaEvent.eventId = OtaAgentEventReceivedFileBlock;
@@ -2080,10 +3344,705 @@ void test_OTA_ReceiveFileBlockCompleteHttp()
     }
 }
 
-void test_OTA_ReceiveFileBlockCompleteDynamicBufferHttp()
+void test_OTA_ReceiveFileBlockHttpLatencyStatistics()
+{
+    #if ( otaconfigLATENCY_STATS == 1U )
+        OtaLatencyStatistics_t latency = { 0 };
+
+        otaInterfaces.pal.writeBlock = mockPalWriteBlockTimed;
+        otaInterfaces.pal.closeFile = mockPalCloseFileTimed;
+        test_OTA_ReceiveFileBlockCompleteHttp();
+
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_GetLatencyStatistics( &latency ) );
+
+        /* The 3 blocks are decoded without the clock moving. */
+        TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS, latency.stages[ OtaLatencyDecode ].count );
+        TEST_ASSERT_EQUAL( 0, latency.stages[ OtaLatencyDecode ].max );
+
+        /* The first 2 blocks are combined in one write, the last one is written alone. */
+        TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS, latency.stages[ OtaLatencyWrite ].count );
+        TEST_ASSERT_EQUAL( 0, latency.stages[ OtaLatencyWrite ].min );
+        TEST_ASSERT_EQUAL( 100, latency.stages[ OtaLatencyWrite ].max );
+        TEST_ASSERT_EQUAL( 200, latency.stages[ OtaLatencyWrite ].total );
+        TEST_ASSERT_EQUAL( 1, latency.stages[ OtaLatencyWrite ].histogram[ 0 ] );
+        TEST_ASSERT_EQUAL( 2, latency.stages[ OtaLatencyWrite ].histogram[ 2 ] );
+
+        TEST_ASSERT_EQUAL( 1, latency.stages[ OtaLatencyClose ].count );
+        TEST_ASSERT_EQUAL( 1000, latency.stages[ OtaLatencyClose ].max );
+        TEST_ASSERT_EQUAL( 1, latency.stages[ OtaLatencyClose ].histogram[ 3 ] );
+
+        /* The blocks answer the request sent when the file transfer started. */
+        TEST_ASSERT_EQUAL( 1, latency.stages[ OtaLatencyBlockRtt ].count );
+        TEST_ASSERT_EQUAL( 1, latency.requestMomentumPeak );
+    #else
+        TEST_IGNORE_MESSAGE( "The latency statistics are off." );
+    #endif
+}
+
+void test_OTA_ReceiveFileBlockMqttLatencyCounters()
+{
+    #if ( otaconfigLATENCY_STATS == 1U )
+        OtaLatencyStatistics_t latency = { 0 };
+
+        test_OTA_ReceiveFileBlockCompleteMqtt();
+
+        /* Each block is sent 3 times, the copies of the last one arrive after the file is closed. */
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_GetLatencyStatistics( &latency ) );
+        TEST_ASSERT_EQUAL( ( OTA_TEST_DUPLICATE_NUM_BLOCKS - 1 ) * ( OTA_TEST_FILE_NUM_BLOCKS - 1 ), latency.duplicateBlocks );
+    #else
+        TEST_IGNORE_MESSAGE( "The latency statistics are off." );
+    #endif
+}
+
+void test_OTA_ReceiveFileBlockHttpSavesCheckpoints()
+{
+    #if ( otaconfigCHECKPOINT_INTERVAL_BLOCKS == 2U )
+        otaInterfaces.pal.saveCheckpoint = mockPalSaveCheckpoint;
+        test_OTA_ReceiveFileBlockCompleteHttp();
+
+        /* A checkpoint is saved every 2 blocks of the 3 blocks file. */
+        TEST_ASSERT_EQUAL( 1, checkpointsSaved );
+        TEST_ASSERT_EQUAL( 1, checkpointBlocksRemaining );
+    #else
+        TEST_IGNORE_MESSAGE( "The test file is not checkpointed every 2 blocks." );
+    #endif
+}
+
+void test_OTA_ReceiveFileBlockHttpResumedFromCheckpoint()
+{
+    OtaEventMsg_t otaEvent;
+    OtaEventData_t eventBuffer;
+    uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    int lastBlockSize = OTA_TEST_FILE_SIZE - ( 2 * OTA_FILE_BLOCK_SIZE );
+    int idx = 0;
+
+    /* Creating the file fails, so the download can only go on from the checkpoint. */
+    otaInterfaces.pal.resumeFile = mockPalResumeFileFirstBlocks;
+    otaInterfaces.pal.createFile = mockPalCreateFileForRxAlwaysFail;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 1, otaAgent.fileContext.blocksRemaining );
+    TEST_ASSERT_EQUAL( 0x04, otaAgent.fileContext.pRxBlockBitmap[ 0 ] );
+    TEST_ASSERT_EQUAL( 2, otaAgent.currBlock );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+
+    for( idx = 0; idx < ( int ) sizeof( pFileBlock ); idx++ )
+    {
+        pFileBlock[ idx ] = idx % UINT8_MAX;
+    }
+
+    /* Send only the last block of the file. */
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    memcpy( otaEvent.pEventData->data, pFileBlock, lastBlockSize );
+    otaEvent.pEventData->dataLength = lastBlockSize;
+    OTA_SignalEvent( &otaEvent );
+
+    processEntireQueue();
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+    TEST_ASSERT_EQUAL( OtaJobEventActivate, lastAppCallbackEvent );
+
+    for( idx = 2 * OTA_FILE_BLOCK_SIZE; idx < OTA_TEST_FILE_SIZE; ++idx )
+    {
+        TEST_ASSERT_EQUAL( pFileBlock[ idx % sizeof( pFileBlock ) ], pOtaFileBuffer[ idx ] );
+    }
+}
+
+void test_OTA_ReceiveFileBlockHttpResumedWithCheckpointBlockSize()
+{
+    #if ( otaconfigMIN_LOG2_FILE_BLOCK_SIZE < otaconfigLOG2_FILE_BLOCK_SIZE )
+        otaInterfaces.pal.resumeFile = mockPalResumeFileCheckpointBlockSize;
+        otaInterfaces.pal.createFile = mockPalCreateFileForRxAlwaysFail;
+        checkpointLog2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE - 1U;
+
+        pOtaJobDoc = JOB_DOC_HTTP;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        /* The blocks left are the ones of the checkpoint, of half the size. */
+        TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE - 1U, otaAgent.fileContext.log2BlockSize );
+        TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE - 1U, otaAgent.log2BlockSize );
+        TEST_ASSERT_EQUAL( 3, otaAgent.fileContext.blocksRemaining );
+        TEST_ASSERT_EQUAL( 2, otaAgent.currBlock );
+    #else
+        TEST_IGNORE_MESSAGE( "The block size of the files does not adapt." );
+    #endif
+}
+
+void test_OTA_ReceiveFileBlockHttpResumeUnsupportedBlockSize()
+{
+    otaInterfaces.pal.resumeFile = mockPalResumeFileCheckpointBlockSize;
+    checkpointLog2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE + 1U;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    /* The file is created again and every block is requested with the chosen size. */
+    TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE, otaAgent.fileContext.log2BlockSize );
+    TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE, otaAgent.log2BlockSize );
+    TEST_ASSERT_EQUAL( 3, otaAgent.fileContext.blocksRemaining );
+    TEST_ASSERT_EQUAL( 0x07, otaAgent.fileContext.pRxBlockBitmap[ 0 ] );
+    TEST_ASSERT_EQUAL( 0, otaAgent.currBlock );
+}
+
+void test_OTA_ReceiveFileBlockHttpResumeFail()
+{
+    otaInterfaces.pal.resumeFile = mockPalResumeFileAlwaysFail;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    /* The file is created again and every block is requested. */
+    TEST_ASSERT_EQUAL( pOtaFileBuffer, otaAgent.fileContext.pFile );
+    TEST_ASSERT_EQUAL( 3, otaAgent.fileContext.blocksRemaining );
+    TEST_ASSERT_EQUAL( 0x07, otaAgent.fileContext.pRxBlockBitmap[ 0 ] );
+    TEST_ASSERT_EQUAL( 0, otaAgent.currBlock );
+}
+
+void test_OTA_SuspendWhileReceivingSavesCheckpoint()
+{
+    otaInterfaces.pal.saveCheckpoint = mockPalSaveCheckpoint;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    TEST_ASSERT_EQUAL( OtaErrNone, OTA_Suspend() );
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateSuspended, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 1, checkpointsSaved );
+    TEST_ASSERT_EQUAL( 3, checkpointBlocksRemaining );
+}
+
+void test_OTA_ReceiveFileBlockHttpWriteCombined()
+{
+    #if ( otaconfigWRITE_COMBINE_SIZE > 0U )
+        otaInterfaces.pal.writeBlock = mockPalWriteBlockRecord;
+        test_OTA_ReceiveFileBlockCompleteHttp();
+
+        /* The first two blocks fill a sector, the last one ends the file. */
+        TEST_ASSERT_EQUAL( 2, writesDone );
+        TEST_ASSERT_EQUAL( 0, writeOffsets[ 0 ] );
+        TEST_ASSERT_EQUAL( otaconfigWRITE_COMBINE_SIZE, writeSizes[ 0 ] );
+        TEST_ASSERT_EQUAL( otaconfigWRITE_COMBINE_SIZE, writeOffsets[ 1 ] );
+        TEST_ASSERT_EQUAL( OTA_TEST_FILE_SIZE - otaconfigWRITE_COMBINE_SIZE, writeSizes[ 1 ] );
+    #else
+        TEST_IGNORE_MESSAGE( "The writes of the blocks are not combined." );
+    #endif
+}
+
+void test_OTA_ReceiveFileBlockHttpWriteCombinedFail()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffers[ 2 ];
+    int idx = 0;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.pal.writeBlock = mockPalWriteBlockAlwaysFail;
+
+    for( idx = 0; idx < 2; idx++ )
+    {
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffers[ idx ];
+        memset( otaEvent.pEventData->data, idx + 1, OTA_FILE_BLOCK_SIZE );
+        otaEvent.pEventData->dataLength = OTA_FILE_BLOCK_SIZE;
+        OTA_SignalEvent( &otaEvent );
+    }
+
+    /* The first block is only buffered, writing the sector fails with the second one. */
+    receiveAndProcessOtaEvent();
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    processEntireQueue();
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+    TEST_ASSERT_EQUAL( OtaJobEventFail, lastAppCallbackEvent );
+}
+
+void test_OTA_ReceiveFileBlockHttpStreamingDigest()
+{
+    otaInterfaces.pal.digestUpdate = mockPalDigestUpdate;
+    test_OTA_ReceiveFileBlockCompleteHttp();
+
+    /* Every block is digested as it is received. */
+    TEST_ASSERT_EQUAL( OTA_TEST_FILE_SIZE, digestBytes );
+    TEST_ASSERT_EQUAL( 3, digestBlocks );
+}
+
+void test_OTA_ReceiveFileBlockCompleteHttpDelta()
+{
+    #if ( configOTA_DELTA_UPDATE_FILE_TYPE_ID == 3U )
+        OtaEventMsg_t otaEvent;
+        OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS ];
+        int remainingBytes = OTA_TEST_FILE_SIZE;
+        int fileBlockSize = 0;
+        int idx = 0;
+
+        otaInterfaces.pal.patchBlock = mockPalPatchBlock;
+        otaInterfaces.pal.writeBlock = mockPalWriteBlockRecord;
+
+        pOtaJobDoc = JOB_DOC_HTTP_DELTA;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+
+        while( remainingBytes > 0 )
+        {
+            fileBlockSize = min( ( uint32_t ) remainingBytes, OTA_FILE_BLOCK_SIZE );
+            otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+            otaEvent.pEventData = &eventBuffers[ idx ];
+            memset( otaEvent.pEventData->data, idx + 1, fileBlockSize );
+            otaEvent.pEventData->dataLength = fileBlockSize;
+            OTA_SignalEvent( &otaEvent );
+
+            idx++;
+            remainingBytes -= OTA_FILE_BLOCK_SIZE;
+        }
+
+        /* The whole patch is applied and the new image is activated like a firmware update. */
+        processEntireQueue();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+        TEST_ASSERT_EQUAL( OtaJobEventActivate, lastAppCallbackEvent );
+        TEST_ASSERT_EQUAL( OTA_TEST_FILE_SIZE, patchedBytes );
+        TEST_ASSERT_EQUAL( 0, writesDone );
+    #else
+        TEST_IGNORE_MESSAGE( "The files of type 3 are not delta updates." );
+    #endif
+}
+
+/* Send the first blocks of the test file to the agent waiting for them. */
+static void otaReceiveFirstFileBlocks( int numBlocks )
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    static OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS ];
+    int idx = 0;
+
+    for( idx = 0; idx < numBlocks; idx++ )
+    {
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffers[ idx ];
+        memset( otaEvent.pEventData->data, idx + 1, OTA_FILE_BLOCK_SIZE );
+        otaEvent.pEventData->dataLength = OTA_FILE_BLOCK_SIZE;
+        OTA_SignalEvent( &otaEvent );
+    }
+
+    processEntireQueue();
+}
+
+/* Expire the progress timer of the agent. */
+static void otaExpireProgressTimer( void )
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    otaEvent.eventId = OtaAgentEventProgressTimer;
+    OTA_SignalEvent( &otaEvent );
+    processEntireQueue();
+}
+
+void test_OTA_ReceiveFileBlockProgressReportedByTimer()
+{
+    #if ( otaconfigPROGRESS_REPORT_INTERVAL_MS > 0U )
+        pOtaJobDoc = JOB_DOC_HTTP;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+        otaInterfaces.mqtt.publish = mockMqttPublishRecordMessage;
+        memset( publishedMessage, 0, sizeof( publishedMessage ) );
+
+        /* Nothing is published while the blocks are received. */
+        otaReceiveFirstFileBlocks( 2 );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        TEST_ASSERT_EQUAL( 0, messagesPublished );
+        TEST_ASSERT_TRUE( otaAgent.progressTimerStarted );
+
+        /* The two blocks are reported at once, out of the three of the file. */
+        otaExpireProgressTimer();
+        TEST_ASSERT_EQUAL( 1, messagesPublished );
+        TEST_ASSERT_NOT_NULL( strstr( publishedMessage, "\"2/3\"" ) );
+        TEST_ASSERT_FALSE( otaAgent.progressTimerStarted );
+
+        /* No blocks were received since, so there is nothing to publish. */
+        otaExpireProgressTimer();
+        TEST_ASSERT_EQUAL( 1, messagesPublished );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    #else
+        TEST_IGNORE_MESSAGE( "The progress is reported every few blocks." );
+    #endif
+}
+
+/* Test that the progress timer is restarted after it expired in a state that does not report the progress. */
+void test_OTA_ReceiveFileBlockProgressTimerUnexpected()
+{
+    #if ( otaconfigPROGRESS_REPORT_INTERVAL_MS > 0U )
+        pOtaJobDoc = JOB_DOC_HTTP;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+
+        otaReceiveFirstFileBlocks( 1 );
+        TEST_ASSERT_TRUE( otaAgent.progressTimerStarted );
+
+        /* The timer expires while the blocks are requested again. */
+        otaAgent.state = OtaAgentStateRequestingFileBlock;
+        otaExpireProgressTimer();
+        TEST_ASSERT_FALSE( otaAgent.progressTimerStarted );
+
+        /* The next progress to report starts it again. */
+        otaAgent.state = OtaAgentStateWaitingForFileBlock;
+        TEST_ASSERT_EQUAL( OtaErrNone, reportProgress() );
+        TEST_ASSERT_TRUE( otaAgent.progressTimerStarted );
+    #else
+        TEST_IGNORE_MESSAGE( "The progress is reported every few blocks." );
+    #endif
+}
+
+void test_OTA_ReceiveFileBlockProgressPublishFail()
+{
+    #if ( otaconfigPROGRESS_REPORT_INTERVAL_MS > 0U )
+        pOtaJobDoc = JOB_DOC_HTTP;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+        otaInterfaces.mqtt.publish = stubMqttPublishAlwaysFail;
+
+        otaReceiveFirstFileBlocks( 1 );
+        otaExpireProgressTimer();
+
+        /* The download goes on and the progress is kept for the next status. */
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        TEST_ASSERT_TRUE( otaAgent.progressPending );
+
+        otaInterfaces.mqtt.publish = mockMqttPublishRecordMessage;
+        memset( publishedMessage, 0, sizeof( publishedMessage ) );
+        otaExpireProgressTimer();
+        TEST_ASSERT_EQUAL( 1, messagesPublished );
+        TEST_ASSERT_NOT_NULL( strstr( publishedMessage, "\"1/3\"" ) );
+        TEST_ASSERT_FALSE( otaAgent.progressPending );
+    #else
+        TEST_IGNORE_MESSAGE( "The progress is reported every few blocks." );
+    #endif
+}
+
+/* Test that the progress is published every few blocks without the progress timer. */
+void test_OTA_ReceiveFileBlockProgressReportedByBlocks()
+{
+    #if ( otaconfigPROGRESS_REPORT_INTERVAL_MS == 0U )
+        pOtaJobDoc = JOB_DOC_HTTP;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+        otaInterfaces.mqtt.publish = mockMqttPublishRecordMessage;
+        memset( publishedMessage, 0, sizeof( publishedMessage ) );
+
+        /* The second block of the three of the file is reported as it is received. */
+        otaReceiveFirstFileBlocks( 2 );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        TEST_ASSERT_EQUAL( 1, messagesPublished );
+        TEST_ASSERT_NOT_NULL( strstr( publishedMessage, "\"2/3\"" ) );
+        TEST_ASSERT_FALSE( otaAgent.progressTimerStarted );
+    #else
+        TEST_IGNORE_MESSAGE( "The progress is reported off the progress timer." );
+    #endif
+}
+
+void test_OTA_ReceiveFileBlockCompleteDynamicBufferHttp()
+{
+    memset( &pOtaAppBuffer, 0, sizeof( pOtaAppBuffer ) );
+    test_OTA_ReceiveFileBlockCompleteHttp();
+}
+
+void test_OTA_ReceiveFileBlockCompleteHttpTwoFiles()
+{
+    #if ( otaconfigMAX_FILES_PER_JOB > 1U )
+        OtaEventMsg_t otaEvent;
+        OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS ];
+        uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+        int remainingBytes = 0;
+        int fileBlockSize = 0;
+        int file = 0;
+        int idx = 0;
+
+        otaInterfaces.pal.closeFile = mockPalCloseFileCount;
+
+        pOtaJobDoc = JOB_DOC_HTTP_TWO_FILES;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        TEST_ASSERT_EQUAL( 2, otaAgent.numJobFiles );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+
+        for( file = 0; file < 2; file++ )
+        {
+            /* Fill the file block differently for each file. */
+            for( idx = 0; idx < ( int ) sizeof( pFileBlock ); idx++ )
+            {
+                pFileBlock[ idx ] = ( idx + file ) % UINT8_MAX;
+            }
+
+            remainingBytes = OTA_TEST_FILE_SIZE;
+            idx = 0;
+
+            while( remainingBytes > 0 )
+            {
+                fileBlockSize = min( ( uint32_t ) remainingBytes, OTA_FILE_BLOCK_SIZE );
+                otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+                otaEvent.pEventData = &eventBuffers[ idx ];
+                memcpy( otaEvent.pEventData->data, pFileBlock, fileBlockSize );
+                otaEvent.pEventData->dataLength = fileBlockSize;
+                OTA_SignalEvent( &otaEvent );
+
+                idx++;
+                remainingBytes -= OTA_FILE_BLOCK_SIZE;
+            }
+
+            processEntireQueue();
+
+            /* Each file is closed once it is received. */
+            TEST_ASSERT_EQUAL( file + 1, filesClosed );
+
+            for( idx = 0; idx < OTA_TEST_FILE_SIZE; ++idx )
+            {
+                TEST_ASSERT_EQUAL( pFileBlock[ idx % sizeof( pFileBlock ) ], pOtaFileBuffer[ idx ] );
+            }
+
+            if( file == 0 )
+            {
+                /* The job goes on with its second file, without notifying the application. */
+                TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+                TEST_ASSERT_EQUAL( 1, otaAgent.fileIndex );
+                TEST_ASSERT_EQUAL( 1, otaAgent.serverFileID );
+                TEST_ASSERT_EQUAL( 2, otaAgent.fileContext.fileType );
+                TEST_ASSERT_EQUAL( OtaLastJobEvent, lastAppCallbackEvent );
+
+                /* The progress of the first file is no longer reported. */
+                TEST_ASSERT_FALSE( otaAgent.progressTimerStarted );
+                TEST_ASSERT_FALSE( otaAgent.progressPending );
+            }
+        }
+
+        /* The job with a firmware file is activated once all its files are received. */
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+        TEST_ASSERT_EQUAL( OtaJobEventActivate, lastAppCallbackEvent );
+        TEST_ASSERT_EQUAL( 0, otaAgent.fileIndex );
+        TEST_ASSERT_NULL( otaAgent.pJobDoc );
+    #else
+        TEST_IGNORE_MESSAGE( "A job has a single file." );
+    #endif
+}
+
+/* Test that a block of the previous file of the job received after the next file is started is dropped. */
+void test_OTA_ReceiveFileBlockOfPreviousFileDropped()
+{
+    #if ( otaconfigMAX_FILES_PER_JOB > 1U )
+        OtaEventMsg_t otaEvent;
+        OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS + 1 ];
+        uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+        uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+        size_t streamingMessageSize = 0;
+        int remainingBytes = OTA_TEST_FILE_SIZE;
+        uint32_t blocksRemaining = 0;
+        uint32_t packetsDropped = 0;
+        int idx = 0;
+
+        pOtaJobDoc = JOB_DOC_TWO_FILES;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+
+        /* Receive the whole first file, whose ID is 0. */
+        while( remainingBytes > 0 )
+        {
+            createOtaStreamingMessage( pStreamingMessage,
+                                       sizeof( pStreamingMessage ),
+                                       idx,
+                                       pFileBlock,
+                                       min( ( uint32_t ) remainingBytes, OTA_FILE_BLOCK_SIZE ),
+                                       &streamingMessageSize,
+                                       true );
+
+            otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+            otaEvent.pEventData = &eventBuffers[ idx ];
+            memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+            otaEvent.pEventData->dataLength = streamingMessageSize;
+            OTA_SignalEvent( &otaEvent );
+
+            idx++;
+            remainingBytes -= OTA_FILE_BLOCK_SIZE;
+        }
+
+        processEntireQueue();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        TEST_ASSERT_EQUAL( 1, otaAgent.serverFileID );
+        blocksRemaining = otaAgent.fileContext.blocksRemaining;
+        packetsDropped = otaAgent.statistics.otaPacketsDropped;
+
+        /* A late block of the first file is not stored as a block of the second one. */
+        createOtaStreamingMessage( pStreamingMessage, sizeof( pStreamingMessage ), 0, pFileBlock, OTA_FILE_BLOCK_SIZE, &streamingMessageSize, true );
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffers[ idx ];
+        memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+        otaEvent.pEventData->dataLength = streamingMessageSize;
+        OTA_SignalEvent( &otaEvent );
+        processEntireQueue();
+
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        TEST_ASSERT_EQUAL( blocksRemaining, otaAgent.fileContext.blocksRemaining );
+        TEST_ASSERT_EQUAL( packetsDropped, otaAgent.statistics.otaPacketsDropped );
+    #else
+        TEST_IGNORE_MESSAGE( "A job has a single file." );
+    #endif
+}
+
+void test_OTA_ReceiveFileBlockHttpNextFileCreateFail()
+{
+    #if ( otaconfigMAX_FILES_PER_JOB > 1U )
+        OtaEventMsg_t otaEvent;
+        OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS ];
+        int remainingBytes = OTA_TEST_FILE_SIZE;
+        int idx = 0;
+
+        pOtaJobDoc = JOB_DOC_HTTP_TWO_FILES;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+        otaInterfaces.pal.createFile = mockPalCreateFileForRxAlwaysFail;
+
+        while( remainingBytes > 0 )
+        {
+            otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+            otaEvent.pEventData = &eventBuffers[ idx ];
+            memset( otaEvent.pEventData->data, 0, OTA_FILE_BLOCK_SIZE );
+            otaEvent.pEventData->dataLength = min( ( uint32_t ) remainingBytes, OTA_FILE_BLOCK_SIZE );
+            OTA_SignalEvent( &otaEvent );
+
+            idx++;
+            remainingBytes -= OTA_FILE_BLOCK_SIZE;
+        }
+
+        /* The job fails if its next file can't be created. */
+        processEntireQueue();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+        TEST_ASSERT_EQUAL( OtaJobEventFail, lastAppCallbackEvent );
+        TEST_ASSERT_NULL( otaAgent.pJobDoc );
+    #else
+        TEST_IGNORE_MESSAGE( "A job has a single file." );
+    #endif
+}
+
+void test_OTA_AddFileSinkInvalidArgs()
+{
+    #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+        OtaFileContext_t extraSink = { 0 };
+
+        TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_AddFileSink( NULL ) );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_AddFileSink( &fileSinks[ 0 ] ) );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_AddFileSink( &fileSinks[ 1 ] ) );
+        TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_AddFileSink( &extraSink ) );
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no file sinks." );
+    #endif
+}
+
+void test_OTA_AddFileSinkWhileReceiving()
+{
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    TEST_ASSERT_EQUAL( OtaErrInvalidArg, OTA_AddFileSink( &fileSinks[ 0 ] ) );
+}
+
+/**
+ * @brief Test that the blocks downloaded once are written to the file and to every sink.
+ */
+void test_OTA_ReceiveFileBlockCompleteHttpFileSinks()
+{
+    #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+        int idx = 0;
+
+        /* The first sink has its own bitmap buffer, the bitmap of the second one is allocated. */
+        fileSinks[ 0 ].pRxBlockBitmap = pFileSinkBitmap;
+        fileSinks[ 0 ].blockBitmapMaxSize = sizeof( pFileSinkBitmap );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_AddFileSink( &fileSinks[ 0 ] ) );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_AddFileSink( &fileSinks[ 1 ] ) );
+
+        otaInterfaces.pal.writeBlock = mockPalWriteBlockFileSinks;
+        otaInterfaces.pal.closeFile = mockPalCloseFileCount;
+
+        test_OTA_ReceiveFileBlockCompleteHttp();
+
+        for( idx = 0; idx < OTA_TEST_FILE_SIZE; ++idx )
+        {
+            TEST_ASSERT_EQUAL( pOtaFileBuffer[ idx ], pFileSinkBuffers[ 0 ][ idx ] );
+            TEST_ASSERT_EQUAL( pOtaFileBuffer[ idx ], pFileSinkBuffers[ 1 ][ idx ] );
+        }
+
+        /* Each file is closed and validated once, and the sinks are done with. */
+        TEST_ASSERT_EQUAL( 3, filesClosed );
+        TEST_ASSERT_EQUAL( 0, fileSinks[ 0 ].blocksRemaining );
+        TEST_ASSERT_EQUAL( 0, fileSinks[ 1 ].blocksRemaining );
+        TEST_ASSERT_NULL( fileSinks[ 0 ].pFile );
+        TEST_ASSERT_NULL( fileSinks[ 1 ].pFile );
+        TEST_ASSERT_NULL( fileSinks[ 1 ].pRxBlockBitmap );
+        TEST_ASSERT_EQUAL( OtaJobEventActivate, lastAppCallbackEvent );
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no file sinks." );
+    #endif
+}
+
+void test_OTA_ReceiveFileBlockCompleteHttpFileSinkSigCheckFail()
+{
+    #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_AddFileSink( &fileSinks[ 0 ] ) );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_AddFileSink( &fileSinks[ 1 ] ) );
+
+        otaInterfaces.pal.writeBlock = mockPalWriteBlockFileSinks;
+        otaInterfaces.pal.closeFile = mockPalCloseFileSinkSigCheckFail;
+
+        test_OTA_ReceiveFileBlockCompleteHttp();
+
+        /* The other sink is still closed, but the job fails. */
+        TEST_ASSERT_EQUAL( 3, filesClosed );
+        TEST_ASSERT_EQUAL( OtaJobEventFail, lastAppCallbackEvent );
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no file sinks." );
+    #endif
+}
+
+void test_OTA_ProcessJobDocumentFileSinkCreateFail()
 {
-    memset( &pOtaAppBuffer, 0, sizeof( pOtaAppBuffer ) );
-    test_OTA_ReceiveFileBlockCompleteHttp();
+    #if ( otaconfigMAX_NUM_FILE_SINKS > 0U )
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_AddFileSink( &fileSinks[ 0 ] ) );
+        TEST_ASSERT_EQUAL( OtaErrNone, OTA_AddFileSink( &fileSinks[ 1 ] ) );
+        otaInterfaces.pal.createFile = mockPalCreateFileSinkFail;
+
+        otaGoToState( OtaAgentStateWaitingForJob );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+        otaReceiveJobDocument();
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+        /* The file of the sink created already is aborted. */
+        TEST_ASSERT_NULL( fileSinks[ 0 ].pFile );
+        TEST_ASSERT_NULL( fileSinks[ 0 ].pRxBlockBitmap );
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no file sinks." );
+    #endif
 }
 
 /**
@@ -2495,6 +4454,668 @@ void test_OTA_MQTT_UpdateStatusFailed()
     TEST_ASSERT_EQUAL( OtaErrUpdateJobStatusFailed, err );
 }
 
+/* Test that the request window is opened by the MQTT file transfer and only free slots are requested. */
+void test_OTA_MQTT_RequestWindowFreeSlots()
+{
+    #if ( otaconfigMAX_REQUEST_WINDOW_SIZE > 0U )
+        OtaErr_t err = OtaErrNone;
+
+        pOtaJobDoc = JOB_DOC_A;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        /* The first request fills the initial window. */
+        TEST_ASSERT_EQUAL( otaconfigINITIAL_REQUEST_WINDOW_SIZE, otaAgent.requestWindow.windowSize );
+        TEST_ASSERT_EQUAL( otaconfigINITIAL_REQUEST_WINDOW_SIZE, otaAgent.requestWindow.blocksInFlight );
+        TEST_ASSERT_EQUAL( otaconfigINITIAL_REQUEST_WINDOW_SIZE, otaAgent.requestWindow.nextBlock );
+
+        /* Open the window so the rest of the file fits in it. */
+        otaAgent.requestWindow.windowSize = OTA_TEST_FILE_NUM_BLOCKS;
+        err = requestFileBlock_Mqtt( &otaAgent );
+        TEST_ASSERT_EQUAL( OtaErrNone, err );
+        TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS - otaconfigINITIAL_REQUEST_WINDOW_SIZE, otaAgent.numOfBlocksToReceive );
+        TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS, otaAgent.requestWindow.blocksInFlight );
+
+        /* Nothing is requested while the window is full. */
+        otaInterfaces.mqtt.publish = stubMqttPublishAlwaysFail;
+        err = requestFileBlock_Mqtt( &otaAgent );
+        TEST_ASSERT_EQUAL( OtaErrNone, err );
+        TEST_ASSERT_EQUAL( 0, otaAgent.numOfBlocksToReceive );
+        TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS, otaAgent.requestWindow.blocksInFlight );
+    #else
+        TEST_IGNORE_MESSAGE( "The blocks are requested one at a time." );
+    #endif
+}
+
+/* Test that retrying the request while the window is full does not count as a request without response. */
+void test_OTA_RequestWindowFullKeepsMomentum()
+{
+    #if ( otaconfigMAX_REQUEST_WINDOW_SIZE > 0U )
+        OtaEventMsg_t otaEvent = { 0 };
+        uint32_t requestMomentum = 0;
+        uint32_t i = 0;
+
+        pOtaJobDoc = JOB_DOC_A;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        TEST_ASSERT_EQUAL( otaAgent.requestWindow.windowSize, otaAgent.requestWindow.blocksInFlight );
+        requestMomentum = otaAgent.requestMomentum;
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+
+        /* No request is sent while the window is full, so the transfer is not aborted. */
+        for( i = 0; i <= otaconfigMAX_NUM_REQUEST_MOMENTUM; i++ )
+        {
+            otaEvent.eventId = OtaAgentEventRequestFileBlock;
+            OTA_SignalEvent( &otaEvent );
+            receiveAndProcessOtaEvent();
+            TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+            TEST_ASSERT_EQUAL( requestMomentum, otaAgent.requestMomentum );
+        }
+    #else
+        TEST_IGNORE_MESSAGE( "The blocks are requested one at a time." );
+    #endif
+}
+
+/* Test that blocks that never arrived are requested again once the frontier passed the last block. */
+void test_OTA_MQTT_RequestWindowWrapsAround()
+{
+    OtaErr_t err = OtaErrNone;
+
+    pOtaJobDoc = JOB_DOC_A;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaAgent.requestWindow.windowSize = 2;
+    otaAgent.requestWindow.blocksInFlight = 0;
+    otaAgent.requestWindow.nextBlock = OTA_TEST_FILE_NUM_BLOCKS;
+
+    err = requestFileBlock_Mqtt( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL( 2, otaAgent.numOfBlocksToReceive );
+    TEST_ASSERT_EQUAL( 2, otaAgent.requestWindow.blocksInFlight );
+    TEST_ASSERT_EQUAL( 2, otaAgent.requestWindow.nextBlock );
+}
+
+/* Test that the request window grows and requests more blocks as each block arrives. */
+void test_OTA_RequestWindowGrowsOnBlockReceived()
+{
+    #if ( otaconfigMAX_REQUEST_WINDOW_SIZE > 0U )
+        OtaEventMsg_t otaEvent = { 0 };
+        uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+        uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+        size_t streamingMessageSize = 0;
+
+        pOtaJobDoc = JOB_DOC_A;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+
+        createOtaStreamingMessage(
+            pStreamingMessage,
+            sizeof( pStreamingMessage ),
+            0,
+            pFileBlock,
+            OTA_FILE_BLOCK_SIZE,
+            &streamingMessageSize,
+            true );
+
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffer;
+        memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+        otaEvent.pEventData->dataLength = streamingMessageSize;
+        OTA_SignalEvent( &otaEvent );
+        receiveAndProcessOtaEvent();
+
+        /* The window grew by one block and the next request was triggered right away. */
+        TEST_ASSERT_EQUAL( otaconfigINITIAL_REQUEST_WINDOW_SIZE + 1U, otaAgent.requestWindow.windowSize );
+        TEST_ASSERT_EQUAL( 0, otaAgent.requestWindow.blocksInFlight );
+        TEST_ASSERT_EQUAL( 1, otaEventQueueEnd - otaEventQueue );
+        TEST_ASSERT_EQUAL( OtaAgentEventRequestFileBlock, otaEventQueue[ 0 ].eventId );
+
+        /* The request fills the window again. */
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( otaAgent.requestWindow.windowSize, otaAgent.requestWindow.blocksInFlight );
+    #else
+        TEST_IGNORE_MESSAGE( "The blocks are requested one at a time." );
+    #endif
+}
+
+/* Test that the request window is halved when packets are dropped before reaching the agent. */
+void test_OTA_RequestWindowShrinksOnDroppedBlocks()
+{
+    #if ( otaconfigMAX_REQUEST_WINDOW_SIZE > 0U )
+        OtaEventMsg_t otaEvent = { 0 };
+        uint8_t pFileBlock[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+        uint8_t pStreamingMessage[ OTA_FILE_BLOCK_SIZE * 2 ] = { 0 };
+        size_t streamingMessageSize = 0;
+
+        pOtaJobDoc = JOB_DOC_A;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+
+        /* Pretend a full window is in flight and one of the blocks was dropped. */
+        otaAgent.requestWindow.windowSize = otaconfigMAX_REQUEST_WINDOW_SIZE;
+        otaAgent.requestWindow.blocksInFlight = otaconfigMAX_REQUEST_WINDOW_SIZE;
+        otaAgent.statistics.otaPacketsDropped++;
+
+        createOtaStreamingMessage(
+            pStreamingMessage,
+            sizeof( pStreamingMessage ),
+            0,
+            pFileBlock,
+            OTA_FILE_BLOCK_SIZE,
+            &streamingMessageSize,
+            true );
+
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffer;
+        memcpy( otaEvent.pEventData->data, pStreamingMessage, streamingMessageSize );
+        otaEvent.pEventData->dataLength = streamingMessageSize;
+        OTA_SignalEvent( &otaEvent );
+        receiveAndProcessOtaEvent();
+
+        TEST_ASSERT_EQUAL( otaconfigMAX_REQUEST_WINDOW_SIZE / 2U, otaAgent.requestWindow.windowSize );
+        TEST_ASSERT_EQUAL( otaconfigMAX_REQUEST_WINDOW_SIZE / 2U, otaAgent.requestWindow.threshold );
+        TEST_ASSERT_EQUAL( otaconfigMAX_REQUEST_WINDOW_SIZE - 2U, otaAgent.requestWindow.blocksInFlight );
+        TEST_ASSERT_EQUAL( otaAgent.statistics.otaPacketsDropped, otaAgent.requestWindow.packetsDropped );
+    #else
+        TEST_IGNORE_MESSAGE( "The blocks are requested one at a time." );
+    #endif
+}
+
+/* Test that a request timeout collapses the request window and requests the missing blocks again. */
+void test_OTA_RequestWindowShrinksOnTimeout()
+{
+    #if ( otaconfigMAX_REQUEST_WINDOW_SIZE > 0U )
+        OtaEventMsg_t otaEvent = { 0 };
+
+        pOtaJobDoc = JOB_DOC_A;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaAgent.requestWindow.windowSize = otaconfigMAX_REQUEST_WINDOW_SIZE;
+        otaAgent.requestWindow.blocksInFlight = otaconfigMAX_REQUEST_WINDOW_SIZE;
+        otaAgent.requestWindow.nextBlock = OTA_TEST_FILE_NUM_BLOCKS;
+
+        otaEvent.eventId = OtaAgentEventRequestTimer;
+        OTA_SignalEvent( &otaEvent );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        /* The window restarts from a single block at the first missing block. */
+        TEST_ASSERT_EQUAL( 1, otaAgent.requestWindow.windowSize );
+        TEST_ASSERT_EQUAL( otaconfigMAX_REQUEST_WINDOW_SIZE / 2U, otaAgent.requestWindow.threshold );
+        TEST_ASSERT_EQUAL( 1, otaAgent.requestWindow.blocksInFlight );
+        TEST_ASSERT_EQUAL( 1, otaAgent.requestWindow.nextBlock );
+
+        /* The request sent after the timeout adds to the momentum of the first request. */
+        TEST_ASSERT_EQUAL( 2, otaAgent.requestMomentum );
+    #else
+        TEST_IGNORE_MESSAGE( "The blocks are requested one at a time." );
+    #endif
+}
+
+/* Test that the request window is kept within the event buffers left in the pool. */
+void test_OTA_RequestWindowLimitedByEventBuffers()
+{
+    #if ( ( otaconfigMAX_REQUEST_WINDOW_SIZE > 0U ) && ( otaconfigEVENT_BUFFER_POOL_SIZE > 0U ) )
+        OtaEventMsg_t otaEvent = { 0 };
+        OtaEventData_t * pBuffers[ otaconfigEVENT_BUFFER_POOL_SIZE - 1 ] = { 0 };
+        uint32_t i = 0;
+
+        pOtaJobDoc = JOB_DOC_A;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        /* Hold all the buffers but one, as if blocks were queued for the agent. */
+        for( i = 0; i < otaconfigEVENT_BUFFER_POOL_SIZE - 1; i++ )
+        {
+            pBuffers[ i ] = OTA_EventBufferGet();
+            TEST_ASSERT_NOT_NULL( pBuffers[ i ] );
+        }
+
+        otaAgent.requestWindow.windowSize = otaconfigMAX_REQUEST_WINDOW_SIZE;
+        otaAgent.requestWindow.blocksInFlight = 0;
+        otaAgent.requestWindow.nextBlock = 0;
+
+        otaEvent.eventId = OtaAgentEventRequestFileBlock;
+        OTA_SignalEvent( &otaEvent );
+        receiveAndProcessOtaEvent();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        /* Only one block is requested, there is no buffer to receive more. */
+        TEST_ASSERT_EQUAL( 1, otaAgent.requestWindow.windowSize );
+        TEST_ASSERT_EQUAL( 1, otaAgent.requestWindow.blocksInFlight );
+
+        for( i = 0; i < otaconfigEVENT_BUFFER_POOL_SIZE - 1; i++ )
+        {
+            OTA_EventBufferFree( pBuffers[ i ] );
+        }
+    #else
+        TEST_IGNORE_MESSAGE( "The agent has no pool of event buffers." );
+    #endif
+}
+
+/* Test that the classic request-and-drain scheme is still used when the request window is closed. */
+void test_OTA_ReceiveFileBlockCompleteMqttWithoutWindow()
+{
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaAgent.requestWindow.windowSize = 0;
+    otaAgent.numOfBlocksToReceive = otaconfigMAX_NUM_BLOCKS_REQUEST;
+
+    test_OTA_ReceiveFileBlockCompleteMqtt();
+}
+
+/* Check that the last request published is for the given part of the block bitmap. */
+static void otaCheckPublishedBitmap( uint32_t blockOffset,
+                                     uint8_t * pBitmap,
+                                     size_t bitmapLen )
+{
+    uint8_t expectedMessage[ OTA_REQUEST_MSG_MAX_SIZE ];
+    size_t expectedSize = 0;
+    bool result = false;
+
+    result = OTA_CBOR_Encode_GetStreamRequestMessage( expectedMessage,
+                                                      sizeof( expectedMessage ),
+                                                      &expectedSize,
+                                                      "rdy", /* Client token sent by the MQTT data plane. */
+                                                      ( int32_t ) otaAgent.fileContext.serverFileID,
+                                                      OTA_FILE_BLOCK_SIZE,
+                                                      ( int32_t ) blockOffset,
+                                                      pBitmap,
+                                                      bitmapLen,
+                                                      otaconfigMAX_NUM_BLOCKS_REQUEST );
+    TEST_ASSERT_TRUE( result );
+    TEST_ASSERT_EQUAL( expectedSize, publishedMessageSize );
+    TEST_ASSERT_EQUAL_MEMORY( expectedMessage, publishedMessage, expectedSize );
+}
+
+/* Test that only the part of the bitmap from the first missing block on is sent when the window is closed. */
+void test_OTA_MQTT_RequestCompactBitmap()
+{
+    #if ( otaconfigCOMPACT_BLOCK_BITMAP == 1U )
+        OtaErr_t err = OtaErrNone;
+        uint8_t bitmapFirstByteOnly[] = { 0xF0 };
+        uint8_t bitmapUpToLastBlock[] = { 0x10, 0x01, 0x00, 0x03 };
+
+        pOtaJobDoc = JOB_DOC_A;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.mqtt.publish = mockMqttPublishRecordMessage;
+        otaAgent.requestWindow.windowSize = 0;
+
+        /* Pretend a file of 64 blocks of which the first 28 have been received. */
+        otaAgent.fileContext.fileSize = 64U * OTA_FILE_BLOCK_SIZE;
+        memset( otaAgent.fileContext.pRxBlockBitmap, 0, 8 );
+        memset( &otaAgent.fileContext.pRxBlockBitmap[ 3 ], 0xFF, 5 );
+        otaAgent.fileContext.pRxBlockBitmap[ 3 ] = 0xF0;
+
+        /* The blocks requested are all in the first byte that is not received. */
+        err = requestFileBlock_Mqtt( &otaAgent );
+        TEST_ASSERT_EQUAL( OtaErrNone, err );
+        otaCheckPublishedBitmap( 24, bitmapFirstByteOnly, sizeof( bitmapFirstByteOnly ) );
+
+        /* The bitmap ends at the byte that holds the last block requested. */
+        memset( otaAgent.fileContext.pRxBlockBitmap, 0, 8 );
+        otaAgent.fileContext.pRxBlockBitmap[ 3 ] = 0x10;
+        otaAgent.fileContext.pRxBlockBitmap[ 4 ] = 0x01;
+        otaAgent.fileContext.pRxBlockBitmap[ 6 ] = 0x03;
+        otaAgent.fileContext.pRxBlockBitmap[ 7 ] = 0x80;
+
+        err = requestFileBlock_Mqtt( &otaAgent );
+        TEST_ASSERT_EQUAL( OtaErrNone, err );
+        otaCheckPublishedBitmap( 24, bitmapUpToLastBlock, sizeof( bitmapUpToLastBlock ) );
+
+        /* The whole bitmap is kept when no block is missing. */
+        memset( otaAgent.fileContext.pRxBlockBitmap, 0, 8 );
+
+        err = requestFileBlock_Mqtt( &otaAgent );
+        TEST_ASSERT_EQUAL( OtaErrNone, err );
+        otaCheckPublishedBitmap( 0, otaAgent.fileContext.pRxBlockBitmap, 8 );
+    #else
+        TEST_IGNORE_MESSAGE( "The whole block bitmap is sent." );
+    #endif
+}
+
+/* Test that the data requests of a file are published to its get stream topic, which is rendered once per file. */
+void test_OTA_MQTT_RequestTopicCached()
+{
+    OtaErr_t err = OtaErrNone;
+
+    pOtaJobDoc = JOB_DOC_A;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.mqtt.publish = mockMqttPublishRecordMessage;
+    otaAgent.requestWindow.windowSize = 0;
+
+    err = requestFileBlock_Mqtt( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL_STRING( "$aws/things/ota_utest/streams/AFR_OTA-XYZ/get/cbor", publishedTopic );
+    TEST_ASSERT_GREATER_THAN( 0, otaAgent.requestCache.requestPrefixLength );
+
+    /* The topic of the next request comes from the cache. */
+    memset( otaAgent.fileContext.pStreamName, 'X', 3 );
+    err = requestFileBlock_Mqtt( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL_STRING( "$aws/things/ota_utest/streams/AFR_OTA-XYZ/get/cbor", publishedTopic );
+
+    /* The transfer of a new file renders it again. */
+    err = initFileTransfer_Mqtt( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    otaAgent.requestWindow.windowSize = 0;
+    err = requestFileBlock_Mqtt( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL_STRING( "$aws/things/ota_utest/streams/XXX_OTA-XYZ/get/cbor", publishedTopic );
+}
+
+/* Test that the status topic is rendered again when the active job changes. */
+void test_OTA_MQTT_StatusTopicFollowsActiveJob()
+{
+    OtaErr_t err = OtaErrNone;
+
+    pOtaJobDoc = JOB_DOC_A;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.mqtt.publish = mockMqttPublishRecordMessage;
+
+    err = updateJobStatus_Mqtt( &otaAgent, JobStatusInProgress, JobReasonReceiving, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL_STRING( "$aws/things/ota_utest/jobs/AFR_OTA-testjob20/update", publishedTopic );
+
+    /* A job with a name of the same length. */
+    otaAgent.pActiveJobName[ strlen( ( const char * ) otaAgent.pActiveJobName ) - 1U ] = '1';
+    err = updateJobStatus_Mqtt( &otaAgent, JobStatusInProgress, JobReasonReceiving, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL_STRING( "$aws/things/ota_utest/jobs/AFR_OTA-testjob21/update", publishedTopic );
+
+    /* A job with a longer name. */
+    strcpy( ( char * ) otaAgent.pActiveJobName, "AFR_OTA-testjob100" );
+    err = updateJobStatus_Mqtt( &otaAgent, JobStatusInProgress, JobReasonReceiving, 0 );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL_STRING( "$aws/things/ota_utest/jobs/AFR_OTA-testjob100/update", publishedTopic );
+}
+
+/* Open the sliding request window of the HTTP data plane. */
+static void otaHttpOpenRequestWindow( uint32_t windowSize,
+                                      uint32_t blocksPerRange )
+{
+    otaAgent.requestWindow.windowSize = windowSize;
+    otaAgent.requestWindow.threshold = otaconfigMAX_REQUEST_WINDOW_SIZE;
+    otaAgent.requestWindow.blocksInFlight = 0;
+    otaAgent.requestWindow.nextBlock = 0;
+    otaAgent.requestWindow.blocksPerRange = blocksPerRange;
+}
+
+/* Test that the missing blocks in the window are requested as ranges of contiguous blocks. */
+void test_OTA_HTTP_RequestWindowRanges()
+{
+    OtaErr_t err = OtaErrNone;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.http.request = mockHttpRequestRecordRange;
+    httpRangesRequested = 0;
+    otaHttpOpenRequestWindow( OTA_TEST_FILE_NUM_BLOCKS, 2 );
+
+    err = requestDataBlock_Http( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL( 2, httpRangesRequested );
+    TEST_ASSERT_EQUAL( 0, httpRangeStarts[ 0 ] );
+    TEST_ASSERT_EQUAL( 2 * OTA_FILE_BLOCK_SIZE - 1, httpRangeEnds[ 0 ] );
+    TEST_ASSERT_EQUAL( 2 * OTA_FILE_BLOCK_SIZE, httpRangeStarts[ 1 ] );
+    TEST_ASSERT_EQUAL( OTA_TEST_FILE_SIZE - 1, httpRangeEnds[ 1 ] );
+    TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS, otaAgent.requestWindow.blocksInFlight );
+
+    /* Nothing is requested while the window is full. */
+    err = requestDataBlock_Http( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL( 2, httpRangesRequested );
+}
+
+/* Test that a file is requested in the block size the agent adapted to. */
+void test_OTA_HTTP_RequestWindowRangesSmallerBlocks()
+{
+    OtaErr_t err = OtaErrNone;
+    uint32_t blockSize = OTA_FILE_BLOCK_SIZE / 2U;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForJob );
+    otaAgent.log2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE - 1U;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE - 1U, otaAgent.fileContext.log2BlockSize );
+
+    otaInterfaces.http.request = mockHttpRequestRecordRange;
+    httpRangesRequested = 0;
+    otaHttpOpenRequestWindow( 2, 1 );
+
+    err = requestDataBlock_Http( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL( 2, httpRangesRequested );
+    TEST_ASSERT_EQUAL( 0, httpRangeStarts[ 0 ] );
+    TEST_ASSERT_EQUAL( blockSize - 1U, httpRangeEnds[ 0 ] );
+    TEST_ASSERT_EQUAL( blockSize, httpRangeStarts[ 1 ] );
+    TEST_ASSERT_EQUAL( 2U * blockSize - 1U, httpRangeEnds[ 1 ] );
+}
+
+/* Test that a failed range request fails the block request. */
+void test_OTA_HTTP_RequestWindowRangesFail()
+{
+    OtaErr_t err = OtaErrNone;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.http.request = mockHttpRequestAlwaysFail;
+    otaHttpOpenRequestWindow( OTA_TEST_FILE_NUM_BLOCKS, 1 );
+
+    err = requestDataBlock_Http( &otaAgent );
+    TEST_ASSERT_EQUAL( OtaErrRequestFileBlockFailed, err );
+    TEST_ASSERT_EQUAL( 0, otaAgent.requestWindow.blocksInFlight );
+}
+
+/* Test that blocks received out of order are stored at the offset they are tagged with. */
+void test_OTA_HTTP_ReceiveFileBlocksOutOfOrder()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+    OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS ];
+    uint32_t fileBlockSize = 0;
+    int idx = 0;
+    int block = 0;
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaInterfaces.os.event.send = mockOSEventSend;
+    otaInterfaces.http.request = mockHttpRequestRecordRange;
+    otaHttpOpenRequestWindow( OTA_TEST_FILE_NUM_BLOCKS, 1 );
+
+    /* Send the blocks last to first, each one filled with its own index. */
+    for( block = OTA_TEST_FILE_NUM_BLOCKS - 1; block >= 0; block-- )
+    {
+        fileBlockSize = min( OTA_TEST_FILE_SIZE - ( uint32_t ) block * OTA_FILE_BLOCK_SIZE, OTA_FILE_BLOCK_SIZE );
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffers[ block ];
+        memset( otaEvent.pEventData->data, block + 1, fileBlockSize );
+        otaEvent.pEventData->dataLength = fileBlockSize;
+        otaEvent.pEventData->fileOffset = ( uint32_t ) block * OTA_FILE_BLOCK_SIZE;
+        OTA_SignalEvent( &otaEvent );
+    }
+
+    /* OTA agent should complete the update and go back to waiting for job state. */
+    processEntireQueue();
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+
+    for( idx = 0; idx < OTA_TEST_FILE_SIZE; ++idx )
+    {
+        TEST_ASSERT_EQUAL( idx / OTA_FILE_BLOCK_SIZE + 1, pOtaFileBuffer[ idx ] );
+    }
+}
+
+/* Test that blocks received out of order are written as runs of contiguous blocks. */
+void test_OTA_HTTP_ReceiveFileBlocksOutOfOrderWriteCombined()
+{
+    otaInterfaces.pal.writeBlock = mockPalWriteBlockRecord;
+    test_OTA_HTTP_ReceiveFileBlocksOutOfOrder();
+
+    /* The last block ends the file and the second one a sector, the first one is written at close. */
+    TEST_ASSERT_EQUAL( 3, writesDone );
+    TEST_ASSERT_EQUAL( 2 * OTA_FILE_BLOCK_SIZE, writeOffsets[ 0 ] );
+    TEST_ASSERT_EQUAL( OTA_FILE_BLOCK_SIZE, writeOffsets[ 1 ] );
+    TEST_ASSERT_EQUAL( OTA_FILE_BLOCK_SIZE, writeSizes[ 1 ] );
+    TEST_ASSERT_EQUAL( 0, writeOffsets[ 2 ] );
+    TEST_ASSERT_EQUAL( OTA_FILE_BLOCK_SIZE, writeSizes[ 2 ] );
+}
+
+/* Test that only the start of the file received in order is given to the streaming digest. */
+void test_OTA_HTTP_ReceiveFileBlocksOutOfOrderStreamingDigest()
+{
+    otaInterfaces.pal.digestUpdate = mockPalDigestUpdate;
+    test_OTA_HTTP_ReceiveFileBlocksOutOfOrder();
+
+    /* The first block is received last, the blocks after it are left for the PAL. */
+    TEST_ASSERT_EQUAL( OTA_FILE_BLOCK_SIZE, digestBytes );
+    TEST_ASSERT_EQUAL( 1, digestBlocks );
+}
+
+/* Test that only the next block of a delta update is applied, the others are requested again. */
+void test_OTA_HTTP_ReceiveDeltaBlocksOutOfOrder()
+{
+    #if ( configOTA_DELTA_UPDATE_FILE_TYPE_ID == 3U )
+        OtaEventMsg_t otaEvent = { 0 };
+        OtaEventData_t eventBuffers[ OTA_TEST_FILE_NUM_BLOCKS ];
+        uint32_t fileBlockSize = 0;
+        int block = 0;
+
+        otaInterfaces.pal.patchBlock = mockPalPatchBlock;
+
+        pOtaJobDoc = JOB_DOC_HTTP_DELTA;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+        otaInterfaces.http.request = mockHttpRequestRecordRange;
+        otaHttpOpenRequestWindow( OTA_TEST_FILE_NUM_BLOCKS, 1 );
+
+        /* Send the blocks last to first. */
+        for( block = OTA_TEST_FILE_NUM_BLOCKS - 1; block >= 0; block-- )
+        {
+            fileBlockSize = min( OTA_TEST_FILE_SIZE - ( uint32_t ) block * OTA_FILE_BLOCK_SIZE, OTA_FILE_BLOCK_SIZE );
+            otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+            otaEvent.pEventData = &eventBuffers[ block ];
+            memset( otaEvent.pEventData->data, block + 1, fileBlockSize );
+            otaEvent.pEventData->dataLength = fileBlockSize;
+            otaEvent.pEventData->fileOffset = ( uint32_t ) block * OTA_FILE_BLOCK_SIZE;
+            OTA_SignalEvent( &otaEvent );
+        }
+
+        /* Only the first block is applied, the file is still being received. */
+        processEntireQueue();
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+        TEST_ASSERT_EQUAL( OTA_FILE_BLOCK_SIZE, patchedBytes );
+        TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS - 1, otaAgent.fileContext.blocksRemaining );
+    #else
+        TEST_IGNORE_MESSAGE( "The files of type 3 are not delta updates." );
+    #endif
+}
+
+/* Test that a block of a delta update received early frees its slot and has the missing block requested at once. */
+void test_OTA_HTTP_ReceiveDeltaBlockEarlyRequestsMissingBlock()
+{
+    #if ( configOTA_DELTA_UPDATE_FILE_TYPE_ID == 3U )
+        OtaEventMsg_t otaEvent = { 0 };
+
+        otaInterfaces.pal.patchBlock = mockPalPatchBlock;
+
+        pOtaJobDoc = JOB_DOC_HTTP_DELTA;
+        otaGoToState( OtaAgentStateWaitingForFileBlock );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+        otaInterfaces.os.event.send = mockOSEventSend;
+        otaInterfaces.http.request = mockHttpRequestRecordRange;
+        otaHttpOpenRequestWindow( 2, 1 );
+
+        /* The first two blocks are in flight. */
+        TEST_ASSERT_EQUAL( OtaErrNone, requestDataBlock_Http( &otaAgent ) );
+        TEST_ASSERT_EQUAL( 2, otaAgent.requestWindow.blocksInFlight );
+        httpRangesRequested = 0;
+
+        /* The second block arrives first. */
+        otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+        otaEvent.pEventData = &eventBuffer;
+        memset( eventBuffer.data, 2, OTA_FILE_BLOCK_SIZE );
+        eventBuffer.dataLength = OTA_FILE_BLOCK_SIZE;
+        eventBuffer.fileOffset = OTA_FILE_BLOCK_SIZE;
+        OTA_SignalEvent( &otaEvent );
+        processEntireQueue();
+
+        /* It is not applied, and its slot is used to request the first block again, without shrinking the window. */
+        TEST_ASSERT_EQUAL( 0, patchedBytes );
+        TEST_ASSERT_EQUAL( OTA_TEST_FILE_NUM_BLOCKS, otaAgent.fileContext.blocksRemaining );
+        TEST_ASSERT_EQUAL( 1, httpRangesRequested );
+        TEST_ASSERT_EQUAL( 0, httpRangeStarts[ 0 ] );
+        TEST_ASSERT_EQUAL( 2, otaAgent.requestWindow.windowSize );
+        TEST_ASSERT_EQUAL( 2, otaAgent.requestWindow.blocksInFlight );
+        TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+    #else
+        TEST_IGNORE_MESSAGE( "The files of type 3 are not delta updates." );
+    #endif
+}
+
+/* Test that a block tagged with an offset that is not block aligned fails the job. */
+void test_OTA_HTTP_ReceiveFileBlockUnalignedOffset()
+{
+    OtaEventMsg_t otaEvent = { 0 };
+
+    pOtaJobDoc = JOB_DOC_HTTP;
+    otaGoToState( OtaAgentStateWaitingForFileBlock );
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForFileBlock, OTA_GetState() );
+
+    otaHttpOpenRequestWindow( OTA_TEST_FILE_NUM_BLOCKS, 1 );
+
+    otaEvent.eventId = OtaAgentEventReceivedFileBlock;
+    otaEvent.pEventData = &eventBuffer;
+    memset( eventBuffer.data, 1, OTA_FILE_BLOCK_SIZE );
+    eventBuffer.dataLength = OTA_FILE_BLOCK_SIZE;
+    eventBuffer.fileOffset = OTA_FILE_BLOCK_SIZE / 2;
+    OTA_SignalEvent( &otaEvent );
+    receiveAndProcessOtaEvent();
+
+    TEST_ASSERT_EQUAL( OtaAgentStateWaitingForJob, OTA_GetState() );
+    TEST_ASSERT_EQUAL( 0, pOtaFileBuffer[ 0 ] );
+}
+
+/* Test that the HTTP body is lent in place when no payload buffer is given. */
+void test_OTA_HTTP_DecodeFileBlockInPlace()
+{
+    OtaErr_t err = OtaErrNone;
+    uint8_t pMessage[ OTA_FILE_BLOCK_SIZE ] = { 0 };
+    uint8_t * pPayload = NULL;
+    size_t payloadSize = 0;
+    int32_t fileId = -1;
+    int32_t blockId = 1;
+    int32_t blockSize = 0;
+
+    err = decodeFileBlock_Http( &otaAgent, pMessage, sizeof( pMessage ), &fileId, &blockId, &blockSize, &pPayload, &payloadSize );
+    TEST_ASSERT_EQUAL( OtaErrNone, err );
+    TEST_ASSERT_EQUAL_PTR( pMessage, pPayload );
+    TEST_ASSERT_EQUAL( sizeof( pMessage ), payloadSize );
+    TEST_ASSERT_EQUAL( 1, blockId );
+}
+
 /* Test data cleanup fails with HTTP deinit failure*/
 void test_OTA_HTTP_cleanupFailed()
 {
@@ -3120,6 +5741,8 @@ void test_OTA_validateDataBlockInputSize()
 {
     OtaFileContext_t fileContext = { 0 };
 
+    fileContext.log2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE;
+
     /* Test for when the block received is the final block. */
     fileContext.fileSize = OTA_FILE_BLOCK_SIZE;
     /* Block size is too small. */
@@ -3139,6 +5762,67 @@ void test_OTA_validateDataBlockInputSize()
     TEST_ASSERT_EQUAL( false, validateDataBlock( &fileContext, 0, OTA_FILE_BLOCK_SIZE + 1 ) );
 }
 
+void test_OTA_chooseFileBlockSizeFitsBitmap()
+{
+    #if ( otaconfigMIN_LOG2_FILE_BLOCK_SIZE < otaconfigLOG2_FILE_BLOCK_SIZE )
+        OtaFileContext_t fileContext = { 0 };
+
+        otaAgent.log2BlockSize = otaconfigMIN_LOG2_FILE_BLOCK_SIZE;
+        otaAgent.requestTimeouts = 1U;
+
+        /* The smallest blocks are used when the bitmap can track all of them. */
+        fileContext.fileSize = OTA_TEST_FILE_SIZE;
+        TEST_ASSERT_EQUAL( ( OTA_TEST_FILE_SIZE + 1023U ) / 1024U, chooseFileBlockSize( &fileContext ) );
+        TEST_ASSERT_EQUAL( otaconfigMIN_LOG2_FILE_BLOCK_SIZE, fileContext.log2BlockSize );
+        TEST_ASSERT_EQUAL( 0U, otaAgent.requestTimeouts );
+
+        /* The blocks are made larger when there are too many to fit in the bitmap. */
+        fileContext.fileSize = ( OTA_MAX_BLOCK_BITMAP_SIZE * BITS_PER_BYTE ) << otaconfigMIN_LOG2_FILE_BLOCK_SIZE;
+        fileContext.fileSize++;
+        TEST_ASSERT_EQUAL( OTA_MAX_BLOCK_BITMAP_SIZE * BITS_PER_BYTE / 2U + 1U, chooseFileBlockSize( &fileContext ) );
+        TEST_ASSERT_EQUAL( otaconfigMIN_LOG2_FILE_BLOCK_SIZE + 1U, fileContext.log2BlockSize );
+    #else
+        TEST_IGNORE_MESSAGE( "The block size of the files does not adapt." );
+    #endif
+}
+
+void test_OTA_adaptBlockSize()
+{
+    #if ( otaconfigMIN_LOG2_FILE_BLOCK_SIZE < otaconfigLOG2_FILE_BLOCK_SIZE )
+        otaAgent.fileContext.fileSize = OTA_TEST_FILE_SIZE;
+        otaAgent.fileContext.log2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE;
+        otaAgent.log2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE;
+
+        /* An abort shrinks the blocks down to the minimum size. */
+        adaptBlockSize( true );
+        TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE - 1U, otaAgent.log2BlockSize );
+        adaptBlockSize( true );
+        adaptBlockSize( true );
+        TEST_ASSERT_EQUAL( otaconfigMIN_LOG2_FILE_BLOCK_SIZE, otaAgent.log2BlockSize );
+
+        /* A file with more than one timeout every 8 blocks shrinks them too. */
+        otaAgent.log2BlockSize = otaconfigLOG2_FILE_BLOCK_SIZE;
+        otaAgent.requestTimeouts = 1U;
+        adaptBlockSize( false );
+        TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE - 1U, otaAgent.log2BlockSize );
+        TEST_ASSERT_EQUAL( 0U, otaAgent.requestTimeouts );
+
+        /* A file with fewer timeouts keeps the block size. */
+        otaAgent.fileContext.fileSize = 16U * OTA_FILE_BLOCK_SIZE;
+        otaAgent.requestTimeouts = 1U;
+        adaptBlockSize( false );
+        TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE - 1U, otaAgent.log2BlockSize );
+
+        /* A file without timeouts grows the blocks up to the maximum size. */
+        adaptBlockSize( false );
+        TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE, otaAgent.log2BlockSize );
+        adaptBlockSize( false );
+        TEST_ASSERT_EQUAL( otaconfigLOG2_FILE_BLOCK_SIZE, otaAgent.log2BlockSize );
+    #else
+        TEST_IGNORE_MESSAGE( "The block size of the files does not adapt." );
+    #endif
+}
+
 void test_ingestDataBlockCleanup_NullFile()
 {
     OtaFileContext_t fileContext = { 0 };
@@ -36,6 +36,11 @@
 
 /* ========================================================================== */
 
+/* Clock of the latency statistics, read with otaconfigLATENCY_TIMESTAMP(). */
+uint32_t utestLatencyClock = 0;
+
+/* ========================================================================== */
+
 CborError createOtaStreamingMessage( uint8_t * pMessageBuffer,
                                      size_t messageBufferSize,
                                      int blockIndex,